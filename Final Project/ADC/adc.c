@@ -1,5 +1,6 @@
 #include "adc.h"
 #include "stm32f4xx.h"
+#include "delay.h"
 #include <stdbool.h>
 
 #define ADC_CR1_RES_Pos             (24U) /* Position of RES bits in CR1 */
@@ -15,13 +16,8 @@ typedef struct {
     uint32_t           RCC_AHB1ENR_DMAxEN; /* RCC AHB1ENR bit for DMA */
 } ADC_DMA_configInfo;
 
-/**
- * @brief Simple delay function (busy-wait loop).
- */
-static void simple_delay(volatile uint32_t count) {
-    while (count--)
-        ;
-}
+/* Time allowed for ADON to take effect after it is cleared */
+#define ADC_POWER_DOWN_US           1U
 
 /**
  * @brief Configures the DMA for ADC operations.
@@ -162,7 +158,7 @@ void ADC_Init(ADC_TypeDef *adc, ADC_Resolution resolution,
     /* Ensure ADC is disabled before configuration */
     if (adc->CR2 & ADC_CR2_ADON) {
         adc->CR2 &= ~ADC_CR2_ADON;
-        simple_delay(100);
+        delay_us(ADC_POWER_DOWN_US);
     }
 
     /* 1. Configure Common ADC settings (CCR) */
@@ -281,6 +277,34 @@ void ADC_configChannel(ADC_TypeDef *adc, uint8_t channel,
     adc->SQR3 |= (channel & ADC_SQR3_SQ1_CLEAR_Mask);
 }
 
+/**
+ * @brief Computes the conversion rate of a continuous single-channel ADC.
+ * @param adc Pointer to the ADC peripheral.
+ * @param pclk2_hz APB2 clock the ADC prescaler divides.
+ * @return Conversions per second of the first channel of the regular
+ * sequence: ADCCLK / (sampling time + conversion time).
+ */
+uint32_t ADC_getSampleRate(ADC_TypeDef *adc, uint32_t pclk2_hz) {
+    static const uint16_t sample_cycles[8] = {
+        3, 15, 28, 56, 84, 112, 144, 480
+    };
+    /* 12, 10, 8 and 6 bits: resolution plus 3 cycles */
+    static const uint8_t convert_cycles[4] = { 15, 13, 11, 9 };
+    uint32_t channel = adc->SQR3 & ADC_SQR3_SQ1_CLEAR_Mask;
+    uint32_t smp;
+
+    if (channel < 10) {
+        smp = (adc->SMPR2 >> (channel * 3)) & ADC_SMPR_SMP_CLEAR_Mask;
+    } else {
+        smp = (adc->SMPR1 >> ((channel - 10) * 3)) & ADC_SMPR_SMP_CLEAR_Mask;
+    }
+    uint32_t prescaler = 2U * (((ADC->CCR & ADC_CCR_ADCPRE)
+            >> ADC_CCR_ADCPRE_Pos) + 1U);
+    uint32_t res = (adc->CR1 & ADC_CR1_RES) >> ADC_CR1_RES_Pos;
+
+    return pclk2_hz / prescaler / (sample_cycles[smp] + convert_cycles[res]);
+}
+
 /**
  * @brief Enables the ADC peripheral (sets the ADON bit).
  * @note This function waits for the ADC to stabilize after enabling.
@@ -293,8 +317,21 @@ void ADC_Enable(ADC_TypeDef *adc) {
     }
     if (!(adc->CR2 & ADC_CR2_ADON)) {
         adc->CR2 |= ADC_CR2_ADON;
-        simple_delay(100);
+        delay_us(ADC_STABILIZATION_US);
+    }
+}
+
+/**
+ * @brief Powers on the ADC (sets the ADON bit) without waiting.
+ * @note The caller must let ADC_STABILIZATION_US elapse before the first
+ * conversion. Used by the boot sequencer to overlap tSTAB with other drivers.
+ * @param adc Pointer to the ADC peripheral.
+ */
+void ADC_powerOn(ADC_TypeDef *adc) {
+    if (!adc) {
+        return;
     }
+    adc->CR2 |= ADC_CR2_ADON;
 }
 
 /**
@@ -309,7 +346,7 @@ void ADC_Disable(ADC_TypeDef *adc) {
     /* Ensure no conversion is ongoing before disabling */
     if (adc->CR2 & ADC_CR2_ADON) {
         adc->CR2 &= ~ADC_CR2_ADON;
-        simple_delay(10);
+        delay_us(ADC_POWER_DOWN_US);
     }
 }
 
@@ -468,7 +505,7 @@ void ADC_DMA_Config(ADC_TypeDef *adc, uint16_t *pData, uint16_t length,
     /* Ensure ADC is disabled before changing DMA-related ADC settings */
     if (adc->CR2 & ADC_CR2_ADON) {
         adc->CR2 &= ~ADC_CR2_ADON;
-        simple_delay(100); // Wait for ADOFF
+        delay_us(ADC_POWER_DOWN_US); // Wait for ADOFF
     }
 
     /* Enable DMA mode for ADC */
@@ -501,9 +538,8 @@ void ADC_DMA_Config(ADC_TypeDef *adc, uint16_t *pData, uint16_t length,
     if (dma_stream->CR & DMA_SxCR_EN) {
         dma_stream->CR &= ~DMA_SxCR_EN;
         /* Wait for EN bit to be cleared */
-        while (dma_stream->CR & DMA_SxCR_EN) {
-            simple_delay(10);
-        }
+        while (dma_stream->CR & DMA_SxCR_EN)
+            ;
     }
 
     /* Clear all interrupt flags for the stream */
@@ -595,9 +631,8 @@ void ADC_DMA_Disable(ADC_TypeDef *adc) {
     if (dma_stream->CR & DMA_SxCR_EN) {
         dma_stream->CR &= ~DMA_SxCR_EN; /* Clear EN bit to disable stream */
         /* Wait for the EN bit to be cleared by hardware, indicating the stream is fully disabled. */
-        while (dma_stream->CR & DMA_SxCR_EN) {
-            simple_delay(10); /* Short delay while polling */
-        }
+        while (dma_stream->CR & DMA_SxCR_EN)
+            ;
     }
 }
 
@@ -671,3 +706,69 @@ void ADC_DMA_clearFlag(ADC_TypeDef *adc, ADC_DMA_genericFlag generic_flag) {
         dma_peripheral->HIFCR |= dma_clear_flag_bitmask;
     }
 }
+
+/**
+ * @brief Sets or clears the interrupt enable bit of a DMA event for the ADC.
+ */
+static void ADC_DMA_setInterrupt(ADC_TypeDef *adc,
+        ADC_DMA_genericFlag generic_flag, bool enable) {
+    ADC_DMA_configInfo dma_info;
+    if (!ADC_DMA_getInfo(adc, &dma_info)) {
+        return; /* Unsupported ADC */
+    }
+    DMA_Stream_TypeDef *dma_stream = dma_info.DMA_Stream;
+
+    /* The FIFO error enable lives in FCR, the other events in CR */
+    if (generic_flag == ADC_DMA_FLAG_FE) {
+        if (enable) {
+            dma_stream->FCR |= DMA_SxFCR_FEIE;
+        } else {
+            dma_stream->FCR &= ~DMA_SxFCR_FEIE;
+        }
+        return;
+    }
+
+    uint32_t enable_bit;
+    switch (generic_flag) {
+    case ADC_DMA_FLAG_TC:
+        enable_bit = DMA_SxCR_TCIE;
+        break;
+    case ADC_DMA_FLAG_HT:
+        enable_bit = DMA_SxCR_HTIE;
+        break;
+    case ADC_DMA_FLAG_TE:
+        enable_bit = DMA_SxCR_TEIE;
+        break;
+    case ADC_DMA_FLAG_DME:
+        enable_bit = DMA_SxCR_DMEIE;
+        break;
+    default:
+        return;
+    }
+
+    if (enable) {
+        dma_stream->CR |= enable_bit;
+    } else {
+        dma_stream->CR &= ~enable_bit;
+    }
+}
+
+/**
+ * @brief Enables the DMA stream interrupt for one event of the ADC transfer.
+ * @param adc Pointer to the ADC peripheral.
+ * @param generic_flag The event to interrupt on (e.g., ADC_DMA_FLAG_HT).
+ */
+void ADC_DMA_enableInterrupt(ADC_TypeDef *adc,
+        ADC_DMA_genericFlag generic_flag) {
+    ADC_DMA_setInterrupt(adc, generic_flag, true);
+}
+
+/**
+ * @brief Disables the DMA stream interrupt for one event of the ADC transfer.
+ * @param adc Pointer to the ADC peripheral.
+ * @param generic_flag The event to stop interrupting on.
+ */
+void ADC_DMA_disableInterrupt(ADC_TypeDef *adc,
+        ADC_DMA_genericFlag generic_flag) {
+    ADC_DMA_setInterrupt(adc, generic_flag, false);
+}
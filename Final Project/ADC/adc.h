@@ -8,6 +8,9 @@ extern "C" {
 #include "stm32f4xx.h"
 #include <stdint.h>
 
+/* ADC power-up stabilization time tSTAB (datasheet max 3 us) */
+#define ADC_STABILIZATION_US        3U
+
 /* ADC Resolution (CR1 Register, RES bits) */
 typedef enum {
     /* 00: 12-bit (15 ADCCLK cycles) */
@@ -104,11 +107,23 @@ void ADC_deInit(ADC_TypeDef *adc);
 void ADC_configChannel(ADC_TypeDef *adc, uint8_t channel,
         ADC_sampleTime sampleTime);
 
+/**
+ * @brief Returns the conversions per second of a continuous single-channel
+ * ADC, from its live prescaler, resolution and sampling time.
+ * @param pclk2_hz APB2 clock, e.g. from ClockMgr_getInfo
+ */
+uint32_t ADC_getSampleRate(ADC_TypeDef *adc, uint32_t pclk2_hz);
+
 /**
  * @brief Enables the specified ADC peripheral.
  */
 void ADC_Enable(ADC_TypeDef *adc);
 
+/**
+ * @brief Powers on the specified ADC without waiting for it to stabilize.
+ */
+void ADC_powerOn(ADC_TypeDef *adc);
+
 /**
  * @brief Disables the specified ADC peripheral.
  */
@@ -178,6 +193,19 @@ uint8_t ADC_DMA_getFlagStatus(ADC_TypeDef *adc,
  */
 void ADC_DMA_clearFlag(ADC_TypeDef *adc, ADC_DMA_genericFlag generic_flag);
 
+/**
+ * @brief Enables the DMA stream interrupt for one event of the ADC transfer.
+ * @note You MUST also enable the DMA stream interrupt in the NVIC separately.
+ */
+void ADC_DMA_enableInterrupt(ADC_TypeDef *adc,
+        ADC_DMA_genericFlag generic_flag);
+
+/**
+ * @brief Disables the DMA stream interrupt for one event of the ADC transfer.
+ */
+void ADC_DMA_disableInterrupt(ADC_TypeDef *adc,
+        ADC_DMA_genericFlag generic_flag);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,69 @@
+#include "boot_sequencer.h"
+
+/**
+ * @brief Microseconds elapsed between two DWT cycle counter samples.
+ */
+static uint32_t Boot_cyclesToUs(uint32_t cycles) {
+    return cycles / (SystemCoreClock / 1000000);
+}
+
+/**
+ * @brief Runs all phases of a boot table until every one has completed.
+ * @param phases Phase table, executed interleaved in table order.
+ * @param count Number of phases (at most BOOT_MAX_PHASES).
+ * @return Total boot time in microseconds.
+ */
+uint32_t Boot_run(boot_phase_t *phases, uint8_t count) {
+    /* Per-phase resume time, in DWT cycles since boot start */
+    uint32_t resume_at[BOOT_MAX_PHASES] = { 0 };
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t done_mask = 0;
+    uint32_t all_mask;
+    uint32_t boot_start = DWT->CYCCNT;
+
+    if (count > BOOT_MAX_PHASES) {
+        count = BOOT_MAX_PHASES;
+    }
+    all_mask = (1UL << count) - 1;
+
+    for (uint8_t i = 0; i < count; i++) {
+        phases[i].start_us = 0;
+        phases[i].done_us = 0;
+        phases[i].busy_us = 0;
+        phases[i].steps = 0;
+        phases[i].done = 0;
+    }
+
+    while (done_mask != all_mask) {
+        for (uint8_t i = 0; i < count; i++) {
+            boot_phase_t *phase = &phases[i];
+            uint32_t now = DWT->CYCCNT - boot_start;
+
+            if (phase->done || (phase->depends_on & ~done_mask) != 0
+                    || (int32_t) (now - resume_at[i]) < 0) {
+                continue;
+            }
+
+            if (phase->steps == 0) {
+                phase->start_us = Boot_cyclesToUs(now);
+            }
+
+            uint32_t wait_us = 0;
+            uint32_t t0 = DWT->CYCCNT;
+            uint8_t finished = phase->step(&wait_us);
+            uint32_t t1 = DWT->CYCCNT;
+
+            phase->busy_us += Boot_cyclesToUs(t1 - t0);
+            phase->steps++;
+            if (finished) {
+                phase->done = 1;
+                phase->done_us = Boot_cyclesToUs(t1 - boot_start);
+                done_mask |= (1UL << i);
+            } else {
+                resume_at[i] = (t1 - boot_start) + wait_us * cycles_per_us;
+            }
+        }
+    }
+
+    return Boot_cyclesToUs(DWT->CYCCNT - boot_start);
+}
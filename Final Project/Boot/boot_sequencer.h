@@ -0,0 +1,44 @@
+#ifndef BOOT_SEQUENCER_H_
+#define BOOT_SEQUENCER_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* Maximum number of phases a boot table may contain */
+#define BOOT_MAX_PHASES 8
+
+/**
+ * @brief Resumable init step.
+ * @param wait_us Receives how long the hardware needs before the next call.
+ * @return 1 when the phase is complete, 0 if it must be called again.
+ * A step must never block; it issues the next hardware action and returns.
+ */
+typedef uint8_t (*boot_step_fn)(uint32_t *wait_us);
+
+/**
+ * @brief One boot phase and its timing record.
+ */
+typedef struct {
+    const char *name;        /* Short name for reports */
+    boot_step_fn step;       /* Resumable init function */
+    uint32_t depends_on;     /* Bit mask of phase indexes that must finish first */
+    /* Filled in by Boot_run */
+    uint32_t start_us;       /* First step call, relative to Boot_run entry */
+    uint32_t done_us;        /* Completion time, relative to Boot_run entry */
+    uint32_t busy_us;        /* CPU time spent inside the step function */
+    uint16_t steps;          /* Number of step calls */
+    uint8_t done;            /* 1 once the step reported completion */
+} boot_phase_t;
+
+/**
+ * @brief Runs all phases of a boot table until every one has completed.
+ * @param phases Phase table, executed interleaved in table order.
+ * @param count Number of phases (at most BOOT_MAX_PHASES).
+ * @return Total boot time in microseconds.
+ * @note While a phase waits for its hardware, the sequencer keeps stepping
+ * the other phases, so independent power-on delays overlap.
+ * Uses the DWT cycle counter; Delay_Init must have been called.
+ */
+uint32_t Boot_run(boot_phase_t *phases, uint8_t count);
+
+#endif /* BOOT_SEQUENCER_H_ */
@@ -0,0 +1,316 @@
+#include "button.h"
+#include "delay.h"
+#include "gpio.h"
+#include "exti.h"
+
+/* EXTI_IRQ_PRIORITY is the lowest, same as SysTick, so the EXTI handler
+ * and the scan never preempt each other while they share button_scanning */
+
+/**
+ * @brief Debounce state of one GPIO port. Bit n of every mask is pin n.
+ */
+typedef struct {
+    GPIO_TypeDef *port;
+    uint16_t mask;              /* Pins that carry a button */
+    uint16_t state;             /* Debounced level, 1 = pressed */
+    uint16_t cnt0;              /* Vertical counter, low bit */
+    uint16_t cnt1;              /* Vertical counter, high bit */
+    uint8_t pin_to_button[16];
+} button_port_t;
+
+/**
+ * @brief Hold timing of one button, only updated while it is pressed.
+ */
+typedef struct {
+    uint32_t hold_ms;           /* Time held since the press event */
+    uint32_t next_repeat_ms;    /* Hold time of the next repeat */
+    uint16_t period_ms;         /* Current repeat interval */
+    uint16_t repeats;           /* Repeats posted during this hold */
+} button_hold_t;
+
+static const button_config_t *button_table = 0;
+static uint8_t button_count = 0;
+static button_port_t button_ports[BUTTON_MAX_PORTS];
+static uint8_t port_count = 0;
+static button_hold_t button_holds[BUTTON_MAX];
+static uint16_t button_lines = 0;           /* EXTI lines owned by buttons */
+static volatile uint8_t button_scanning = 0;
+static uint8_t scan_divider = 0;
+
+static button_event_t button_queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;     /* Written by the scan only */
+static volatile uint8_t queue_tail = 0;     /* Written by Button_getEvent only */
+static volatile button_stats_t button_stats;
+
+static void Button_tick(void);
+static void Button_edge(uint8_t line);
+
+/**
+ * @brief Appends an event; drops it if the queue is full.
+ */
+static void Button_post(uint8_t button, uint8_t type, uint16_t repeat) {
+    uint8_t head = queue_head;
+    button_event_t *event = &button_queue[head & (BUTTON_QUEUE_SIZE - 1)];
+
+    if ((uint8_t) (head - queue_tail) >= BUTTON_QUEUE_SIZE) {
+        button_stats.dropped++;
+        return;
+    }
+    event->button = button;
+    event->type = type;
+    event->repeat = repeat;
+    queue_head = head + 1;
+    button_stats.events++;
+}
+
+/**
+ * @brief Finds the port slot for a GPIO port, adding it if needed.
+ * @return The slot, or 0 if all BUTTON_MAX_PORTS slots are taken
+ */
+static button_port_t *Button_portSlot(GPIO_TypeDef *port) {
+    for (uint8_t i = 0; i < port_count; i++) {
+        if (button_ports[i].port == port) {
+            return &button_ports[i];
+        }
+    }
+    if (port_count == BUTTON_MAX_PORTS) {
+        return 0;
+    }
+    button_ports[port_count].port = port;
+    return &button_ports[port_count++];
+}
+
+/**
+ * @brief Returns 1 if any button pin currently reads low.
+ */
+static uint8_t Button_anyLow(void) {
+    for (uint8_t i = 0; i < port_count; i++) {
+        if (~button_ports[i].port->IDR & button_ports[i].mask) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Starts scanning; the EXTI lines stay masked until all is idle.
+ */
+static void Button_wake(void) {
+    EXTI_disableLines(button_lines);
+    button_scanning = 1;
+}
+
+/**
+ * @brief Stops scanning and re-arms the EXTI lines.
+ */
+static void Button_sleep(void) {
+    button_scanning = 0;
+    EXTI_enableLines(button_lines);
+    /* A press between the last scan and unmasking has no edge left */
+    if (Button_anyLow()) {
+        Button_wake();
+    }
+}
+
+/**
+ * @brief Routes the buttons' falling edges to EXTI and starts debouncing.
+ */
+uint8_t Button_Init(const button_config_t *buttons, uint8_t count) {
+    uint16_t lines = 0;
+
+    if (count > BUTTON_MAX) {
+        return 0;
+    }
+    port_count = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t line = (uint16_t) (1U << buttons[i].pin);
+        button_port_t *slot = Button_portSlot(buttons[i].port);
+        if (buttons[i].pin > 15 || (lines & line) || slot == 0) {
+            port_count = 0;
+            return 0;
+        }
+        lines |= line;
+        slot->mask |= line;
+        slot->pin_to_button[buttons[i].pin] = i;
+    }
+
+    button_table = buttons;
+    button_count = count;
+    button_lines = lines;
+    if (!Delay_registerTickHandler(Button_tick)) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (!EXTI_attach(buttons[i].port, buttons[i].pin, EXTI_EDGE_FALLING,
+                Button_edge)) {
+            return 0;
+        }
+    }
+    Button_sleep();
+    return 1;
+}
+
+/**
+ * @brief Takes the oldest event from the queue.
+ */
+uint8_t Button_getEvent(button_event_t *event) {
+    uint8_t tail = queue_tail;
+
+    if (tail == queue_head) {
+        return 0;
+    }
+    *event = button_queue[tail & (BUTTON_QUEUE_SIZE - 1)];
+    queue_tail = tail + 1;
+    return 1;
+}
+
+/**
+ * @brief Returns 1 if events wait in the queue.
+ */
+uint8_t Button_hasEvent(void) {
+    return queue_tail != queue_head;
+}
+
+/**
+ * @brief Returns 1 while the debouncer needs the 1 ms tick.
+ */
+uint8_t Button_isScanning(void) {
+    return button_scanning;
+}
+
+/**
+ * @brief Returns 1 while the button is held (debounced).
+ */
+uint8_t Button_isPressed(uint8_t button) {
+    if (button >= button_count) {
+        return 0;
+    }
+    const button_config_t *b = &button_table[button];
+    for (uint8_t i = 0; i < port_count; i++) {
+        if (button_ports[i].port == b->port) {
+            return (button_ports[i].state >> b->pin) & 1U;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies the event counters.
+ */
+void Button_getStats(button_stats_t *stats) {
+    stats->events = button_stats.events;
+    stats->dropped = button_stats.dropped;
+    stats->bounces = button_stats.bounces;
+    stats->scans = button_stats.scans;
+}
+
+/**
+ * @brief Advances the long-press and repeat timing of a held button.
+ */
+static void Button_hold(uint8_t button) {
+    const button_config_t *b = &button_table[button];
+    button_hold_t *h = &button_holds[button];
+
+    h->hold_ms += BUTTON_SCAN_MS;
+    if ((b->flags & BUTTON_FLAG_LONG_PRESS) && h->hold_ms >= BUTTON_LONG_PRESS_MS
+            && h->hold_ms < BUTTON_LONG_PRESS_MS + BUTTON_SCAN_MS) {
+        Button_post(button, BUTTON_EVENT_LONG_PRESS, 0);
+    }
+    if (!(b->flags & BUTTON_FLAG_REPEAT) || h->hold_ms < h->next_repeat_ms) {
+        return;
+    }
+    h->repeats++;
+    if ((b->flags & BUTTON_FLAG_ACCELERATE)
+            && (h->repeats % BUTTON_ACCEL_REPEATS) == 0
+            && h->period_ms > BUTTON_REPEAT_MIN_MS) {
+        h->period_ms /= 2;
+        if (h->period_ms < BUTTON_REPEAT_MIN_MS) {
+            h->period_ms = BUTTON_REPEAT_MIN_MS;
+        }
+    }
+    h->next_repeat_ms += h->period_ms;
+    Button_post(button, BUTTON_EVENT_REPEAT, h->repeats);
+}
+
+/**
+ * @brief Debounces every button of one port with a single IDR read.
+ * Each pin has a 2-bit counter spread over cnt1:cnt0; it advances while the
+ * sample differs from the debounced state and resets when they agree, so a
+ * pin toggles after 4 differing samples in a row. The cost is the same for
+ * one button or sixteen.
+ * @return 1 while the port still has a pressed or unsettled pin
+ */
+static uint8_t Button_scanPort(button_port_t *p) {
+    uint16_t sample = (uint16_t) (~p->port->IDR & p->mask);
+    uint16_t delta = sample ^ p->state;
+    uint16_t counting = p->cnt0 | p->cnt1;
+
+    /* Counters that were running but see the old level again */
+    uint16_t bounced = counting & ~delta;
+    if (bounced) {
+        button_stats.bounces += (uint32_t) __builtin_popcount(bounced);
+    }
+
+    p->cnt1 = (p->cnt1 ^ p->cnt0) & delta;
+    p->cnt0 = ~p->cnt0 & delta;
+    uint16_t toggle = delta & ~(p->cnt0 | p->cnt1);
+    p->state ^= toggle;
+
+    uint16_t pressed = toggle & p->state;
+    uint16_t released = toggle & ~p->state;
+    uint16_t held = p->state & ~toggle;
+
+    while (pressed) {
+        uint8_t button = p->pin_to_button[__builtin_ctz(pressed)];
+        pressed &= (uint16_t) (pressed - 1);
+        button_holds[button].hold_ms = 0;
+        button_holds[button].next_repeat_ms = BUTTON_REPEAT_DELAY_MS;
+        button_holds[button].period_ms = BUTTON_REPEAT_PERIOD_MS;
+        button_holds[button].repeats = 0;
+        Button_post(button, BUTTON_EVENT_PRESS, 0);
+    }
+    while (released) {
+        uint8_t button = p->pin_to_button[__builtin_ctz(released)];
+        released &= (uint16_t) (released - 1);
+        Button_post(button, BUTTON_EVENT_RELEASE, 0);
+    }
+    while (held) {
+        uint8_t button = p->pin_to_button[__builtin_ctz(held)];
+        held &= (uint16_t) (held - 1);
+        Button_hold(button);
+    }
+
+    return (p->state | p->cnt0 | p->cnt1) != 0;
+}
+
+/**
+ * @brief 1 ms SysTick callback: scans all ports every BUTTON_SCAN_MS while
+ * woken by an edge, and goes back to sleep once everything has settled.
+ */
+static void Button_tick(void) {
+    if (!button_scanning) {
+        return;
+    }
+    if (++scan_divider < BUTTON_SCAN_MS) {
+        return;
+    }
+    scan_divider = 0;
+    button_stats.scans++;
+
+    uint8_t busy = 0;
+    for (uint8_t i = 0; i < port_count; i++) {
+        busy |= Button_scanPort(&button_ports[i]);
+    }
+    if (!busy) {
+        Button_sleep();
+    }
+}
+
+/**
+ * @brief EXTI callback: an edge on any button line starts the scans.
+ */
+static void Button_edge(uint8_t line) {
+    (void) line;
+    Button_wake();
+}
@@ -0,0 +1,115 @@
+#ifndef BUTTON_H_
+#define BUTTON_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* Buttons a table passed to Button_Init may contain */
+#define BUTTON_MAX              16
+
+/* GPIO ports the buttons may be spread over */
+#define BUTTON_MAX_PORTS        3
+
+/* Event queue depth; must be a power of two */
+#define BUTTON_QUEUE_SIZE       16
+
+/* Ports are sampled every BUTTON_SCAN_MS; the 2-bit vertical counters
+ * accept a new level after 4 identical samples in a row */
+#define BUTTON_SCAN_MS          5
+#define BUTTON_DEBOUNCE_MS      (4 * BUTTON_SCAN_MS)
+
+/* Hold timings in milliseconds */
+#define BUTTON_LONG_PRESS_MS    800     /* Hold time for BUTTON_EVENT_LONG_PRESS */
+#define BUTTON_REPEAT_DELAY_MS  500     /* Hold time before the first repeat */
+#define BUTTON_REPEAT_PERIOD_MS 150     /* Interval between repeats */
+
+/* BUTTON_FLAG_ACCELERATE halves the repeat interval every
+ * BUTTON_ACCEL_REPEATS repeats, down to BUTTON_REPEAT_MIN_MS */
+#define BUTTON_ACCEL_REPEATS    6
+#define BUTTON_REPEAT_MIN_MS    25
+
+/* Per-button options for button_config_t.flags */
+#define BUTTON_FLAG_REPEAT      0x01    /* Post BUTTON_EVENT_REPEAT while held */
+#define BUTTON_FLAG_LONG_PRESS  0x02    /* Post BUTTON_EVENT_LONG_PRESS once */
+#define BUTTON_FLAG_ACCELERATE  0x04    /* Repeat faster the longer it is held */
+
+/**
+ * @brief Kind of button event.
+ */
+typedef enum {
+    BUTTON_EVENT_PRESS = 0,     /* Debounced press */
+    BUTTON_EVENT_RELEASE,       /* Debounced release */
+    BUTTON_EVENT_LONG_PRESS,    /* Held for BUTTON_LONG_PRESS_MS */
+    BUTTON_EVENT_REPEAT         /* Auto-repeat while held */
+} button_event_type_t;
+
+/**
+ * @brief One queued button event.
+ */
+typedef struct {
+    uint8_t button;             /* Index in the table given to Button_Init */
+    uint8_t type;               /* button_event_type_t */
+    uint16_t repeat;            /* BUTTON_EVENT_REPEAT: repeats so far, from 1 */
+} button_event_t;
+
+/**
+ * @brief One active-low button with a pull-up.
+ * The pin must already be configured as an input.
+ */
+typedef struct {
+    GPIO_TypeDef *port;
+    uint8_t pin;                /* 0-15; each pin number may appear only once */
+    uint8_t flags;              /* BUTTON_FLAG_* */
+} button_config_t;
+
+/**
+ * @brief Event counters.
+ */
+typedef struct {
+    uint32_t events;            /* Events posted */
+    uint32_t dropped;           /* Events lost to a full queue */
+    uint32_t bounces;           /* Level changes rejected by the debounce */
+    uint32_t scans;             /* Port scans performed */
+} button_stats_t;
+
+/**
+ * @brief Routes the buttons' falling edges to EXTI and starts debouncing.
+ * @param buttons Button table; it must stay valid, indexes become event ids
+ * @param count Number of buttons (at most BUTTON_MAX)
+ * @return 1 on success, 0 if the table is too large, spans more than
+ * BUTTON_MAX_PORTS ports or reuses an EXTI line (also one taken by
+ * another EXTI_attach user)
+ * @note Delay_Init must have been called. Every port is debounced with one
+ * IDR read per scan, from the SysTick interrupt, and only between the first
+ * edge and the moment all buttons are released and settled.
+ */
+uint8_t Button_Init(const button_config_t *buttons, uint8_t count);
+
+/**
+ * @brief Takes the oldest event from the queue. Never blocks.
+ * @return 1 if *event was filled, 0 if the queue is empty
+ */
+uint8_t Button_getEvent(button_event_t *event);
+
+/**
+ * @brief Returns 1 if events wait in the queue.
+ */
+uint8_t Button_hasEvent(void);
+
+/**
+ * @brief Returns 1 while the debouncer needs the 1 ms tick, from the first
+ * edge until every button is released and settled.
+ */
+uint8_t Button_isScanning(void);
+
+/**
+ * @brief Returns 1 while the button is held (debounced).
+ */
+uint8_t Button_isPressed(uint8_t button);
+
+/**
+ * @brief Copies the event counters.
+ */
+void Button_getStats(button_stats_t *stats);
+
+#endif /* BUTTON_H_ */
@@ -0,0 +1,293 @@
+#include "clock_mgr.h"
+#include "delay.h"
+#include "health.h"
+
+/**
+ * @brief Register settings of one profile.
+ */
+typedef struct {
+    uint32_t hclk_hz;
+    uint32_t ppre1;             /* RCC_CFGR_PPRE1 field */
+    uint8_t apb1_shift;         /* PCLK1 = HCLK >> apb1_shift */
+    uint32_t latency;           /* FLASH_ACR_LATENCY field, 2.7-3.6 V */
+} clock_profile_cfg_t;
+
+static const clock_profile_cfg_t clock_profiles[] = {
+    [CLOCK_PROFILE_LOW]  = { CLOCK_LOW_HZ, RCC_CFGR_PPRE1_DIV1, 0,
+                             FLASH_ACR_LATENCY_0WS },
+    [CLOCK_PROFILE_FULL] = { CLOCK_FULL_HZ, RCC_CFGR_PPRE1_DIV2, 1,
+                             FLASH_ACR_LATENCY_2WS },
+};
+
+static clock_notifier_fn clock_notifiers[CLOCK_MAX_NOTIFIERS];
+static uint8_t notifier_count = 0;
+static volatile uint32_t boost_clients = 0;
+static clock_profile_t clock_profile = CLOCK_PROFILE_FULL;
+static clock_stats_t clock_stats;
+
+/* Back-off after a refused or failed switch; 0 while none is pending */
+static uint32_t retry_ms = 0;
+static uint32_t retry_at;                   /* Delay_getTick of the retry */
+static clock_profile_t retry_target;
+
+/**
+ * @brief Polls until (reg & mask) == value.
+ * @return 1 on success, 0 after CLOCK_SWITCH_TIMEOUT polls
+ */
+static uint8_t ClockMgr_wait(volatile uint32_t *reg, uint32_t mask,
+        uint32_t value) {
+    uint32_t timeout = CLOCK_SWITCH_TIMEOUT;
+
+    while ((*reg & mask) != value) {
+        if (--timeout == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Undoes a failed ClockMgr_toPll: back to the crystal with the
+ * previous APB1 divider, then the previous latency, PLL off.
+ * The latency is only lowered once the core no longer runs from the PLL.
+ */
+static void ClockMgr_undoPll(uint32_t acr_latency, uint32_t ppre1) {
+    RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_SW))
+            | ppre1 | RCC_CFGR_SW_HSE;
+    if (!ClockMgr_wait(&RCC->CFGR, RCC_CFGR_SWS, RCC_CFGR_SWS_HSE)) {
+        return;
+    }
+    FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | acr_latency;
+    RCC->CR &= ~RCC_CR_PLLON;
+}
+
+/**
+ * @brief Raises the flash latency, starts the PLL and switches to it.
+ * The PLL keeps the dividers programmed by SystemClock_Config. On a
+ * timeout the crystal settings are restored.
+ */
+static uint8_t ClockMgr_toPll(const clock_profile_cfg_t *cfg) {
+    uint32_t acr_latency = FLASH->ACR & FLASH_ACR_LATENCY;
+    uint32_t ppre1 = RCC->CFGR & RCC_CFGR_PPRE1;
+
+    FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | cfg->latency;
+    if (!ClockMgr_wait(&FLASH->ACR, FLASH_ACR_LATENCY, cfg->latency)) {
+        ClockMgr_undoPll(acr_latency, ppre1);
+        return 0;
+    }
+    RCC->CR |= RCC_CR_PLLON;
+    if (!ClockMgr_wait(&RCC->CR, RCC_CR_PLLRDY, RCC_CR_PLLRDY)) {
+        ClockMgr_undoPll(acr_latency, ppre1);
+        return 0;
+    }
+    /* APB1 must not exceed 42 MHz once the PLL drives it */
+    RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_SW))
+            | cfg->ppre1 | RCC_CFGR_SW_PLL;
+    if (!ClockMgr_wait(&RCC->CFGR, RCC_CFGR_SWS, RCC_CFGR_SWS_PLL)) {
+        ClockMgr_undoPll(acr_latency, ppre1);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Switches to the crystal, then lowers the flash latency and stops
+ * the PLL.
+ */
+static uint8_t ClockMgr_toHse(const clock_profile_cfg_t *cfg) {
+    RCC->CR |= RCC_CR_HSEON;
+    if (!ClockMgr_wait(&RCC->CR, RCC_CR_HSERDY, RCC_CR_HSERDY)) {
+        return 0;
+    }
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_HSE;
+    if (!ClockMgr_wait(&RCC->CFGR, RCC_CFGR_SWS, RCC_CFGR_SWS_HSE)) {
+        return 0;
+    }
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_PPRE1) | cfg->ppre1;
+    FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | cfg->latency;
+    RCC->CR &= ~RCC_CR_PLLON;
+    return 1;
+}
+
+/**
+ * @brief Takes over the clock tree left by SystemClock_Config.
+ */
+void ClockMgr_Init(void) {
+    notifier_count = 0;
+    boost_clients = 0;
+    retry_ms = 0;
+    clock_profile = ((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL)
+            ? CLOCK_PROFILE_FULL : CLOCK_PROFILE_LOW;
+}
+
+/**
+ * @brief Adopts the live clock tree and tells every driver about it.
+ */
+void ClockMgr_resync(void) {
+    clock_info_t info;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    clock_profile = ((RCC->CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL)
+            ? CLOCK_PROFILE_FULL : CLOCK_PROFILE_LOW;
+    SystemCoreClock = clock_profiles[clock_profile].hclk_hz;
+    retry_ms = 0;
+    ClockMgr_getInfo(&info);
+    for (uint8_t i = 0; i < notifier_count; i++) {
+        clock_notifiers[i](CLOCK_POST_CHANGE, &info);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Adds a driver to be told about clock switches.
+ */
+uint8_t ClockMgr_registerNotifier(clock_notifier_fn notifier) {
+    if (notifier_count == CLOCK_MAX_NOTIFIERS) {
+        return 0;
+    }
+    clock_notifiers[notifier_count++] = notifier;
+    return 1;
+}
+
+/**
+ * @brief Sets or clears one client's request for full speed.
+ */
+void ClockMgr_requestBoost(uint8_t client, uint8_t on) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (on) {
+        boost_clients |= 1UL << client;
+    } else {
+        boost_clients &= ~(1UL << client);
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Runs a switch with every notifier's agreement.
+ * @return 1 if the clock now runs at 'target'
+ */
+static uint8_t ClockMgr_switch(clock_profile_t target) {
+    const clock_profile_cfg_t *cfg = &clock_profiles[target];
+    clock_info_t next = {
+        .hclk_hz = cfg->hclk_hz,
+        .pclk1_hz = cfg->hclk_hz >> cfg->apb1_shift,
+        .pclk2_hz = cfg->hclk_hz
+    };
+    clock_info_t old;
+    uint8_t accepted;
+
+    ClockMgr_getInfo(&old);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t start = DWT->CYCCNT;
+
+    for (accepted = 0; accepted < notifier_count; accepted++) {
+        if (!clock_notifiers[accepted](CLOCK_PRE_CHANGE, &next)) {
+            break;
+        }
+    }
+    uint8_t ok = (accepted == notifier_count);
+    if (ok) {
+        ok = (target == CLOCK_PROFILE_FULL) ? ClockMgr_toPll(cfg)
+                : ClockMgr_toHse(cfg);
+        if (!ok) {
+            clock_stats.failed++;
+            HEALTH_INC(HEALTH_CLOCK_FAILURE);
+        }
+    } else {
+        clock_stats.vetoed++;
+    }
+
+    if (!ok) {
+        for (uint8_t i = 0; i < accepted; i++) {
+            clock_notifiers[i](CLOCK_ABORT_CHANGE, &old);
+        }
+        __set_PRIMASK(primask);
+        return 0;
+    }
+
+    uint32_t elapsed = DWT->CYCCNT - start;
+    SystemCoreClock = cfg->hclk_hz;
+    clock_profile = target;
+    for (uint8_t i = 0; i < notifier_count; i++) {
+        clock_notifiers[i](CLOCK_POST_CHANGE, &next);
+    }
+    if (target == CLOCK_PROFILE_FULL) {
+        clock_stats.boosts++;
+    } else {
+        clock_stats.drops++;
+    }
+    /* Most of a switch runs on the slower clock */
+    uint32_t us = elapsed / (CLOCK_LOW_HZ / 1000000U);
+    clock_stats.switch_last_us = us;
+    if (us > clock_stats.switch_max_us) {
+        clock_stats.switch_max_us = us;
+    }
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+/**
+ * @brief Switches to the profile the clients ask for, if it differs.
+ */
+clock_profile_t ClockMgr_update(void) {
+    clock_profile_t target = boost_clients ? CLOCK_PROFILE_FULL
+            : CLOCK_PROFILE_LOW;
+
+    if (target == clock_profile) {
+        retry_ms = 0;
+        return clock_profile;
+    }
+    uint32_t now = Delay_getTick();
+    if (retry_ms && target == retry_target
+            && (int32_t) (now - retry_at) < 0) {
+        return clock_profile;
+    }
+
+    if (ClockMgr_switch(target)) {
+        retry_ms = 0;
+    } else {
+        if (retry_ms == 0 || target != retry_target) {
+            retry_ms = CLOCK_RETRY_MIN_MS;
+        } else if (retry_ms < CLOCK_RETRY_MAX_MS) {
+            retry_ms *= 2;
+        }
+        retry_target = target;
+        retry_at = now + retry_ms;
+    }
+    return clock_profile;
+}
+
+/**
+ * @brief Returns the profile in use.
+ */
+clock_profile_t ClockMgr_getProfile(void) {
+    return clock_profile;
+}
+
+/**
+ * @brief Reads the bus clocks from the live RCC settings.
+ */
+void ClockMgr_getInfo(clock_info_t *info) {
+    static const uint8_t apb_shift[8] = {0, 0, 0, 0, 1, 2, 3, 4};
+    uint32_t cfgr = RCC->CFGR;
+
+    /* SystemCoreClock is HCLK */
+    info->hclk_hz = SystemCoreClock;
+    info->pclk1_hz = SystemCoreClock
+            >> apb_shift[(cfgr & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+    info->pclk2_hz = SystemCoreClock
+            >> apb_shift[(cfgr & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+}
+
+/**
+ * @brief Copies the switch counters.
+ */
+void ClockMgr_getStats(clock_stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = clock_stats;
+    __set_PRIMASK(primask);
+}
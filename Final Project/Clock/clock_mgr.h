@@ -0,0 +1,128 @@
+#ifndef CLOCK_MGR_H_
+#define CLOCK_MGR_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* Drivers ClockMgr_registerNotifier can hold */
+#define CLOCK_MAX_NOTIFIERS     6
+
+/* Core clock of each profile. FULL is the PLL set up by SystemClock_Config
+ * (HSE / 25 * 168 / 2, APB1 / 2); LOW runs from the crystal with the PLL
+ * off and APB1 undivided. */
+#define CLOCK_LOW_HZ            HSE_VALUE
+#define CLOCK_FULL_HZ           84000000U
+
+/* Polls of each RCC ready flag before a switch gives up */
+#define CLOCK_SWITCH_TIMEOUT    100000U
+
+/* Wait before retrying a refused or failed switch; doubles on every
+ * further refusal of the same target, up to CLOCK_RETRY_MAX_MS */
+#define CLOCK_RETRY_MIN_MS      1U
+#define CLOCK_RETRY_MAX_MS      1024U
+
+/**
+ * @brief Clock tree setting.
+ */
+typedef enum {
+    CLOCK_PROFILE_LOW = 0,      /* HSE only, 25 MHz: idle and control passes */
+    CLOCK_PROFILE_FULL          /* PLL, 84 MHz: streaming and bursts */
+} clock_profile_t;
+
+/**
+ * @brief Phase of a clock switch reported to the notifiers.
+ */
+typedef enum {
+    CLOCK_PRE_CHANGE = 0,       /* About to switch; return 0 to refuse */
+    CLOCK_POST_CHANGE,          /* Switched; recompute dividers now */
+    CLOCK_ABORT_CHANGE          /* Switch cancelled after PRE was accepted */
+} clock_event_t;
+
+/**
+ * @brief Bus clocks of a profile.
+ */
+typedef struct {
+    uint32_t hclk_hz;           /* Core, AHB, SysTick and DWT */
+    uint32_t pclk1_hz;          /* APB1: USART2, I2C1 */
+    uint32_t pclk2_hz;          /* APB2: ADC1 */
+} clock_info_t;
+
+/**
+ * @brief Driver callback for clock switches, run with interrupts masked.
+ * @param event Phase of the switch
+ * @param info New clocks for PRE and POST, the unchanged ones for ABORT
+ * @return PRE: 1 to accept, 0 if the driver cannot switch now (e.g. a
+ * transfer in flight). Ignored for POST and ABORT.
+ */
+typedef uint8_t (*clock_notifier_fn)(clock_event_t event,
+        const clock_info_t *info);
+
+/**
+ * @brief Switch counters.
+ */
+typedef struct {
+    uint32_t boosts;            /* Switches to CLOCK_PROFILE_FULL */
+    uint32_t drops;             /* Switches to CLOCK_PROFILE_LOW */
+    uint32_t vetoed;            /* Switches refused by a notifier */
+    uint32_t failed;            /* Switches aborted on an RCC timeout */
+    uint32_t switch_last_us;    /* Duration of the last switch */
+    uint32_t switch_max_us;     /* Longest switch */
+} clock_stats_t;
+
+/**
+ * @brief Takes over the clock tree left by SystemClock_Config as
+ * CLOCK_PROFILE_FULL.
+ */
+void ClockMgr_Init(void);
+
+/**
+ * @brief Adopts a clock tree set up behind the manager's back, e.g. by
+ * SystemClock_Config after a failed wake-up restore: the profile and
+ * SystemCoreClock follow the live SYSCLK source, and every notifier gets
+ * CLOCK_POST_CHANGE with the live bus clocks. ClockMgr_update then
+ * switches back to the profile the clients ask for.
+ */
+void ClockMgr_resync(void);
+
+/**
+ * @brief Adds a driver to be told about clock switches.
+ * @return 1 on success, 0 if all CLOCK_MAX_NOTIFIERS slots are used
+ */
+uint8_t ClockMgr_registerNotifier(clock_notifier_fn notifier);
+
+/**
+ * @brief Sets or clears one client's request for full speed. The clock
+ * runs at CLOCK_PROFILE_FULL while any client asks for it.
+ * @param client Client number, 0-31
+ * @param on 1 to request full speed, 0 to release it
+ * @note Takes effect at the next ClockMgr_update.
+ */
+void ClockMgr_requestBoost(uint8_t client, uint8_t on);
+
+/**
+ * @brief Switches to the profile the clients ask for, if it differs.
+ * @return The profile in use afterwards. A refused or failed switch is
+ * not retried before its back-off has passed, so a notifier that can never
+ * accept (e.g. a baud rate the other clock cannot reach) costs one attempt
+ * every CLOCK_RETRY_MAX_MS.
+ * @note Called from the main loop (thread context).
+ */
+clock_profile_t ClockMgr_update(void);
+
+/**
+ * @brief Returns the profile in use.
+ */
+clock_profile_t ClockMgr_getProfile(void);
+
+/**
+ * @brief Reads the bus clocks from the live RCC settings.
+ * @note Valid before ClockMgr_Init, for drivers that start first.
+ */
+void ClockMgr_getInfo(clock_info_t *info);
+
+/**
+ * @brief Copies the switch counters.
+ */
+void ClockMgr_getStats(clock_stats_t *stats);
+
+#endif /* CLOCK_MGR_H_ */
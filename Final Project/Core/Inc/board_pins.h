@@ -0,0 +1,70 @@
+#ifndef BOARD_PINS_H_
+#define BOARD_PINS_H_
+
+#include "gpio.h"
+
+/* Soil Moisture Sensor */
+#define SOIL_SENSOR_PORT        GPIOA
+#define SOIL_SENSOR_PIN         0
+#define SOIL_SENSOR_ADC_CH      0
+
+/* Relay */
+#define RELAY_PORT              GPIOA
+#define RELAY_PIN               1
+
+/* Button */
+#define MODE_BUTTON_PORT        GPIOA
+#define MODE_BUTTON_PIN         12
+#define UP_BUTTON_PORT          GPIOA
+#define UP_BUTTON_PIN           15
+#define DOWN_BUTTON_PORT        GPIOB
+#define DOWN_BUTTON_PIN         5
+#define LEFT_BUTTON_PORT        GPIOB
+#define LEFT_BUTTON_PIN         3
+#define RIGHT_BUTTON_PORT       GPIOB
+#define RIGHT_BUTTON_PIN        4
+
+/* DS3231 INT/SQW, open drain: 1 Hz wake-up source for STOP mode */
+#define RTC_SQW_PORT            GPIOB
+#define RTC_SQW_PIN             8
+
+/* Width of a Board_printPinMap line, without the terminator */
+#define BOARD_PIN_LINE_WIDTH    32
+
+/**
+ * @brief Who writes a pin's registers.
+ */
+typedef enum {
+    BOARD_PIN_INIT = 0,     /* Configured by Board_pinsInit */
+    BOARD_PIN_DRIVER        /* Configured by its driver; listed to catch conflicts */
+} board_pin_owner_t;
+
+/**
+ * @brief One entry of the board pin table.
+ */
+typedef struct {
+    const char *name;
+    gpio_config_t cfg;
+    board_pin_owner_t owner;
+} board_pin_t;
+
+/* Every pin the board uses, in one place */
+extern const board_pin_t board_pins[];
+extern const uint8_t board_pin_count;
+
+/**
+ * @brief Checks the pin table for duplicates, then configures every
+ * BOARD_PIN_INIT pin with one masked write per register per port.
+ * @return -1 on success, otherwise the index of the first entry that reuses
+ * a pin; nothing is written in that case.
+ */
+int8_t Board_pinsInit(void);
+
+/**
+ * @brief Writes the pin map, one "PB10 LCD_RS     OUT  M" line per pin,
+ * sorted by port and pin. Usable from a host build for documentation.
+ * @param print Receives each NUL-terminated line
+ */
+void Board_printPinMap(void (*print)(const char *line));
+
+#endif /* BOARD_PINS_H_ */
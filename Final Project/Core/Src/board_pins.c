@@ -0,0 +1,156 @@
+#include "board_pins.h"
+#include "lcd_config.h"
+#include "fast_format.h"
+
+#define PIN_IN(port, pin, pull) \
+    { port, pin, GPIO_DRIVER_MODE_INPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, \
+      GPIO_DRIVER_SPEED_LOW, pull, GPIO_DRIVER_AF0 }
+#define PIN_OUT(port, pin, speed) \
+    { port, pin, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, \
+      speed, GPIO_DRIVER_NO_PULL, GPIO_DRIVER_AF0 }
+#define PIN_AF(port, pin, otype, pull, af) \
+    { port, pin, GPIO_DRIVER_MODE_ALT_FUNCTION, otype, \
+      GPIO_DRIVER_SPEED_HIGH, pull, af }
+#define PIN_ANALOG(port, pin) \
+    { port, pin, GPIO_DRIVER_MODE_ANALOG, GPIO_DRIVER_OUTPUT_PUSH_PULL, \
+      GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_NO_PULL, GPIO_DRIVER_AF0 }
+
+const board_pin_t board_pins[] = {
+    /* Soil sensor, ADC1 channel 0 */
+    { "SOIL",     PIN_ANALOG(SOIL_SENSOR_PORT, SOIL_SENSOR_PIN), BOARD_PIN_INIT },
+    /* Pump relay, driven low before the mode switches to output */
+    { "RELAY",    PIN_OUT(RELAY_PORT, RELAY_PIN, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    /* USART2 to LabVIEW, set up by LabVIEW_UART_Init */
+    { "UART_TX",  PIN_AF(GPIOA, 2, GPIO_DRIVER_OUTPUT_PUSH_PULL,
+      GPIO_DRIVER_NO_PULL, GPIO_DRIVER_AF7), BOARD_PIN_DRIVER },
+    { "UART_RX",  PIN_AF(GPIOA, 3, GPIO_DRIVER_OUTPUT_PUSH_PULL,
+      GPIO_DRIVER_NO_PULL, GPIO_DRIVER_AF7), BOARD_PIN_DRIVER },
+    /* I2C1 to the DS3231, set up by the I2C driver after bus recovery */
+    { "I2C_SCL",  PIN_AF(GPIOB, 6, GPIO_DRIVER_OUTPUT_OPEN_DRAIN,
+      GPIO_DRIVER_PULL_UP, GPIO_DRIVER_AF4), BOARD_PIN_DRIVER },
+    { "I2C_SDA",  PIN_AF(GPIOB, 7, GPIO_DRIVER_OUTPUT_OPEN_DRAIN,
+      GPIO_DRIVER_PULL_UP, GPIO_DRIVER_AF4), BOARD_PIN_DRIVER },
+    /* DS3231 square-wave output, open drain */
+    { "RTC_SQW",  PIN_IN(RTC_SQW_PORT, RTC_SQW_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+#if LCD_TRANSPORT == LCD_TRANSPORT_PARALLEL
+    /* HD44780 in 4-bit mode */
+    { "LCD_D4",   PIN_OUT(LCD_DATA_PORT_B, DATA5_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    { "LCD_D5",   PIN_OUT(LCD_DATA_PORT_B, DATA6_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    { "LCD_D6",   PIN_OUT(LCD_DATA_PORT_A, DATA7_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    { "LCD_D7",   PIN_OUT(LCD_DATA_PORT_A, DATA8_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    { "LCD_RS",   PIN_OUT(LCD_DATA_PORT_B, RS_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+    { "LCD_E",    PIN_OUT(LCD_DATA_PORT_B, E_Pin, GPIO_DRIVER_SPEED_MEDIUM),
+      BOARD_PIN_INIT },
+#endif
+    /* Buttons, active low */
+    { "BTN_MODE", PIN_IN(MODE_BUTTON_PORT, MODE_BUTTON_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+    { "BTN_UP",   PIN_IN(UP_BUTTON_PORT, UP_BUTTON_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+    { "BTN_DOWN", PIN_IN(DOWN_BUTTON_PORT, DOWN_BUTTON_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+    { "BTN_LEFT", PIN_IN(LEFT_BUTTON_PORT, LEFT_BUTTON_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+    { "BTN_RIGHT", PIN_IN(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN, GPIO_DRIVER_PULL_UP),
+      BOARD_PIN_INIT },
+};
+
+const uint8_t board_pin_count = sizeof(board_pins) / sizeof(board_pin_t);
+
+/**
+ * @brief Checks the pin table and configures the board-owned pins.
+ */
+int8_t Board_pinsInit(void) {
+    gpio_batch_t batch;
+
+    GPIO_batchInit(&batch);
+    for (uint8_t i = 0; i < board_pin_count; i++) {
+        const board_pin_t *p = &board_pins[i];
+        gpio_batch_status_t status = (p->owner == BOARD_PIN_INIT)
+                ? GPIO_batchAdd(&batch, &p->cfg)
+                : GPIO_batchClaim(&batch, p->cfg.port, p->cfg.pin);
+        if (status != GPIO_BATCH_OK) {
+            return (int8_t) i;
+        }
+    }
+
+    /* The relay must not pulse on while its pin turns into an output; the
+     * batch writes the level after enabling the port clock */
+    GPIO_batchSetLevel(&batch, RELAY_PORT, RELAY_PIN, 0);
+    GPIO_batchApply(&batch);
+    return -1;
+}
+
+/**
+ * @brief Sort key of a pin: port index, then pin number.
+ */
+static uint16_t Board_pinKey(const board_pin_t *p) {
+    return (uint16_t) (GPIO_portIndex(p->cfg.port) * 16U + p->cfg.pin);
+}
+
+/**
+ * @brief Writes the pin map, sorted by port and pin.
+ */
+void Board_printPinMap(void (*print)(const char *line)) {
+    static const char *const mode_names[] = { "IN", "OUT", "AF", "AN" };
+    static const char *const speed_names[] = { " L", " M", " F", " H" };
+    char line[BOARD_PIN_LINE_WIDTH + 1];
+    int32_t last_key = -1;
+
+    for (uint8_t n = 0; n < board_pin_count; n++) {
+        /* Next entry in key order; equal keys are conflicts and print twice */
+        const board_pin_t *p = 0;
+        for (uint8_t i = 0; i < board_pin_count; i++) {
+            int32_t key = Board_pinKey(&board_pins[i]);
+            if (key > last_key && (p == 0 || key < Board_pinKey(p))) {
+                p = &board_pins[i];
+            }
+        }
+        if (p == 0) {
+            break;
+        }
+        last_key = Board_pinKey(p);
+
+        for (uint8_t i = 0; i < board_pin_count; i++) {
+            if (Board_pinKey(&board_pins[i]) != last_key) {
+                continue;
+            }
+            const gpio_config_t *cfg = &board_pins[i].cfg;
+            char *end = line;
+            *end++ = 'P';
+            *end++ = (char) ('A' + (last_key >> 4));
+            end = FMT_uint(end, cfg->pin, 1);
+            FMT_finishLine(line, end, 5);
+            end = FMT_str(line + 5, board_pins[i].name);
+            FMT_finishLine(line, end, 15);
+            end = FMT_str(line + 15, mode_names[cfg->mode & 0x3]);
+            if (cfg->mode == GPIO_DRIVER_MODE_ALT_FUNCTION) {
+                end = FMT_uint(end, cfg->af, 1);
+            }
+            if (cfg->mode == GPIO_DRIVER_MODE_OUTPUT
+                    || cfg->mode == GPIO_DRIVER_MODE_ALT_FUNCTION) {
+                end = FMT_str(end, speed_names[cfg->speed & 0x3]);
+                if (cfg->otype == GPIO_DRIVER_OUTPUT_OPEN_DRAIN) {
+                    end = FMT_str(end, " OD");
+                }
+            }
+            if (cfg->pull == GPIO_DRIVER_PULL_UP) {
+                end = FMT_str(end, " PU");
+            } else if (cfg->pull == GPIO_DRIVER_PULL_DOWN) {
+                end = FMT_str(end, " PD");
+            }
+            if (board_pins[i].owner == BOARD_PIN_DRIVER) {
+                end = FMT_str(end, " drv");
+            }
+            FMT_finishLine(line, end, BOARD_PIN_LINE_WIDTH);
+            print(line);
+        }
+    }
+}
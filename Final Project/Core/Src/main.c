@@ -5,31 +5,41 @@
 #include "i2c_driver.h"
 #include "lcd_parallel.h"
 #include "labview_comm.h"
+#include "labview_stream.h"
+#include "labview_sub.h"
 #include "delay.h"
-#include <stdio.h>
-#include <string.h>
+#include "fast_format.h"
+#include "boot_sequencer.h"
+#include "button.h"
+#include "board_pins.h"
+#include "soft_timer.h"
+#include "idle.h"
+#include "sleep_mgr.h"
+#include "clock_mgr.h"
+#include "profiler.h"
+#include "trace.h"
+#include "health.h"
+#include "flash_log.h"
+#include "history.h"
 #include <stdbool.h>
+#include <string.h>
+
+/* Button indexes, reported in button_event_t.button */
+enum {
+    BUTTON_MODE, BUTTON_UP, BUTTON_DOWN, BUTTON_LEFT, BUTTON_RIGHT
+};
+
+/* UP and DOWN auto-repeat, faster the longer they are held, so a held key
+ * scrolls quickly through hours and minutes */
+#define BUTTON_SCROLL   (BUTTON_FLAG_REPEAT | BUTTON_FLAG_ACCELERATE)
 
-/* Soil Moisture Sensor */
-#define SOIL_SENSOR_PORT        GPIOA
-#define SOIL_SENSOR_PIN         0
-#define SOIL_SENSOR_ADC_CH      0
-
-/* Relay */
-#define RELAY_PORT              GPIOA
-#define RELAY_PIN               1
-
-/* Button */
-#define MODE_BUTTON_PORT        GPIOA
-#define MODE_BUTTON_PIN         12
-#define UP_BUTTON_PORT          GPIOA
-#define UP_BUTTON_PIN           15
-#define DOWN_BUTTON_PORT        GPIOB
-#define DOWN_BUTTON_PIN         5
-#define LEFT_BUTTON_PORT        GPIOB
-#define LEFT_BUTTON_PIN         3
-#define RIGHT_BUTTON_PORT       GPIOB
-#define RIGHT_BUTTON_PIN        4
+static const button_config_t buttons[] = {
+    [BUTTON_MODE]  = { MODE_BUTTON_PORT,  MODE_BUTTON_PIN,  0 },
+    [BUTTON_UP]    = { UP_BUTTON_PORT,    UP_BUTTON_PIN,    BUTTON_SCROLL },
+    [BUTTON_DOWN]  = { DOWN_BUTTON_PORT,  DOWN_BUTTON_PIN,  BUTTON_SCROLL },
+    [BUTTON_LEFT]  = { LEFT_BUTTON_PORT,  LEFT_BUTTON_PIN,  0 },
+    [BUTTON_RIGHT] = { RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN, 0 },
+};
 
 /* Constant and Threshold */
 #define MOISTURE_THRESHOLD_LOW      30
@@ -65,7 +75,7 @@ ds3231_time_t manual_start_time = {0, 0, 8, 0, 0, 0, 0};
 ds3231_time_t manual_stop_time  = {0, 0, 9, 0, 0, 0, 0};
 
 /* ADC buffer for soil moisture sensor readings */
-uint16_t adc_buffer[20];
+uint16_t adc_buffer[64];
 
 /* Variables for soil moisture readings */
 uint16_t soil_moisture_raw = 0;
@@ -76,6 +86,138 @@ uint8_t soil_moisture_percent = 0;
 /* Pump status */
 uint8_t pump_status = 0; /* 0 = OFF, 1 = ON */
 
+/* Boot phase indexes, used for dependencies in boot_phases */
+enum {
+    BOOT_PHASE_I2C, BOOT_PHASE_LCD, BOOT_PHASE_ADC, BOOT_PHASE_UART
+};
+
+/* LCD behind a PCF8574 backpack can only start once the I2C bus is up */
+#if LCD_TRANSPORT == LCD_TRANSPORT_PCF8574
+#define BOOT_LCD_DEPENDS   (1UL << BOOT_PHASE_I2C)
+#else
+#define BOOT_LCD_DEPENDS   0
+#endif
+
+static uint8_t ADC_peripheralConfigStep(uint32_t *wait_us);
+static uint8_t LabVIEW_UART_InitStep(uint32_t *wait_us);
+
+/* Start-up phases, interleaved by Boot_run; timings kept for diagnostics */
+boot_phase_t boot_phases[] = {
+    [BOOT_PHASE_I2C]  = { .name = "I2C",  .step = I2C_initStep },
+    [BOOT_PHASE_LCD]  = { .name = "LCD",  .step = LCD_initStep,
+                          .depends_on = BOOT_LCD_DEPENDS },
+    [BOOT_PHASE_ADC]  = { .name = "ADC",  .step = ADC_peripheralConfigStep },
+    [BOOT_PHASE_UART] = { .name = "UART", .step = LabVIEW_UART_InitStep },
+};
+
+/* Total boot time in microseconds (time to first valid ADC reading) */
+uint32_t boot_total_us = 0;
+
+/* Sensing, control, telemetry and display run every CONTROL_PERIOD_MS;
+ * UART commands and buttons are served in between */
+#define CONTROL_PERIOD_MS   100
+static soft_timer_t control_timer;
+static volatile uint8_t control_due = 0;
+
+/* 1: battery build, STOP mode between control passes, which then follow
+ * the DS3231 1 Hz square wave. 0: mains build, SLEEP (WFI) only. */
+#define POWER_STOP_MODE     0
+#define RTC_SQW_PERIOD_MS   1000
+
+/* 1: run from the 25 MHz crystal and boost to the 84 MHz PLL only while a
+ * client needs it; the UART must then run at a rate both clocks reach
+ * (not 2 Mbaud). 0: stay at 84 MHz. */
+#define POWER_CLOCK_SCALING 0
+
+/* Clients of ClockMgr_requestBoost */
+enum {
+    CLOCK_CLIENT_STREAM     /* Raw ADC waveform streaming */
+};
+
+/* Flash history: a sample is logged when the pump or mode changes and at
+ * least every FLASH_LOG_PERIOD_S seconds ("LOG" exports it) */
+#define FLASH_LOG_PERIOD_S  300
+#define FLASH_LOG_FRAME_SLOTS   (PROTO_MAX_PAYLOAD / LOG_SLOT_SIZE)
+/* The RX DMA ring laps after 256 bytes: erase only once the host has been
+ * silent for this long */
+#define FLASH_LOG_RX_QUIET_MS   500
+static log_entry_t log_last;
+static uint8_t log_exporting = 0;
+static log_codec_t log_export_codec;
+
+/* Every minute of the last day or so in RAM ("HIST" exports it) */
+static uint8_t history_last_minute = 0xFF;
+static uint8_t history_exporting = 0;
+/* Text export: the block being decoded, copied, and where it stands */
+static uint8_t history_text_block[HISTORY_BLOCK_SIZE];
+static ts_decoder_t history_text_dec;
+static uint8_t history_text_open = 0;
+
+/* Control pass stages timed by the profiler ("PROF" dumps, "PROF 0" clears) */
+enum {
+    PROF_RTC, PROF_ADC, PROF_CONTROL, PROF_UART, PROF_LCD, PROF_PASS,
+    PROF_STAGE_COUNT
+};
+
+/* Diagnostic lines, without "\r\n", fit one log frame */
+#define DIAG_LINE_WIDTH         PROTO_MAX_PAYLOAD
+
+/* Short command replies ("SLEEP", "IDLE", "BAUD"), queued as "TAG name=value ..." lines
+ * and sent as the TX ring drains */
+#define DIAG_REPLY_LINES        6
+static char diag_reply[DIAG_REPLY_LINES][DIAG_LINE_WIDTH + 1];
+static uint8_t diag_reply_count = 0;
+static uint8_t diag_reply_sent = 0;
+static uint8_t diag_reply_open = 0;         /* The last line takes fields */
+static uint8_t diag_reply_length = 0;       /* Of the last line */
+static const char *diag_reply_tag = "";
+
+static uint8_t diagEmit(const char *line);
+static void diagReplyLine(const char *tag);
+static void diagReplyField(const char *name, uint32_t value);
+static void diagReplySigned(const char *name, int32_t value);
+static void diagReplyStep(void);
+static void sleepCommand(const int32_t *args, uint8_t argc);
+static void idleCommand(const int32_t *args, uint8_t argc);
+static void baudCommand(const int32_t *args, uint8_t argc);
+
+#if PROFILE_ENABLED
+static const char *const profile_stage_names[PROF_STAGE_COUNT] = {
+    [PROF_RTC] = "RTC", [PROF_ADC] = "ADC", [PROF_CONTROL] = "CONTROL",
+    [PROF_UART] = "UART", [PROF_LCD] = "LCD", [PROF_PASS] = "PASS"
+};
+
+/* Set by "PROF" while the report is being sent */
+static uint8_t profile_exporting = 0;
+
+static void profileCommand(const int32_t *args, uint8_t argc);
+#endif
+
+#if TRACE_ENABLED
+/* Set by "TRACE" while the ring is being exported */
+static uint8_t trace_exporting = 0;
+
+static void traceCommand(const int32_t *args, uint8_t argc);
+#endif
+
+static void healthCommand(const int32_t *args, uint8_t argc);
+static void logSample(void);
+static void logCommand(const int32_t *args, uint8_t argc);
+static uint8_t logEmitFrame(const uint8_t *slots, uint8_t count);
+static uint8_t logEmitText(const uint8_t *slots, uint8_t count);
+static uint8_t logEmitEnd(void);
+static void historySample(void);
+static void historyCommand(const int32_t *args, uint8_t argc);
+static uint8_t historyEmitFrame(const uint8_t *block, uint16_t length);
+static uint8_t historyEmitText(const uint8_t *block, uint16_t length);
+static uint8_t historyEmitEnd(void);
+static void ADC_countDmaErrors(void);
+static void controlTimerExpired(void *arg);
+#if POWER_STOP_MODE
+static void controlSyncEdge(void);
+#endif
+static uint8_t mainLoopReady(void);
+
 /* Static Function */
 static uint16_t Time_ToMinutes(const ds3231_time_t* time_struct);
 
@@ -84,10 +226,9 @@ void SystemClock_Config(void);
 void Error_Handler(void);
 
 void GPIO_pinsConfig(void);
-void ADC_peripheralConfig(void);
 
-uint8_t readButtonDebounced(GPIO_TypeDef *GPIOx, uint8_t pin);
 void handleButtonInputs(void);
+static void handleButtonPress(uint8_t button);
 
 void processAutoMode(void);
 void processManualMode(void);
@@ -100,32 +241,141 @@ int main(void) {
     HAL_Init();
     SystemClock_Config();
     Delay_Init(); // Khởi tạo SysTick cho delay
+    /* Drivers that derive dividers from the clock follow every switch */
+    ClockMgr_Init();
+    ClockMgr_registerNotifier(Delay_clockNotifier);
+    ClockMgr_registerNotifier(I2C_clockNotifier);
+    ClockMgr_registerNotifier(LabVIEW_UART_clockNotifier);
+#if TRACE_ENABLED
+    ClockMgr_registerNotifier(Trace_clockNotifier);
+#endif
 
     GPIO_pinsConfig();
+    /* Button edges arrive on EXTI, debounced from the SysTick */
+    Button_Init(buttons, sizeof(buttons) / sizeof(button_config_t));
+
+    /* LCD power-on wait, ADC stabilisation and I2C recovery overlap */
+    boot_total_us = Boot_run(boot_phases,
+            sizeof(boot_phases) / sizeof(boot_phase_t));
+
+    /* Raw waveform streaming on demand ("STREAM 1,n" from LabVIEW) */
+    LabVIEW_Stream_Init(adc_buffer, sizeof(adc_buffer) / sizeof(uint16_t));
+    /* Change-only telemetry ("SUB field,deadband,min_ms,heartbeat_ms") */
+    LabVIEW_Sub_Init();
+#if PROFILE_ENABLED
+    Profile_Init(profile_stage_names, PROF_STAGE_COUNT);
+    LabVIEW_registerCommand("PROF", profileCommand);
+#endif
+#if TRACE_ENABLED
+    LabVIEW_registerCommand("TRACE", traceCommand);
+#endif
+    /* Fault counters ("HEALTH" reads them, "HEALTH 1" also clears them) */
+    LabVIEW_registerCommand("HEALTH", healthCommand);
+    /* Moisture and pump history in flash ("LOG" exports it); UART
+     * reception keeps running through an erase */
+    FlashLog_registerStallHandler(DMA1_Stream5_IRQn, LabVIEW_UART_rxStallHandler);
+    FlashLog_Init();
+    LabVIEW_registerCommand("LOG", logCommand);
+    History_Init();
+    LabVIEW_registerCommand("HIST", historyCommand);
+
+#if LABVIEW_UART_AUTOBAUD
+    /* Let the host pick 921600 or 2 Mbaud by sending 'U' after reset */
+    LabVIEW_UART_AutoBaud(LABVIEW_UART_AUTOBAUD_TIMEOUT_MS);
+#endif
 
-    LCD_Init();
     LCD_Clear();
-    LCD_Write("System Init...");
-
-
-    ADC_peripheralConfig();
-    LabVIEW_UART_Init();
 
-    I2C_Init();
-
-    LCD_Clear();
+    /* Software timers advance with the 1 ms SysTick */
+    Delay_registerTickHandler(SoftTimer_tick);
+    SoftTimer_init(&control_timer, controlTimerExpired, 0, 0);
+
+    /* STOP is entered only while none of these peripherals is mid-transfer */
+    SleepMgr_Init(SystemClock_Config);
+    SleepMgr_registerBusy("UART", LabVIEW_UART_isTxBusy);
+    SleepMgr_registerBusy("I2C", I2C_isBusy);
+    SleepMgr_registerBusy("STREAM", LabVIEW_Stream_isRequested);
+    SleepMgr_registerBusy("BUTTON", Button_isScanning);
+    /* Power-state counters and veto counts ("SLEEP") */
+    LabVIEW_registerCommand("SLEEP", sleepCommand);
+    /* Idle share since the last "IDLE" and the WFI counters */
+    LabVIEW_registerCommand("IDLE", idleCommand);
+    /* USART2 rate the BRR divider actually produces ("BAUD") */
+    LabVIEW_registerCommand("BAUD", baudCommand);
+#if POWER_STOP_MODE
+    /* The square wave wakes the MCU from STOP and times the STOP periods */
+    DS3231_setSquareWave(DS3231_SQW_1HZ);
+    SleepMgr_setSyncPin(RTC_SQW_PORT, RTC_SQW_PIN, RTC_SQW_PERIOD_MS,
+            controlSyncEdge);
+#else
+    SoftTimer_start(&control_timer, CONTROL_PERIOD_MS, CONTROL_PERIOD_MS);
+#endif
 
     while (1) {
         /* Read and process data */
         LabVIEW_UART_ProcessData();
         /* Handle button inputs */
         handleButtonInputs();
+        /* Run deferred timer callbacks */
+        SoftTimer_process();
+#if POWER_CLOCK_SCALING
+        /* Full speed only while streaming. The UART refuses a switch while
+         * it transmits, so a started stream is held until the boost is in */
+        ClockMgr_requestBoost(CLOCK_CLIENT_STREAM,
+                LabVIEW_Stream_isRequested());
+        LabVIEW_Stream_setHold(ClockMgr_update() != CLOCK_PROFILE_FULL);
+#endif
+        diagReplyStep();
+#if PROFILE_ENABLED
+        /* Paced by the TX ring like the trace export below */
+        if (profile_exporting) {
+            profile_exporting = Profile_reportStep(diagEmit);
+        }
+#endif
+#if TRACE_ENABLED
+        /* Paced by the TX ring: a refused line is offered again next pass */
+        if (trace_exporting) {
+            trace_exporting = Trace_exportStep(diagEmit);
+        }
+#endif
+        if (log_exporting && !FlashLog_exportStep(
+                LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY ?
+                        logEmitFrame : logEmitText, FLASH_LOG_FRAME_SLOTS)) {
+            /* End marker, offered again until the TX ring takes it */
+            log_exporting = !logEmitEnd();
+        }
+        if (history_exporting && !History_exportStep(
+                LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY ?
+                        historyEmitFrame : historyEmitText)) {
+            history_exporting = !historyEmitEnd();
+        }
+        if (!control_due) {
+#if POWER_STOP_MODE
+            /* Deep sleep until the next second or a button press */
+            if (SleepMgr_enterStop(mainLoopReady) != SLEEP_WAKE_NONE) {
+                continue;
+            }
+#endif
+            /* Nothing to do: sleep until the next timer or interrupt */
+            TRACE_BEGIN(TRACE_ID_IDLE);
+            Idle_sleep(mainLoopReady);
+            TRACE_END(TRACE_ID_IDLE);
+            continue;
+        }
+        control_due = 0;
+        PROFILE_BEGIN(PROF_PASS);
+        TRACE_BEGIN(TRACE_ID_PASS);
         /* Get real time from DS3231 */
+        PROFILE_BEGIN(PROF_RTC);
+        TRACE_BEGIN(TRACE_ID_RTC);
+        /* Left unchanged on a NACK or stall (counted in HEALTH), so the
+         * control pass runs on the last good time */
         DS3231_getFullTime(&current_time);
-        /* Read soil moisture sensor */
-        ADC_startConversionSW(ADC1);
-        while (!ADC_DMA_getFlagStatus(ADC1, ADC_DMA_FLAG_TC));
-        ADC_DMA_clearFlag(ADC1, ADC_DMA_FLAG_TC);
+        TRACE_END(TRACE_ID_RTC);
+        PROFILE_END(PROF_RTC);
+        /* Read soil moisture sensor: the ADC converts continuously into the
+         * circular DMA buffer, so it always holds the latest samples */
+        PROFILE_BEGIN(PROF_ADC);
         uint32_t sum = 0;
         for (int i = 0; i < (sizeof(adc_buffer) / sizeof(uint16_t)); i++) {
             sum += adc_buffer[i];
@@ -133,238 +383,732 @@ int main(void) {
         soil_moisture_raw = sum / (sizeof(adc_buffer) / sizeof(uint16_t));
         soil_moisture_percent = ADC_convertToMoisturePercentage(
                 soil_moisture_raw);
+        ADC_countDmaErrors();
+        PROFILE_END(PROF_ADC);
 
         /* Process based on current mode */
+        PROFILE_BEGIN(PROF_CONTROL);
         if (current_mode == AUTO_MODE) {
             processAutoMode();
         } else {
             processManualMode();
 
         }
+        PROFILE_END(PROF_CONTROL);
         /* Send state signal to labview */
-        LabVIEW_Send_Value(soil_moisture_raw,
-                current_mode == AUTO_MODE ? 0 : 1, pump_status);
+        PROFILE_BEGIN(PROF_UART);
+        TRACE_BEGIN(TRACE_ID_TELEMETRY);
+        proto_telemetry_t telemetry = {
+            .timestamp_ms = Delay_getTick(),
+            .moisture_raw = soil_moisture_raw,
+            .moisture_percent = soil_moisture_percent,
+            .mode = current_mode == AUTO_MODE ? 0 : 1,
+            .pump = pump_status,
+            .threshold_low = MOISTURE_THRESHOLD_LOW,
+            .threshold_high = MOISTURE_THRESHOLD_OPTIMAL,
+            .hours = current_time.hours,
+            .minutes = current_time.minutes,
+            .seconds = current_time.seconds
+        };
+        LabVIEW_Send_Telemetry(&telemetry);
+        TRACE_END(TRACE_ID_TELEMETRY);
+        PROFILE_END(PROF_UART);
         /* Update LCD display */
+        PROFILE_BEGIN(PROF_LCD);
+        TRACE_BEGIN(TRACE_ID_LCD);
         updateLCD();
-        delay_ms(100);
+        TRACE_END(TRACE_ID_LCD);
+        PROFILE_END(PROF_LCD);
+        TRACE_END(TRACE_ID_PASS);
+        PROFILE_END(PROF_PASS);
+        logSample();
+        historySample();
+        /* The erase stalls the CPU for a few hundred ms: run it now, with
+         * the pass done, no waveform being streamed and the host quiet, or
+         * regardless once it is overdue, before samples are dropped */
+        if (FlashLog_eraseOverdue() || (FlashLog_eraseDue()
+                && !LabVIEW_Stream_isRequested()
+                && LabVIEW_UART_isRxQuiet(FLASH_LOG_RX_QUIET_MS))) {
+            FlashLog_eraseSpare();
+        }
     }
 }
 
+/**
+ * @brief Control period timer callback (SysTick context)
+ * Marks the sensing and control pass as due.
+ */
+static void controlTimerExpired(void *arg) {
+    (void) arg;
+    if (control_due) {
+        /* The previous pass has not started yet */
+        HEALTH_INC(HEALTH_CONTROL_OVERRUN);
+    }
+    control_due = 1;
+}
 
+#if POWER_STOP_MODE
 /**
- * @brief GPIO Pins Configuration
- * This function configures the GPIO pins for various peripherals
- * including the soil moisture sensor, relay, buttons, and LCD.
+ * @brief DS3231 square-wave edge callback (EXTI context)
+ * Starts a sensing and control pass every second.
  */
-void GPIO_pinsConfig(void) {
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOBEN;
-    /* Soil Sensor PA0 - Analog Input */
-    gpio_config_t soil_sensor = { .port = SOIL_SENSOR_PORT, .pin =
-    SOIL_SENSOR_PIN, .mode = GPIO_DRIVER_MODE_ANALOG,
-            .otype = GPIO_DRIVER_OUTPUT_PUSH_PULL,
-            .speed = GPIO_DRIVER_SPEED_LOW,
-            .pull = GPIO_DRIVER_NO_PULL,
-            };
-    GPIO_Init(&soil_sensor);
-
-    /* LCD Pins PA5-PA10 - Output Push-Pull */
-    gpio_config_t lcd_pins[] = { { GPIOB, 1, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL,
-            GPIO_DRIVER_SPEED_MEDIUM, GPIO_DRIVER_NO_PULL },
-            { GPIOB, 0, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-                    GPIO_DRIVER_NO_PULL },
-            { GPIOA, 7, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-                    GPIO_DRIVER_NO_PULL },
-            { GPIOA, 6, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-                    GPIO_DRIVER_NO_PULL },
-            { GPIOB, 10, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-                    GPIO_DRIVER_NO_PULL },
-            { GPIOB, 2, GPIO_DRIVER_MODE_OUTPUT, GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_MEDIUM,
-                    GPIO_DRIVER_NO_PULL }
+static void controlSyncEdge(void) {
+    if (control_due) {
+        HEALTH_INC(HEALTH_CONTROL_OVERRUN);
+    }
+    control_due = 1;
+}
+#endif
+
+/**
+ * @brief Paced diagnostic output for command replies and exports
+ * Lines go out as log frames in binary mode and as plain text lines
+ * otherwise, since the host asked for them. A line the TX ring cannot
+ * take whole is refused rather than dropped or cut.
+ * @return 1 if the line was queued, 0 to retry later
+ */
+static uint8_t diagEmit(const char *line) {
+    char buffer[DIAG_LINE_WIDTH + 3];
+    char *end;
+
+    if (LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY) {
+        return LabVIEW_Log(line);
+    }
+    end = FMT_str(buffer, line);
+    end = FMT_str(end, "\r\n");
+    return LabVIEW_UART_SendBuffer((const uint8_t*) buffer,
+            (uint16_t) (end - buffer));
+}
+
+/**
+ * @brief Opens a reply line, queued after any reply still being sent
+ * @param tag Start of the line, and of the lines it wraps into
+ * @note Lines beyond DIAG_REPLY_LINES, and their fields, are left out.
+ */
+static void diagReplyLine(const char *tag) {
+    if (diag_reply_sent == diag_reply_count) {
+        diag_reply_count = 0;
+        diag_reply_sent = 0;
+    }
+    diag_reply_tag = tag;
+    diag_reply_open = (diag_reply_count < DIAG_REPLY_LINES);
+    if (!diag_reply_open) {
+        return;
+    }
+    char *end = FMT_str(diag_reply[diag_reply_count], tag);
+    *end = '\0';
+    diag_reply_length = (uint8_t) (end - diag_reply[diag_reply_count]);
+    diag_reply_count++;
+}
+
+/**
+ * @brief Appends " name=value", or " name=-value" if 'negative', to the
+ * open reply line, wrapping into a new line with the same tag when it would
+ * pass DIAG_LINE_WIDTH
+ */
+static void diagReplyValue(const char *name, uint32_t value, uint8_t negative) {
+    /* Space, name, '=', sign and up to 10 digits */
+    if (diag_reply_open
+            && diag_reply_length + strlen(name) + 13 > DIAG_LINE_WIDTH) {
+        diagReplyLine(diag_reply_tag);
+    }
+    if (!diag_reply_open) {
+        return;
+    }
+    char *line = diag_reply[diag_reply_count - 1];
+    char *end = FMT_str(line + diag_reply_length, " ");
+    end = FMT_str(end, name);
+    *end++ = '=';
+    if (negative) {
+        *end++ = '-';
+    }
+    end = FMT_uint(end, value, 1);
+    *end = '\0';
+    diag_reply_length = (uint8_t) (end - line);
+}
+
+/**
+ * @brief Appends " name=value" to the open reply line
+ */
+static void diagReplyField(const char *name, uint32_t value) {
+    diagReplyValue(name, value, 0);
+}
+
+/**
+ * @brief Appends a signed " name=value" to the open reply line
+ */
+static void diagReplySigned(const char *name, int32_t value) {
+    diagReplyValue(name, value < 0 ? 0U - (uint32_t) value : (uint32_t) value,
+            value < 0);
+}
+
+/**
+ * @brief Sends queued reply lines until the TX ring refuses one
+ */
+static void diagReplyStep(void) {
+    while (diag_reply_sent < diag_reply_count
+            && diagEmit(diag_reply[diag_reply_sent])) {
+        diag_reply_sent++;
+    }
+}
+
+/**
+ * @brief "SLEEP" sends the power-state counters
+ * "SLEEP run_ms=... sleep_ms=... stop_ms=... stop=... aborted=... ..." with
+ * the time in each state and the STOP outcomes, then "VETO NAME=count ..."
+ * with how often each busy check refused STOP.
+ */
+static void sleepCommand(const int32_t *args, uint8_t argc) {
+    sleep_mgr_stats_t stats;
+    const char *name;
+    (void) args;
+    (void) argc;
+
+    SleepMgr_getStats(&stats);
+    diagReplyLine("SLEEP");
+    diagReplyField("run_ms", (uint32_t) (stats.run_us / 1000U));
+    diagReplyField("sleep_ms", (uint32_t) (stats.sleep_us / 1000U));
+    diagReplyField("stop_ms", (uint32_t) (stats.stop_us / 1000U));
+    diagReplyField("stop", stats.stop_entries);
+    diagReplyField("aborted", stats.stop_aborted);
+    diagReplyField("vetoed", stats.stop_vetoed);
+    diagReplyField("wake_sync", stats.wake_sync);
+    diagReplyField("wake_exti", stats.wake_exti);
+    diagReplyField("clock_fail", stats.clock_failures);
+    diagReplyField("wake_us", stats.wake_last_us);
+    diagReplyField("wake_max_us", stats.wake_max_us);
+
+    diagReplyLine("VETO");
+    for (uint8_t i = 0; i < SLEEPMGR_MAX_BUSY; i++) {
+        uint32_t vetoes = SleepMgr_getVetoes(i, &name);
+        if (name == 0) {
+            break;
+        }
+        diagReplyField(name, vetoes);
+    }
+}
+
+/**
+ * @brief "IDLE" sends the idle counters
+ * "IDLE pct=... sleeps=... tickless=... ticks_skipped=... aborted=...
+ * sleep_ms=...", where pct is the share of time in WFI since the previous
+ * "IDLE" (or since boot), STOP periods not included.
+ */
+static void idleCommand(const int32_t *args, uint8_t argc) {
+    idle_stats_t stats;
+    (void) args;
+    (void) argc;
+
+    diagReplyLine("IDLE");
+    diagReplyField("pct", Idle_getIdlePercent());
+    Idle_getStats(&stats);
+    diagReplyField("sleeps", stats.sleeps);
+    diagReplyField("tickless", stats.tickless_sleeps);
+    diagReplyField("ticks_skipped", stats.ticks_suppressed);
+    diagReplyField("aborted", stats.aborted);
+    diagReplyField("sleep_ms", (uint32_t) (stats.sleep_us / 1000U));
+}
+
+/**
+ * @brief "BAUD" sends the USART2 rate
+ * "BAUD requested=... actual=... error_ppm=... pclk=... over8=...", where
+ * actual is the rate the BRR divider produces from pclk, the APB1 clock.
+ */
+static void baudCommand(const int32_t *args, uint8_t argc) {
+    labview_baud_t baud;
+    (void) args;
+    (void) argc;
+
+    LabVIEW_UART_getBaud(&baud);
+    diagReplyLine("BAUD");
+    diagReplyField("requested", baud.requested);
+    diagReplyField("actual", baud.actual);
+    diagReplySigned("error_ppm", baud.error_ppm);
+    diagReplyField("pclk", baud.pclk);
+    diagReplyField("over8", baud.over8);
+}
+
+#if PROFILE_ENABLED
+/**
+ * @brief "PROF" sends the control pass profile, "PROF 0" clears it
+ * The report runs up to about 1 KB, more than the TX ring holds, so the main
+ * loop sends it a line at a time as the ring drains.
+ */
+static void profileCommand(const int32_t *args, uint8_t argc) {
+    if (argc > 0 && args[0] == 0) {
+        Profile_reset();
+        return;
+    }
+    Profile_reportStart();
+    profile_exporting = 1;
+}
+#endif
+
+#if TRACE_ENABLED
+/**
+ * @brief "TRACE 1" clears the trace ring and starts recording, "TRACE 0"
+ * stops it, "TRACE" stops it and exports the events as Chrome trace JSON
+ */
+static void traceCommand(const int32_t *args, uint8_t argc) {
+    if (argc > 0) {
+        if (args[0]) {
+            trace_exporting = 0;
+            Trace_start();
+        } else {
+            Trace_stop();
+        }
+        return;
+    }
+    Trace_exportStart();
+    trace_exporting = 1;
+}
+#endif
+
+/**
+ * @brief "HEALTH" sends the fault counters, "HEALTH 1" also clears them
+ * Binary hosts get one PROTO_MSG_HEALTH frame of little-endian u32 values
+ * in health_counter_t order; text hosts get a "NAME=value ..." line.
+ */
+static void healthCommand(const int32_t *args, uint8_t argc) {
+    uint32_t values[HEALTH_COUNT];
+
+    Health_snapshot(values, argc > 0 && args[0] != 0);
+
+    if (LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY) {
+        uint8_t payload[HEALTH_COUNT * 4];
+        for (uint8_t i = 0; i < HEALTH_COUNT; i++) {
+            payload[i * 4] = (uint8_t) values[i];
+            payload[i * 4 + 1] = (uint8_t) (values[i] >> 8);
+            payload[i * 4 + 2] = (uint8_t) (values[i] >> 16);
+            payload[i * 4 + 3] = (uint8_t) (values[i] >> 24);
+        }
+        LabVIEW_Send_Frame(PROTO_MSG_HEALTH, payload, sizeof(payload));
+        return;
+    }
+
+    /* Up to 11 + 1 + 10 + 1 characters per counter, plus "\r\n" */
+    char line[HEALTH_COUNT * 23 + 3];
+    char *end = line;
+    for (uint8_t i = 0; i < HEALTH_COUNT; i++) {
+        if (i > 0) {
+            *end++ = ' ';
+        }
+        end = FMT_str(end, Health_getName(i));
+        *end++ = '=';
+        end = FMT_uint(end, values[i], 1);
+    }
+    end = FMT_str(end, "\r\n");
+    LabVIEW_UART_SendBuffer((const uint8_t*) line, (uint16_t) (end - line));
+}
+
+/**
+ * @brief Appends a sample to the flash log
+ * Only on a pump or mode change, or once FLASH_LOG_PERIOD_S has passed.
+ */
+static void logSample(void) {
+    log_entry_t entry = {
+        .time = DS3231_toSeconds(&current_time),
+        .moisture_raw = soil_moisture_raw,
+        .pump = pump_status,
+        .mode = current_mode == AUTO_MODE ? 0 : 1
     };
-    for (int i = 0; i < sizeof(lcd_pins) / sizeof(gpio_config_t); i++) {
-        GPIO_Init(&lcd_pins[i]);
+
+    if (log_last.time != 0 && entry.pump == log_last.pump
+            && entry.mode == log_last.mode && entry.time >= log_last.time
+            && entry.time - log_last.time < FLASH_LOG_PERIOD_S) {
+        return;
     }
+    FlashLog_append(&entry);
+    log_last = entry;
+}
 
-    /* PB15 (Relay) - Output Push-Pull */
-    gpio_config_t relay = { .port = RELAY_PORT, .pin = RELAY_PIN, .mode =
-            GPIO_DRIVER_MODE_OUTPUT, .otype = GPIO_DRIVER_OUTPUT_PUSH_PULL, .speed =
-                    GPIO_DRIVER_SPEED_MEDIUM, .pull = GPIO_DRIVER_NO_PULL };
-    GPIO_Init(&relay);
-    GPIO_Write(RELAY_PORT, RELAY_PIN, 0);
+/**
+ * @brief "LOG" exports the flash history, oldest first
+ * Binary hosts get PROTO_MSG_LOG_DUMP frames of raw slots, to be checked
+ * and decoded with LogRecord_decode, then an empty frame; text hosts get
+ * "LOG,time,raw,pump,mode" lines, then "LOG,END".
+ */
+static void logCommand(const int32_t *args, uint8_t argc) {
+    (void) args;
+    (void) argc;
+    LogRecord_reset(&log_export_codec);
+    FlashLog_exportStart();
+    log_exporting = 1;
+}
+
+/**
+ * @brief Sends a run of slots as one PROTO_MSG_LOG_DUMP frame
+ * @return Slots taken, 0 if the TX ring is full
+ */
+static uint8_t logEmitFrame(const uint8_t *slots, uint8_t count) {
+    return LabVIEW_Send_Frame(PROTO_MSG_LOG_DUMP, slots,
+            count * LOG_SLOT_SIZE) ? count : 0;
+}
 
-    /* Buttons PB0-PB4 - Input with Pull-up */
-    gpio_config_t buttons[] = {
-            { MODE_BUTTON_PORT, MODE_BUTTON_PIN, GPIO_DRIVER_MODE_INPUT,
-                    GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_PULL_UP },
-            { UP_BUTTON_PORT, UP_BUTTON_PIN, GPIO_DRIVER_MODE_INPUT,
-                    GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_PULL_UP },
-            { DOWN_BUTTON_PORT, DOWN_BUTTON_PIN, GPIO_DRIVER_MODE_INPUT,
-                    GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_PULL_UP },
-            { LEFT_BUTTON_PORT, LEFT_BUTTON_PIN, GPIO_DRIVER_MODE_INPUT,
-                    GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_PULL_UP },
-            { RIGHT_BUTTON_PORT,RIGHT_BUTTON_PIN, GPIO_DRIVER_MODE_INPUT,
-                    GPIO_DRIVER_OUTPUT_PUSH_PULL, GPIO_DRIVER_SPEED_LOW, GPIO_DRIVER_PULL_UP } };
-    for (int i = 0; i < sizeof(buttons) / sizeof(gpio_config_t); i++) {
-        GPIO_Init(&buttons[i]);
+/**
+ * @brief Decodes slots into text lines, one per sample
+ * Headers, time bases and torn slots produce no line.
+ * @return Slots taken; stops at the first line the TX ring cannot take
+ */
+static uint8_t logEmitText(const uint8_t *slots, uint8_t count) {
+    uint8_t taken;
+
+    for (taken = 0; taken < count; taken++) {
+        /* Decode on a copy so a refused line is decoded again */
+        log_codec_t codec = log_export_codec;
+        log_entry_t entry;
+        if (LogRecord_decode(&codec, &slots[taken * LOG_SLOT_SIZE], 0, &entry)
+                == LOG_SLOT_ENTRY) {
+            char line[32];
+            char *end = FMT_str(line, "LOG,");
+            end = FMT_uint(end, entry.time, 1);
+            *end++ = ',';
+            end = FMT_uint(end, entry.moisture_raw, 1);
+            *end++ = ',';
+            end = FMT_uint(end, entry.pump, 1);
+            *end++ = ',';
+            end = FMT_uint(end, entry.mode, 1);
+            end = FMT_str(end, "\r\n");
+            if (!LabVIEW_UART_SendBuffer((const uint8_t*) line,
+                    (uint16_t) (end - line))) {
+                break;
+            }
+        }
+        log_export_codec = codec;
     }
+    return taken;
 }
 
 /**
- * @brief ADC Peripheral Configuration
- * This function initializes the ADC peripheral for reading soil moisture sensor values.
+ * @brief Ends the export with an empty frame or a "LOG,END" line
+ * @return 1 if queued, 0 if the TX ring is full
  */
-void ADC_peripheralConfig(void) {
-    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
-    ADC_Init(ADC1, ADC_Resolution_12BIT, ADC_ALIGN_RIGHT,
-            ADC_CLK_PRESCALER_DIV4);
-    ADC_configChannel(ADC1, SOIL_SENSOR_ADC_CH, ADC_sampleTime_144CYCLES);
-    ADC_DMA_Config(ADC1, adc_buffer, sizeof(adc_buffer) / sizeof(uint16_t),
-            ADC_DMA_MODE_CIRCULAR);
-    ADC_Enable(ADC1);
-    ADC_DMA_Enable(ADC1);
+static uint8_t logEmitEnd(void) {
+    static const char end_line[] = "LOG,END\r\n";
+
+    if (LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY) {
+        return LabVIEW_Send_Frame(PROTO_MSG_LOG_DUMP, 0, 0);
+    }
+    return LabVIEW_UART_SendBuffer((const uint8_t*) end_line,
+            sizeof(end_line) - 1);
 }
 
 /**
- * @brief Read Button with Debouncing
- * This function reads the button state with debouncing logic.
- * It waits for the button to be released before returning a pressed state.
- *
- * @param GPIOx Pointer to the GPIO port
- * @param pin Pin number of the button
- * @return 1 if button is pressed, 0 otherwise
+ * @brief Appends a sample to the RAM history once a minute
+ */
+static void historySample(void) {
+    if (current_time.minutes == history_last_minute) {
+        return;
+    }
+    history_last_minute = current_time.minutes;
+
+    ts_record_t record = {
+        .time = DS3231_toSeconds(&current_time),
+        .moisture_raw = soil_moisture_raw,
+        .pump = pump_status
+    };
+    History_append(&record);
+}
+
+/**
+ * @brief "HIST" exports the minute history, oldest first
+ * Binary hosts get one PROTO_MSG_HISTORY frame per ts_codec block, then an
+ * empty frame (tools/log_dump decodes them); text hosts get
+ * "HIST,time,raw,pump" lines, then "HIST,END".
+ */
+static void historyCommand(const int32_t *args, uint8_t argc) {
+    (void) args;
+    (void) argc;
+    history_text_open = 0;
+    History_exportStart();
+    history_exporting = 1;
+}
+
+/**
+ * @brief Sends one block as a PROTO_MSG_HISTORY frame
+ * @return 1 if queued, 0 if the TX ring is full
  */
-uint8_t readButtonDebounced(GPIO_TypeDef *GPIOx, uint8_t pin) {
-    if (GPIO_Read(GPIOx, pin) == 0) {
-        /* Wait for button to be released */
-        delay_ms(50);
-        /* Check if button is still pressed after delay */
-        if (GPIO_Read(GPIOx, pin) == 0) {
+static uint8_t historyEmitFrame(const uint8_t *block, uint16_t length) {
+    return LabVIEW_Send_Frame(PROTO_MSG_HISTORY, block, (uint8_t) length);
+}
 
-            while (GPIO_Read(GPIOx, pin) == 0)
-                ;
+/**
+ * @brief Decodes a block into text lines, one per record
+ * A copy of the block is decoded across calls, so a line refused by the
+ * TX ring is sent again, and a block overwritten meanwhile stays intact.
+ * @return 1 once every record of the block is queued
+ */
+static uint8_t historyEmitText(const uint8_t *block, uint16_t length) {
+    if (!history_text_open) {
+        memcpy(history_text_block, block, length);
+        TsCodec_decoderInit(&history_text_dec, history_text_block, length);
+        history_text_open = 1;
+    }
+    for (;;) {
+        ts_decoder_t dec = history_text_dec;
+        ts_record_t record;
+        if (!TsCodec_next(&dec, &record)) {
+            break;
+        }
+        char line[32];
+        char *end = FMT_str(line, "HIST,");
+        end = FMT_uint(end, record.time, 1);
+        *end++ = ',';
+        end = FMT_uint(end, record.moisture_raw, 1);
+        *end++ = ',';
+        end = FMT_uint(end, record.pump, 1);
+        end = FMT_str(end, "\r\n");
+        if (!LabVIEW_UART_SendBuffer((const uint8_t*) line,
+                (uint16_t) (end - line))) {
+            return 0;
+        }
+        history_text_dec = dec;
+    }
+    history_text_open = 0;
+    return 1;
+}
+
+/**
+ * @brief Ends the export with an empty frame or a "HIST,END" line
+ * @return 1 if queued, 0 if the TX ring is full
+ */
+static uint8_t historyEmitEnd(void) {
+    static const char end_line[] = "HIST,END\r\n";
+
+    if (LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY) {
+        return LabVIEW_Send_Frame(PROTO_MSG_HISTORY, 0, 0);
+    }
+    return LabVIEW_UART_SendBuffer((const uint8_t*) end_line,
+            sizeof(end_line) - 1);
+}
 
-            return 1;
+/**
+ * @brief Counts and clears ADC DMA error flags
+ * A transfer error disables the stream, so the counter going up means the
+ * moisture readings have frozen.
+ */
+static void ADC_countDmaErrors(void) {
+    static const ADC_DMA_genericFlag errors[] = {
+        ADC_DMA_FLAG_TE, ADC_DMA_FLAG_DME, ADC_DMA_FLAG_FE
+    };
+
+    for (uint8_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
+        if (ADC_DMA_getFlagStatus(ADC1, errors[i])) {
+            ADC_DMA_clearFlag(ADC1, errors[i]);
+            HEALTH_INC(HEALTH_ADC_DMA_ERROR);
+        }
+    }
+}
+
+/**
+ * @brief Main loop work check, run by Idle_sleep with interrupts masked
+ * @return 1 if the loop has something to do and must not sleep
+ */
+static uint8_t mainLoopReady(void) {
+    return control_due || LabVIEW_UART_hasPending() || Button_hasEvent()
+            || SoftTimer_hasDeferred();
+}
+
+
+/**
+ * @brief GPIO Pins Configuration
+ * This function configures the GPIO pins for various peripherals
+ * including the soil moisture sensor, relay, buttons, and LCD, as listed
+ * in the board pin table (board_pins.c).
+ */
+void GPIO_pinsConfig(void) {
+    if (Board_pinsInit() >= 0) {
+        /* Two entries of board_pins[] use the same pin */
+        Error_Handler();
+    }
+}
+
+/**
+ * @brief ADC Peripheral Configuration
+ * This function initializes the ADC peripheral for reading soil moisture sensor values.
+ * Boot step: configures the ADC and DMA, powers the ADC on, and completes
+ * once the first DMA block of samples is available.
+ * @param wait_us Receives the delay required before the next call
+ * @return 1 when the first valid reading is in adc_buffer, 0 otherwise
+ */
+static uint8_t ADC_peripheralConfigStep(uint32_t *wait_us) {
+    static uint8_t state = 0;
+    *wait_us = 0;
+
+    switch (state) {
+    case 0:
+        RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+        ADC_Init(ADC1, ADC_Resolution_12BIT, ADC_ALIGN_RIGHT,
+                ADC_CLK_PRESCALER_DIV4);
+        ADC_configChannel(ADC1, SOIL_SENSOR_ADC_CH, ADC_sampleTime_144CYCLES);
+        ADC_DMA_Config(ADC1, adc_buffer, sizeof(adc_buffer) / sizeof(uint16_t),
+                ADC_DMA_MODE_CIRCULAR);
+        ADC_powerOn(ADC1);
+        *wait_us = ADC_STABILIZATION_US;
+        state = 1;
+        return 0;
+    case 1:
+        ADC_DMA_Enable(ADC1);
+        ADC_startConversionSW(ADC1);
+        state = 2;
+        return 0;
+    default:
+        /* adc_buffer now holds a full block of valid samples */
+        if (!ADC_DMA_getFlagStatus(ADC1, ADC_DMA_FLAG_TC)) {
+            *wait_us = 10;
+            return 0;
         }
+        return 1;
     }
-    return 0;
+}
+
+/**
+ * @brief LabVIEW UART boot step
+ * USART2 set-up has no hardware wait, it completes in a single call.
+ */
+static uint8_t LabVIEW_UART_InitStep(uint32_t *wait_us) {
+    *wait_us = 0;
+    LabVIEW_UART_Init();
+    return 1;
 }
 
 /**
  * @brief Handle Button Inputs
- * This function handles the button inputs for switching modes and setting manual watering times.
+ * This function drains the button event queue and applies each press to the
+ * mode and manual watering times. It never waits for a button.
  */
 void handleButtonInputs(void) {
+    button_event_t event;
+
+    while (Button_getEvent(&event)) {
+        /* Held UP/DOWN repeat like fresh presses */
+        if (event.type == BUTTON_EVENT_PRESS
+                || event.type == BUTTON_EVENT_REPEAT) {
+            handleButtonPress(event.button);
+        }
+    }
+}
+
+/**
+ * @brief Handle one Button Press
+ * This function switches modes and sets the manual watering times.
+ *
+ * @param button Index of the pressed button (BUTTON_MODE...BUTTON_RIGHT)
+ */
+static void handleButtonPress(uint8_t button) {
     /* Switch between Auto and Manual Mode */
-    if (readButtonDebounced(MODE_BUTTON_PORT, MODE_BUTTON_PIN)) {
+    if (button == BUTTON_MODE) {
         current_mode = (current_mode == AUTO_MODE) ? MANUAL_MODE : AUTO_MODE;
         manual_ui_state = DISPLAY_MANUAL_NORMAL;
         LCD_Clear();
+        return;
     }
 
     /* Handle Manual Mode UI State */
-    if (current_mode == MANUAL_MODE) {
-        ds3231_time_t temp_time;  // Temporary time structure for validation
-
-        switch (manual_ui_state) {
-        case DISPLAY_MANUAL_NORMAL:
-            if (readButtonDebounced(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN)) {
-                manual_ui_state = SETTING_START_HOUR;
-            }
-            break;
-
-        case SETTING_START_HOUR:
-            if (readButtonDebounced(UP_BUTTON_PORT, UP_BUTTON_PIN)) {
-                manual_start_time.hours = (manual_start_time.hours + 1) % 24;
-                if (Time_ToMinutes(&manual_start_time)
-                        >= Time_ToMinutes(&manual_stop_time)) {
-                    manual_stop_time = manual_start_time;
-                    manual_stop_time.minutes = (manual_stop_time.minutes + 1)
-                            % 60;
-                    if (manual_stop_time.minutes == 0) {
-                        manual_stop_time.hours = (manual_stop_time.hours + 1)
-                                % 24;
-                    }
-                }
-            }
-            if (readButtonDebounced(DOWN_BUTTON_PORT, DOWN_BUTTON_PIN)) {
-                manual_start_time.hours = (manual_start_time.hours + 23) % 24;
-            }
-            if (readButtonDebounced(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN))
-                manual_ui_state = SETTING_START_MINUTE;
-            if (readButtonDebounced(LEFT_BUTTON_PORT, LEFT_BUTTON_PIN))
-                manual_ui_state = DISPLAY_MANUAL_NORMAL;
-            break;
+    if (current_mode != MANUAL_MODE) {
+        return;
+    }
+    ds3231_time_t temp_time;  // Temporary time structure for validation
 
-        case SETTING_START_MINUTE:
-            if (readButtonDebounced(UP_BUTTON_PORT, UP_BUTTON_PIN)) {
-                manual_start_time.minutes = (manual_start_time.minutes + 1)
+    switch (manual_ui_state) {
+    case DISPLAY_MANUAL_NORMAL:
+        if (button == BUTTON_RIGHT) {
+            manual_ui_state = SETTING_START_HOUR;
+        }
+        break;
+
+    case SETTING_START_HOUR:
+        if (button == BUTTON_UP) {
+            manual_start_time.hours = (manual_start_time.hours + 1) % 24;
+            if (Time_ToMinutes(&manual_start_time)
+                    >= Time_ToMinutes(&manual_stop_time)) {
+                manual_stop_time = manual_start_time;
+                manual_stop_time.minutes = (manual_stop_time.minutes + 1)
                         % 60;
-                if (manual_start_time.minutes == 0)
-                    manual_start_time.hours = (manual_start_time.hours + 1)
+                if (manual_stop_time.minutes == 0) {
+                    manual_stop_time.hours = (manual_stop_time.hours + 1)
                             % 24;
-                if (Time_ToMinutes(&manual_start_time)
-                        >= Time_ToMinutes(&manual_stop_time)) {
-                    manual_stop_time = manual_start_time;
-                    manual_stop_time.minutes = (manual_stop_time.minutes + 1)
-                            % 60;
-                    if (manual_stop_time.minutes == 0)
-                        manual_stop_time.hours = (manual_stop_time.hours + 1)
-                                % 24;
                 }
             }
-            if (readButtonDebounced(DOWN_BUTTON_PORT, DOWN_BUTTON_PIN)) {
-                if (manual_start_time.minutes == 0)
-                    manual_start_time.hours = (manual_start_time.hours + 23)
-                            % 24;
-                manual_start_time.minutes = (manual_start_time.minutes + 59)
+        }
+        if (button == BUTTON_DOWN) {
+            manual_start_time.hours = (manual_start_time.hours + 23) % 24;
+        }
+        if (button == BUTTON_RIGHT)
+            manual_ui_state = SETTING_START_MINUTE;
+        if (button == BUTTON_LEFT)
+            manual_ui_state = DISPLAY_MANUAL_NORMAL;
+        break;
+
+    case SETTING_START_MINUTE:
+        if (button == BUTTON_UP) {
+            manual_start_time.minutes = (manual_start_time.minutes + 1)
+                    % 60;
+            if (manual_start_time.minutes == 0)
+                manual_start_time.hours = (manual_start_time.hours + 1)
+                        % 24;
+            if (Time_ToMinutes(&manual_start_time)
+                    >= Time_ToMinutes(&manual_stop_time)) {
+                manual_stop_time = manual_start_time;
+                manual_stop_time.minutes = (manual_stop_time.minutes + 1)
                         % 60;
+                if (manual_stop_time.minutes == 0)
+                    manual_stop_time.hours = (manual_stop_time.hours + 1)
+                            % 24;
             }
-            if (readButtonDebounced(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN))
-                manual_ui_state = SETTING_STOP_HOUR;
-            if (readButtonDebounced(LEFT_BUTTON_PORT, LEFT_BUTTON_PIN))
-                manual_ui_state = SETTING_START_HOUR;
-            break;
-
-        case SETTING_STOP_HOUR:
-            if (readButtonDebounced(UP_BUTTON_PORT, UP_BUTTON_PIN)) {
-                manual_stop_time.hours = (manual_stop_time.hours + 1) % 24;
+        }
+        if (button == BUTTON_DOWN) {
+            if (manual_start_time.minutes == 0)
+                manual_start_time.hours = (manual_start_time.hours + 23)
+                        % 24;
+            manual_start_time.minutes = (manual_start_time.minutes + 59)
+                    % 60;
+        }
+        if (button == BUTTON_RIGHT)
+            manual_ui_state = SETTING_STOP_HOUR;
+        if (button == BUTTON_LEFT)
+            manual_ui_state = SETTING_START_HOUR;
+        break;
+
+    case SETTING_STOP_HOUR:
+        if (button == BUTTON_UP) {
+            manual_stop_time.hours = (manual_stop_time.hours + 1) % 24;
+        }
+        if (button == BUTTON_DOWN) {
+            temp_time = manual_stop_time;
+            temp_time.hours = (temp_time.hours + 23) % 24;
+            if (Time_ToMinutes(&temp_time)
+                    > Time_ToMinutes(&manual_start_time)) {
+                manual_stop_time.hours = temp_time.hours;
             }
-            if (readButtonDebounced(DOWN_BUTTON_PORT, DOWN_BUTTON_PIN)) {
-                temp_time = manual_stop_time;
+        }
+        if (button == BUTTON_RIGHT)
+            manual_ui_state = SETTING_STOP_MINUTE;
+        if (button == BUTTON_LEFT)
+            manual_ui_state = SETTING_START_MINUTE;
+        break;
+
+    case SETTING_STOP_MINUTE:
+        if (button == BUTTON_UP) {
+            manual_stop_time.minutes = (manual_stop_time.minutes + 1) % 60;
+            if (manual_stop_time.minutes == 0)
+                manual_stop_time.hours = (manual_stop_time.hours + 1) % 24;
+        }
+        if (button == BUTTON_DOWN) {
+            temp_time = manual_stop_time;
+            if (temp_time.minutes == 0)
                 temp_time.hours = (temp_time.hours + 23) % 24;
-                if (Time_ToMinutes(&temp_time)
-                        > Time_ToMinutes(&manual_start_time)) {
-                    manual_stop_time.hours = temp_time.hours;
-                }
+            temp_time.minutes = (temp_time.minutes + 59) % 60;
+            if (Time_ToMinutes(&temp_time)
+                    > Time_ToMinutes(&manual_start_time)) {
+                manual_stop_time = temp_time;
             }
-            if (readButtonDebounced(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN))
-                manual_ui_state = SETTING_STOP_MINUTE;
-            if (readButtonDebounced(LEFT_BUTTON_PORT, LEFT_BUTTON_PIN))
-                manual_ui_state = SETTING_START_MINUTE;
-            break;
-
-        case SETTING_STOP_MINUTE:
-            if (readButtonDebounced(UP_BUTTON_PORT, UP_BUTTON_PIN)) {
-                manual_stop_time.minutes = (manual_stop_time.minutes + 1) % 60;
-                if (manual_stop_time.minutes == 0)
-                    manual_stop_time.hours = (manual_stop_time.hours + 1) % 24;
-            }
-            if (readButtonDebounced(DOWN_BUTTON_PORT, DOWN_BUTTON_PIN)) {
-                temp_time = manual_stop_time;
-                if (temp_time.minutes == 0)
-                    temp_time.hours = (temp_time.hours + 23) % 24;
-                temp_time.minutes = (temp_time.minutes + 59) % 60;
-                if (Time_ToMinutes(&temp_time)
-                        > Time_ToMinutes(&manual_start_time)) {
-                    manual_stop_time = temp_time;
-                }
-            }
-            if (readButtonDebounced(RIGHT_BUTTON_PORT, RIGHT_BUTTON_PIN))
-                manual_ui_state = DISPLAY_MANUAL_NORMAL;
-            if (readButtonDebounced(LEFT_BUTTON_PORT, LEFT_BUTTON_PIN))
-                manual_ui_state = SETTING_STOP_HOUR;
-            break;
         }
+        if (button == BUTTON_RIGHT)
+            manual_ui_state = DISPLAY_MANUAL_NORMAL;
+        if (button == BUTTON_LEFT)
+            manual_ui_state = SETTING_STOP_HOUR;
+        break;
     }
 }
 
@@ -391,6 +1135,9 @@ uint8_t ADC_convertToMoisturePercentage(uint16_t adc_value) {
  * @param state 1 to turn on the pump, 0 to turn it off
  */
 void controlPump(uint8_t state) {
+    if (state && !pump_status) {
+        HEALTH_INC(HEALTH_PUMP_START);
+    }
     if (state) {
         GPIO_Write(RELAY_PORT, RELAY_PIN, 1);
         pump_status = 1;
@@ -471,64 +1218,87 @@ void processManualMode(void) {
  * It formats the display based on whether the system is in auto or manual mode.
  */
 void updateLCD(void) {
-    char line1[21];
-    char line2[21];
-    memset(line1, 0, sizeof(line1));
-    memset(line2, 0, sizeof(line2));
+    /* Room for the widest field sequence; FMT_finishLine clips to the display */
+    char line1[32];
+    char line2[32];
+    char *p1 = line1;
+    char *p2 = line2;
+    uint8_t cols = LCD_getColumns();
 
     if (current_mode == AUTO_MODE) {
-        sprintf(line1, "AUTO %02d:%02d:%02d", current_time.hours,
-                current_time.minutes, current_time.seconds);
-        sprintf(line2, "Moist:%3d%% P:%s", soil_moisture_percent,
-                pump_status ? "ON" : "OFF");
+        p1 = FMT_str(p1, "AUTO ");
+        p1 = FMT_time(p1, current_time.hours, current_time.minutes,
+                current_time.seconds);
+        p2 = FMT_str(p2, "Moist:");
+        p2 = FMT_percent(p2, soil_moisture_percent);
+        p2 = FMT_str(p2, " P:");
+        p2 = FMT_onOff(p2, pump_status);
     } else {
         switch (manual_ui_state) {
         case DISPLAY_MANUAL_NORMAL:
-            sprintf(line1, "MANUAL %02d:%02d:%02d", current_time.hours,
-                    current_time.minutes, current_time.seconds);
-            sprintf(line2, "S:%02d:%02d E:%02d:%02d P:%s",
-                    manual_start_time.hours, manual_start_time.minutes,
-                    manual_stop_time.hours, manual_stop_time.minutes,
-                    pump_status ? "ON" : "OFF");
+            p1 = FMT_str(p1, "MANUAL ");
+            p1 = FMT_time(p1, current_time.hours, current_time.minutes,
+                    current_time.seconds);
+            p2 = FMT_str(p2, "S:");
+            p2 = FMT_hourMinute(p2, manual_start_time.hours,
+                    manual_start_time.minutes);
+            p2 = FMT_str(p2, " E:");
+            p2 = FMT_hourMinute(p2, manual_stop_time.hours,
+                    manual_stop_time.minutes);
+            p2 = FMT_str(p2, " P:");
+            p2 = FMT_onOff(p2, pump_status);
             break;
         case SETTING_START_HOUR:
-            sprintf(line1, "Set Start HH:MM");
-            sprintf(line2, ">%02d_:%02d S:%02d:%02d", manual_start_time.hours,
-                    manual_start_time.minutes, manual_stop_time.hours,
+            p1 = FMT_str(p1, "Set Start HH:MM");
+            p2 = FMT_str(p2, ">");
+            p2 = FMT_twoDigits(p2, manual_start_time.hours);
+            p2 = FMT_str(p2, "_:");
+            p2 = FMT_twoDigits(p2, manual_start_time.minutes);
+            p2 = FMT_str(p2, " S:");
+            p2 = FMT_hourMinute(p2, manual_stop_time.hours,
                     manual_stop_time.minutes);
             break;
         case SETTING_START_MINUTE:
-            sprintf(line1, "Set Start HH:MM");
-            sprintf(line2, " %02d:%02d< S:%02d:%02d", manual_start_time.hours,
-                    manual_start_time.minutes, manual_stop_time.hours,
+            p1 = FMT_str(p1, "Set Start HH:MM");
+            p2 = FMT_str(p2, " ");
+            p2 = FMT_hourMinute(p2, manual_start_time.hours,
+                    manual_start_time.minutes);
+            p2 = FMT_str(p2, "< S:");
+            p2 = FMT_hourMinute(p2, manual_stop_time.hours,
                     manual_stop_time.minutes);
             break;
         case SETTING_STOP_HOUR:
-            sprintf(line1, "Set Stop HH:MM");
-            sprintf(line2, "S:%02d:%02d >%02d_:%02d", manual_start_time.hours,
-                    manual_start_time.minutes, manual_stop_time.hours,
-                    manual_stop_time.minutes);
+            p1 = FMT_str(p1, "Set Stop HH:MM");
+            p2 = FMT_str(p2, "S:");
+            p2 = FMT_hourMinute(p2, manual_start_time.hours,
+                    manual_start_time.minutes);
+            p2 = FMT_str(p2, " >");
+            p2 = FMT_twoDigits(p2, manual_stop_time.hours);
+            p2 = FMT_str(p2, "_:");
+            p2 = FMT_twoDigits(p2, manual_stop_time.minutes);
             break;
         case SETTING_STOP_MINUTE:
-            sprintf(line1, "Set Stop HH:MM");
-            sprintf(line2, "S:%02d:%02d  %02d:%02d<", manual_start_time.hours,
-                    manual_start_time.minutes, manual_stop_time.hours,
+            p1 = FMT_str(p1, "Set Stop HH:MM");
+            p2 = FMT_str(p2, "S:");
+            p2 = FMT_hourMinute(p2, manual_start_time.hours,
+                    manual_start_time.minutes);
+            p2 = FMT_str(p2, "  ");
+            p2 = FMT_hourMinute(p2, manual_stop_time.hours,
                     manual_stop_time.minutes);
+            p2 = FMT_str(p2, "<");
             break;
         }
     }
 
+    /* Pad with spaces to the full width so no strlen/padding loop is needed */
+    FMT_finishLine(line1, p1, cols);
+    FMT_finishLine(line2, p2, cols);
+
     LCD_setCursor(0, 0);
     LCD_Write(line1);
 
-    for (int i = strlen(line1); i < 16; i++)
-        LCD_Put(' ');
-
     LCD_setCursor(0, 1); // Dòng thứ 2, cột 0
     LCD_Write(line2);
-    for (int i = strlen(line2); i < 16; i++)
-        LCD_Put(' ');
-
 }
 
 void SystemClock_Config(void) {
@@ -12,6 +12,12 @@
 #define DS3231_REG_DATE         0x04 /* Date of the month Register (1-31) */
 #define DS3231_REG_MONTH        0x05 /* Month Register. Bit 7: Century. (1-12) */
 #define DS3231_REG_YEAR         0x06 /* Year Register (00-99) */
+#define DS3231_REG_CONTROL      0x0E /* Control Register */
+
+/* Control Register bits */
+#define DS3231_CONTROL_INTCN    0x04 /* 1: INT/SQW is the alarm interrupt */
+#define DS3231_CONTROL_RS_POS   3    /* RS2:RS1, square-wave rate */
+#define DS3231_CONTROL_RS_MASK  0x18
 
 
 /**
@@ -170,8 +176,10 @@ void DS3231_setDate(uint8_t dow, uint8_t date, uint8_t month, uint8_t year) {
  * @brief Get the full time and date from the DS3231 RTC
  * @param time_struct Pointer to a ds3231_time_t structure to fill with current time and date
  * All values in the structure will be in decimal format.
+ * @return 1 on success, 0 if the transaction failed; the structure is
+ * then left unchanged.
  */
-void DS3231_getFullTime(ds3231_time_t *time_struct) {
+uint8_t DS3231_getFullTime(ds3231_time_t *time_struct) {
     uint8_t raw_seconds, raw_minutes, raw_hours, raw_day, raw_date, raw_month, raw_year;
 
     I2C_Start();
@@ -195,6 +203,11 @@ void DS3231_getFullTime(ds3231_time_t *time_struct) {
     raw_year = I2C_readByte(MULTI_BYTE_ACK_OFF);   /* Read year, NACK (last byte) */
     I2C_Stop();
 
+    /* A NACK or stall anywhere leaves 0xFF bytes: keep the previous time */
+    if (I2C_hasFailed()) {
+        return 0;
+    }
+
     /* Convert BCD values to decimal and store in the structure */
     time_struct->seconds = bcd_to_dec(raw_seconds & 0x7F); /* Mask CH bit */
     time_struct->minutes = bcd_to_dec(raw_minutes & 0x7F); /* Mask unused bit 7 */
@@ -228,4 +241,52 @@ void DS3231_getFullTime(ds3231_time_t *time_struct) {
     time_struct->month = bcd_to_dec(raw_month & 0x1F);
     /* Year is 00-99 */
     time_struct->year = bcd_to_dec(raw_year);
+    return 1;
+}
+
+/**
+ * @brief Select the output of the INT/SQW pin
+ * @param sqw Square-wave rate, or DS3231_SQW_OFF for alarm interrupts
+ * @note The other control bits (oscillator, alarms) are preserved.
+ */
+void DS3231_setSquareWave(ds3231_sqw_t sqw) {
+    uint8_t control = DS3231_readRegister(DS3231_REG_CONTROL);
+
+    /* Writing back a failed read would set random control bits */
+    if (I2C_hasFailed()) {
+        return;
+    }
+    control &= (uint8_t) ~(DS3231_CONTROL_INTCN | DS3231_CONTROL_RS_MASK);
+    if (sqw == DS3231_SQW_OFF) {
+        control |= DS3231_CONTROL_INTCN;
+    } else {
+        control |= (uint8_t) (sqw << DS3231_CONTROL_RS_POS);
+    }
+    DS3231_writeRegister(DS3231_REG_CONTROL, control);
+}
+
+/**
+ * @brief Convert a date and time to seconds since 2000-01-01 00:00:00
+ * Every year divisible by 4 is a leap year, which holds for 2000-2099.
+ * @param time_struct Date and time as read by DS3231_getFullTime
+ * @return Seconds since the start of 2000
+ */
+uint32_t DS3231_toSeconds(const ds3231_time_t *time_struct) {
+    static const uint16_t days_before_month[12] = {
+        0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+    };
+    uint32_t year = time_struct->year;
+    uint8_t month = (time_struct->month >= 1 && time_struct->month <= 12)
+            ? time_struct->month : 1;
+    uint32_t days = year * 365U + (year + 3U) / 4U
+            + days_before_month[month - 1];
+
+    if (month > 2 && (year % 4U) == 0) {
+        days++;
+    }
+    if (time_struct->date > 0) {
+        days += time_struct->date - 1U;
+    }
+    return ((days * 24U + time_struct->hours) * 60U + time_struct->minutes)
+            * 60U + time_struct->seconds;
 }
@@ -17,6 +17,17 @@ typedef struct {
     uint8_t year;    /* Year: 0-99 (representing 2000-2099, assuming century bit is handled or RTC is in 21st century) */
 } ds3231_time_t;
 
+/**
+ * @brief Output of the INT/SQW pin, set through the control register.
+ */
+typedef enum {
+    DS3231_SQW_1HZ = 0,     /* 1 Hz square wave */
+    DS3231_SQW_1024HZ,      /* 1.024 kHz square wave */
+    DS3231_SQW_4096HZ,      /* 4.096 kHz square wave */
+    DS3231_SQW_8192HZ,      /* 8.192 kHz square wave */
+    DS3231_SQW_OFF          /* Pin used for alarm interrupts, held high */
+} ds3231_sqw_t;
+
 
 /**
  * @brief Get the current seconds from the DS3231 RTC.
@@ -60,7 +71,26 @@ void DS3231_setDate(uint8_t dow, uint8_t date, uint8_t month, uint8_t year);
  * @brief Get the full time and date from the DS3231 RTC.
  * @param time_struct Pointer to a ds3231_time_t structure to be filled with current time and date.
  * All values in the structure will be in decimal format.
+ * @return 1 on success, 0 after a NACK or bus stall; the structure is then
+ * left unchanged.
+ */
+uint8_t DS3231_getFullTime(ds3231_time_t *time_struct);
+
+/**
+ * @brief Select the output of the open-drain INT/SQW pin.
+ * @param sqw Square-wave rate, or DS3231_SQW_OFF for alarm interrupts.
+ * @note The square wave runs from VCC only (BBSQW is left clear). Its
+ * falling edge lines up with the seconds register update, so the 1 Hz
+ * output is a precise wake-up source while the MCU is in STOP mode.
+ * Nothing is written if reading the control register fails.
+ */
+void DS3231_setSquareWave(ds3231_sqw_t sqw);
+
+/**
+ * @brief Convert a date and time to seconds since 2000-01-01 00:00:00.
+ * @param time_struct Date and time as read by DS3231_getFullTime.
+ * @return Seconds since the start of 2000, valid through 2099.
  */
-void DS3231_getFullTime(ds3231_time_t *time_struct);
+uint32_t DS3231_toSeconds(const ds3231_time_t *time_struct);
 
 #endif /* DS3231_H_ */
@@ -1,8 +1,10 @@
 #include "i2c_driver.h"
+#include "delay.h"
+#include "health.h"
 
-#define PCLK1_FREQ_MHZ         42                   /* PCLK1 frequency in MHz, adjust as needed */
-#define I2C_STANDARD_MODE_CCR  (PCLK1_FREQ_MHZ * 5) /* Standard mode CCR value for 100kHz */
-#define I2C_TRISE_VALUE        (PCLK1_FREQ_MHZ + 1) /* TRISE value for 100kHz */
+/* Standard mode SCL frequency. CCR, TRISE and the CR2 FREQ field are
+ * computed from the live PCLK1, so they follow clock switches */
+#define I2C_SCL_FREQ_HZ        100000
 
 #define I2C_GPIO_RCC_ENR RCC_AHB1ENR_GPIOBEN  /* GPIOB clock enable bit */
 #define I2C_RCC_ENR      RCC_APB1ENR_I2C1EN   /* I2C1 clock enable bit */
@@ -10,108 +12,214 @@
 #define I2C_SCL_PIN      6                    /* SCL pin number */
 #define I2C_SDA_PIN      7                    /* SDA pin number */
 
+/* Bus recovery timing: half an SCL period at 100kHz */
+#define I2C_RECOVERY_SETTLE_US 10
+#define I2C_RECOVERY_HALF_US   5
+#define I2C_RECOVERY_EDGES     18 /* 9 clock pulses, low and high phase each */
+
+/* States of the resumable initialisation driven by I2C_initStep */
+typedef enum {
+    I2C_INIT_PINS = 0,     /* Clocks and AF pin setup, BUSY check */
+    I2C_INIT_CLOCK_PULSES, /* Toggling SCL to release a stuck slave */
+    I2C_INIT_STOP_SDA_LOW, /* Manual STOP: SDA low while SCL high */
+    I2C_INIT_STOP_SDA_HIGH,/* Manual STOP: SDA rising edge */
+    I2C_INIT_CONFIGURE     /* Peripheral reset and timing setup */
+} i2c_init_state_t;
+
+static i2c_init_state_t i2c_init_state = I2C_INIT_PINS;
+static uint8_t i2c_recovery_edge = 0;
+
+/* A step of the current transaction failed; the rest of it is skipped.
+ * Kept across repeated STARTs, cleared by the first START after a STOP */
+static uint8_t i2c_failed = 0;
+/* A START was generated and its transaction has not been stopped yet */
+static uint8_t i2c_open = 0;
+/* A wait timed out; the next START re-initialises the bus first */
+static uint8_t i2c_stalled = 0;
+
 /**
- * @brief Initialize I2C1 peripheral for communication
+ * @brief Wait for a flag in SR1, giving up on a NACK or a stall
+ * A NACK (AF) ends the transaction with a STOP. Either failure makes the
+ * remaining steps of the transaction return at once instead of waiting
+ * on flags that will never be set.
+ * @param flag SR1 flag to wait for.
+ * @return 1 once the flag is set, 0 if the transaction failed.
+ */
+static uint8_t I2C_waitFlag(uint32_t flag) {
+    uint32_t timeout = I2C_FLAG_TIMEOUT;
+
+    if (i2c_failed) {
+        return 0;
+    }
+    while (!(I2C1->SR1 & flag)) {
+        if (I2C1->SR1 & I2C_SR1_AF) {
+            I2C1->SR1 &= ~I2C_SR1_AF;
+            I2C1->CR1 |= I2C_CR1_STOP;
+            HEALTH_INC(HEALTH_I2C_NACK);
+            i2c_failed = 1;
+            return 0;
+        }
+        if (--timeout == 0) {
+            HEALTH_INC(HEALTH_I2C_STALL);
+            i2c_failed = 1;
+            i2c_stalled = 1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Program the SCL timing for a PCLK1 frequency
+ * Standard mode: SCL high and low each last CCR PCLK1 periods, and the
+ * 1000 ns maximum rise time is PCLK1 in MHz periods.
+ * @param pclk1_hz APB1 clock in Hz (2-50 MHz).
+ * @note The peripheral is disabled while the registers change.
+ */
+static void I2C_setTiming(uint32_t pclk1_hz) {
+    uint32_t freq_mhz = pclk1_hz / 1000000U;
+
+    I2C1->CR1 &= ~I2C_CR1_PE; /* Disable peripheral (PE=0) before configuration */
+
+    /* Set peripheral clock frequency (FREQ bits in CR2) */
+    I2C1->CR2 = (I2C1->CR2 & ~I2C_CR2_FREQ) | freq_mhz;
+
+    /* Configure CCR (Clock Control Register) for SCL frequency (Standard mode 100kHz) */
+    I2C1->CCR = pclk1_hz / (2U * I2C_SCL_FREQ_HZ);
+
+    /* Configure TRISE (Rise Time Register) based on PCLK1 and max SCL rise time */
+    I2C1->TRISE = freq_mhz + 1;
+
+    I2C1->CR1 |= I2C_CR1_PE; /* Enable peripheral (PE=1) after configuration */
+}
+
+/**
+ * @brief Run the next step of the I2C1 initialisation
  * This function configures the GPIO pins for I2C,
  * enables the I2C1 peripheral,
  * and sets up the I2C timing for standard mode (100kHz).
- * It also handles the BUSY flag to ensure
- * the I2C bus is not stuck before initialization.
- * * @note This function assumes the system clock is configured
+ * If the BUSY flag is set, the bus recovery (9 SCL pulses and a manual
+ * STOP) is spread over several calls instead of spinning.
+ * @param wait_us Receives the delay required before the next call.
+ * @return 1 when the peripheral is ready, 0 if more steps remain.
  */
-void I2C_Init(void) {
-    /* Enable clocks for GPIO and I2C peripherals */
-    RCC->AHB1ENR |= I2C_GPIO_RCC_ENR;
-    RCC->APB1ENR |= I2C_RCC_ENR;
-
-    /* 2. Configure PB6 (SCL) and PB7 (SDA) for I2C1 alternate function */
-    /* These pins need to be set to: Alternate function, Open-drain, Pull-up, High speed. */
-
-    /* Clear mode bits for PB6 and PB7 */
-    I2C_PORT->MODER &= ~((3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2)));
-    /* Set PB6 and PB7 to Alternate function mode (10) */
-    I2C_PORT->MODER |= (2U << (I2C_SCL_PIN * 2)) | (2U << (I2C_SDA_PIN * 2));
-
-    /* Set PB6 and PB7 to Output open-drain (1) */
-    I2C_PORT->OTYPER |= (1U << I2C_SCL_PIN) | (1U << I2C_SDA_PIN);
-
-    /* Set PB6 and PB7 to High speed (11) */
-    I2C_PORT->OSPEEDR |= (3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2));
-
-    /* Clear pull-up/pull-down bits for PB6 and PB7 */
-    I2C_PORT->PUPDR &= ~((3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2)));
-    /* Enable Pull-up resistors for PB6 and PB7 (01) */
-    I2C_PORT->PUPDR |= (1U << (I2C_SCL_PIN * 2)) | (1U << (I2C_SDA_PIN * 2));
-
-    /* Configure Alternate Function for PB6 and PB7 to I2C1 (AF4) */
-    /* AFR[0] is for pins 0-7. PB6 is pin 6, PB7 is pin 7. */
-    /* Clear AF selection bits for PB6 and PB7 */
-    I2C_PORT->AFR[0] &= ~((0xFU << (I2C_SCL_PIN * 4))
-            | (0xFU << (I2C_SDA_PIN * 4)));
-    /* Set AF4 (I2C1) for PB6 and PB7 */
-    I2C_PORT->AFR[0] |= (4U << (I2C_SCL_PIN * 4)) | (4U << (I2C_SDA_PIN * 4));
-
-    /* 3. Check and handle I2C BUSY flag (optional, but good practice for robustness) */
-    /* If the BUSY flag is set, it might indicate a previously stuck communication. */
-    /* This attempts to free the bus by manually generating clock pulses and a STOP condition. */
-    if (I2C1->SR2 & I2C_SR2_BUSY) {
-        /* Temporarily configure I2C pins (PB6 SCL, PB7 SDA) as GPIO outputs */
-        I2C_PORT->MODER &= ~((3U << (I2C_SCL_PIN * 2))
-                | (3U << (I2C_SDA_PIN * 2)));
-        I2C_PORT->MODER |= (1U << (I2C_SCL_PIN * 2))
-                | (1U << (I2C_SDA_PIN * 2));  // Output mode
-        I2C_PORT->ODR |= (1U << I2C_SCL_PIN) | (1U << I2C_SDA_PIN); // Both SDA and SCL high
+uint8_t I2C_initStep(uint32_t *wait_us) {
+    clock_info_t clocks;
+    *wait_us = 0;
+    switch (i2c_init_state) {
+    case I2C_INIT_PINS:
+        /* Enable clocks for GPIO and I2C peripherals */
+        RCC->AHB1ENR |= I2C_GPIO_RCC_ENR;
+        RCC->APB1ENR |= I2C_RCC_ENR;
+
+        /* 2. Configure PB6 (SCL) and PB7 (SDA) for I2C1 alternate function */
+        /* These pins need to be set to: Alternate function, Open-drain, Pull-up, High speed. */
+
+        /* Clear mode bits for PB6 and PB7 */
+        I2C_PORT->MODER &= ~((3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2)));
+        /* Set PB6 and PB7 to Alternate function mode (10) */
+        I2C_PORT->MODER |= (2U << (I2C_SCL_PIN * 2)) | (2U << (I2C_SDA_PIN * 2));
+
+        /* Set PB6 and PB7 to Output open-drain (1) */
+        I2C_PORT->OTYPER |= (1U << I2C_SCL_PIN) | (1U << I2C_SDA_PIN);
 
-        /* Short delay for lines to stabilize */
-        for (volatile int i = 0; i < 1000; i++)
-            ;
+        /* Set PB6 and PB7 to High speed (11) */
+        I2C_PORT->OSPEEDR |= (3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2));
 
+        /* Clear pull-up/pull-down bits for PB6 and PB7 */
+        I2C_PORT->PUPDR &= ~((3U << (I2C_SCL_PIN * 2)) | (3U << (I2C_SDA_PIN * 2)));
+        /* Enable Pull-up resistors for PB6 and PB7 (01) */
+        I2C_PORT->PUPDR |= (1U << (I2C_SCL_PIN * 2)) | (1U << (I2C_SDA_PIN * 2));
+
+        /* Configure Alternate Function for PB6 and PB7 to I2C1 (AF4) */
+        /* AFR[0] is for pins 0-7. PB6 is pin 6, PB7 is pin 7. */
+        /* Clear AF selection bits for PB6 and PB7 */
+        I2C_PORT->AFR[0] &= ~((0xFU << (I2C_SCL_PIN * 4))
+                | (0xFU << (I2C_SDA_PIN * 4)));
+        /* Set AF4 (I2C1) for PB6 and PB7 */
+        I2C_PORT->AFR[0] |= (4U << (I2C_SCL_PIN * 4)) | (4U << (I2C_SDA_PIN * 4));
+
+        /* 3. Check and handle I2C BUSY flag (optional, but good practice for robustness) */
+        /* If the BUSY flag is set, it might indicate a previously stuck communication. */
+        /* This attempts to free the bus by manually generating clock pulses and a STOP condition. */
+        if (I2C1->SR2 & I2C_SR2_BUSY) {
+            /* Temporarily configure I2C pins (PB6 SCL, PB7 SDA) as GPIO outputs */
+            I2C_PORT->MODER &= ~((3U << (I2C_SCL_PIN * 2))
+                    | (3U << (I2C_SDA_PIN * 2)));
+            I2C_PORT->MODER |= (1U << (I2C_SCL_PIN * 2))
+                    | (1U << (I2C_SDA_PIN * 2));  // Output mode
+            I2C_PORT->ODR |= (1U << I2C_SCL_PIN) | (1U << I2C_SDA_PIN); // Both SDA and SCL high
+
+            /* Let the lines stabilize before clocking */
+            HEALTH_INC(HEALTH_I2C_RECOVERY);
+            i2c_recovery_edge = 0;
+            i2c_init_state = I2C_INIT_CLOCK_PULSES;
+            *wait_us = I2C_RECOVERY_SETTLE_US;
+        } else {
+            i2c_init_state = I2C_INIT_CONFIGURE;
+        }
+        return 0;
+
+    case I2C_INIT_CLOCK_PULSES:
         /* Generate 9 clock pulses on SCL to attempt to clock out any data from a stuck slave */
-        for (int i = 0; i < 9; i++) {
-            I2C_PORT->ODR &= ~(1U << I2C_SCL_PIN); /* SCL low */
-            for (volatile int j = 0; j < 100; j++)
-                ; /* Clock low duration */
+        if (i2c_recovery_edge & 1) {
             I2C_PORT->ODR |= (1U << I2C_SCL_PIN); /* SCL high */
-            for (volatile int j = 0; j < 100; j++)
-                ; /* Clock high duration */
+        } else {
+            I2C_PORT->ODR &= ~(1U << I2C_SCL_PIN); /* SCL low */
+        }
+        if (++i2c_recovery_edge >= I2C_RECOVERY_EDGES) {
+            i2c_init_state = I2C_INIT_STOP_SDA_LOW;
         }
+        *wait_us = I2C_RECOVERY_HALF_US;
+        return 0;
 
+    case I2C_INIT_STOP_SDA_LOW:
         /* Generate a manual STOP condition: SCL high, SDA transitions low to high */
         I2C_PORT->ODR &= ~(1U << I2C_SDA_PIN); /* SDA low (while SCL is high) */
-        for (volatile int j = 0; j < 100; j++)
-            ;
         I2C_PORT->ODR |= (1U << I2C_SCL_PIN); /* SCL high */
-        for (volatile int j = 0; j < 100; j++)
-            ;
+        i2c_init_state = I2C_INIT_STOP_SDA_HIGH;
+        *wait_us = I2C_RECOVERY_HALF_US;
+        return 0;
+
+    case I2C_INIT_STOP_SDA_HIGH:
         I2C_PORT->ODR |= (1U << I2C_SDA_PIN); /* SDA high (generates STOP) */
-        for (volatile int j = 0; j < 100; j++)
-            ;
 
         /* Revert pins back to Alternate Function mode for I2C operation */
         I2C_PORT->MODER &= ~((3U << (I2C_SCL_PIN * 2))
                 | (3U << (I2C_SDA_PIN * 2)));
         I2C_PORT->MODER |= (2U << (I2C_SCL_PIN * 2))
                 | (2U << (I2C_SDA_PIN * 2));
-    }
+        i2c_init_state = I2C_INIT_CONFIGURE;
+        *wait_us = I2C_RECOVERY_HALF_US;
+        return 0;
 
-    /* 4. Reset I2C1 peripheral to clear any internal stuck state */
-    I2C1->CR1 |= I2C_CR1_SWRST; /* Put I2C peripheral into reset state */
-    I2C1->CR1 &= ~I2C_CR1_SWRST; /* Release I2C peripheral from reset state */
+    case I2C_INIT_CONFIGURE:
+    default:
+        /* 4. Reset I2C1 peripheral to clear any internal stuck state */
+        I2C1->CR1 |= I2C_CR1_SWRST; /* Put I2C peripheral into reset state */
+        I2C1->CR1 &= ~I2C_CR1_SWRST; /* Release I2C peripheral from reset state */
 
-    /* 5. Configure I2C1 parameters */
-    I2C1->CR1 &= ~I2C_CR1_PE; /* Disable peripheral (PE=0) before configuration */
+        /* 5. Configure I2C1 timing for the current PCLK1 */
+        ClockMgr_getInfo(&clocks);
+        I2C_setTiming(clocks.pclk1_hz);
 
-    /* Set peripheral clock frequency (FREQ bits in CR2) */
-    /* This must be configured with the APB1 clock frequency in MHz. */
-    I2C1->CR2 = PCLK1_FREQ_MHZ;
-
-    /* Configure CCR (Clock Control Register) for SCL frequency (Standard mode 100kHz) */
-    I2C1->CCR = I2C_STANDARD_MODE_CCR;
-
-    /* Configure TRISE (Rise Time Register) based on PCLK1 and max SCL rise time */
-    I2C1->TRISE = I2C_TRISE_VALUE;
+        /* Ready; the next call starts over */
+        i2c_init_state = I2C_INIT_PINS;
+        return 1;
+    }
+}
 
-    I2C1->CR1 |= I2C_CR1_PE; /* Enable peripheral (PE=1) after configuration */
+/**
+ * @brief Initialize I2C1 peripheral for communication
+ * Blocking wrapper around I2C_initStep.
+ * * @note This function assumes the system clock is configured
+ */
+void I2C_Init(void) {
+    uint32_t wait_us;
+    i2c_init_state = I2C_INIT_PINS;
+    while (!I2C_initStep(&wait_us)) {
+        delay_us(wait_us);
+    }
 }
 
 /**
@@ -119,15 +227,29 @@ void I2C_Init(void) {
  * This function sets the ACK bit (enabling acknowledgment for reception)
  * before generating the START condition. It then waits for the Start Bit (SB)
  * flag in SR1 to confirm the start condition has been sent.
+ * The first START after a STOP begins a new transaction and clears the
+ * failure flag; a repeated START keeps it, and is skipped once the
+ * transaction has failed.
  */
 void I2C_Start(void) {
+    if (!i2c_open) {
+        /* A stalled bus is recovered before the next transaction */
+        if (i2c_stalled) {
+            i2c_stalled = 0;
+            I2C_Init();
+        }
+        i2c_failed = 0;
+        i2c_open = 1;
+    } else if (i2c_failed) {
+        return;
+    }
     /* Enable ACK before generating START. This is important for the master receiver mode. */
         /* For master transmitter, it doesn't harm. */
     I2C1->CR1 |= I2C_CR1_ACK;
     /* Generate START condition */
     I2C1->CR1 |= I2C_CR1_START;
     /* Wait for the START condition to be sent */
-    while (!(I2C1->SR1 & I2C_SR1_SB));
+    I2C_waitFlag(I2C_SR1_SB);
 }
 
 /**
@@ -139,10 +261,20 @@ void I2C_Start(void) {
  *
  */
 void I2C_Stop(void) {
+    uint32_t timeout = I2C_FLAG_TIMEOUT;
+
+    i2c_open = 0;
     /* Generate STOP condition by setting the STOP bit in CR1 */
     I2C1->CR1 |= I2C_CR1_STOP;
     /* Wait until BUSY flag is cleared */
-    while (I2C1->SR2 & I2C_SR2_BUSY);
+    while (I2C1->SR2 & I2C_SR2_BUSY) {
+        if (--timeout == 0) {
+            HEALTH_INC(HEALTH_I2C_STALL);
+            i2c_failed = 1;
+            i2c_stalled = 1;
+            break;
+        }
+    }
 }
 
 /**
@@ -154,13 +286,18 @@ void I2C_Stop(void) {
 void I2C_addressWrite(uint8_t slave_address) {
     /* Temporary variable for reading status registers */
     volatile uint32_t temp;
+    if (i2c_failed) {
+        return;
+    }
     /* Send slave address shifted left by 1, with LSB=0 for write operation */
     I2C1->DR = (uint8_t) (slave_address << 1);
     /* Wait for ADDR (Address Acknowledged) flag to be set in SR1. */
     /* This indicates the slave has acknowledged its address. */
-    while (!(I2C1->SR1 & I2C_SR1_ADDR));
+    if (!I2C_waitFlag(I2C_SR1_ADDR)) {
+        return;
+    }
     /* Clearing ADDR flag: This is done by a read to SR1 followed by a read to SR2. */
-    /* The read of SR1 was done in the while loop condition. */
+    /* The read of SR1 was done in I2C_waitFlag. */
     temp = I2C1->SR1;
     temp = I2C1->SR2;
     (void) temp; /* Avoid unused variable warning if optimizations are high */
@@ -175,12 +312,17 @@ void I2C_addressWrite(uint8_t slave_address) {
 void I2C_addressRead(uint8_t slave_address) {
     /* Temporary variable for reading status registers */
     volatile uint32_t temp;
+    if (i2c_failed) {
+        return;
+    }
     /* Send slave address shifted left by 1, with LSB=1 for read operation */
     I2C1->DR = (uint8_t) ((slave_address << 1) | 1);
     /* Wait for ADDR (Address Acknowledged) flag to be set in SR1. */
-    while (!(I2C1->SR1 & I2C_SR1_ADDR));
+    if (!I2C_waitFlag(I2C_SR1_ADDR)) {
+        return;
+    }
     /* Clearing ADDR flag: Read SR1 then SR2. */
-    /* The read of SR1 was done in the while loop condition. */
+    /* The read of SR1 was done in I2C_waitFlag. */
     temp = I2C1->SR1;
     temp = I2C1->SR2;
     (void) temp; /* Avoid unused variable warning */
@@ -194,12 +336,14 @@ void I2C_addressRead(uint8_t slave_address) {
 void I2C_writeByte(uint8_t byte) {
     /* Wait for TXE (Transmit data register empty) flag to be set in SR1. */
     /* This indicates that I2C_DR is empty and ready for the next byte. */
-    while (!(I2C1->SR1 & I2C_SR1_TXE));
+    if (!I2C_waitFlag(I2C_SR1_TXE)) {
+        return;
+    }
     /* Write data to Data Register (DR) */
     I2C1->DR = byte;
     /* Wait for BTF (Byte Transfer Finished) flag to be set in SR1. */
     /* This indicates that the byte has been successfully transmitted (shifted out). */
-    while (!(I2C1->SR1 & I2C_SR1_BTF));
+    I2C_waitFlag(I2C_SR1_BTF);
 }
 
 /**
@@ -222,7 +366,60 @@ uint8_t I2C_readByte(ack_status_t ack) {
 
     /* Wait for RXNE (Receive data register not empty) flag to be set in SR1. */
     /* This indicates that a byte has been received and is ready to be read from I2C_DR. */
-    while (!(I2C1->SR1 & I2C_SR1_RXNE));
+    if (!I2C_waitFlag(I2C_SR1_RXNE)) {
+        return 0xFF;
+    }
     /* Read data from Data Register (DR) */
     return (uint8_t) I2C1->DR;
 }
+
+/**
+ * @brief Write a block of bytes to a slave in a single transaction.
+ * Generates START, sends the address with WRITE bit, streams every byte
+ * of the buffer and finishes with STOP.
+ * @param slave_address The 7-bit I2C slave address.
+ * @param data Pointer to the bytes to send.
+ * @param length Number of bytes to send.
+ */
+void I2C_writeBuffer(uint8_t slave_address, const uint8_t *data,
+        uint16_t length) {
+    I2C_Start();
+    I2C_addressWrite(slave_address);
+    while (length--) {
+        I2C_writeByte(*data++);
+    }
+    I2C_Stop();
+}
+
+/**
+ * @brief Check whether a transfer is in progress on the bus.
+ * @return 1 while I2C1 reports BUSY, 0 when the bus is idle.
+ */
+uint8_t I2C_isBusy(void) {
+    return (I2C1->SR2 & I2C_SR2_BUSY) ? 1 : 0;
+}
+
+/**
+ * @brief Check whether the current or last transaction failed.
+ * @return 1 after a NACK or a stall since the transaction's first START,
+ * 0 otherwise.
+ */
+uint8_t I2C_hasFailed(void) {
+    return i2c_failed;
+}
+
+/**
+ * @brief Clock switch notifier: recomputes CCR/TRISE for the new PCLK1.
+ * @param event Phase of the switch.
+ * @param info Bus clocks after the switch.
+ * @return PRE: 0 while a transfer is on the bus, 1 otherwise.
+ */
+uint8_t I2C_clockNotifier(clock_event_t event, const clock_info_t *info) {
+    if (event == CLOCK_PRE_CHANGE) {
+        return !I2C_isBusy();
+    }
+    if (event == CLOCK_POST_CHANGE) {
+        I2C_setTiming(info->pclk1_hz);
+    }
+    return 1;
+}
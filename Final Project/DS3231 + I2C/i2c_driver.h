@@ -2,8 +2,13 @@
 #define I2C_DRIVER_H_
 
 #include "stm32f4xx.h"
+#include "clock_mgr.h"
 #include "stdint.h"
 
+/* Polls of a status flag before a transfer step counts as stalled, about
+ * 12 ms at 84 MHz: over a hundred byte times at 100kHz */
+#define I2C_FLAG_TIMEOUT       100000U
+
 /**
  * @brief Enumeration to specify whether to send an ACK or NACK after a byte reception.
  * This is typically used when reading multiple bytes from a slave device.
@@ -18,15 +23,29 @@ typedef enum {
 /**
  * @brief Initialize I2C1 peripheral.
  * @note This function configures GPIO pins PB6 (SCL) and PB7 (SDA) for I2C1.
- * It sets up I2C timing for standard mode (100kHz) assuming PCLK1 is 42MHz.
+ * It sets up I2C timing for standard mode (100kHz) from the current PCLK1.
  * It also includes a routine to attempt recovery from a stuck I2C bus.
  */
 void I2C_Init(void);
 
+/**
+ * @brief Runs one step of the I2C1 initialisation without waiting.
+ * @param wait_us Receives the delay required before the next call.
+ * @return 1 when the peripheral is ready, 0 otherwise.
+ * @note Bus recovery is split into short steps so it can overlap other
+ * drivers' start-up waits.
+ */
+uint8_t I2C_initStep(uint32_t *wait_us);
+
 /**
  * @brief Generate an I2C START condition on the bus.
  * @note This function also enables ACKing from the master side.
  * It waits until the START condition is successfully generated (SB flag is set).
+ * Every flag wait of the transaction gives up after I2C_FLAG_TIMEOUT polls
+ * or on a NACK, counting it in the health counters; the remaining steps,
+ * repeated STARTs included, are then skipped. The failure holds until the
+ * first START after I2C_Stop, so I2C_hasFailed reports the whole
+ * transaction. A bus that stalled is re-initialised by that START.
  */
 void I2C_Start(void);
 
@@ -70,4 +89,38 @@ void I2C_writeByte(uint8_t byte);
  */
 uint8_t I2C_readByte(ack_status_t ack);
 
+/**
+ * @brief Write a block of bytes to a slave in one START/STOP transaction.
+ * @param slave_address The 7-bit slave address.
+ * @param data Pointer to the bytes to send.
+ * @param length Number of bytes to send.
+ * @note Used by devices that need several bytes latched back-to-back,
+ * e.g. the PCF8574 LCD backpack.
+ */
+void I2C_writeBuffer(uint8_t slave_address, const uint8_t *data,
+        uint16_t length);
+
+/**
+ * @brief Check whether a transfer is in progress on the bus.
+ * @return 1 while the BUSY flag is set (between START and STOP), 0 otherwise.
+ * @note Used by the sleep manager: entering STOP mid-transfer would leave
+ * the slave holding SDA.
+ */
+uint8_t I2C_isBusy(void);
+
+/**
+ * @brief Check whether the current or last transaction failed.
+ * @return 1 after a NACK or a stall at any step since the transaction's
+ * first START, including its STOP, 0 otherwise.
+ * @note Bytes read after a failure are 0xFF and must be discarded.
+ */
+uint8_t I2C_hasFailed(void);
+
+/**
+ * @brief Clock switch notifier for I2C1.
+ * @note Register with ClockMgr_registerNotifier. Refuses a switch while a
+ * transfer is in progress, then reprograms the SCL timing for the new PCLK1.
+ */
+uint8_t I2C_clockNotifier(clock_event_t event, const clock_info_t *info);
+
 #endif /* I2C_DRIVER_H_ */
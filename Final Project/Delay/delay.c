@@ -3,6 +3,27 @@
 /* Tick counter for millisecond delays */
 static volatile uint32_t systick_ms_count = 0;
 
+/* Callbacks run from the SysTick interrupt every millisecond */
+static delay_tick_handler_t tick_handlers[DELAY_MAX_TICK_HANDLERS];
+static volatile uint8_t tick_handler_count = 0;
+
+/*
+ * 64-bit timebase extending DWT->CYCCNT. SysTick samples the counter every
+ * millisecond, far more often than its 51 s wrap at 84 MHz, and updates
+ * these fields with interrupts masked. Readers retry if 'time_gen' changed
+ * under them, which can only happen when SysTick preempted the reader.
+ */
+static volatile uint32_t time_gen = 0;
+static volatile uint32_t time_cyc_hi = 0;   /* Upper word of the cycle count */
+static volatile uint32_t time_cyc_last = 0; /* CYCCNT at the last update */
+static volatile uint64_t time_us_base = 0;  /* Microseconds at time_us_cyc */
+static volatile uint32_t time_us_cyc = 0;   /* CYCCNT at a whole microsecond */
+static uint32_t time_cycles_per_us = 1;
+/* Cycles the CPU slept while CYCCNT was stopped, see Delay_compensateSleep */
+static volatile uint64_t time_skew_cycles = 0;
+static volatile uint64_t time_skew_us = 0;
+static uint32_t time_skew_rem = 0;          /* Cycles short of a whole us */
+
 /**
  * @brief Initializes the SysTick for millisecond delays and the DWT for microsecond delays.
  * @note  This function must be called once at the beginning of the main function,
@@ -20,6 +41,37 @@ void Delay_Init(void) {
     CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; /* Enable Trace & Debug block */
     DWT->CYCCNT = 0; /* Reset the cycle counter */
     DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; /* Enable the cycle counter */
+
+    /* 3. Start the 64-bit timebase at zero */
+    time_cycles_per_us = SystemCoreClock / 1000000;
+    time_cyc_hi = 0;
+    time_cyc_last = 0;
+    time_us_base = 0;
+    time_us_cyc = 0;
+}
+
+/**
+ * @brief Folds the cycles elapsed since the last call into the timebase.
+ * @note Runs from SysTick; must be called at least once per CYCCNT wrap.
+ */
+static void time_update(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = DWT->CYCCNT;
+    if (now < time_cyc_last) {
+        time_cyc_hi++;
+    }
+    time_cyc_last = now;
+
+    /* Advance the microsecond base by whole microseconds only, so the
+     * remainder carries over and the clock never drifts */
+    uint32_t us = (now - time_us_cyc) / time_cycles_per_us;
+    time_us_base += us;
+    time_us_cyc += us * time_cycles_per_us;
+
+    time_gen++;
+    __set_PRIMASK(primask);
 }
 
 /**
@@ -29,6 +81,130 @@ void Delay_Init(void) {
  */
 void SysTick_Handler(void) {
     systick_ms_count++;
+    time_update();
+
+    for (uint8_t i = 0; i < tick_handler_count; i++) {
+        tick_handlers[i]();
+    }
+}
+
+/**
+ * @brief Accounts for SysTick interrupts suppressed during a sleep.
+ */
+void Delay_compensateSleep(uint32_t ticks, uint32_t lost_cycles) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    systick_ms_count += ticks;
+    if (lost_cycles) {
+        /* Converted at the current rate, which may change later */
+        uint32_t total = time_skew_rem + lost_cycles;
+        uint32_t us = total / time_cycles_per_us;
+        time_skew_cycles += lost_cycles;
+        time_skew_us += us;
+        time_skew_rem = total - us * time_cycles_per_us;
+    }
+    time_update();
+
+    /* Skipped ticks are replayed so that handlers keep their own time */
+    for (uint32_t t = 0; t < ticks; t++) {
+        for (uint8_t i = 0; i < tick_handler_count; i++) {
+            tick_handlers[i]();
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Clock switch notifier: retimes SysTick and the timebase.
+ */
+uint8_t Delay_clockNotifier(clock_event_t event, const clock_info_t *info) {
+    if (event != CLOCK_POST_CHANGE) {
+        return 1;
+    }
+
+    /* Cycles counted up to now ran mostly at the old rate: fold them in
+     * first, then restart the microsecond remainder at the new rate */
+    time_update();
+    time_us_cyc = time_cyc_last;
+    time_cycles_per_us = info->hclk_hz / 1000000;
+    time_skew_rem = 0;
+
+    /* Scale the part of the tick still to run, then continue with the new
+     * period, the same way tickless idle reprograms SysTick */
+    uint32_t old_period = SysTick->LOAD + 1;
+    uint32_t new_period = info->hclk_hz / 1000;
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t remaining = (uint32_t) (((uint64_t) SysTick->VAL * new_period)
+            / old_period);
+    SysTick->LOAD = remaining ? remaining : new_period - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    /* Takes effect at the next reload */
+    SysTick->LOAD = new_period - 1;
+    return 1;
+}
+
+/**
+ * @brief Adds a callback to the 1 ms SysTick interrupt.
+ */
+uint8_t Delay_registerTickHandler(delay_tick_handler_t handler) {
+    if (tick_handler_count >= DELAY_MAX_TICK_HANDLERS) {
+        return 0;
+    }
+    tick_handlers[tick_handler_count] = handler;
+    /* Publish the entry before the count the interrupt reads */
+    __DMB();
+    tick_handler_count++;
+    return 1;
+}
+
+/**
+ * @brief Returns the number of milliseconds elapsed since Delay_Init.
+ * @note Wraps after about 49 days.
+ */
+uint32_t Delay_getTick(void) {
+    return systick_ms_count;
+}
+
+/**
+ * @brief Returns the CPU cycles elapsed since Delay_Init, without wrapping.
+ */
+uint64_t time_now_cycles64(void) {
+    uint32_t gen, hi, last, now;
+
+    uint64_t skew;
+
+    do {
+        gen = time_gen;
+        hi = time_cyc_hi;
+        last = time_cyc_last;
+        skew = time_skew_cycles;
+        now = DWT->CYCCNT;
+    } while (gen != time_gen);
+
+    /* CYCCNT wrapped after SysTick last sampled it */
+    if (now < last) {
+        hi++;
+    }
+    return (((uint64_t) hi << 32) | now) + skew;
+}
+
+/**
+ * @brief Returns the microseconds elapsed since Delay_Init, without wrapping.
+ */
+uint64_t time_now_us(void) {
+    uint32_t gen, cyc, now;
+    uint64_t base;
+
+    do {
+        gen = time_gen;
+        base = time_us_base + time_skew_us;
+        cyc = time_us_cyc;
+        now = DWT->CYCCNT;
+    } while (gen != time_gen);
+
+    return base + (now - cyc) / time_cycles_per_us;
 }
 
 /**
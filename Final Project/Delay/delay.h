@@ -2,8 +2,18 @@
 #define DELAY_H_
 
 #include "stm32f4xx.h"
+#include "clock_mgr.h"
 #include <stdio.h>
 
+/* Callbacks that Delay_registerTickHandler can hold */
+#define DELAY_MAX_TICK_HANDLERS 4
+
+/**
+ * @brief Callback run from the SysTick interrupt once per millisecond.
+ * It must be short and must not block.
+ */
+typedef void (*delay_tick_handler_t)(void);
+
 /**
  * @brief Initializes the SysTick for millisecond delays and the DWT for microsecond delays.
  * @note  This function must be called once at the beginning of the main function,
@@ -12,6 +22,52 @@
  */
 void Delay_Init(void);
 
+/**
+ * @brief Accounts for SysTick interrupts suppressed by tickless idle.
+ * @param ticks Whole milliseconds that passed without a SysTick interrupt;
+ * the tick handlers are run once for each
+ * @param lost_cycles Sleep cycles that DWT->CYCCNT did not count, added to
+ * the 64-bit timebase (0 if the counter kept running)
+ * @note Called with SysTick stopped or reprogrammed, interrupts masked.
+ */
+void Delay_compensateSleep(uint32_t ticks, uint32_t lost_cycles);
+
+/**
+ * @brief Clock switch notifier: retimes SysTick and the timebase.
+ * @note Register with ClockMgr_registerNotifier. The current tick keeps its
+ * progress, scaled to the new period; time_now_us() stays continuous and
+ * time_now_cycles64() keeps counting CPU cycles at whatever rate they run.
+ */
+uint8_t Delay_clockNotifier(clock_event_t event, const clock_info_t *info);
+
+/**
+ * @brief Returns the number of milliseconds elapsed since Delay_Init.
+ * @note Wraps after about 49 days.
+ */
+uint32_t Delay_getTick(void);
+
+/**
+ * @brief Adds a callback to the 1 ms SysTick interrupt.
+ * @param handler Function to run every tick, after the counter is updated
+ * @return 1 on success, 0 if all DELAY_MAX_TICK_HANDLERS slots are used
+ */
+uint8_t Delay_registerTickHandler(delay_tick_handler_t handler);
+
+/**
+ * @brief Returns the CPU cycles elapsed since Delay_Init as a 64-bit count.
+ * @note Extends DWT->CYCCNT with a high word kept by SysTick. Safe to call
+ * from any interrupt, never tears, and takes about a dozen cycles.
+ */
+uint64_t time_now_cycles64(void);
+
+/**
+ * @brief Returns the microseconds elapsed since Delay_Init as a 64-bit count.
+ * @note Same properties as time_now_cycles64; one 32-bit divide, no 64-bit
+ * arithmetic besides the final add. Use it for timeouts, profiling and
+ * telemetry timestamps so every driver shares one timebase.
+ */
+uint64_t time_now_us(void);
+
 /**
  * @brief Provides a blocking delay in microseconds.
  * @note  This function uses the DWT cycle counter for high accuracy. It is
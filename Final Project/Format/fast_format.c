@@ -0,0 +1,139 @@
+#include "fast_format.h"
+
+/* "00".."99" so two digits cost one division instead of two */
+static const char digit_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+/**
+ * @brief Converts a value to decimal digits, right-aligned in 'tmp'.
+ * @param tmp Scratch buffer of 10 bytes (enough for UINT32_MAX).
+ * @return Number of digits produced (at least 1).
+ */
+static uint8_t FMT_toDigits(char *tmp, uint32_t value) {
+    char *p = tmp + 10;
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        *--p = digit_pairs[value * 2 + 1];
+        *--p = digit_pairs[value * 2];
+    } else {
+        *--p = (char) ('0' + value);
+    }
+    return (uint8_t) (tmp + 10 - p);
+}
+
+/**
+ * @brief Writes digits padded on the left with 'fill' up to 'width'.
+ */
+static char *FMT_padded(char *dst, uint32_t value, uint8_t width, char fill) {
+    char tmp[10];
+    uint8_t n = FMT_toDigits(tmp, value);
+    while (width > n) {
+        *dst++ = fill;
+        width--;
+    }
+    for (const char *s = tmp + 10 - n; s < tmp + 10; s++) {
+        *dst++ = *s;
+    }
+    return dst;
+}
+
+/**
+ * @brief Writes an unsigned integer, zero-padded to 'width' digits.
+ */
+char *FMT_uint(char *dst, uint32_t value, uint8_t width) {
+    return FMT_padded(dst, value, width, '0');
+}
+
+/**
+ * @brief Writes an unsigned integer right-aligned in 'width' columns.
+ */
+char *FMT_uintSpace(char *dst, uint32_t value, uint8_t width) {
+    return FMT_padded(dst, value, width, ' ');
+}
+
+/**
+ * @brief Writes a two-digit zero-padded value, equivalent to "%02d".
+ */
+char *FMT_twoDigits(char *dst, uint8_t value) {
+    if (value > 99) {
+        return FMT_uint(dst, value, 2);
+    }
+    dst[0] = digit_pairs[value * 2];
+    dst[1] = digit_pairs[value * 2 + 1];
+    return dst + 2;
+}
+
+/**
+ * @brief Writes "hh:mm:ss".
+ */
+char *FMT_time(char *dst, uint8_t hours, uint8_t minutes, uint8_t seconds) {
+    dst = FMT_twoDigits(dst, hours);
+    *dst++ = ':';
+    dst = FMT_twoDigits(dst, minutes);
+    *dst++ = ':';
+    return FMT_twoDigits(dst, seconds);
+}
+
+/**
+ * @brief Writes "hh:mm".
+ */
+char *FMT_hourMinute(char *dst, uint8_t hours, uint8_t minutes) {
+    dst = FMT_twoDigits(dst, hours);
+    *dst++ = ':';
+    return FMT_twoDigits(dst, minutes);
+}
+
+/**
+ * @brief Writes a percentage as "%3d%%".
+ */
+char *FMT_percent(char *dst, uint8_t percent) {
+    dst = FMT_uintSpace(dst, percent, 3);
+    *dst++ = '%';
+    return dst;
+}
+
+/**
+ * @brief Writes "ON" or "OFF".
+ */
+char *FMT_onOff(char *dst, uint8_t on) {
+    return FMT_str(dst, on ? "ON" : "OFF");
+}
+
+/**
+ * @brief Copies a string without its terminator.
+ */
+char *FMT_str(char *dst, const char *str) {
+    while (*str) {
+        *dst++ = *str++;
+    }
+    return dst;
+}
+
+/**
+ * @brief Pads or truncates a line to 'width' characters and terminates it.
+ */
+void FMT_finishLine(char *line, char *end, uint8_t width) {
+    char *limit = line + width;
+    if (end > limit) {
+        end = limit;
+    }
+    while (end < limit) {
+        *end++ = ' ';
+    }
+    *end = '\0';
+}
@@ -0,0 +1,85 @@
+#ifndef FAST_FORMAT_H_
+#define FAST_FORMAT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Allocation-free field writers for display and telemetry lines.
+ * Every writer stores its field at 'dst' without a terminating NUL and
+ * returns the position right after the field, so calls can be chained:
+ *
+ *     char *p = line;
+ *     p = FMT_str(p, "AUTO ");
+ *     p = FMT_time(p, hh, mm, ss);
+ *     FMT_finishLine(line, p, 16);
+ */
+
+/**
+ * @brief Writes an unsigned integer, zero-padded to 'width' digits.
+ * @param dst Destination buffer.
+ * @param value Value to write.
+ * @param width Minimum number of digits (0 or 1 for no padding).
+ * @return Pointer just past the last written character.
+ */
+char *FMT_uint(char *dst, uint32_t value, uint8_t width);
+
+/**
+ * @brief Writes an unsigned integer, right-aligned with spaces in 'width' columns.
+ * @return Pointer just past the last written character.
+ */
+char *FMT_uintSpace(char *dst, uint32_t value, uint8_t width);
+
+/**
+ * @brief Writes a two-digit zero-padded value (0-99), equivalent to "%02d".
+ * @return Pointer just past the last written character.
+ */
+char *FMT_twoDigits(char *dst, uint8_t value);
+
+/**
+ * @brief Writes "hh:mm:ss".
+ * @return Pointer just past the last written character.
+ */
+char *FMT_time(char *dst, uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/**
+ * @brief Writes "hh:mm".
+ * @return Pointer just past the last written character.
+ */
+char *FMT_hourMinute(char *dst, uint8_t hours, uint8_t minutes);
+
+/**
+ * @brief Writes a percentage as "%3d%%" (e.g. " 42%").
+ * @return Pointer just past the last written character.
+ */
+char *FMT_percent(char *dst, uint8_t percent);
+
+/**
+ * @brief Writes "ON" or "OFF".
+ * @return Pointer just past the last written character.
+ */
+char *FMT_onOff(char *dst, uint8_t on);
+
+/**
+ * @brief Copies a NUL-terminated string without its terminator.
+ * @return Pointer just past the last written character.
+ */
+char *FMT_str(char *dst, const char *str);
+
+/**
+ * @brief Pads with spaces or truncates a line to exactly 'width' characters
+ * and NUL-terminates it.
+ * @param line Start of the line buffer (at least width + 1 bytes).
+ * @param end Current write position returned by the field writers.
+ * @param width Target line length.
+ */
+void FMT_finishLine(char *line, char *end, uint8_t width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FAST_FORMAT_H_ */
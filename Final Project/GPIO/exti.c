@@ -0,0 +1,129 @@
+#include "exti.h"
+#include "gpio.h"
+#include "trace.h"
+
+/* Handler of each EXTI line, 0 if the line is unused */
+static exti_handler_t exti_handlers[16];
+static uint16_t exti_lines = 0;
+
+/**
+ * @brief Route a GPIO pin to its EXTI line and attach a handler.
+ *
+ * @param port    GPIO port.
+ * @param pin     GPIO pin number, also the EXTI line (0~15).
+ * @param edge    Edges that trigger the line.
+ * @param handler Callback for the line.
+ * @return 1 on success, 0 if the line is taken.
+ */
+uint8_t EXTI_attach(GPIO_TypeDef *port, uint8_t pin, exti_edge_t edge,
+        exti_handler_t handler)
+{
+    uint32_t line = 1UL << pin;
+    uint32_t shift = (pin & 3U) * 4U;
+
+    if (pin > 15 || (exti_lines & line))
+    {
+        return 0;
+    }
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[pin >> 2] = (SYSCFG->EXTICR[pin >> 2] & ~(0xFUL << shift))
+            | ((uint32_t)GPIO_portIndex(port) << shift);
+
+    EXTI->IMR &= ~line;
+    if (edge & EXTI_EDGE_FALLING)
+        EXTI->FTSR |= line;
+    else
+        EXTI->FTSR &= ~line;
+    if (edge & EXTI_EDGE_RISING)
+        EXTI->RTSR |= line;
+    else
+        EXTI->RTSR &= ~line;
+
+    exti_handlers[pin] = handler;
+    exti_lines |= (uint16_t)line;
+
+    IRQn_Type irq;
+    if (pin <= 4)
+        irq = (IRQn_Type)(EXTI0_IRQn + pin);
+    else if (pin <= 9)
+        irq = EXTI9_5_IRQn;
+    else
+        irq = EXTI15_10_IRQn;
+    NVIC_SetPriority(irq, EXTI_IRQ_PRIORITY);
+    NVIC_EnableIRQ(irq);
+    return 1;
+}
+
+/**
+ * @brief Clear stale pending bits and unmask EXTI lines.
+ *
+ * @param mask Lines to enable.
+ */
+void EXTI_enableLines(uint16_t mask)
+{
+    EXTI->PR = mask;
+    EXTI->IMR |= mask;
+}
+
+/**
+ * @brief Mask EXTI lines.
+ *
+ * @param mask Lines to disable.
+ */
+void EXTI_disableLines(uint16_t mask)
+{
+    EXTI->IMR &= ~(uint32_t)mask;
+}
+
+/**
+ * @brief Clear and dispatch the pending lines in 'lines'.
+ */
+static void EXTI_dispatch(uint16_t lines)
+{
+    uint32_t pending = EXTI->PR & lines & exti_lines;
+
+    EXTI->PR = pending;
+    while (pending)
+    {
+        uint8_t line = (uint8_t)__builtin_ctz(pending);
+        pending &= pending - 1;
+        TRACE_INSTANT(TRACE_ID_EXTI, line);
+        exti_handlers[line](line);
+    }
+}
+
+void EXTI0_IRQHandler(void)
+{
+    EXTI_dispatch(0x0001);
+}
+
+void EXTI1_IRQHandler(void)
+{
+    EXTI_dispatch(0x0002);
+}
+
+void EXTI2_IRQHandler(void)
+{
+    EXTI_dispatch(0x0004);
+}
+
+void EXTI3_IRQHandler(void)
+{
+    EXTI_dispatch(0x0008);
+}
+
+void EXTI4_IRQHandler(void)
+{
+    EXTI_dispatch(0x0010);
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+    EXTI_dispatch(0x03E0);
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+    EXTI_dispatch(0xFC00);
+}
@@ -0,0 +1,47 @@
+#ifndef EXTI_H
+#define EXTI_H
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* NVIC priority of every EXTI interrupt: the lowest, same as SysTick */
+#define EXTI_IRQ_PRIORITY 15
+
+/**
+ * @brief Edge selection for an EXTI line
+ */
+typedef enum {
+    EXTI_EDGE_FALLING = 0x01,
+    EXTI_EDGE_RISING  = 0x02,
+    EXTI_EDGE_BOTH    = 0x03
+} exti_edge_t;
+
+/**
+ * @brief Callback run from the EXTI interrupt with the line that fired.
+ * The pending bit is already cleared when it runs.
+ */
+typedef void (*exti_handler_t)(uint8_t line);
+
+/**
+ * @brief Routes a GPIO pin to its EXTI line and attaches a handler
+ * @param port GPIO port of the pin
+ * @param pin Pin number, also the EXTI line (0-15)
+ * @param edge Edges that set the pending bit
+ * @param handler Callback for the line
+ * @return 1 on success, 0 if the line already has a handler
+ * @note The line is left masked; enable it with EXTI_enableLine.
+ */
+uint8_t EXTI_attach(GPIO_TypeDef *port, uint8_t pin, exti_edge_t edge,
+        exti_handler_t handler);
+
+/**
+ * @brief Clears any stale pending bit and unmasks the lines in 'mask'
+ */
+void EXTI_enableLines(uint16_t mask);
+
+/**
+ * @brief Masks the lines in 'mask'
+ */
+void EXTI_disableLines(uint16_t mask);
+
+#endif /* EXTI_H */
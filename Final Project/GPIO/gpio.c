@@ -10,6 +10,7 @@ void GPIO_Init(const gpio_config_t *cfg)
     /* Enable clock for the corresponding GPIO port */
 	uint32_t gpio_en_bit = ((uint32_t)cfg->port - GPIOA_BASE) / 0x400;
 	RCC->AHB1ENR |= (1 << (gpio_en_bit + RCC_AHB1ENR_GPIOAEN_Pos));
+	(void) RCC->AHB1ENR; /* Clock running before MODER is written */
 
     /* Configure pin mode */
     cfg->port->MODER &= ~(0x3 << (cfg->pin * 2));
@@ -81,3 +82,202 @@ void GPIO_Toggle(GPIO_TypeDef *port, uint8_t pin)
 {
     port->ODR ^= (1 << pin);
 }
+
+/**
+ * @brief Get the index of a GPIO port.
+ *
+ * @param port GPIO port (GPIOA~GPIOH).
+ * @return 0 for GPIOA, 1 for GPIOB, ... 7 for GPIOH.
+ */
+uint8_t GPIO_portIndex(const GPIO_TypeDef *port)
+{
+    if (port == GPIOA) return 0;
+    if (port == GPIOB) return 1;
+    if (port == GPIOC) return 2;
+#ifdef GPIOD
+    if (port == GPIOD) return 3;
+#endif
+#ifdef GPIOE
+    if (port == GPIOE) return 4;
+#endif
+    return 7; /* GPIOH */
+}
+
+/**
+ * @brief Empties a batch.
+ *
+ * @param batch Batch to clear.
+ */
+void GPIO_batchInit(gpio_batch_t *batch)
+{
+    batch->count = 0;
+}
+
+/**
+ * @brief Finds the batch entry of a port, adding one if needed.
+ *
+ * @return The entry, or 0 if the batch already holds GPIO_BATCH_MAX_PORTS ports.
+ */
+static gpio_port_batch_t *GPIO_batchPort(gpio_batch_t *batch, GPIO_TypeDef *port)
+{
+    for (uint8_t i = 0; i < batch->count; i++)
+    {
+        if (batch->ports[i].port == port)
+        {
+            return &batch->ports[i];
+        }
+    }
+    if (batch->count == GPIO_BATCH_MAX_PORTS)
+    {
+        return 0;
+    }
+
+    gpio_port_batch_t *p = &batch->ports[batch->count++];
+    p->port = port;
+    p->claimed = 0;
+    p->configured = 0;
+    p->moder = 0;
+    p->mask2 = 0;
+    p->otyper = 0;
+    p->ospeedr = 0;
+    p->pupdr = 0;
+    p->afr[0] = p->afr[1] = 0;
+    p->afr_mask[0] = p->afr_mask[1] = 0;
+    p->bsrr = 0;
+    return p;
+}
+
+/**
+ * @brief Reserves a pin without configuring it.
+ *
+ * @param batch Batch to add to.
+ * @param port  GPIO port.
+ * @param pin   GPIO pin number (0~15).
+ * @return GPIO_BATCH_OK, or the reason the pin was rejected.
+ */
+gpio_batch_status_t GPIO_batchClaim(gpio_batch_t *batch, GPIO_TypeDef *port,
+        uint8_t pin)
+{
+    if (pin > 15)
+    {
+        return GPIO_BATCH_BAD_PIN;
+    }
+    gpio_port_batch_t *p = GPIO_batchPort(batch, port);
+    if (p == 0)
+    {
+        return GPIO_BATCH_FULL;
+    }
+    if (p->claimed & (1U << pin))
+    {
+        return GPIO_BATCH_CONFLICT;
+    }
+    p->claimed |= (uint16_t)(1U << pin);
+    return GPIO_BATCH_OK;
+}
+
+/**
+ * @brief Adds one pin configuration to a batch.
+ *
+ * @param batch Batch to add to.
+ * @param cfg   Pin configuration.
+ * @return GPIO_BATCH_OK, or the reason the pin was rejected.
+ */
+gpio_batch_status_t GPIO_batchAdd(gpio_batch_t *batch, const gpio_config_t *cfg)
+{
+    gpio_batch_status_t status = GPIO_batchClaim(batch, cfg->port, cfg->pin);
+    if (status != GPIO_BATCH_OK)
+    {
+        return status;
+    }
+
+    gpio_port_batch_t *p = GPIO_batchPort(batch, cfg->port);
+    uint32_t shift2 = cfg->pin * 2U;
+
+    p->configured |= (uint16_t)(1U << cfg->pin);
+    p->mask2 |= 0x3UL << shift2;
+    p->moder |= (uint32_t)(cfg->mode & 0x3) << shift2;
+    p->otyper |= (uint32_t)(cfg->otype & 0x1) << cfg->pin;
+    p->ospeedr |= (uint32_t)(cfg->speed & 0x3) << shift2;
+    p->pupdr |= (uint32_t)(cfg->pull & 0x3) << shift2;
+    if (cfg->mode == GPIO_DRIVER_MODE_ALT_FUNCTION)
+    {
+        uint32_t shift4 = (cfg->pin & 0x7U) * 4U;
+        p->afr_mask[cfg->pin >> 3] |= 0xFUL << shift4;
+        p->afr[cfg->pin >> 3] |= (uint32_t)(cfg->af & 0xF) << shift4;
+    }
+    return GPIO_BATCH_OK;
+}
+
+/**
+ * @brief Records the starting output level of a pin.
+ *
+ * @param batch Batch to add to.
+ * @param port  GPIO port.
+ * @param pin   GPIO pin number (0~15).
+ * @param value 0 for low, non-zero for high.
+ * @return GPIO_BATCH_OK, or the reason the level was rejected.
+ */
+gpio_batch_status_t GPIO_batchSetLevel(gpio_batch_t *batch, GPIO_TypeDef *port,
+        uint8_t pin, uint8_t value)
+{
+    if (pin > 15)
+    {
+        return GPIO_BATCH_BAD_PIN;
+    }
+    gpio_port_batch_t *p = GPIO_batchPort(batch, port);
+    if (p == 0)
+    {
+        return GPIO_BATCH_FULL;
+    }
+    /* Set and reset halves are exclusive for one pin */
+    p->bsrr &= ~((1UL << pin) | (1UL << (pin + 16)));
+    p->bsrr |= 1UL << (pin + (value ? 0 : 16));
+    return GPIO_BATCH_OK;
+}
+
+/**
+ * @brief Writes a batch to the hardware, one masked write per register per port.
+ *
+ * @param batch Batch built with GPIO_batchAdd.
+ */
+void GPIO_batchApply(const gpio_batch_t *batch)
+{
+    uint32_t clocks = 0;
+
+    for (uint8_t i = 0; i < batch->count; i++)
+    {
+        clocks |= 1UL << (GPIO_portIndex(batch->ports[i].port) + RCC_AHB1ENR_GPIOAEN_Pos);
+    }
+    RCC->AHB1ENR |= clocks;
+    /* Read back so the enable completes before the first port access */
+    (void) RCC->AHB1ENR;
+
+    for (uint8_t i = 0; i < batch->count; i++)
+    {
+        const gpio_port_batch_t *p = &batch->ports[i];
+        GPIO_TypeDef *port = p->port;
+
+        /* Levels first: BSRR only takes effect once the clock runs */
+        if (p->bsrr)
+        {
+            port->BSRR = p->bsrr;
+        }
+        if (p->configured == 0)
+        {
+            continue;
+        }
+        /* Set output type, speed and pull before the mode switches the pin */
+        port->OTYPER = (port->OTYPER & ~(uint32_t)p->configured) | p->otyper;
+        port->OSPEEDR = (port->OSPEEDR & ~p->mask2) | p->ospeedr;
+        port->PUPDR = (port->PUPDR & ~p->mask2) | p->pupdr;
+        if (p->afr_mask[0])
+        {
+            port->AFR[0] = (port->AFR[0] & ~p->afr_mask[0]) | p->afr[0];
+        }
+        if (p->afr_mask[1])
+        {
+            port->AFR[1] = (port->AFR[1] & ~p->afr_mask[1]) | p->afr[1];
+        }
+        port->MODER = (port->MODER & ~p->mask2) | p->moder;
+    }
+}
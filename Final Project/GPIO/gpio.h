@@ -63,6 +63,45 @@ typedef struct {
     gpio_alt_function_t af;    /**< Alternate function if used */
 } gpio_config_t;
 
+/* Ports a gpio_batch_t can collect pins for */
+#define GPIO_BATCH_MAX_PORTS 5
+
+/**
+ * @brief Register values collected for one port by GPIO_batchAdd.
+ * Each *_mask marks the bits the batch owns; other bits are left as they are.
+ */
+typedef struct {
+    GPIO_TypeDef *port;
+    uint16_t claimed;          /* Pins added or claimed, for conflict checks */
+    uint16_t configured;       /* Pins whose registers the batch writes */
+    uint32_t moder;
+    uint32_t mask2;            /* 2-bit field mask for MODER/OSPEEDR/PUPDR */
+    uint32_t otyper;
+    uint32_t ospeedr;
+    uint32_t pupdr;
+    uint32_t afr[2];
+    uint32_t afr_mask[2];
+    uint32_t bsrr;             /* Output levels set before MODER is written */
+} gpio_port_batch_t;
+
+/**
+ * @brief A set of pin configurations compiled into per-port register writes.
+ */
+typedef struct {
+    gpio_port_batch_t ports[GPIO_BATCH_MAX_PORTS];
+    uint8_t count;
+} gpio_batch_t;
+
+/**
+ * @brief Result of adding a pin to a batch.
+ */
+typedef enum {
+    GPIO_BATCH_OK = 0,
+    GPIO_BATCH_CONFLICT,       /* Pin already added or claimed */
+    GPIO_BATCH_FULL,           /* More than GPIO_BATCH_MAX_PORTS ports */
+    GPIO_BATCH_BAD_PIN         /* Pin number above 15 */
+} gpio_batch_status_t;
+
 /**
  * @brief Initialize a GPIO pin with the given configuration
  * @param cfg Pointer to GPIO configuration struct
@@ -100,4 +139,46 @@ void GPIO_Toggle(GPIO_TypeDef *port, uint8_t pin);
  */
 void GPIO_SetAlternateFunction(GPIO_TypeDef *port, uint8_t pin, gpio_alt_function_t af);
 
+/**
+ * @brief Returns the index of a GPIO port: 0 for GPIOA, 1 for GPIOB, ...
+ * 7 for GPIOH. This is also its RCC AHB1ENR bit and its SYSCFG EXTICR code.
+ */
+uint8_t GPIO_portIndex(const GPIO_TypeDef *port);
+
+/**
+ * @brief Empties a batch.
+ */
+void GPIO_batchInit(gpio_batch_t *batch);
+
+/**
+ * @brief Adds one pin configuration to a batch; no register is touched.
+ * @return GPIO_BATCH_CONFLICT if the pin is already in the batch
+ */
+gpio_batch_status_t GPIO_batchAdd(gpio_batch_t *batch, const gpio_config_t *cfg);
+
+/**
+ * @brief Reserves a pin that its driver configures itself, so that a later
+ * GPIO_batchAdd or GPIO_batchClaim of the same pin reports a conflict.
+ */
+gpio_batch_status_t GPIO_batchClaim(gpio_batch_t *batch, GPIO_TypeDef *port,
+        uint8_t pin);
+
+/**
+ * @brief Sets the level an output pin starts at when the batch is applied.
+ * The level is written once the port clock runs and before the pin turns
+ * into an output, so it never drives the reset ODR value.
+ * @param value 0 = Low, non-zero = High
+ * @return GPIO_BATCH_FULL or GPIO_BATCH_BAD_PIN if it cannot be recorded
+ */
+gpio_batch_status_t GPIO_batchSetLevel(gpio_batch_t *batch, GPIO_TypeDef *port,
+        uint8_t pin, uint8_t value);
+
+/**
+ * @brief Writes a batch to the hardware.
+ * Enables all port clocks with one RCC write, then issues one masked
+ * read-modify-write per register per port, whatever the pin count.
+ * Output levels from GPIO_batchSetLevel go out before the modes change.
+ */
+void GPIO_batchApply(const gpio_batch_t *batch);
+
 #endif  /* GPIO_H */
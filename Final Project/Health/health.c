@@ -0,0 +1,58 @@
+#include "health.h"
+
+static volatile uint32_t health_counters[HEALTH_COUNT];
+
+static const char *const health_names[HEALTH_COUNT] = {
+    [HEALTH_UART_OVERRUN] = "UART_OVR", [HEALTH_UART_FRAMING] = "UART_FE",
+    [HEALTH_UART_PARSE] = "UART_PARSE", [HEALTH_UART_BAD_FRAME] = "UART_CRC",
+    [HEALTH_UART_RX_DROP] = "UART_RXDROP",
+    [HEALTH_UART_TX_DROP] = "UART_TXDROP",
+    [HEALTH_ADC_DMA_ERROR] = "ADC_DMA", [HEALTH_I2C_STALL] = "I2C_STALL",
+    [HEALTH_I2C_NACK] = "I2C_NACK", [HEALTH_I2C_RECOVERY] = "I2C_RECOVER",
+    [HEALTH_PUMP_START] = "PUMP_ON", [HEALTH_CONTROL_OVERRUN] = "LOOP_LATE",
+    [HEALTH_CLOCK_FAILURE] = "CLOCK_FAIL", [HEALTH_LOG_DROP] = "LOG_DROP",
+    [HEALTH_FLASH_ERROR] = "FLASH_ERR", [HEALTH_UART_RX_LAP] = "UART_RXLAP"
+};
+
+/**
+ * @brief Adds 'n' to a counter with an exclusive load/store pair.
+ */
+void Health_add(health_counter_t counter, uint32_t n) {
+    uint32_t value;
+
+    if (counter >= HEALTH_COUNT) {
+        return;
+    }
+    do {
+        value = __LDREXW(&health_counters[counter]);
+    } while (__STREXW(value + n, &health_counters[counter]));
+}
+
+/**
+ * @brief Reads one counter.
+ */
+uint32_t Health_get(health_counter_t counter) {
+    return (counter < HEALTH_COUNT) ? health_counters[counter] : 0;
+}
+
+/**
+ * @brief Copies every counter, optionally swapping each for zero.
+ */
+void Health_snapshot(uint32_t *values, uint8_t reset) {
+    for (uint8_t i = 0; i < HEALTH_COUNT; i++) {
+        if (!reset) {
+            values[i] = health_counters[i];
+            continue;
+        }
+        do {
+            values[i] = __LDREXW(&health_counters[i]);
+        } while (__STREXW(0, &health_counters[i]));
+    }
+}
+
+/**
+ * @brief Returns a counter's short name.
+ */
+const char *Health_getName(uint8_t counter) {
+    return (counter < HEALTH_COUNT) ? health_names[counter] : 0;
+}
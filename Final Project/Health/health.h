@@ -0,0 +1,71 @@
+#ifndef HEALTH_H_
+#define HEALTH_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/*
+ * Central fault and event counters. Drivers call HEALTH_INC at the point
+ * an error is detected; the increment is a single LDREX/STREX add, safe
+ * from any interrupt priority without masking. Health_snapshot copies all
+ * counters at once and can clear them as it reads, so a host polling it
+ * gets per-interval counts without losing events that land in between.
+ *
+ * The per-module statistics (LabVIEW_UART_getRxStats, Button_getStats...)
+ * are kept: they count since boot and never reset.
+ */
+
+/**
+ * @brief Counters, in the order of a snapshot.
+ */
+typedef enum {
+    HEALTH_UART_OVERRUN = 0,    /* USART2 overrun (ORE) */
+    HEALTH_UART_FRAMING,        /* USART2 framing or noise error */
+    HEALTH_UART_PARSE,          /* Command lines that matched nothing */
+    HEALTH_UART_BAD_FRAME,      /* Binary frames failing CRC or format */
+    HEALTH_UART_RX_DROP,        /* Valid frames lost to a full queue */
+    HEALTH_UART_TX_DROP,        /* Blocks or frames lost to a full TX ring */
+    HEALTH_ADC_DMA_ERROR,       /* ADC DMA transfer, FIFO or direct mode error */
+    HEALTH_I2C_STALL,           /* I2C flag waits that timed out */
+    HEALTH_I2C_NACK,            /* I2C address or data not acknowledged */
+    HEALTH_I2C_RECOVERY,        /* I2C bus recoveries (9 clocks and STOP) */
+    HEALTH_PUMP_START,          /* Pump off-to-on transitions */
+    HEALTH_CONTROL_OVERRUN,     /* Control passes due before the last ran */
+    HEALTH_CLOCK_FAILURE,       /* Clock switches or wake-up restores that timed out */
+    HEALTH_LOG_DROP,            /* Flash log samples lost, no erased sector ready */
+    HEALTH_FLASH_ERROR,         /* Flash program or erase errors */
+    HEALTH_UART_RX_LAP,         /* USART2 RX DMA ring overwritten before it was read */
+    HEALTH_COUNT
+} health_counter_t;
+
+/**
+ * @brief Adds one to a counter.
+ */
+#define HEALTH_INC(counter)     Health_add((counter), 1)
+
+/**
+ * @brief Adds 'n' to a counter.
+ * @note Safe from thread and interrupt context at any priority.
+ */
+void Health_add(health_counter_t counter, uint32_t n);
+
+/**
+ * @brief Reads one counter.
+ */
+uint32_t Health_get(health_counter_t counter);
+
+/**
+ * @brief Copies every counter.
+ * @param values Receives HEALTH_COUNT values in health_counter_t order
+ * @param reset 1 to clear each counter as it is read; increments racing
+ * with the read land in the next snapshot
+ */
+void Health_snapshot(uint32_t *values, uint8_t reset);
+
+/**
+ * @brief Returns a counter's short name, e.g. "I2C_STALL", or 0 for an
+ * unknown id.
+ */
+const char *Health_getName(uint8_t counter);
+
+#endif /* HEALTH_H_ */
@@ -15,4 +15,16 @@
 #define RS_Pin 10
 #define E_Pin 2
 
+/* Transport used by LCD_Init: parallel GPIO pins or PCF8574 I2C backpack */
+#define LCD_TRANSPORT_PARALLEL  0
+#define LCD_TRANSPORT_PCF8574   1
+#define LCD_TRANSPORT           LCD_TRANSPORT_PARALLEL
+
+/* 7-bit address of the PCF8574 backpack (0x27 for PCF8574, 0x3F for PCF8574A) */
+#define LCD_PCF8574_ADDRESS     0x27
+
+/* Display geometry: 16x2, 16x4, 20x2 or 20x4 */
+#define LCD_COLS 16
+#define LCD_ROWS 2
+
 #endif /* _LCD_CONFIG_H_ */
@@ -3,8 +3,22 @@
 #include "stm32f4xx.h"
 #include "delay.h"
 
+#if LCD_TRANSPORT == LCD_TRANSPORT_PCF8574
+#include "lcd_pcf8574.h"
+#define LCD_DEFAULT_TRANSPORT (&lcd_transport_pcf8574)
+#else
+#define LCD_DEFAULT_TRANSPORT (&lcd_transport_parallel)
+#endif
+
 char display_settings;
 
+/* Active transport and geometry */
+static const lcd_transport_t *lcd_transport = LCD_DEFAULT_TRANSPORT;
+static uint8_t lcd_cols = LCD_COLS;
+static uint8_t lcd_rows = LCD_ROWS;
+/* DDRAM start address of each row for the current geometry */
+static uint8_t lcd_row_offsets[4] = { 0x00, 0x40, LCD_COLS, 0x40 + LCD_COLS };
+
 /**
  * @brief  Send a falling edge to the LCD
  * This function generates a falling edge on the Enable pin of the LCD.
@@ -43,6 +57,41 @@ static void LCD_sendData4Bit(char data) {
 }
 #endif
 
+/**
+ * @brief  Parallel transport: drive RS and EN low before the power-on wait.
+ */
+static void parallel_init(void) {
+    /* Clear RS pin for command */
+    LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
+    /* Clear Enable pin */
+    LCD_DATA_PORT_B->ODR &= ~(1 << E_Pin);
+}
+
+/**
+ * @brief  Parallel transport: clock a single nibble with the given RS level.
+ */
+static void parallel_writeNibble(uint8_t nibble, uint8_t rs) {
+    if (rs)
+        LCD_DATA_PORT_B->ODR |= (1 << RS_Pin);
+    else
+        LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
+    LCD_sendData4Bit(nibble);
+}
+
+/**
+ * @brief  Parallel transport: clock a byte as upper then lower nibble.
+ */
+static void parallel_writeByte(uint8_t byte, uint8_t rs) {
+    parallel_writeNibble(byte >> 4, rs);
+    LCD_sendData4Bit(byte);
+}
+
+const lcd_transport_t lcd_transport_parallel = {
+    .init = parallel_init,
+    .writeNibble = parallel_writeNibble,
+    .writeByte = parallel_writeByte
+};
+
 /**
  * @brief  Send a command to the LCD
  * @param  command: Command to send
@@ -50,12 +99,8 @@ static void LCD_sendData4Bit(char data) {
  to the LCD by splitting it into two 4-bit transmissions.
  */
 static void LCD_sendCommand(char command) {
-    /* Clear RS pin for command */
-    LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
-    /* Send upper nibble*/
-    LCD_sendData4Bit(command >> 4);
-    /* Send lower nibble */
-    LCD_sendData4Bit(command); // Send lower nibble
+    /* RS low for command, upper nibble then lower nibble */
+    lcd_transport->writeByte((uint8_t) command, 0);
 }
 
 /**
@@ -65,9 +110,51 @@ static void LCD_sendCommand(char command) {
  * Sends a character to be displayed on the LCD.
  */
 static void LCD_sendData(char data) {
-    LCD_DATA_PORT_B->ODR |= (1 << RS_Pin); // Set RS pin for data
-    LCD_sendData4Bit(data >> 4); // Send upper nibble
-    LCD_sendData4Bit(data); // Send lower nibble
+    /* RS high for data, upper nibble then lower nibble */
+    lcd_transport->writeByte((uint8_t) data, 1);
+}
+
+/**
+ * @brief  Select the transport used to reach the controller
+ * @param  transport: Transport descriptor, NULL keeps the current one
+ */
+void LCD_setTransport(const lcd_transport_t *transport) {
+    if (transport) {
+        lcd_transport = transport;
+    }
+}
+
+/**
+ * @brief  Set the display geometry used for cursor addressing
+ * @param  cols: Number of columns (16 or 20)
+ * @param  rows: Number of rows (2 or 4)
+ * Rows 2 and 3 of 4-line modules continue rows 0 and 1 in DDRAM,
+ * so their start addresses are offset by the column count.
+ */
+void LCD_setGeometry(uint8_t cols, uint8_t rows) {
+    if (cols == 0 || cols > 20 || rows == 0 || rows > 4) {
+        return;
+    }
+    lcd_cols = cols;
+    lcd_rows = rows;
+    lcd_row_offsets[0] = 0x00;
+    lcd_row_offsets[1] = 0x40;
+    lcd_row_offsets[2] = 0x00 + cols;
+    lcd_row_offsets[3] = 0x40 + cols;
+}
+
+/**
+ * @brief  Number of columns of the configured display
+ */
+uint8_t LCD_getColumns(void) {
+    return lcd_cols;
+}
+
+/**
+ * @brief  Number of rows of the configured display
+ */
+uint8_t LCD_getRows(void) {
+    return lcd_rows;
 }
 
 /**
@@ -101,57 +188,97 @@ void LCD_Write(char *str) {
     }
 }
 
+/* Position in the resumable power-on sequence driven by LCD_initStep */
+static uint8_t lcd_init_state = 0;
+
+/**
+ * @brief  Run the next step of the 4-bit power-on sequence
+ * @param  wait_us: Receives how long the controller needs before the next step
+ * @retval 1 when the LCD is fully initialised, 0 if more steps remain
+ * Each call issues at most one transfer and never waits, so the boot
+ * sequencer can overlap the HD44780 execution times with other drivers.
+ */
+uint8_t LCD_initStep(uint32_t *wait_us) {
+    *wait_us = 0;
+    switch (lcd_init_state) {
+    case 0:
+        /* RS and EN low on the selected transport, power-on wait */
+        lcd_transport->init();
+        *wait_us = 50000;
+        break;
+    case 1:
+        display_settings =
+        LCD_CMD_4BIT_MODE | LCD_CMD_2LINE_MODE | LCD_CMD_5x8_DOTS;
+        lcd_transport->writeNibble(0x03, 0);
+        *wait_us = 5000;
+        break;
+    case 2:
+        lcd_transport->writeNibble(0x03, 0);
+        *wait_us = 150;
+        break;
+    case 3:
+        lcd_transport->writeNibble(0x03, 0);
+        *wait_us = 50;
+        break;
+    case 4:
+        lcd_transport->writeNibble(0x02, 0);
+        *wait_us = 50;
+        break;
+    case 5:
+        LCD_sendCommand(LCD_CMD_FUNCTION_SET | display_settings);
+        *wait_us = 1000;
+        break;
+    case 6:
+        display_settings |= LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF;
+        LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | display_settings);
+        *wait_us = 50;
+        break;
+    case 7:
+        LCD_sendCommand(LCD_CMD_CLEAR_DISPLAY);
+        *wait_us = 2000;
+        break;
+    case 8:
+        display_settings |= LCD_CMD_SET_ENTRY_LEFT | LCD_CMD_SET_ENTRY_NO_SHIFT;
+        LCD_sendCommand(LCD_CMD_ENTRY_MODE_SET | display_settings);
+        *wait_us = 50;
+        break;
+    default:
+        /* Sequence finished; the next call starts over */
+        lcd_init_state = 0;
+        return 1;
+    }
+    lcd_init_state++;
+    return 0;
+}
+
 /**
  * @brief  Initialize the LCD in 4-bit mode
  * Sends the required startup sequence and configuration commands to prepare the LCD for operation.
+ * Blocking wrapper around LCD_initStep.
  */
 void LCD_Init(void) {
-    /* Clear RS pin for command */
-    LCD_DATA_PORT_B->ODR &= ~(1 << RS_Pin);
-    /* Clear Enable pin */
-    LCD_DATA_PORT_B->ODR &= ~(1 << E_Pin);
-    delay_ms(50);
-
-#if 1
-    display_settings =
-    LCD_CMD_4BIT_MODE | LCD_CMD_2LINE_MODE | LCD_CMD_5x8_DOTS;
-    LCD_sendData4Bit(0x03);
-    delay_ms(5);
-    LCD_sendData4Bit(0x03);
-    delay_us(150);
-    LCD_sendData4Bit(0x03);
-    delay_us(50);
-    LCD_sendData4Bit(0x02);
-    delay_us(50);
-#endif
-    LCD_sendCommand(LCD_CMD_FUNCTION_SET | display_settings);
-    delay_ms(1);
-    display_settings |= LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF;
-    LCD_sendCommand(LCD_CMD_DISPLAY_CONTROL | display_settings);
-    delay_us(50);
-
-    LCD_Clear();
-    display_settings |= LCD_CMD_SET_ENTRY_LEFT | LCD_CMD_SET_ENTRY_NO_SHIFT;
-    LCD_sendCommand(LCD_CMD_ENTRY_MODE_SET | display_settings);
-    delay_us(50);
+    uint32_t wait_us;
+    lcd_init_state = 0;
+    while (!LCD_initStep(&wait_us)) {
+        delay_us(wait_us);
+    }
 }
 
 /**
  * @brief  Set cursor to specified column and row
- * @param  x: Column position (0–15)
- * @param  y: Row position (0: top row, 1: bottom row)
+ * @param  x: Column position (0 to columns - 1)
+ * @param  y: Row position (0 to rows - 1)
  * @retval None
  * Moves the LCD cursor to the given (x, y) position.
  */
 void LCD_setCursor(char x, char y) {
-    uint8_t address;
-    if (y == 0) {
-        /* First line */
-        address = 0x00 + x;
-    } else {
-        /* Second line */
-        address = 0x40 + x;
-    }
+    uint8_t col = (uint8_t) x;
+    uint8_t row = (uint8_t) y;
+    if (col >= lcd_cols)
+        col = lcd_cols - 1;
+    if (row >= lcd_rows)
+        row = lcd_rows - 1;
+    uint8_t address = lcd_row_offsets[row] + col;
     /* Set DDRAM address */
     LCD_sendCommand(LCD_CMD_SET_DDRAM_ADDR | address);
 }
@@ -47,11 +47,55 @@ typedef enum {
     LCD_BLINK_OFF = 0x00
 } LCD_Display_Settings;
 
+/**
+ * @brief Low-level bus used to reach the HD44780 controller.
+ * The driver only talks 4-bit mode, so a transport has to be able to clock
+ * out a lone nibble (init sequence) and a full byte as two nibbles.
+ */
+typedef struct {
+    void (*init)(void);                          /* Prepare the bus, EN/RS low */
+    void (*writeNibble)(uint8_t nibble, uint8_t rs); /* Low 4 bits, one EN pulse */
+    void (*writeByte)(uint8_t byte, uint8_t rs);     /* High then low nibble */
+} lcd_transport_t;
+
+/* Parallel GPIO transport (pins from lcd_config.h) */
+extern const lcd_transport_t lcd_transport_parallel;
+
+/**
+ * @brief Selects the transport used by the driver.
+ * @note Must be called before LCD_Init. Defaults to LCD_TRANSPORT in lcd_config.h.
+ */
+void LCD_setTransport(const lcd_transport_t *transport);
+
+/**
+ * @brief Sets the display geometry used for cursor addressing.
+ * @param cols Number of columns (16 or 20).
+ * @param rows Number of rows (2 or 4).
+ */
+void LCD_setGeometry(uint8_t cols, uint8_t rows);
+
+/**
+ * @brief Returns the number of columns of the configured display.
+ */
+uint8_t LCD_getColumns(void);
+
+/**
+ * @brief Returns the number of rows of the configured display.
+ */
+uint8_t LCD_getRows(void);
+
 /**
  * @brief Initializes the LCD in 4-bit mode.
  */
 void LCD_Init(void);
 
+/**
+ * @brief Runs one step of the LCD power-on sequence without waiting.
+ * @param wait_us Receives the delay required before the next call.
+ * @return 1 when initialisation is complete, 0 otherwise.
+ */
+uint8_t LCD_initStep(uint32_t *wait_us);
+
 /**
  * @brief Sends a command to the LCD.
  * @param cmd Command to send.
@@ -70,6 +114,7 @@ void LCD_Write(char *str);
 
 /**
  * @brief Sets the cursor position on the LCD.
+ * @note Out-of-range positions are clamped to the configured geometry.
  */
 void LCD_setCursor(char x, char y);
 
@@ -93,4 +138,8 @@ void LCD_clearDisplay(void);
  */
 void LCD_setDisplaySettings(LCD_Display_Settings settings);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _LCD_PARALLEL_H_ */
@@ -0,0 +1,70 @@
+#include "lcd_pcf8574.h"
+#include "i2c_driver.h"
+
+/* Backlight bit ORed into every byte latched on the expander */
+static uint8_t pcf8574_backlight = LCD_PCF8574_BACKLIGHT;
+
+/**
+ * @brief  Fill the expander bytes that clock one nibble into the LCD.
+ * @param  out: Destination, receives two bytes (EN high, EN low)
+ * @param  nibble: Data nibble (low 4 bits used)
+ * @param  rs: RS level, 0 for command, 1 for data
+ * The data lines are stable on both bytes, so the HD44780 latches the
+ * nibble on the falling edge between them. At 100 kHz each byte takes
+ * ~90 us on the bus, well above the 450 ns minimum enable pulse.
+ */
+static void pcf8574_packNibble(uint8_t *out, uint8_t nibble, uint8_t rs) {
+    uint8_t bits = (uint8_t) ((nibble & 0x0F) << LCD_PCF8574_DATA_SHIFT)
+            | pcf8574_backlight;
+    if (rs) {
+        bits |= LCD_PCF8574_RS;
+    }
+    out[0] = bits | LCD_PCF8574_EN;
+    out[1] = bits;
+}
+
+/**
+ * @brief  PCF8574 transport: all outputs low except the backlight.
+ * @note   I2C_Init must have been called before.
+ */
+static void pcf8574_init(void) {
+    uint8_t idle = pcf8574_backlight;
+    I2C_writeBuffer(LCD_PCF8574_ADDRESS, &idle, 1);
+}
+
+/**
+ * @brief  PCF8574 transport: clock a single nibble in one I2C write.
+ */
+static void pcf8574_writeNibble(uint8_t nibble, uint8_t rs) {
+    uint8_t frame[2];
+    pcf8574_packNibble(frame, nibble, rs);
+    I2C_writeBuffer(LCD_PCF8574_ADDRESS, frame, sizeof(frame));
+}
+
+/**
+ * @brief  PCF8574 transport: clock a full byte in one I2C write.
+ * Upper nibble EN high/low followed by lower nibble EN high/low,
+ * four expander bytes behind a single address phase.
+ */
+static void pcf8574_writeByte(uint8_t byte, uint8_t rs) {
+    uint8_t frame[4];
+    pcf8574_packNibble(&frame[0], byte >> 4, rs);
+    pcf8574_packNibble(&frame[2], byte, rs);
+    I2C_writeBuffer(LCD_PCF8574_ADDRESS, frame, sizeof(frame));
+}
+
+const lcd_transport_t lcd_transport_pcf8574 = {
+    .init = pcf8574_init,
+    .writeNibble = pcf8574_writeNibble,
+    .writeByte = pcf8574_writeByte
+};
+
+/**
+ * @brief  Turn the backpack backlight on or off
+ * @param  on: 1 to turn the backlight on, 0 to turn it off
+ */
+void LCD_PCF8574_setBacklight(uint8_t on) {
+    pcf8574_backlight = on ? LCD_PCF8574_BACKLIGHT : 0;
+    uint8_t idle = pcf8574_backlight;
+    I2C_writeBuffer(LCD_PCF8574_ADDRESS, &idle, 1);
+}
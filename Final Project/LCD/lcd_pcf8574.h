@@ -0,0 +1,32 @@
+#ifndef _LCD_PCF8574_H_
+#define _LCD_PCF8574_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lcd_parallel.h"
+#include <stdint.h>
+
+/* PCF8574 backpack bit mapping (P0..P7) */
+#define LCD_PCF8574_RS          0x01
+#define LCD_PCF8574_RW          0x02
+#define LCD_PCF8574_EN          0x04
+#define LCD_PCF8574_BACKLIGHT   0x08
+#define LCD_PCF8574_DATA_SHIFT  4
+
+/* I2C backpack transport, address LCD_PCF8574_ADDRESS from lcd_config.h */
+extern const lcd_transport_t lcd_transport_pcf8574;
+
+/**
+ * @brief Turns the backpack backlight on or off.
+ * @param on 1 to turn the backlight on, 0 to turn it off.
+ * @note Takes effect on the next transfer; a single latch write is issued here.
+ */
+void LCD_PCF8574_setBacklight(uint8_t on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LCD_PCF8574_H_ */
@@ -0,0 +1,481 @@
+#include "flash_log.h"
+#include "delay.h"
+#include "health.h"
+
+#define FLASH_KEY1              0x45670123U
+#define FLASH_KEY2              0xCDEF89ABU
+#define FLASH_SR_ERRORS         (FLASH_SR_OPERR | FLASH_SR_WRPERR \
+                                | FLASH_SR_PGAERR | FLASH_SR_PGPERR \
+                                | FLASH_SR_PGSERR)
+
+/**
+ * @brief Contents of the sector that is not being written.
+ */
+typedef enum {
+    FLASHLOG_SPARE_ERASED = 0,  /* Ready to take over */
+    FLASHLOG_SPARE_HISTORY,     /* Older samples, exported first */
+    FLASHLOG_SPARE_DIRTY        /* No valid header, must be erased */
+} flash_log_spare_t;
+
+/* Reserved range, defined by STM32F401CCUX_FLASH.ld only */
+extern const uint8_t _sflash_log[] __attribute__((weak));
+extern const uint8_t _eflash_log[] __attribute__((weak));
+/* Start-up symbols of every linker script: the image ends with the
+ * initial values of .data */
+extern const uint8_t _sidata[];
+extern uint8_t _sdata[];
+extern uint8_t _edata[];
+
+static const uint32_t log_addr[2] = { FLASHLOG_ADDR_A, FLASHLOG_ADDR_B };
+static const uint8_t log_sector[2] = { FLASHLOG_SECTOR_A, FLASHLOG_SECTOR_B };
+
+static uint8_t log_enabled = 0;             /* Sectors known to be free of code */
+static uint8_t log_active = 0;              /* 0: sector A, 1: sector B */
+static uint16_t log_fill[2];                /* Slots written per sector */
+static flash_log_spare_t log_spare = FLASHLOG_SPARE_DIRTY;
+static log_codec_t log_codec;
+static flash_log_stats_t log_stats;
+
+/* Vector table used during an erase. VTOR needs it aligned to its size
+ * rounded up to a power of two: 101 entries, 512 bytes. */
+static flash_log_isr_fn stall_vectors[FLASHLOG_VECTORS]
+        __attribute__((aligned(512)));
+static struct {
+    IRQn_Type irq;
+    flash_log_isr_fn handler;
+} stall_handlers[FLASHLOG_MAX_STALL_HANDLERS];
+static uint8_t stall_handler_count = 0;
+static volatile uint32_t stall_ticks;       /* SysTick periods during the erase */
+static volatile uint32_t stall_held[(FLASHLOG_VECTORS - 16 + 31) / 32];
+
+/* Export cursor: up to two sectors, oldest first */
+static uint8_t export_order[2];
+static uint8_t export_sectors = 0;
+static uint8_t export_part = 0;
+static uint16_t export_slot = 0;
+
+/**
+ * @brief Returns the address of a slot.
+ */
+static const uint8_t *FlashLog_slot(uint8_t sector, uint16_t slot) {
+    return (const uint8_t*) (log_addr[sector] + (uint32_t) slot * LOG_SLOT_SIZE);
+}
+
+/**
+ * @brief Returns 1 if every slot from 'first' on is erased.
+ */
+static uint8_t FlashLog_isBlank(uint8_t sector, uint16_t first) {
+    const uint32_t *word = (const uint32_t*) FlashLog_slot(sector, first);
+    const uint32_t *end = (const uint32_t*) (log_addr[sector]
+            + FLASHLOG_SECTOR_SIZE);
+
+    while (word < end) {
+        if (*word++ != 0xFFFFFFFFU) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Counts the slots in use: everything up to the last non-erased one.
+ */
+static uint16_t FlashLog_scanFill(uint8_t sector) {
+    uint16_t fill = FLASHLOG_SLOTS;
+
+    while (fill > 0) {
+        const uint32_t *word = (const uint32_t*) FlashLog_slot(sector, fill - 1);
+        if (word[0] != 0xFFFFFFFFU || word[1] != 0xFFFFFFFFU) {
+            break;
+        }
+        fill--;
+    }
+    return fill;
+}
+
+/**
+ * @brief Waits for the flash to finish and clears the error flags.
+ * @return 1 on success, 0 if an error flag was set
+ */
+static uint8_t FlashLog_wait(void) {
+    while (FLASH->SR & FLASH_SR_BSY) {
+    }
+    uint32_t errors = FLASH->SR & FLASH_SR_ERRORS;
+    FLASH->SR = errors | FLASH_SR_EOP;
+    return errors == 0;
+}
+
+/**
+ * @brief Unlocks the flash control register.
+ */
+static void FlashLog_unlock(void) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+/**
+ * @brief Programs one 32-bit word (x32 parallelism, 2.7-3.6 V).
+ */
+static uint8_t FlashLog_programWord(uint32_t address, uint32_t word) {
+    FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SER))
+            | FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+    *(volatile uint32_t*) address = word;
+    uint8_t ok = FlashLog_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    return ok && *(volatile uint32_t*) address == word;
+}
+
+/**
+ * @brief Programs one slot, commit byte last.
+ * @return 1 on success, 0 on a flash error
+ */
+static uint8_t FlashLog_programSlot(uint8_t sector, uint16_t slot,
+        const uint8_t *data) {
+    uint32_t address = (uint32_t) FlashLog_slot(sector, slot);
+    uint32_t low = (uint32_t) data[0] | ((uint32_t) data[1] << 8)
+            | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+    uint32_t high = (uint32_t) data[4] | ((uint32_t) data[5] << 8)
+            | ((uint32_t) data[6] << 16) | ((uint32_t) data[7] << 24);
+
+    FlashLog_unlock();
+    uint8_t ok = FlashLog_programWord(address + 4, high)
+            && FlashLog_programWord(address, low);
+    FLASH->CR |= FLASH_CR_LOCK;
+    if (!ok) {
+        log_stats.program_errors++;
+        HEALTH_INC(HEALTH_FLASH_ERROR);
+    }
+    return ok;
+}
+
+/**
+ * @brief SysTick during an erase: counts the periods for Delay.
+ */
+static FLASHLOG_RAMFUNC void FlashLog_stallTick(void) {
+    stall_ticks++;
+}
+
+/**
+ * @brief Any other interrupt during an erase: disabled until the erase is
+ * over. Its peripheral flag stays set, so it fires again once re-enabled.
+ */
+static FLASHLOG_RAMFUNC void FlashLog_stallHold(void) {
+    uint32_t irq = (__get_IPSR() & 0x1FFU) - 16U;
+
+    NVIC->ICER[irq >> 5] = 1UL << (irq & 31U);
+    stall_held[irq >> 5] |= 1UL << (irq & 31U);
+}
+
+/**
+ * @brief Starts a sector erase and waits for it without reading the flash.
+ * @return FLASH->SR once the flash is idle
+ */
+static FLASHLOG_RAMFUNC uint32_t FlashLog_eraseRam(uint32_t cr) {
+    FLASH->CR = cr;
+    FLASH->CR = cr | FLASH_CR_STRT;
+    while (FLASH->SR & FLASH_SR_BSY) {
+    }
+    return FLASH->SR;
+}
+
+/**
+ * @brief Erases one sector from RAM, with the RAM vector table in place,
+ * then catches up on the SysTick periods and held-back interrupts.
+ */
+static uint8_t FlashLog_erase(uint8_t sector) {
+    const flash_log_isr_fn *vectors = (const flash_log_isr_fn*) SCB->VTOR;
+    uint32_t vtor = SCB->VTOR;
+
+    /* Faults keep their handlers; they are not expected during an erase */
+    for (uint32_t i = 0; i < FLASHLOG_VECTORS; i++) {
+        stall_vectors[i] = (i < 15) ? vectors[i] : FlashLog_stallHold;
+    }
+    stall_vectors[15] = FlashLog_stallTick;
+    for (uint8_t i = 0; i < stall_handler_count; i++) {
+        stall_vectors[16 + stall_handlers[i].irq] = stall_handlers[i].handler;
+    }
+    for (uint8_t i = 0; i < sizeof(stall_held) / sizeof(stall_held[0]); i++) {
+        stall_held[i] = 0;
+    }
+    stall_ticks = 0;
+
+    FlashLog_unlock();
+    uint32_t cr = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB | FLASH_CR_PG))
+            | FLASH_CR_PSIZE_1 | FLASH_CR_SER
+            | ((uint32_t) log_sector[sector] << FLASH_CR_SNB_Pos);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    SCB->VTOR = (uint32_t) stall_vectors;
+    __DSB();
+    __set_PRIMASK(primask);
+
+    uint32_t status = FlashLog_eraseRam(cr);
+
+    __disable_irq();
+    SCB->VTOR = vtor;
+    __DSB();
+    FLASH->SR = (status & FLASH_SR_ERRORS) | FLASH_SR_EOP;
+    FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+    FLASH->CR |= FLASH_CR_LOCK;
+
+    uint32_t ms = stall_ticks;
+    if (ms) {
+        Delay_compensateSleep(ms, 0);
+    }
+    /* Held-back interrupts run as soon as the mask is lifted; the
+     * registered ones run their regular handler once to catch up */
+    for (uint8_t i = 0; i < sizeof(stall_held) / sizeof(stall_held[0]); i++) {
+        NVIC->ISER[i] = stall_held[i];
+    }
+    for (uint8_t i = 0; i < stall_handler_count; i++) {
+        NVIC_SetPendingIRQ(stall_handlers[i].irq);
+    }
+    __set_PRIMASK(primask);
+
+    log_stats.erases++;
+    log_stats.erase_last_ms = ms;
+    if (ms > log_stats.erase_max_ms) {
+        log_stats.erase_max_ms = ms;
+    }
+    uint8_t ok = !(status & FLASH_SR_ERRORS) && FlashLog_isBlank(sector, 0);
+    if (!ok) {
+        HEALTH_INC(HEALTH_FLASH_ERROR);
+    }
+    return ok;
+}
+
+/**
+ * @brief Makes 'sector' the active one, with a header one above 'seq'.
+ */
+static uint8_t FlashLog_begin(uint8_t sector, uint32_t seq) {
+    uint8_t header[LOG_SLOT_SIZE];
+
+    LogRecord_header(seq + 1, header);
+    if (!FlashLog_programSlot(sector, 0, header)) {
+        return 0;
+    }
+    log_active = sector;
+    log_fill[sector] = 1;
+    log_stats.seq = seq + 1;
+    LogRecord_reset(&log_codec);
+    return 1;
+}
+
+/**
+ * @brief Reads a sector's header.
+ * @return 1 and *seq if the first slot is a valid header
+ */
+static uint8_t FlashLog_readHeader(uint8_t sector, uint32_t *seq) {
+    log_codec_t codec;
+
+    LogRecord_reset(&codec);
+    return LogRecord_decode(&codec, FlashLog_slot(sector, 0), seq, 0)
+            == LOG_SLOT_HEADER;
+}
+
+/**
+ * @brief Keeps an interrupt running from RAM while a sector is erased.
+ */
+uint8_t FlashLog_registerStallHandler(IRQn_Type irq,
+        flash_log_isr_fn handler) {
+    if (stall_handler_count == FLASHLOG_MAX_STALL_HANDLERS) {
+        return 0;
+    }
+    stall_handlers[stall_handler_count].irq = irq;
+    stall_handlers[stall_handler_count].handler = handler;
+    stall_handler_count++;
+    return 1;
+}
+
+/**
+ * @brief Returns 1 if the linked image keeps out of both log sectors.
+ */
+static uint8_t FlashLog_isReserved(void) {
+    if (_sflash_log != 0) {
+        return (uint32_t) _sflash_log <= FLASHLOG_ADDR_A
+                && (uint32_t) _eflash_log
+                        >= FLASHLOG_ADDR_B + FLASHLOG_SECTOR_SIZE;
+    }
+    /* Another script: only safe if the whole image ends below sector 2 */
+    uint32_t image_end = (uint32_t) _sidata + (uint32_t) (_edata - _sdata);
+    return image_end <= FLASHLOG_ADDR_A;
+}
+
+/**
+ * @brief Finds the active sector and its end after a reset.
+ */
+void FlashLog_Init(void) {
+    uint32_t seq[2];
+    uint8_t valid[2];
+
+    /* Erasing a sector that holds code would brick the board */
+    log_enabled = FlashLog_isReserved();
+    if (!log_enabled) {
+        HEALTH_INC(HEALTH_FLASH_ERROR);
+        return;
+    }
+
+    for (uint8_t s = 0; s < 2; s++) {
+        valid[s] = FlashLog_readHeader(s, &seq[s]);
+        log_fill[s] = FlashLog_scanFill(s);
+    }
+    export_sectors = 0;
+
+    if (valid[0] || valid[1]) {
+        log_active = (valid[0] && (!valid[1] || seq[0] > seq[1])) ? 0 : 1;
+        log_stats.seq = seq[log_active];
+        uint8_t other = log_active ^ 1;
+        if (valid[other]) {
+            log_spare = FLASHLOG_SPARE_HISTORY;
+        } else {
+            log_spare = (log_fill[other] == 0) ? FLASHLOG_SPARE_ERASED
+                    : FLASHLOG_SPARE_DIRTY;
+        }
+        /* The first sample after a reset starts with a time base */
+        LogRecord_reset(&log_codec);
+        return;
+    }
+
+    /* Blank or corrupted: start over in sector A */
+    if (log_fill[0] != 0) {
+        FlashLog_erase(0);
+    }
+    log_spare = (log_fill[1] == 0) ? FLASHLOG_SPARE_ERASED
+            : FLASHLOG_SPARE_DIRTY;
+    FlashLog_begin(0, 0);
+}
+
+/**
+ * @brief Stores one sample.
+ */
+uint8_t FlashLog_append(const log_entry_t *entry) {
+    uint8_t slots[2 * LOG_SLOT_SIZE];
+
+    if (!log_enabled) {
+        log_stats.dropped++;
+        HEALTH_INC(HEALTH_LOG_DROP);
+        return 0;
+    }
+    uint8_t count = LogRecord_encode(&log_codec, entry, slots);
+
+    if (log_fill[log_active] + count > FLASHLOG_SLOTS) {
+        uint8_t other = log_active ^ 1;
+        if (log_spare != FLASHLOG_SPARE_ERASED
+                || !FlashLog_begin(other, log_stats.seq)) {
+            log_stats.dropped++;
+            HEALTH_INC(HEALTH_LOG_DROP);
+            return 0;
+        }
+        log_spare = FLASHLOG_SPARE_HISTORY;
+        /* A new sector opens with a time base */
+        count = LogRecord_encode(&log_codec, entry, slots);
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint16_t slot = log_fill[log_active]++;
+        if (!FlashLog_programSlot(log_active, slot, &slots[i * LOG_SLOT_SIZE])) {
+            /* The slot is left as it is and skipped by readers */
+            return 0;
+        }
+    }
+    LogRecord_commit(&log_codec, entry);
+    log_stats.appended++;
+    return 1;
+}
+
+/**
+ * @brief Returns 1 when the other sector should be erased now.
+ */
+uint8_t FlashLog_eraseDue(void) {
+    return log_enabled && log_spare != FLASHLOG_SPARE_ERASED
+            && FLASHLOG_SLOTS - log_fill[log_active] <= FLASHLOG_ERASE_AHEAD;
+}
+
+/**
+ * @brief Returns 1 when the erase can wait no longer.
+ */
+uint8_t FlashLog_eraseOverdue(void) {
+    return FlashLog_eraseDue()
+            && FLASHLOG_SLOTS - log_fill[log_active] <= FLASHLOG_ERASE_FORCE;
+}
+
+/**
+ * @brief Erases the other sector, dropping the older history.
+ */
+uint8_t FlashLog_eraseSpare(void) {
+    uint8_t other = log_active ^ 1;
+
+    if (!log_enabled) {
+        return 0;
+    }
+    /* Never pull the history from under an export */
+    for (uint8_t i = export_part; i < export_sectors; i++) {
+        if (export_order[i] == other) {
+            return 0;
+        }
+    }
+    if (!FlashLog_erase(other)) {
+        log_spare = FLASHLOG_SPARE_DIRTY;
+        return 0;
+    }
+    log_fill[other] = 0;
+    log_spare = FLASHLOG_SPARE_ERASED;
+    return 1;
+}
+
+/**
+ * @brief Starts an export of the whole history.
+ */
+void FlashLog_exportStart(void) {
+    export_sectors = 0;
+    if (!log_enabled) {
+        return;
+    }
+    if (log_spare == FLASHLOG_SPARE_HISTORY) {
+        export_order[export_sectors++] = log_active ^ 1;
+    }
+    export_order[export_sectors++] = log_active;
+    export_part = 0;
+    export_slot = 0;
+}
+
+/**
+ * @brief Offers slots to 'emit' until it refuses them or the export is
+ * complete.
+ */
+uint8_t FlashLog_exportStep(flash_log_emit_fn emit, uint8_t max) {
+    while (export_part < export_sectors) {
+        uint8_t sector = export_order[export_part];
+        /* Read live: the active sector may grow meanwhile */
+        uint16_t end = log_fill[sector];
+
+        if (export_slot >= end) {
+            export_part++;
+            export_slot = 0;
+            continue;
+        }
+        uint16_t count = end - export_slot;
+        if (count > max) {
+            count = max;
+        }
+        uint8_t taken = emit(FlashLog_slot(sector, export_slot),
+                (uint8_t) count);
+        if (taken == 0) {
+            return 1;
+        }
+        export_slot += taken;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies the log counters.
+ */
+void FlashLog_getStats(flash_log_stats_t *stats) {
+    *stats = log_stats;
+    stats->used = log_fill[log_active];
+    stats->enabled = log_enabled;
+}
@@ -0,0 +1,155 @@
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+#include "stm32f4xx.h"
+#include "log_record.h"
+#include <stdint.h>
+
+/*
+ * Moisture and pump history in two 16 KB flash sectors used in turn.
+ * Samples are appended as log_record.h slots to the active sector; when it
+ * is full, logging moves to the other sector, which must have been erased
+ * beforehand, and the full one becomes the older half of the history.
+ *
+ * The STM32F401 has a single flash bank: every instruction fetch stalls
+ * while a sector is being erased (about 250 ms for 16 KB). The erase is
+ * therefore never part of an append. It becomes due FLASHLOG_ERASE_AHEAD
+ * slots before the active sector fills, and the main loop runs it with
+ * FlashLog_eraseSpare at a quiet moment, right after a control pass.
+ * A host that streams or talks without pause would starve that wait and,
+ * once the active sector filled, every sample would be dropped; so at
+ * FLASHLOG_ERASE_FORCE free slots the erase is overdue and runs anyway,
+ * at the cost of one stall of the link.
+ * The erase itself runs from RAM with a vector table in RAM: SysTick
+ * periods are counted and replayed afterwards, interrupts registered with
+ * FlashLog_registerStallHandler keep running from RAM, and every other
+ * interrupt is held back until the erase is over.
+ *
+ * Sectors 2 and 3 exist with the same size on every STM32F401 variant.
+ * The linker script must keep code out of them: STM32F401CCUX_FLASH.ld
+ * keeps the vector table in sectors 0-1 (0x08000000-0x08007FFF), starts
+ * the rest of the image at sector 4 (0x08010000) and marks the reserved
+ * range with _sflash_log/_eflash_log. FlashLog_Init checks those symbols,
+ * or with another script that the whole image ends below sector 2, and
+ * otherwise leaves the flash alone: every sample is then dropped.
+ */
+
+#define FLASHLOG_SECTOR_A       2
+#define FLASHLOG_SECTOR_B       3
+#define FLASHLOG_ADDR_A         0x08008000U
+#define FLASHLOG_ADDR_B         0x0800C000U
+#define FLASHLOG_SECTOR_SIZE    0x4000U
+#define FLASHLOG_SLOTS          (FLASHLOG_SECTOR_SIZE / LOG_SLOT_SIZE)
+
+/* Free slots left in the active sector when erasing the other one
+ * becomes due. The older history is kept until then. */
+#define FLASHLOG_ERASE_AHEAD    256
+
+/* Free slots left when the erase becomes overdue and must run whatever the
+ * link is doing: a few samples' worth, changes written as two slots */
+#define FLASHLOG_ERASE_FORCE    32
+
+/* Code that runs during an erase. It lives in RAM (copied with .data) and
+ * must neither call flash code nor read constants from flash. */
+#define FLASHLOG_RAMFUNC        __attribute__((section(".RamFunc"), noinline))
+
+/* Vector table entries: 16 system exceptions and the STM32F401 IRQs */
+#define FLASHLOG_VECTORS        (16 + SPI4_IRQn + 1)
+
+/* Interrupts FlashLog_registerStallHandler can keep running */
+#define FLASHLOG_MAX_STALL_HANDLERS 2
+
+/**
+ * @brief Interrupt handler run during an erase.
+ */
+typedef void (*flash_log_isr_fn)(void);
+
+/**
+ * @brief Receives slots of the export, oldest first.
+ * @param slots 'count' consecutive LOG_SLOT_SIZE-byte slots, in flash
+ * @return Number of slots taken, 0 to have them offered again later
+ */
+typedef uint8_t (*flash_log_emit_fn)(const uint8_t *slots, uint8_t count);
+
+/**
+ * @brief Log counters.
+ */
+typedef struct {
+    uint32_t appended;          /* Samples stored */
+    uint32_t dropped;           /* Samples lost: active full, other not erased */
+    uint32_t program_errors;    /* Slots that failed to program, skipped */
+    uint32_t erases;            /* Sectors erased */
+    uint32_t erase_last_ms;     /* Duration of the last erase */
+    uint32_t erase_max_ms;      /* Longest erase */
+    uint16_t used;              /* Slots written in the active sector */
+    uint32_t seq;               /* Sequence number of the active sector */
+    uint8_t enabled;            /* 0: sectors not reserved, logging off */
+} flash_log_stats_t;
+
+/**
+ * @brief Keeps an interrupt running, from RAM, while a sector is erased.
+ * Its regular handler is pended once after the erase to catch up.
+ * @param irq Interrupt to keep running
+ * @param handler Stand-in for the regular handler, FLASHLOG_RAMFUNC
+ * @return 1 on success, 0 if all FLASHLOG_MAX_STALL_HANDLERS slots are used
+ * @note Call before FlashLog_Init, which may erase at boot.
+ */
+uint8_t FlashLog_registerStallHandler(IRQn_Type irq, flash_log_isr_fn handler);
+
+/**
+ * @brief Finds the active sector and its end after a reset.
+ * A slot torn by a reset is skipped. If neither sector holds a valid
+ * header, sector A is erased (blocking) and started. Nothing is erased or
+ * written if the image may overlap the log sectors.
+ * @note Delay_Init must have been called; interrupts must be enabled.
+ */
+void FlashLog_Init(void);
+
+/**
+ * @brief Stores one sample; programs one or two slots, about 40 us each.
+ * @return 1 if stored, 0 if dropped or the flash reported an error
+ * @note Thread context only.
+ */
+uint8_t FlashLog_append(const log_entry_t *entry);
+
+/**
+ * @brief Returns 1 when the other sector should be erased now, so it is
+ * ready before the active sector fills.
+ */
+uint8_t FlashLog_eraseDue(void);
+
+/**
+ * @brief Returns 1 when the erase is due and only FLASHLOG_ERASE_FORCE
+ * slots or fewer are left: it must run now, quiet moment or not.
+ */
+uint8_t FlashLog_eraseOverdue(void);
+
+/**
+ * @brief Erases the other sector, dropping the older history.
+ * Blocks for the whole erase. Only the registered stall handlers run
+ * meanwhile; SysTick periods and held-back interrupts are caught up
+ * afterwards.
+ * @return 1 on success, 0 on a flash error or while an export reads it
+ * @note Thread context, interrupts enabled.
+ */
+uint8_t FlashLog_eraseSpare(void);
+
+/**
+ * @brief Starts an export of the whole history.
+ */
+void FlashLog_exportStart(void);
+
+/**
+ * @brief Offers slots to 'emit' until it refuses them or the export is
+ * complete. Samples appended during the export are included.
+ * @param max Largest run of slots passed at once
+ * @return 1 while slots remain, 0 once the export is complete
+ */
+uint8_t FlashLog_exportStep(flash_log_emit_fn emit, uint8_t max);
+
+/**
+ * @brief Copies the log counters.
+ */
+void FlashLog_getStats(flash_log_stats_t *stats);
+
+#endif /* FLASH_LOG_H_ */
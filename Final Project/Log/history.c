@@ -0,0 +1,106 @@
+#include "history.h"
+#include <string.h>
+
+#define HISTORY_MASK            (HISTORY_BLOCKS - 1)
+
+static uint8_t history_blocks[HISTORY_BLOCKS][HISTORY_BLOCK_SIZE];
+static uint16_t history_lengths[HISTORY_BLOCKS];
+static ts_encoder_t history_enc;
+/* Sequence number of the open block; finished ones precede it */
+static uint32_t history_open_seq = 0;
+static uint32_t history_finished = 0;   /* Finished blocks kept, < HISTORY_BLOCKS */
+static history_stats_t history_stats;
+
+/* Export cursor: the sequence number of the next block to offer */
+static uint32_t export_seq = 0;
+static uint8_t export_active = 0;
+
+/**
+ * @brief Empties the history.
+ */
+void History_Init(void) {
+    history_open_seq = 0;
+    history_finished = 0;
+    export_active = 0;
+    memset(&history_stats, 0, sizeof(history_stats));
+    TsCodec_encoderInit(&history_enc, history_blocks[0], HISTORY_BLOCK_SIZE);
+}
+
+/**
+ * @brief Finishes the open block and reopens the oldest one.
+ */
+static void History_nextBlock(void) {
+    history_lengths[history_open_seq & HISTORY_MASK] =
+            TsCodec_finish(&history_enc);
+    history_stats.blocks++;
+    history_open_seq++;
+    if (history_finished < HISTORY_BLOCKS - 1) {
+        history_finished++;
+    } else {
+        history_stats.overwritten++;
+    }
+    TsCodec_encoderInit(&history_enc,
+            history_blocks[history_open_seq & HISTORY_MASK],
+            HISTORY_BLOCK_SIZE);
+}
+
+/**
+ * @brief Appends a record, moving to the next block when needed.
+ */
+void History_append(const ts_record_t *record) {
+    if (!TsCodec_append(&history_enc, record)) {
+        History_nextBlock();
+        /* Always fits an empty block */
+        TsCodec_append(&history_enc, record);
+    }
+    history_stats.records++;
+}
+
+/**
+ * @brief Starts an export at the oldest finished block.
+ */
+void History_exportStart(void) {
+    export_seq = history_open_seq - history_finished;
+    export_active = 1;
+}
+
+/**
+ * @brief Offers blocks until 'emit' refuses one or none are left.
+ */
+uint8_t History_exportStep(history_emit_fn emit) {
+    while (export_active) {
+        uint32_t oldest = history_open_seq - history_finished;
+
+        if ((int32_t) (export_seq - oldest) < 0) {
+            /* Reused meanwhile */
+            export_seq = oldest;
+        }
+        if (export_seq != history_open_seq) {
+            uint32_t index = export_seq & HISTORY_MASK;
+            if (!emit(history_blocks[index], history_lengths[index])) {
+                return 1;
+            }
+            export_seq++;
+            continue;
+        }
+        /* The open block, finished on a copy so appends carry on */
+        if (history_enc.count > 0) {
+            uint8_t block[HISTORY_BLOCK_SIZE];
+            ts_encoder_t enc = history_enc;
+            memcpy(block, history_enc.block, HISTORY_BLOCK_SIZE);
+            enc.block = block;
+            if (!emit(block, TsCodec_finish(&enc))) {
+                return 1;
+            }
+        }
+        export_active = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies the history counters.
+ */
+void History_getStats(history_stats_t *stats) {
+    *stats = history_stats;
+}
@@ -0,0 +1,76 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ts_codec.h"
+#include <stdint.h>
+
+/*
+ * Minute-by-minute moisture and pump history in RAM, compressed with
+ * ts_codec into a ring of HISTORY_BLOCK_SIZE-byte blocks. The flash log
+ * keeps a sample per FLASH_LOG_PERIOD_S or per change across resets; this
+ * keeps every minute of the last day or so, and is lost on reset.
+ *
+ * Records go to the open block until it is full; it is then finished and
+ * the next block, the oldest of the ring, is reopened. tests/bench_ts_codec
+ * measures 0.44 to 2.2 bytes per record in 32-byte blocks, so the 2 KB
+ * ring holds from about 16 hours (noisy readings) to 3 days (steady).
+ *
+ * Portable C, built on the host by the tests. Thread context only.
+ */
+
+#define HISTORY_BLOCK_SIZE      32      /* Also one PROTO_MSG_HISTORY payload */
+#define HISTORY_BLOCKS          64      /* Must be a power of two */
+
+/**
+ * @brief Takes one finished block during an export.
+ * @return 1 if taken, 0 to have it offered again later
+ */
+typedef uint8_t (*history_emit_fn)(const uint8_t *block, uint16_t length);
+
+/**
+ * @brief History counters.
+ */
+typedef struct {
+    uint32_t records;           /* Records appended */
+    uint32_t blocks;            /* Blocks finished */
+    uint32_t overwritten;       /* Finished blocks reused for newer records */
+} history_stats_t;
+
+/**
+ * @brief Empties the history.
+ */
+void History_Init(void);
+
+/**
+ * @brief Appends a record, reusing the oldest block when the open one is
+ * full.
+ */
+void History_append(const ts_record_t *record);
+
+/**
+ * @brief Starts an export of the whole history, oldest block first.
+ */
+void History_exportStart(void);
+
+/**
+ * @brief Offers finished blocks to 'emit' until it refuses one or the
+ * export is complete. The open block is offered last, finished on a copy.
+ * Blocks overwritten during the export are skipped.
+ * @return 1 while blocks remain, 0 once the export is complete
+ */
+uint8_t History_exportStep(history_emit_fn emit);
+
+/**
+ * @brief Copies the history counters.
+ */
+void History_getStats(history_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HISTORY_H_ */
@@ -0,0 +1,125 @@
+#include "log_record.h"
+#include "labview_proto.h"
+
+/**
+ * @brief Fills a slot around its type and payload.
+ */
+static void LogRecord_pack(uint8_t *slot, uint8_t type, uint32_t payload) {
+    slot[0] = LOG_COMMIT;
+    slot[1] = type;
+    slot[2] = (uint8_t) payload;
+    slot[3] = (uint8_t) (payload >> 8);
+    slot[4] = (uint8_t) (payload >> 16);
+    slot[5] = (uint8_t) (payload >> 24);
+    uint16_t crc = Proto_crc16(0xFFFF, &slot[1], 5);
+    slot[6] = (uint8_t) crc;
+    slot[7] = (uint8_t) (crc >> 8);
+}
+
+/**
+ * @brief Forgets the delta state.
+ */
+void LogRecord_reset(log_codec_t *c) {
+    c->last_time = 0;
+    c->has_base = 0;
+}
+
+/**
+ * @brief Builds a sector header slot.
+ */
+void LogRecord_header(uint32_t seq, uint8_t *slot) {
+    LogRecord_pack(slot, LOG_TYPE_HEADER, seq);
+}
+
+/**
+ * @brief Encodes a sample, preceded by a BASE slot when needed.
+ * A clock set backwards also forces a BASE, as deltas are unsigned.
+ */
+uint8_t LogRecord_encode(const log_codec_t *c, const log_entry_t *entry,
+        uint8_t *slots) {
+    uint8_t count = 0;
+    uint32_t delta = 0;
+
+    if (!c->has_base || entry->time < c->last_time
+            || entry->time - c->last_time > UINT16_MAX) {
+        LogRecord_pack(slots, LOG_TYPE_BASE, entry->time);
+        slots += LOG_SLOT_SIZE;
+        count++;
+    } else {
+        delta = entry->time - c->last_time;
+    }
+
+    uint8_t type = LOG_TYPE_SAMPLE;
+    if (entry->pump) {
+        type |= LOG_FLAG_PUMP;
+    }
+    if (entry->mode) {
+        type |= LOG_FLAG_MODE;
+    }
+    LogRecord_pack(slots, type,
+            delta | ((uint32_t) (entry->moisture_raw & 0x0FFF) << 16));
+    return count + 1;
+}
+
+/**
+ * @brief Advances the encoder past a stored sample.
+ */
+void LogRecord_commit(log_codec_t *c, const log_entry_t *entry) {
+    c->last_time = entry->time;
+    c->has_base = 1;
+}
+
+/**
+ * @brief Checks and decodes one slot.
+ */
+log_slot_t LogRecord_decode(log_codec_t *c, const uint8_t *slot,
+        uint32_t *seq, log_entry_t *entry) {
+    uint8_t erased = 1;
+
+    for (uint8_t i = 0; i < LOG_SLOT_SIZE; i++) {
+        if (slot[i] != LOG_ERASED) {
+            erased = 0;
+            break;
+        }
+    }
+    if (erased) {
+        return LOG_SLOT_EMPTY;
+    }
+
+    uint16_t crc = (uint16_t) (slot[6] | (slot[7] << 8));
+    if (slot[0] != LOG_COMMIT || Proto_crc16(0xFFFF, &slot[1], 5) != crc) {
+        return LOG_SLOT_INVALID;
+    }
+
+    uint32_t payload = (uint32_t) slot[2] | ((uint32_t) slot[3] << 8)
+            | ((uint32_t) slot[4] << 16) | ((uint32_t) slot[5] << 24);
+
+    switch (slot[1] & LOG_TYPE_MASK) {
+    case LOG_TYPE_HEADER:
+        /* Deltas never continue across sectors */
+        LogRecord_reset(c);
+        if (seq) {
+            *seq = payload;
+        }
+        return LOG_SLOT_HEADER;
+    case LOG_TYPE_BASE:
+        c->last_time = payload;
+        c->has_base = 1;
+        return LOG_SLOT_BASE;
+    case LOG_TYPE_SAMPLE:
+        if (!c->has_base) {
+            /* The BASE was lost with an older sector */
+            return LOG_SLOT_INVALID;
+        }
+        c->last_time += payload & 0xFFFF;
+        if (entry) {
+            entry->time = c->last_time;
+            entry->moisture_raw = (uint16_t) ((payload >> 16) & 0x0FFF);
+            entry->pump = (slot[1] & LOG_FLAG_PUMP) ? 1 : 0;
+            entry->mode = (slot[1] & LOG_FLAG_MODE) ? 1 : 0;
+        }
+        return LOG_SLOT_ENTRY;
+    default:
+        return LOG_SLOT_INVALID;
+    }
+}
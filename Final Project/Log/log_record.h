@@ -0,0 +1,111 @@
+#ifndef LOG_RECORD_H_
+#define LOG_RECORD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Record format of the flash log, shared by the firmware and host decoders.
+ *
+ * The log is a sequence of 8-byte slots:
+ *
+ *     commit | type | payload[4] | crc16_lo | crc16_hi
+ *
+ * The CRC is CRC-16/CCITT-FALSE (Proto_crc16) over type and payload. The
+ * firmware programs the second half (payload[2..3] and the CRC) first and
+ * the half holding the commit byte last, so a slot cut short by a reset is
+ * either still erased (0xFF), or lacks the commit byte, or fails its CRC.
+ *
+ * type bits 1-0 select the record, bits 3-2 carry the pump and mode of a
+ * sample:
+ *     HEADER  payload = sector sequence number (u32), first slot of a sector
+ *     BASE    payload = absolute time in seconds since 2000-01-01 (u32)
+ *     SAMPLE  payload = seconds since the previous record (u16), then the
+ *             raw moisture reading (u16, 12 bits used)
+ * A BASE precedes the first sample after boot or a sector change, and any
+ * sample more than 65535 s after the previous one. All fields are
+ * little-endian. tools/log_dump prints the samples of a captured export.
+ */
+
+#define LOG_SLOT_SIZE           8
+#define LOG_COMMIT              0x5A    /* Commit byte of a complete slot */
+#define LOG_ERASED              0xFF
+
+#define LOG_TYPE_MASK           0x03
+#define LOG_TYPE_HEADER         0x00
+#define LOG_TYPE_BASE           0x01
+#define LOG_TYPE_SAMPLE         0x02
+#define LOG_FLAG_PUMP           0x04
+#define LOG_FLAG_MODE           0x08    /* 0 = AUTO, 1 = MANUAL */
+
+/**
+ * @brief One logged sample.
+ */
+typedef struct {
+    uint32_t time;              /* Seconds since 2000-01-01 */
+    uint16_t moisture_raw;      /* Averaged ADC reading */
+    uint8_t pump;               /* 0 = OFF, 1 = ON */
+    uint8_t mode;               /* 0 = AUTO, 1 = MANUAL */
+} log_entry_t;
+
+/**
+ * @brief Delta state of an encoder or a decoder.
+ */
+typedef struct {
+    uint32_t last_time;         /* Time of the previous record */
+    uint8_t has_base;           /* last_time is valid */
+} log_codec_t;
+
+/**
+ * @brief What a slot holds.
+ */
+typedef enum {
+    LOG_SLOT_EMPTY = 0,         /* Erased, end of the written area */
+    LOG_SLOT_INVALID,           /* Torn write or CRC mismatch, skipped */
+    LOG_SLOT_HEADER,            /* Sector header, *seq is set */
+    LOG_SLOT_BASE,              /* Time base, absorbed by the codec */
+    LOG_SLOT_ENTRY              /* Sample, *entry is set */
+} log_slot_t;
+
+/**
+ * @brief Forgets the delta state, so the next record is a BASE.
+ */
+void LogRecord_reset(log_codec_t *c);
+
+/**
+ * @brief Builds a sector header slot.
+ */
+void LogRecord_header(uint32_t seq, uint8_t *slot);
+
+/**
+ * @brief Encodes a sample, preceded by a BASE slot when needed.
+ * @param slots Receives 1 or 2 slots, room for 2 * LOG_SLOT_SIZE bytes
+ * @return Number of slots written
+ * @note The codec state only advances with LogRecord_commit, once the
+ * slots are stored.
+ */
+uint8_t LogRecord_encode(const log_codec_t *c, const log_entry_t *entry,
+        uint8_t *slots);
+
+/**
+ * @brief Advances the encoder past a stored sample.
+ */
+void LogRecord_commit(log_codec_t *c, const log_entry_t *entry);
+
+/**
+ * @brief Checks and decodes one slot.
+ * @param seq Receives the sequence number of a HEADER; may be 0
+ * @param entry Receives the sample of an ENTRY; may be 0
+ * @note Host decoders call it for every slot of a dump, oldest first.
+ */
+log_slot_t LogRecord_decode(log_codec_t *c, const uint8_t *slot,
+        uint32_t *seq, log_entry_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_RECORD_H_ */
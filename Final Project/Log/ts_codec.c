@@ -0,0 +1,249 @@
+#include "ts_codec.h"
+
+#define TS_CODE_SHORT           0x00
+#define TS_CODE_RUN             0x80
+#define TS_CODE_LONG            0xC0
+#define TS_CODE_TOGGLE          0x40    /* Short codes */
+#define TS_CODE_LONG_TOGGLE     0x20
+#define TS_RUN_MAX              64
+#define TS_PUMP_BIT             0x8000
+
+/**
+ * @brief Maps a signed value to an unsigned one, small magnitudes first.
+ */
+static uint32_t TsCodec_zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+/**
+ * @brief Inverse of TsCodec_zigzag.
+ */
+static int32_t TsCodec_unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+/**
+ * @brief Writes a LEB128 varint.
+ * @return Bytes written
+ */
+static uint8_t TsCodec_putVarint(uint8_t *dst, uint32_t value) {
+    uint8_t n = 0;
+
+    while (value >= 0x80) {
+        dst[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    dst[n++] = (uint8_t) value;
+    return n;
+}
+
+/**
+ * @brief Reads a LEB128 varint of at most 'max_bytes' bytes.
+ * @return 1 on success, 0 if it runs past the block or is too long
+ */
+static uint8_t TsCodec_getVarint(ts_decoder_t *dec, uint8_t max_bytes,
+        uint32_t *value) {
+    uint32_t result = 0;
+
+    for (uint8_t i = 0; i < max_bytes && dec->pos < dec->length; i++) {
+        uint8_t byte = dec->block[dec->pos++];
+        result |= (uint32_t) (byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the pending run code, if any.
+ */
+static void TsCodec_flushRun(ts_encoder_t *enc) {
+    if (enc->run > 0) {
+        enc->block[enc->length++] = TS_CODE_RUN | (enc->run - 1);
+        enc->run = 0;
+    }
+}
+
+/**
+ * @brief Starts a block in 'block'.
+ */
+void TsCodec_encoderInit(ts_encoder_t *enc, uint8_t *block, uint16_t size) {
+    enc->block = block;
+    enc->size = size;
+    enc->length = 0;
+    enc->count = 0;
+    enc->run = 0;
+    enc->last_delta = 0;
+}
+
+/**
+ * @brief Appends a record to the block.
+ * The space check keeps room for the code of a pending run, so
+ * TsCodec_finish never overflows.
+ */
+uint8_t TsCodec_append(ts_encoder_t *enc, const ts_record_t *record) {
+    uint16_t raw = record->moisture_raw & TS_RAW_MASK;
+    uint8_t pump = record->pump ? 1 : 0;
+
+    /* Run codes could otherwise overflow the header's record count */
+    if (enc->count == TS_BLOCK_RECORDS_MAX) {
+        return 0;
+    }
+    if (enc->count == 0) {
+        if (enc->size < TS_BLOCK_HEADER) {
+            return 0;
+        }
+        uint16_t first = raw | (pump ? TS_PUMP_BIT : 0);
+        enc->block[2] = (uint8_t) record->time;
+        enc->block[3] = (uint8_t) (record->time >> 8);
+        enc->block[4] = (uint8_t) (record->time >> 16);
+        enc->block[5] = (uint8_t) (record->time >> 24);
+        enc->block[6] = (uint8_t) first;
+        enc->block[7] = (uint8_t) (first >> 8);
+        enc->length = TS_BLOCK_HEADER;
+    } else {
+        uint32_t delta = record->time - enc->last.time;
+        int32_t dod = (int32_t) (delta - enc->last_delta);
+        int32_t dm = (int32_t) raw - (int32_t) enc->last.moisture_raw;
+        uint8_t toggle = pump != enc->last.pump;
+        uint16_t reserved = enc->run ? 1 : 0;
+
+        if (dod <= -TS_DOD_LIMIT || dod >= TS_DOD_LIMIT) {
+            return 0;
+        }
+
+        if (dod == 0 && dm == 0 && !toggle) {
+            /* Repeats only ever grow the run; a full run is written out */
+            uint16_t need = (enc->run == 0 || enc->run == TS_RUN_MAX) ? 1 : 0;
+            if (enc->length + reserved + need > enc->size) {
+                return 0;
+            }
+            if (enc->run == TS_RUN_MAX) {
+                TsCodec_flushRun(enc);
+            }
+            enc->run++;
+        } else {
+            uint8_t code[TS_RECORD_MAX];
+            uint8_t n;
+            if (dod == 0 && dm >= -32 && dm <= 31) {
+                code[0] = TS_CODE_SHORT | (toggle ? TS_CODE_TOGGLE : 0)
+                        | (uint8_t) TsCodec_zigzag(dm);
+                n = 1;
+            } else {
+                code[0] = TS_CODE_LONG | (toggle ? TS_CODE_LONG_TOGGLE : 0);
+                n = 1 + TsCodec_putVarint(&code[1], TsCodec_zigzag(dod));
+                n += TsCodec_putVarint(&code[n], TsCodec_zigzag(dm));
+            }
+            if (enc->length + reserved + n > enc->size) {
+                return 0;
+            }
+            TsCodec_flushRun(enc);
+            for (uint8_t i = 0; i < n; i++) {
+                enc->block[enc->length++] = code[i];
+            }
+        }
+        enc->last_delta = delta;
+    }
+
+    enc->last.time = record->time;
+    enc->last.moisture_raw = raw;
+    enc->last.pump = pump;
+    enc->count++;
+    return 1;
+}
+
+/**
+ * @brief Writes the pending run and the record count.
+ */
+uint16_t TsCodec_finish(ts_encoder_t *enc) {
+    if (enc->count == 0) {
+        return 0;
+    }
+    TsCodec_flushRun(enc);
+    enc->block[0] = (uint8_t) enc->count;
+    enc->block[1] = (uint8_t) (enc->count >> 8);
+    return enc->length;
+}
+
+/**
+ * @brief Starts reading a finished block.
+ */
+void TsCodec_decoderInit(ts_decoder_t *dec, const uint8_t *block,
+        uint16_t length) {
+    dec->block = block;
+    dec->length = length;
+    dec->pos = 0;
+    dec->remaining = 0;
+    dec->run = 0;
+    dec->last_delta = 0;
+    if (length >= TS_BLOCK_HEADER) {
+        dec->remaining = (uint16_t) (block[0] | (block[1] << 8));
+    }
+}
+
+/**
+ * @brief Decodes the next record.
+ */
+uint8_t TsCodec_next(ts_decoder_t *dec, ts_record_t *record) {
+    if (dec->remaining == 0) {
+        return 0;
+    }
+
+    if (dec->pos == 0) {
+        const uint8_t *b = dec->block;
+        uint16_t first = (uint16_t) (b[6] | (b[7] << 8));
+        dec->last.time = (uint32_t) b[2] | ((uint32_t) b[3] << 8)
+                | ((uint32_t) b[4] << 16) | ((uint32_t) b[5] << 24);
+        dec->last.moisture_raw = first & TS_RAW_MASK;
+        dec->last.pump = (first & TS_PUMP_BIT) ? 1 : 0;
+        dec->pos = TS_BLOCK_HEADER;
+    } else if (dec->run > 0) {
+        dec->run--;
+        dec->last.time += dec->last_delta;
+    } else {
+        if (dec->pos >= dec->length) {
+            dec->remaining = 0;
+            return 0;
+        }
+        uint8_t code = dec->block[dec->pos++];
+        int32_t dod = 0;
+        int32_t dm = 0;
+        uint8_t toggle = 0;
+
+        if ((code & 0x80) == TS_CODE_SHORT) {
+            toggle = (code & TS_CODE_TOGGLE) ? 1 : 0;
+            dm = TsCodec_unzigzag(code & 0x3F);
+        } else if ((code & 0xC0) == TS_CODE_RUN) {
+            /* This record is the first of the run */
+            dec->run = code & 0x3F;
+        } else {
+            uint32_t value;
+            if (code & ~(TS_CODE_LONG | TS_CODE_LONG_TOGGLE)) {
+                dec->remaining = 0;
+                return 0;
+            }
+            toggle = (code & TS_CODE_LONG_TOGGLE) ? 1 : 0;
+            if (!TsCodec_getVarint(dec, 3, &value)) {
+                dec->remaining = 0;
+                return 0;
+            }
+            dod = TsCodec_unzigzag(value);
+            if (!TsCodec_getVarint(dec, 2, &value)) {
+                dec->remaining = 0;
+                return 0;
+            }
+            dm = TsCodec_unzigzag(value);
+        }
+        dec->last_delta += (uint32_t) dod;
+        dec->last.time += dec->last_delta;
+        dec->last.moisture_raw = (uint16_t) (dec->last.moisture_raw + dm)
+                & TS_RAW_MASK;
+        dec->last.pump ^= toggle;
+    }
+
+    dec->remaining--;
+    *record = dec->last;
+    return 1;
+}
@@ -0,0 +1,127 @@
+#ifndef TS_CODEC_H_
+#define TS_CODEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Compact block format for moisture and pump history, shared by the
+ * firmware and host decoders. Encoder and decoder keep all their state in
+ * the caller's structures and never allocate.
+ *
+ * A block starts with an 8-byte header holding the record count (u16),
+ * the first record's time (u32, seconds) and its raw reading with the pump
+ * state in bit 15 (u16), all little-endian. Each further record is coded
+ * against the previous one: time as a delta-of-delta (0 for a fixed
+ * sampling period), moisture as a delta, the pump as a change flag.
+ * Codes, by their first byte:
+ *
+ *     0TMMMMMM  delta-of-delta 0, pump toggled if T, moisture delta
+ *               zigzag(M), -32..31
+ *     10NNNNNN  N + 1 records with delta-of-delta 0, moisture delta 0 and
+ *               no pump change
+ *     11T00000  pump toggled if T, then varint(zigzag(delta-of-delta)) and
+ *               varint(zigzag(moisture delta))
+ *
+ * Varints are LEB128 (7 bits per byte, least significant first). A record
+ * takes at most TS_RECORD_MAX bytes, so a block of 'size' bytes is sure to
+ * hold 1 + (size - TS_BLOCK_HEADER) / TS_RECORD_MAX records; with
+ * 1-minute samples a steady trace costs about one byte per record.
+ *
+ * Storage is left to the caller: a block is written once it is finished,
+ * with whatever integrity check the medium needs.
+ *
+ * Log/history.c keeps the minute history in RAM in 32-byte blocks of
+ * this format, and tools/log_dump decodes them from a "HIST" export. The
+ * flash log keeps its 8-byte slots (log_record.h), which survive a reset
+ * one sample at a time; a block only survives once it is written whole.
+ * tests/bench_ts_codec measures 0.44 to 2.2 bytes per record in 32-byte
+ * blocks, depending on ADC noise and sampling jitter: a 4 KB store such
+ * as the AT24C32 would hold 1 to 6 days of 1-minute history, not weeks.
+ */
+
+#define TS_BLOCK_HEADER         8
+#define TS_RECORD_MAX           6       /* Code, 3-byte varint, 2-byte varint */
+#define TS_DOD_LIMIT            (1L << 20) /* |delta-of-delta| in seconds */
+#define TS_RAW_MASK             0x0FFF  /* 12-bit ADC reading */
+#define TS_BLOCK_RECORDS_MAX    UINT16_MAX /* Header count field */
+
+/**
+ * @brief One history record.
+ */
+typedef struct {
+    uint32_t time;              /* Seconds, e.g. DS3231_toSeconds */
+    uint16_t moisture_raw;      /* Averaged ADC reading, 12 bits */
+    uint8_t pump;               /* 0 = OFF, 1 = ON */
+} ts_record_t;
+
+/**
+ * @brief Encoder state for one block.
+ */
+typedef struct {
+    uint8_t *block;
+    uint16_t size;
+    uint16_t length;            /* Bytes used, without a pending run */
+    uint16_t count;             /* Records appended */
+    uint8_t run;                /* Repeats not yet written, 0-64 */
+    ts_record_t last;
+    uint32_t last_delta;
+} ts_encoder_t;
+
+/**
+ * @brief Decoder state for one block.
+ */
+typedef struct {
+    const uint8_t *block;
+    uint16_t length;
+    uint16_t pos;
+    uint16_t remaining;         /* Records left, from the header */
+    uint8_t run;                /* Repeats left from a run code */
+    ts_record_t last;
+    uint32_t last_delta;
+} ts_decoder_t;
+
+/**
+ * @brief Starts a block in 'block'.
+ * @param size Block size in bytes, at least TS_BLOCK_HEADER + TS_RECORD_MAX
+ */
+void TsCodec_encoderInit(ts_encoder_t *enc, uint8_t *block, uint16_t size);
+
+/**
+ * @brief Appends a record to the block.
+ * @return 1 if appended. 0 if the block is full (in bytes, or at
+ * TS_BLOCK_RECORDS_MAX records), or if the time step changed by
+ * TS_DOD_LIMIT or more: finish the block and append the record to a new
+ * one, where it always fits.
+ */
+uint8_t TsCodec_append(ts_encoder_t *enc, const ts_record_t *record);
+
+/**
+ * @brief Writes the pending run and the record count.
+ * @return Bytes used in the block, 0 if it holds no record
+ */
+uint16_t TsCodec_finish(ts_encoder_t *enc);
+
+/**
+ * @brief Starts reading a finished block.
+ * @param length Bytes used, as returned by TsCodec_finish; trailing bytes
+ * (e.g. erased flash) are ignored
+ */
+void TsCodec_decoderInit(ts_decoder_t *dec, const uint8_t *block,
+        uint16_t length);
+
+/**
+ * @brief Decodes the next record.
+ * @return 1 with *record filled, 0 at the end of the block or on a
+ * malformed code
+ */
+uint8_t TsCodec_next(ts_decoder_t *dec, ts_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TS_CODEC_H_ */
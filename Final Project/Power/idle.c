@@ -0,0 +1,184 @@
+#include "idle.h"
+#include "delay.h"
+#include "soft_timer.h"
+#include "button.h"
+
+static idle_stats_t idle_stats;
+static uint32_t sleep_rest_cycles = 0;    /* Part of a microsecond not yet counted */
+static uint64_t window_us = 0;            /* time_now_us at the last report */
+static uint64_t window_sleep_us = 0;      /* sleep_us at the last report */
+
+/**
+ * @brief Ticks until the firmware next needs a SysTick interrupt.
+ */
+static uint32_t Idle_nextDeadline(void) {
+    if (Button_isScanning()) {
+        return 1;
+    }
+    return SoftTimer_ticksToNext();
+}
+
+/**
+ * @brief Sleeps until the next interrupt, normally the next tick.
+ * @return Cycles spent asleep, measured with SysTick
+ */
+static uint32_t Idle_wfi(void) {
+    uint32_t period = SysTick->LOAD + 1;
+
+    (void) SysTick->CTRL;   /* Clears COUNTFLAG */
+    uint32_t before = SysTick->VAL;
+    __DSB();
+    __WFI();
+    __ISB();
+    uint32_t wrapped = SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk;
+    uint32_t after = SysTick->VAL;
+
+    return wrapped ? before + (period - after) : before - after;
+}
+
+#if IDLE_TICKLESS
+/**
+ * @brief Stretches the SysTick period to 'ticks' ticks and sleeps.
+ * On wake, SysTick is set to end the current tick on its normal boundary.
+ * @param completed Receives the whole ticks that passed without an interrupt
+ * @return Cycles spent asleep, or 0 if a tick was already pending
+ */
+static uint32_t Idle_tickless(uint32_t ticks, uint32_t *completed) {
+    uint32_t period = SysTick->LOAD + 1;
+    uint32_t max_ticks = SysTick_LOAD_RELOAD_Msk / period;
+
+    if (ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+    *completed = 0;
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+        /* The tick fired while stopping: let it run first */
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        return 0;
+    }
+
+    uint32_t reload = SysTick->VAL + period * (ticks - 1);
+    if (reload > IDLE_SYSTICK_STOPPED_CYCLES) {
+        reload -= IDLE_SYSTICK_STOPPED_CYCLES;
+    }
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    uint32_t ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t slept;
+
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        /* Slept to the deadline; its SysTick interrupt is pending and will
+         * count the last tick. Finish the tick that has started since. */
+        uint32_t since = reload - SysTick->VAL;
+        uint32_t remaining = (period - 1) - since;
+        if (since >= period - 1 || remaining < IDLE_SYSTICK_STOPPED_CYCLES) {
+            remaining = period - 1;
+        }
+        SysTick->LOAD = remaining;
+        *completed = ticks - 1;
+        slept = reload + since;
+    } else {
+        /* Woken early by another interrupt. Count from the last tick
+         * boundary, which was (period - start value) before the sleep. */
+        uint32_t value = SysTick->VAL;
+        uint32_t decrements = ticks * period - value;
+        *completed = decrements / period;
+        SysTick->LOAD = (*completed + 1) * period - decrements;
+        slept = reload - value;
+    }
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    /* Takes effect at the next reload */
+    SysTick->LOAD = period - 1;
+    return slept;
+}
+#endif
+
+/**
+ * @brief Sleeps until the next deadline or interrupt unless work is ready.
+ */
+void Idle_sleep(idle_ready_fn ready) {
+    __disable_irq();
+    if (ready && ready()) {
+        idle_stats.aborted++;
+        __enable_irq();
+        return;
+    }
+
+    uint32_t ticks = Idle_nextDeadline();
+    uint32_t completed = 0;
+    uint32_t cycles_before = DWT->CYCCNT;
+    uint32_t slept;
+
+#if IDLE_TICKLESS
+    if (ticks > 1) {
+        slept = Idle_tickless(ticks, &completed);
+        idle_stats.tickless_sleeps++;
+        idle_stats.ticks_suppressed += completed;
+    } else
+#endif
+    {
+        slept = Idle_wfi();
+    }
+
+    /* DWT->CYCCNT may stop while the core sleeps; hand the difference to
+     * the timebase so that time_now_us() stays continuous */
+    uint32_t counted = DWT->CYCCNT - cycles_before;
+    uint32_t lost = (slept > counted + slept / 8) ? slept - counted : 0;
+    if (completed || lost) {
+        Delay_compensateSleep(completed, lost);
+    }
+
+    /* Converted at the clock of this sleep; the clock may change later */
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    sleep_rest_cycles += slept;
+    idle_stats.sleep_us += sleep_rest_cycles / cycles_per_us;
+    sleep_rest_cycles %= cycles_per_us;
+
+    idle_stats.sleeps++;
+    idle_stats.sleep_cycles += slept;
+    __enable_irq();
+}
+
+/**
+ * @brief Returns the idle share since the previous call, in percent.
+ */
+uint8_t Idle_getIdlePercent(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint64_t now = time_now_us();
+    uint64_t sleep = idle_stats.sleep_us;
+    __set_PRIMASK(primask);
+
+    uint64_t total = now - window_us;
+    uint64_t asleep = sleep - window_sleep_us;
+    window_us = now;
+    window_sleep_us = sleep;
+
+    if (total == 0) {
+        return 0;
+    }
+    if (asleep >= total) {
+        return 100;
+    }
+    return (uint8_t) ((asleep * 100) / total);
+}
+
+/**
+ * @brief Copies the idle counters.
+ */
+void Idle_getStats(idle_stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = idle_stats;
+    __set_PRIMASK(primask);
+}
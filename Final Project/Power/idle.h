@@ -0,0 +1,53 @@
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* 1: stop SysTick interrupts while idle until the next deadline.
+ * 0: sleep with WFI until the next 1 ms tick only. */
+#define IDLE_TICKLESS           1
+
+/* Cycles lost while SysTick is stopped to be reprogrammed */
+#define IDLE_SYSTICK_STOPPED_CYCLES 40U
+
+/**
+ * @brief Returns 1 if the caller has work ready; checked with interrupts
+ * masked right before sleeping, so an interrupt that makes work ready can
+ * never be missed.
+ */
+typedef uint8_t (*idle_ready_fn)(void);
+
+/**
+ * @brief Idle counters.
+ */
+typedef struct {
+    uint32_t sleeps;            /* WFI entries */
+    uint32_t tickless_sleeps;   /* Sleeps that suppressed SysTick interrupts */
+    uint32_t ticks_suppressed;  /* SysTick interrupts skipped in total */
+    uint32_t aborted;           /* Sleeps skipped because work became ready */
+    uint64_t sleep_cycles;      /* CPU cycles spent asleep, at any clock */
+    uint64_t sleep_us;          /* Time spent asleep */
+} idle_stats_t;
+
+/**
+ * @brief Sleeps until the next deadline or interrupt unless work is ready.
+ * The next deadline is the earliest software timer, or the next tick while
+ * the button debouncer is scanning. With IDLE_TICKLESS, SysTick is
+ * reprogrammed to fire only at that deadline and the tick count is
+ * compensated on wake.
+ * @param ready Work check run with interrupts masked; may be 0
+ */
+void Idle_sleep(idle_ready_fn ready);
+
+/**
+ * @brief Returns the idle share since the previous call, in percent.
+ */
+uint8_t Idle_getIdlePercent(void);
+
+/**
+ * @brief Copies the idle counters.
+ */
+void Idle_getStats(idle_stats_t *stats);
+
+#endif /* IDLE_H_ */
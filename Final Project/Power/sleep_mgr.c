@@ -0,0 +1,278 @@
+#include "sleep_mgr.h"
+#include "clock_mgr.h"
+#include "delay.h"
+#include "exti.h"
+#include "soft_timer.h"
+#include "health.h"
+
+/**
+ * @brief One registered quiescence check.
+ */
+typedef struct {
+    const char *name;
+    sleep_busy_fn busy;
+    uint32_t vetoes;
+} sleep_busy_t;
+
+static sleep_busy_t busy_checks[SLEEPMGR_MAX_BUSY];
+static uint8_t busy_count = 0;
+static sleep_clock_fn clock_fallback = 0;
+
+/* Sync pin */
+static uint16_t sync_line = 0;
+static uint16_t sync_period_ms = 0;
+static sleep_sync_fn sync_callback = 0;
+static volatile uint8_t sync_valid = 0;     /* An edge has been seen */
+static volatile uint32_t sync_tick = 0;     /* Tick of the last edge */
+
+/* First STOP since the last edge: its tick and its phase after that edge.
+ * The edge that follows lies exactly period - phase ms after it. */
+static volatile uint8_t stop_pending = 0;
+static uint32_t stop_entry_tick = 0;
+static uint32_t stop_entry_phase = 0;
+
+static sleep_mgr_stats_t sleep_stats;
+
+/**
+ * @brief Built-in check: the wheel needs the tick while timers are pending.
+ */
+static uint8_t SleepMgr_timersBusy(void) {
+    return !SoftTimer_isIdle();
+}
+
+/**
+ * @brief Built-in check: STOP needs a live sync pin that is not about to
+ * fire, or nothing would wake the MCU and its time could not be measured.
+ */
+static uint8_t SleepMgr_syncBusy(void) {
+    return !sync_valid || (Delay_getTick() - sync_tick)
+            >= (uint32_t) sync_period_ms - SLEEPMGR_SYNC_MARGIN_MS;
+}
+
+/**
+ * @brief Prepares the sleep manager and its built-in busy checks.
+ */
+void SleepMgr_Init(sleep_clock_fn clock_config) {
+    clock_fallback = clock_config;
+    busy_count = 0;
+    SleepMgr_registerBusy("TIMER", SleepMgr_timersBusy);
+    SleepMgr_registerBusy("SYNC", SleepMgr_syncBusy);
+}
+
+/**
+ * @brief Adds a quiescence check.
+ */
+uint8_t SleepMgr_registerBusy(const char *name, sleep_busy_fn busy) {
+    if (busy_count == SLEEPMGR_MAX_BUSY) {
+        return 0;
+    }
+    busy_checks[busy_count].name = name;
+    busy_checks[busy_count].busy = busy;
+    busy_checks[busy_count].vetoes = 0;
+    busy_count++;
+    return 1;
+}
+
+/**
+ * @brief EXTI callback of the sync pin. Adds the time spent in STOP since
+ * the first entry after the previous edge, then resynchronises.
+ */
+static void SleepMgr_syncEdge(uint8_t line) {
+    uint32_t now = Delay_getTick();
+    (void) line;
+
+    if (stop_pending) {
+        uint32_t real = sync_period_ms - stop_entry_phase;
+        uint32_t counted = now - stop_entry_tick;
+        stop_pending = 0;
+        if (real > counted) {
+            uint32_t lag = real - counted;
+            uint32_t primask = __get_PRIMASK();
+            __disable_irq();
+            Delay_compensateSleep(lag, lag * (SystemCoreClock / 1000U));
+            __set_PRIMASK(primask);
+            sleep_stats.stop_us += (uint64_t) lag * 1000U;
+            now += lag;
+        }
+    }
+    sync_tick = now;
+    sync_valid = 1;
+    if (sync_callback) {
+        sync_callback();
+    }
+}
+
+/**
+ * @brief Selects the periodic wake-up pin that times STOP periods.
+ */
+uint8_t SleepMgr_setSyncPin(GPIO_TypeDef *port, uint8_t pin,
+        uint16_t period_ms, sleep_sync_fn on_edge) {
+    sync_period_ms = period_ms;
+    sync_callback = on_edge;
+    if (!EXTI_attach(port, pin, EXTI_EDGE_FALLING, SleepMgr_syncEdge)) {
+        return 0;
+    }
+    sync_line = (uint16_t) (1U << pin);
+    EXTI_enableLines(sync_line);
+    return 1;
+}
+
+/**
+ * @brief Restarts HSE, and the PLL if it was in use, and switches SYSCLK
+ * back to the source the clock manager had selected.
+ * Runs at HSI 16 MHz; the HSE crystal start-up dominates the latency.
+ * @param sws RCC_CFGR_SWS value before STOP
+ * @return 1 on success, 0 on a timeout
+ */
+static uint8_t SleepMgr_restoreClock(uint32_t sws) {
+    uint32_t timeout = SLEEPMGR_CLOCK_TIMEOUT;
+
+    RCC->CR |= RCC_CR_HSEON;
+    while (!(RCC->CR & RCC_CR_HSERDY)) {
+        if (--timeout == 0) {
+            return 0;
+        }
+    }
+    timeout = SLEEPMGR_CLOCK_TIMEOUT;
+    if (sws == RCC_CFGR_SWS_HSE) {
+        RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_HSE;
+        while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_HSE) {
+            if (--timeout == 0) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    RCC->CR |= RCC_CR_PLLON;
+    while (!(RCC->CR & RCC_CR_PLLRDY)) {
+        if (--timeout == 0) {
+            return 0;
+        }
+    }
+    timeout = SLEEPMGR_CLOCK_TIMEOUT;
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+    while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) {
+        if (--timeout == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Enters STOP mode if no work is ready and every peripheral is idle.
+ */
+sleep_wake_t SleepMgr_enterStop(idle_ready_fn ready) {
+    __disable_irq();
+    if (ready && ready()) {
+        __enable_irq();
+        return SLEEP_WAKE_NONE;
+    }
+    for (uint8_t i = 0; i < busy_count; i++) {
+        if (busy_checks[i].busy()) {
+            busy_checks[i].vetoes++;
+            sleep_stats.stop_vetoed++;
+            __enable_irq();
+            return SLEEP_WAKE_NONE;
+        }
+    }
+
+    uint8_t first = !stop_pending;
+    if (first) {
+        stop_entry_tick = Delay_getTick();
+        stop_entry_phase = stop_entry_tick - sync_tick;
+        stop_pending = 1;
+    }
+
+    uint32_t sws = RCC->CFGR & RCC_CFGR_SWS;
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+#if SLEEPMGR_LOW_POWER_REGULATOR
+    PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS | PWR_CR_CWUF;
+#else
+    PWR->CR = (PWR->CR & ~(PWR_CR_PDDS | PWR_CR_LPDS)) | PWR_CR_CWUF;
+#endif
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    __ISB();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    /* Read before the EXTI handlers clear it */
+    uint32_t pending = EXTI->PR;
+    sleep_wake_t wake;
+
+    if ((RCC->CFGR & RCC_CFGR_SWS) == sws) {
+        /* An interrupt was pending: the clocks never stopped */
+        sleep_stats.stop_aborted++;
+        if (first) {
+            stop_pending = 0;
+        }
+        wake = SLEEP_WAKE_ABORTED;
+    } else {
+        uint32_t start = DWT->CYCCNT;
+        if (!SleepMgr_restoreClock(sws)) {
+            sleep_stats.clock_failures++;
+            HEALTH_INC(HEALTH_CLOCK_FAILURE);
+            if (clock_fallback) {
+                clock_fallback();
+            }
+            /* The fallback may pick another profile: the clock manager
+             * and the dividers of Delay, I2C and USART2 must follow */
+            ClockMgr_resync();
+        }
+        /* Almost every cycle before the switch ran on HSI */
+        uint32_t us = (DWT->CYCCNT - start) / (HSI_VALUE / 1000000U);
+        sleep_stats.wake_last_us = us;
+        if (us > sleep_stats.wake_max_us) {
+            sleep_stats.wake_max_us = us;
+        }
+        sleep_stats.stop_entries++;
+        if (pending & sync_line) {
+            sleep_stats.wake_sync++;
+            wake = SLEEP_WAKE_SYNC;
+        } else {
+            sleep_stats.wake_exti++;
+            wake = SLEEP_WAKE_EXTI;
+        }
+    }
+    /* The sync edge handler now runs and accounts for the STOP time */
+    __enable_irq();
+    return wake;
+}
+
+/**
+ * @brief Returns how often a busy check has refused STOP.
+ */
+uint32_t SleepMgr_getVetoes(uint8_t index, const char **name) {
+    if (index >= busy_count) {
+        if (name) {
+            *name = 0;
+        }
+        return 0;
+    }
+    if (name) {
+        *name = busy_checks[index].name;
+    }
+    return busy_checks[index].vetoes;
+}
+
+/**
+ * @brief Copies the power-state counters.
+ */
+void SleepMgr_getStats(sleep_mgr_stats_t *stats) {
+    idle_stats_t idle;
+
+    Idle_getStats(&idle);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = sleep_stats;
+    uint64_t total = time_now_us();
+    __set_PRIMASK(primask);
+
+    stats->sleep_us = idle.sleep_us;
+    if (total > stats->sleep_us + stats->stop_us) {
+        stats->run_us = total - stats->sleep_us - stats->stop_us;
+    } else {
+        stats->run_us = 0;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef SLEEP_MGR_H_
+#define SLEEP_MGR_H_
+
+#include "stm32f4xx.h"
+#include "idle.h"
+#include <stdint.h>
+
+/* Quiescence checks SleepMgr_registerBusy can hold, built-ins included */
+#define SLEEPMGR_MAX_BUSY           8
+
+/* 1: low-power regulator in STOP (lower current, slower wake-up).
+ * 0: main regulator stays on. */
+#define SLEEPMGR_LOW_POWER_REGULATOR 1
+
+/* Polls of each RCC ready flag before the fast restore gives up */
+#define SLEEPMGR_CLOCK_TIMEOUT      100000U
+
+/* STOP is refused this close to the next sync edge */
+#define SLEEPMGR_SYNC_MARGIN_MS     2U
+
+/**
+ * @brief Returns 1 while a peripheral must not lose its clock, e.g. a UART
+ * frame or an I2C transaction in flight. Called with interrupts masked.
+ */
+typedef uint8_t (*sleep_busy_fn)(void);
+
+/**
+ * @brief Callback run from the EXTI interrupt on each sync edge.
+ */
+typedef void (*sleep_sync_fn)(void);
+
+/**
+ * @brief Full clock set-up, e.g. SystemClock_Config.
+ */
+typedef void (*sleep_clock_fn)(void);
+
+/**
+ * @brief Outcome of SleepMgr_enterStop.
+ */
+typedef enum {
+    SLEEP_WAKE_NONE = 0,    /* STOP not entered: work ready or a peripheral busy */
+    SLEEP_WAKE_SYNC,        /* Woken by the sync pin (DS3231 INT/SQW) */
+    SLEEP_WAKE_EXTI,        /* Woken by another EXTI line, e.g. a button */
+    SLEEP_WAKE_ABORTED      /* An interrupt was already pending, WFI returned */
+} sleep_wake_t;
+
+/**
+ * @brief Power-state counters.
+ */
+typedef struct {
+    uint32_t stop_entries;      /* STOP periods entered */
+    uint32_t stop_aborted;      /* WFI returned without stopping the clocks */
+    uint32_t stop_vetoed;       /* Attempts refused by a busy check */
+    uint32_t wake_sync;         /* Wake-ups by the sync pin */
+    uint32_t wake_exti;         /* Wake-ups by other EXTI lines */
+    uint32_t clock_failures;    /* Fast restores that fell back to the full set-up */
+    uint32_t wake_last_us;      /* Clock restore time of the last wake-up */
+    uint32_t wake_max_us;       /* Longest clock restore time */
+    uint64_t run_us;            /* Time running */
+    uint64_t sleep_us;          /* Time in SLEEP (WFI), from Idle_getStats */
+    uint64_t stop_us;           /* Time in STOP */
+} sleep_mgr_stats_t;
+
+/**
+ * @brief Prepares the sleep manager and its built-in busy checks: software
+ * timers pending ("TIMER") and no recent sync edge ("SYNC").
+ * @param clock_config Run if the fast clock restore times out; the clock
+ * manager then adopts whatever it set up through ClockMgr_resync
+ * @note Delay_Init must have been called.
+ */
+void SleepMgr_Init(sleep_clock_fn clock_config);
+
+/**
+ * @brief Adds a quiescence check; STOP is entered only when all report idle.
+ * @param name Short label for the veto counters; must stay valid
+ * @return 1 on success, 0 if all SLEEPMGR_MAX_BUSY slots are used
+ */
+uint8_t SleepMgr_registerBusy(const char *name, sleep_busy_fn busy);
+
+/**
+ * @brief Selects the periodic wake-up pin that times STOP periods.
+ * SysTick and the cycle counter stop in STOP, so the time spent there is
+ * measured against this pin: every STOP ends at or before its next falling
+ * edge, and the edge handler adds the missed milliseconds to the tick and
+ * the 64-bit timebase.
+ * @param port GPIO port of the pin, already configured as an input
+ * @param pin Pin number; its EXTI line must be free
+ * @param period_ms Edge period, 1000 for the DS3231 1 Hz square wave
+ * @param on_edge Called on every edge after the time is corrected; may be 0
+ * @return 1 on success, 0 if the EXTI line is taken
+ */
+uint8_t SleepMgr_setSyncPin(GPIO_TypeDef *port, uint8_t pin,
+        uint16_t period_ms, sleep_sync_fn on_edge);
+
+/**
+ * @brief Enters STOP mode if no work is ready and every peripheral is idle.
+ * On wake-up the HSE, and the PLL if the clock manager was using it, are
+ * restarted with direct register writes; the PLL, prescalers and flash
+ * latency keep their settings through STOP.
+ * @param ready Work check run with interrupts masked; may be 0
+ * @return What ended the STOP period, or SLEEP_WAKE_NONE if it was refused
+ * @note Only EXTI lines wake the MCU: UART bytes received in STOP are lost.
+ */
+sleep_wake_t SleepMgr_enterStop(idle_ready_fn ready);
+
+/**
+ * @brief Returns how often a busy check has refused STOP.
+ * @param index Registration order, built-ins first
+ * @param name Receives the check's label, or 0 if index is unused; may be 0
+ */
+uint32_t SleepMgr_getVetoes(uint8_t index, const char **name);
+
+/**
+ * @brief Copies the power-state counters; run, sleep and stop times add up
+ * to the time since Delay_Init.
+ */
+void SleepMgr_getStats(sleep_mgr_stats_t *stats);
+
+#endif /* SLEEP_MGR_H_ */
@@ -0,0 +1,187 @@
+#include "profiler.h"
+#include "fast_format.h"
+
+static profile_stage_t profile_table[PROFILE_MAX_STAGES];
+static const char *const *profile_names = 0;
+static uint8_t profile_count = 0;
+static uint32_t profile_overhead = 0;  /* Cycles of an empty BEGIN/END pair */
+
+/* Report cursor: bucket PROFILE_REPORT_SUMMARY stands for the summary line */
+#define PROFILE_REPORT_SUMMARY  0xFF
+static uint8_t report_stage = 0;
+static uint8_t report_bucket = PROFILE_REPORT_SUMMARY;
+static uint8_t report_active = 0;
+
+/**
+ * @brief Names the stages and clears the table.
+ */
+void Profile_Init(const char *const *names, uint8_t count) {
+    profile_names = names;
+    profile_count = (count > PROFILE_MAX_STAGES) ? PROFILE_MAX_STAGES : count;
+
+    /* Smallest of a few runs, so a stray interrupt does not inflate it */
+    profile_overhead = UINT32_MAX;
+    for (uint8_t i = 0; i < 4; i++) {
+        uint32_t start = PROFILE_NOW();
+        uint32_t cycles = PROFILE_NOW() - start;
+        if (cycles < profile_overhead) {
+            profile_overhead = cycles;
+        }
+    }
+    Profile_reset();
+}
+
+/**
+ * @brief Adds one sample to a stage.
+ */
+void Profile_record(uint8_t stage, uint32_t cycles) {
+    if (stage >= profile_count) {
+        return;
+    }
+    profile_stage_t *s = &profile_table[stage];
+
+    cycles = (cycles > profile_overhead) ? cycles - profile_overhead : 0;
+    if (s->count == 0 || cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+    s->count++;
+    s->total += cycles;
+
+    uint32_t bucket = cycles ? 31U - (uint32_t) __builtin_clz(cycles) : 0;
+    if (bucket >= PROFILE_BUCKETS) {
+        bucket = PROFILE_BUCKETS - 1;
+    }
+    s->hist[bucket]++;
+}
+
+/**
+ * @brief Clears every stage's statistics.
+ */
+void Profile_reset(void) {
+    for (uint8_t i = 0; i < PROFILE_MAX_STAGES; i++) {
+        profile_stage_t *s = &profile_table[i];
+        s->count = 0;
+        s->min = 0;
+        s->max = 0;
+        s->total = 0;
+        for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+            s->hist[b] = 0;
+        }
+    }
+}
+
+/**
+ * @brief Returns a stage's statistics.
+ */
+const profile_stage_t *Profile_getStage(uint8_t stage) {
+    return (stage < profile_count) ? &profile_table[stage] : 0;
+}
+
+/**
+ * @brief Formats the report line at a cursor and advances the cursor.
+ * @param stage Stage of the next line
+ * @param bucket First histogram bucket of the next line, or
+ * PROFILE_REPORT_SUMMARY for the stage's summary line
+ * @return 1 if a line was written, 0 once the report is complete
+ */
+static uint8_t Profile_nextLine(char *line, uint8_t *stage, uint8_t *bucket) {
+    while (*stage < profile_count) {
+        const profile_stage_t *s = &profile_table[*stage];
+        if (s->count == 0) {
+            (*stage)++;
+            *bucket = PROFILE_REPORT_SUMMARY;
+            continue;
+        }
+
+        char *end;
+        if (*bucket == PROFILE_REPORT_SUMMARY) {
+            end = FMT_str(line, profile_names[*stage]);
+            FMT_finishLine(line, end, 7);
+            end = FMT_str(line + 7, " n=");
+            end = FMT_uint(end, s->count, 1);
+            end = FMT_str(end, " min=");
+            end = FMT_uint(end, s->min, 1);
+            end = FMT_str(end, " avg=");
+            end = FMT_uint(end, (uint32_t) (s->total / s->count), 1);
+            end = FMT_str(end, " max=");
+            end = FMT_uint(end, s->max, 1);
+            *end = '\0';
+            *bucket = 0;
+            return 1;
+        }
+
+        /* Non-empty buckets, wrapped before a line could overflow */
+        uint8_t b = *bucket;
+        end = FMT_str(line, " ");
+        for (; b < PROFILE_BUCKETS; b++) {
+            if (s->hist[b] == 0) {
+                continue;
+            }
+            /* " 2^nn:" plus up to 10 digits */
+            if (end - line > PROFILE_LINE_WIDTH - 16) {
+                break;
+            }
+            end = FMT_str(end, " 2^");
+            end = FMT_uint(end, b, 1);
+            *end++ = ':';
+            end = FMT_uint(end, s->hist[b], 1);
+        }
+        *end = '\0';
+        if (b == PROFILE_BUCKETS) {
+            (*stage)++;
+            *bucket = PROFILE_REPORT_SUMMARY;
+        } else {
+            *bucket = b;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the table, two lines per stage that has samples.
+ */
+void Profile_report(void (*print)(const char *line)) {
+    char line[PROFILE_LINE_WIDTH + 1];
+    uint8_t stage = 0;
+    uint8_t bucket = PROFILE_REPORT_SUMMARY;
+
+    while (Profile_nextLine(line, &stage, &bucket)) {
+        print(line);
+    }
+}
+
+/**
+ * @brief Starts a paced report at the first stage.
+ */
+void Profile_reportStart(void) {
+    report_stage = 0;
+    report_bucket = PROFILE_REPORT_SUMMARY;
+    report_active = 1;
+}
+
+/**
+ * @brief Passes report lines to 'emit' until it refuses one or the report
+ * is complete.
+ */
+uint8_t Profile_reportStep(profile_emit_fn emit) {
+    char line[PROFILE_LINE_WIDTH + 1];
+
+    while (report_active) {
+        uint8_t stage = report_stage;
+        uint8_t bucket = report_bucket;
+        if (!Profile_nextLine(line, &stage, &bucket)) {
+            report_active = 0;
+            break;
+        }
+        if (!emit(line)) {
+            return 1;
+        }
+        report_stage = stage;
+        report_bucket = bucket;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Per-stage cycle profiler. PROFILE_BEGIN/PROFILE_END around a stage record
+ * its cycle count into a static table: count, min, mean, max and a log2
+ * histogram (bucket n holds durations of 2^n to 2^(n+1)-1 cycles).
+ *
+ *     PROFILE_BEGIN(PROF_LCD);
+ *     updateLCD();
+ *     PROFILE_END(PROF_LCD);
+ *
+ * With PROFILE_ENABLED 0 both macros expand to nothing. The firmware reads
+ * DWT->CYCCNT; a host build (PROFILE_HOST) supplies Profile_hostCycles and
+ * produces the same report from the same code (tests/test_profiler.c).
+ */
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED         1
+#endif
+
+#define PROFILE_MAX_STAGES      8
+#define PROFILE_BUCKETS         24      /* Last bucket also holds longer runs */
+
+/* Width of a Profile_report line, without the terminator */
+#define PROFILE_LINE_WIDTH      72
+
+#ifdef PROFILE_HOST
+uint32_t Profile_hostCycles(void);
+#define PROFILE_NOW()           Profile_hostCycles()
+#else
+#include "stm32f4xx.h"
+#define PROFILE_NOW()           (DWT->CYCCNT)
+#endif
+
+#if PROFILE_ENABLED
+#define PROFILE_BEGIN(stage)    uint32_t profile_start_##stage = PROFILE_NOW()
+#define PROFILE_END(stage)      Profile_record((stage), \
+        PROFILE_NOW() - profile_start_##stage)
+#else
+#define PROFILE_BEGIN(stage)    do { } while (0)
+#define PROFILE_END(stage)      do { } while (0)
+#endif
+
+/**
+ * @brief Statistics of one stage.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PROFILE_BUCKETS];
+} profile_stage_t;
+
+/**
+ * @brief Names the stages and clears the table.
+ * @param names One name per stage id, at most 7 characters shown; the
+ * array must stay valid
+ * @param count Number of stages (at most PROFILE_MAX_STAGES)
+ * @note Also measures the cost of an empty BEGIN/END pair, which is
+ * subtracted from every sample.
+ */
+void Profile_Init(const char *const *names, uint8_t count);
+
+/**
+ * @brief Adds one sample to a stage. Called by PROFILE_END.
+ * @note Thread context only: stages are not protected from interrupts.
+ */
+void Profile_record(uint8_t stage, uint32_t cycles);
+
+/**
+ * @brief Clears every stage's statistics.
+ */
+void Profile_reset(void);
+
+/**
+ * @brief Returns a stage's statistics, or 0 for an unknown id.
+ */
+const profile_stage_t *Profile_getStage(uint8_t stage);
+
+/**
+ * @brief Writes the table, two lines per stage that has samples:
+ * "LCD     n=120 min=80312 avg=80554 max=81022" and its non-empty
+ * histogram buckets "  2^16:120".
+ * @param print Receives each NUL-terminated line, without a line ending
+ */
+void Profile_report(void (*print)(const char *line));
+
+/**
+ * @brief Takes one report line during a paced report.
+ * @return 1 if the line was taken, 0 to have it offered again later
+ */
+typedef uint8_t (*profile_emit_fn)(const char *line);
+
+/**
+ * @brief Starts a paced report of the table as it stands when each line
+ * is formatted.
+ */
+void Profile_reportStart(void);
+
+/**
+ * @brief Passes the Profile_report lines to 'emit' until it refuses one
+ * or the report is complete.
+ * @return 1 while lines remain, 0 once the report is complete
+ * @note Called from the main loop, so a full UART ring only delays it.
+ */
+uint8_t Profile_reportStep(profile_emit_fn emit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,290 @@
+#include "trace.h"
+#include "fast_format.h"
+
+/**
+ * @brief One recorded event, 8 bytes.
+ */
+typedef struct {
+    uint32_t cycles;            /* DWT->CYCCNT */
+    uint8_t id;                 /* trace_id_t */
+    uint8_t ctx;                /* IPSR: 0 thread, 15 SysTick, 16 + IRQn */
+    uint16_t info;              /* Type in bits 15-14, argument in 13-0 */
+} trace_event_t;
+
+/**
+ * @brief Export progress.
+ */
+typedef enum {
+    TRACE_EXPORT_IDLE = 0,
+    TRACE_EXPORT_OPEN,          /* "[" */
+    TRACE_EXPORT_TRACKS,        /* thread_name records */
+    TRACE_EXPORT_EVENTS,
+    TRACE_EXPORT_CLOSE          /* trace_end and "]" */
+} trace_export_state_t;
+
+/* At most 8 characters, so every exported line fits TRACE_LINE_WIDTH */
+static const char *const trace_names[TRACE_ID_COUNT] = {
+    [TRACE_ID_PASS] = "PASS", [TRACE_ID_RTC] = "RTC",
+    [TRACE_ID_TELEMETRY] = "TELEM", [TRACE_ID_LCD] = "LCD",
+    [TRACE_ID_IDLE] = "IDLE", [TRACE_ID_USART2] = "USART2",
+    [TRACE_ID_RX_DMA] = "RX_DMA", [TRACE_ID_TX_DMA] = "TX_DMA",
+    [TRACE_ID_ADC_DMA] = "ADC_DMA", [TRACE_ID_EXTI] = "EXTI"
+};
+
+static const char *const trace_phases[] = {
+    [TRACE_TYPE_BEGIN] = "B", [TRACE_TYPE_END] = "E",
+    [TRACE_TYPE_INSTANT] = "i"
+};
+
+static trace_event_t trace_ring[TRACE_SIZE];
+static volatile uint32_t trace_head = 0;    /* Slots reserved since start */
+static volatile uint8_t trace_recording = 0;
+static uint32_t trace_mhz = 1;              /* Core clock when started */
+
+/* Export cursor */
+static trace_export_state_t export_state = TRACE_EXPORT_IDLE;
+static uint32_t export_first = 0;           /* Slot of the oldest event */
+static uint16_t export_count = 0;
+static uint16_t export_index = 0;
+static uint16_t export_track = 0;
+static uint32_t export_tracks[8];           /* Contexts seen, one bit each */
+static uint32_t export_prev = 0;            /* Timestamp of the last event */
+static uint64_t export_time = 0;            /* Cycles since the first event */
+static uint64_t export_end = 0;             /* Latest timestamp */
+
+/**
+ * @brief Clears the ring and starts recording.
+ */
+void Trace_start(void) {
+    trace_recording = 0;
+    export_state = TRACE_EXPORT_IDLE;
+    trace_head = 0;
+    trace_mhz = SystemCoreClock / 1000000U;
+    if (trace_mhz == 0) {
+        trace_mhz = 1;
+    }
+    trace_recording = 1;
+}
+
+/**
+ * @brief Stops recording.
+ */
+void Trace_stop(void) {
+    trace_recording = 0;
+}
+
+/**
+ * @brief Returns 1 while events are being recorded.
+ */
+uint8_t Trace_isRecording(void) {
+    return trace_recording;
+}
+
+/**
+ * @brief Stores one event.
+ * A preempting handler may take the next slot and write an earlier
+ * timestamp; the export works with signed deltas, so this only swaps the
+ * order of two lines.
+ */
+void Trace_record(uint8_t id, uint8_t type, uint16_t arg) {
+    uint32_t slot;
+
+    if (!trace_recording) {
+        return;
+    }
+    do {
+        slot = __LDREXW(&trace_head);
+    } while (__STREXW(slot + 1, &trace_head));
+
+    trace_event_t *e = &trace_ring[slot & (TRACE_SIZE - 1)];
+    e->cycles = DWT->CYCCNT;
+    e->id = id;
+    e->ctx = (uint8_t) __get_IPSR();
+    e->info = (uint16_t) (((uint32_t) type << 14) | (arg & TRACE_ARG_MAX));
+}
+
+/**
+ * @brief Stops recording and prepares the JSON export of the ring.
+ * Collects the contexts that recorded events and shifts the time origin
+ * so the earliest timestamp is zero.
+ */
+uint16_t Trace_exportStart(void) {
+    uint32_t head;
+    int64_t run = 0;
+    int64_t earliest = 0;
+    int64_t latest = 0;
+
+    trace_recording = 0;
+    head = trace_head;
+    export_count = (head > TRACE_SIZE) ? TRACE_SIZE : (uint16_t) head;
+    export_first = head - export_count;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        export_tracks[i] = 0;
+    }
+    /* Thread context always gets a track, for trace_end */
+    export_tracks[0] = 1;
+
+    if (export_count) {
+        export_prev = trace_ring[export_first & (TRACE_SIZE - 1)].cycles;
+    }
+    for (uint16_t i = 0; i < export_count; i++) {
+        const trace_event_t *e =
+                &trace_ring[(export_first + i) & (TRACE_SIZE - 1)];
+        run += (int32_t) (e->cycles - export_prev);
+        export_prev = e->cycles;
+        if (run < earliest) {
+            earliest = run;
+        }
+        if (run > latest) {
+            latest = run;
+        }
+        export_tracks[e->ctx >> 5] |= 1UL << (e->ctx & 31);
+    }
+
+    if (export_count) {
+        export_prev = trace_ring[export_first & (TRACE_SIZE - 1)].cycles;
+    }
+    export_time = (uint64_t) -earliest;
+    export_end = (uint64_t) (latest - earliest);
+    export_index = 0;
+    export_track = 0;
+    export_state = TRACE_EXPORT_OPEN;
+    return export_count;
+}
+
+/**
+ * @brief Writes a timestamp in microseconds with two decimals.
+ */
+static char *Trace_formatTs(char *p, uint64_t cycles) {
+    uint64_t us = cycles / trace_mhz;
+
+    p = FMT_uint(p, (us > UINT32_MAX) ? UINT32_MAX : (uint32_t) us, 1);
+    *p++ = '.';
+    return FMT_uint(p, (uint32_t) ((cycles % trace_mhz) * 100U / trace_mhz),
+            2);
+}
+
+/**
+ * @brief Writes the thread_name record of one context.
+ */
+static void Trace_formatTrack(char *line, uint8_t ctx) {
+    char *p = FMT_str(line, "{\"name\":\"thread_name\",\"ph\":\"M\","
+            "\"pid\":1,\"tid\":");
+    p = FMT_uint(p, ctx, 1);
+    p = FMT_str(p, ",\"args\":{\"name\":\"");
+    if (ctx == 0) {
+        p = FMT_str(p, "Thread");
+    } else if (ctx == 15) {
+        p = FMT_str(p, "SysTick");
+    } else if (ctx >= 16) {
+        p = FMT_str(p, "IRQ ");
+        p = FMT_uint(p, ctx - 16U, 1);
+    } else {
+        p = FMT_str(p, "Exception ");
+        p = FMT_uint(p, ctx, 1);
+    }
+    p = FMT_str(p, "\"}},");
+    *p = '\0';
+}
+
+/**
+ * @brief Writes one event. Instant arguments are appended to the name,
+ * e.g. "EXTI 8", which keeps lines short and separates them in the view.
+ */
+static void Trace_formatEvent(char *line, const trace_event_t *e,
+        uint64_t time) {
+    uint8_t type = e->info >> 14;
+    char *p = FMT_str(line, "{\"name\":\"");
+
+    p = FMT_str(p, (e->id < TRACE_ID_COUNT) ? trace_names[e->id] : "?");
+    if (type == TRACE_TYPE_INSTANT) {
+        *p++ = ' ';
+        p = FMT_uint(p, e->info & TRACE_ARG_MAX, 1);
+    }
+    p = FMT_str(p, "\",\"ph\":\"");
+    p = FMT_str(p, (type <= TRACE_TYPE_INSTANT) ? trace_phases[type] : "i");
+    p = FMT_str(p, "\",\"ts\":");
+    p = Trace_formatTs(p, time);
+    p = FMT_str(p, ",\"pid\":1,\"tid\":");
+    p = FMT_uint(p, e->ctx, 1);
+    p = FMT_str(p, "},");
+    *p = '\0';
+}
+
+/**
+ * @brief Passes export lines to 'emit' until it refuses one or the export
+ * is complete. The cursor only advances once a line has been taken.
+ */
+uint8_t Trace_exportStep(trace_emit_fn emit) {
+    char line[TRACE_LINE_WIDTH + 1];
+
+    while (export_state != TRACE_EXPORT_IDLE) {
+        switch (export_state) {
+        case TRACE_EXPORT_OPEN:
+            if (!emit("[")) {
+                return 1;
+            }
+            export_state = TRACE_EXPORT_TRACKS;
+            break;
+
+        case TRACE_EXPORT_TRACKS:
+            while (export_track < 256 && !(export_tracks[export_track >> 5]
+                    & (1UL << (export_track & 31)))) {
+                export_track++;
+            }
+            if (export_track == 256) {
+                export_state = TRACE_EXPORT_EVENTS;
+                break;
+            }
+            Trace_formatTrack(line, (uint8_t) export_track);
+            if (!emit(line)) {
+                return 1;
+            }
+            export_track++;
+            break;
+
+        case TRACE_EXPORT_EVENTS: {
+            if (export_index == export_count) {
+                export_state = TRACE_EXPORT_CLOSE;
+                break;
+            }
+            const trace_event_t *e =
+                    &trace_ring[(export_first + export_index)
+                            & (TRACE_SIZE - 1)];
+            uint64_t time = export_time
+                    + (int64_t) (int32_t) (e->cycles - export_prev);
+            Trace_formatEvent(line, e, time);
+            if (!emit(line)) {
+                return 1;
+            }
+            export_time = time;
+            export_prev = e->cycles;
+            export_index++;
+            break;
+        }
+
+        default: {
+            char *p = FMT_str(line, "{\"name\":\"trace_end\",\"ph\":\"i\","
+                    "\"ts\":");
+            p = Trace_formatTs(p, export_end);
+            p = FMT_str(p, ",\"pid\":1,\"tid\":0}]");
+            *p = '\0';
+            if (!emit(line)) {
+                return 1;
+            }
+            export_state = TRACE_EXPORT_IDLE;
+            break;
+        }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Clock switch notifier: refuses switches while recording.
+ */
+uint8_t Trace_clockNotifier(clock_event_t event, const clock_info_t *info) {
+    (void) info;
+    return (event != CLOCK_PRE_CHANGE) || !trace_recording;
+}
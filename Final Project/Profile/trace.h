@@ -0,0 +1,124 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stm32f4xx.h"
+#include "clock_mgr.h"
+#include <stdint.h>
+
+/*
+ * Event trace. Threads and interrupt handlers record begin, end and instant
+ * events with a DWT->CYCCNT timestamp into a fixed ring; slots are reserved
+ * with LDREX/STREX, so recording never masks interrupts. Once stopped, the
+ * ring is exported as Chrome trace JSON lines, one event per line, which
+ * load as-is in chrome://tracing and Perfetto. Each interrupt shows up as
+ * its own track, named after its exception number.
+ *
+ *     TRACE_BEGIN(TRACE_ID_LCD);
+ *     updateLCD();
+ *     TRACE_END(TRACE_ID_LCD);
+ *
+ * With TRACE_ENABLED 0 the macros expand to nothing. tools/trace_capture.py
+ * records and saves a trace from the host.
+ */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED           1
+#endif
+
+/* Events kept; must be a power of two. The oldest are overwritten. */
+#define TRACE_SIZE              512
+
+/* Width of an exported line, without the terminator. Lines stay within
+ * PROTO_MAX_PAYLOAD so they also fit a log frame. */
+#define TRACE_LINE_WIDTH        80
+
+/* Largest argument of an instant event */
+#define TRACE_ARG_MAX           0x3FFFU
+
+/**
+ * @brief Traced code sections and events; names are in trace.c.
+ */
+typedef enum {
+    TRACE_ID_PASS = 0,          /* Control pass */
+    TRACE_ID_RTC,               /* DS3231 time read */
+    TRACE_ID_TELEMETRY,         /* Telemetry send */
+    TRACE_ID_LCD,               /* Display update */
+    TRACE_ID_IDLE,              /* Idle_sleep */
+    TRACE_ID_USART2,            /* USART2 idle line / error interrupt */
+    TRACE_ID_RX_DMA,            /* DMA1 Stream 5, USART2 RX */
+    TRACE_ID_TX_DMA,            /* DMA1 Stream 6, USART2 TX */
+    TRACE_ID_ADC_DMA,           /* DMA2 Stream 0, ADC stream blocks */
+    TRACE_ID_EXTI,              /* Instant, argument: EXTI line */
+    TRACE_ID_COUNT
+} trace_id_t;
+
+/**
+ * @brief Kind of event.
+ */
+typedef enum {
+    TRACE_TYPE_BEGIN = 0,
+    TRACE_TYPE_END,
+    TRACE_TYPE_INSTANT
+} trace_type_t;
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(id)         Trace_record((id), TRACE_TYPE_BEGIN, 0)
+#define TRACE_END(id)           Trace_record((id), TRACE_TYPE_END, 0)
+#define TRACE_INSTANT(id, arg)  Trace_record((id), TRACE_TYPE_INSTANT, (arg))
+#else
+#define TRACE_BEGIN(id)         do { } while (0)
+#define TRACE_END(id)           do { } while (0)
+#define TRACE_INSTANT(id, arg)  do { } while (0)
+#endif
+
+/**
+ * @brief Receives one exported line, NUL-terminated, without a line ending.
+ * @return 1 if the line was taken, 0 to have it offered again later
+ */
+typedef uint8_t (*trace_emit_fn)(const char *line);
+
+/**
+ * @brief Clears the ring and starts recording.
+ * @note Timestamps are converted with the core clock at this point; the
+ * trace vetoes clock switches while it records (Trace_clockNotifier).
+ */
+void Trace_start(void);
+
+/**
+ * @brief Stops recording; the ring keeps its events.
+ */
+void Trace_stop(void);
+
+/**
+ * @brief Returns 1 while events are being recorded.
+ */
+uint8_t Trace_isRecording(void);
+
+/**
+ * @brief Stores one event. Called by the TRACE_* macros.
+ * @note Safe from thread and interrupt context at any priority.
+ */
+void Trace_record(uint8_t id, uint8_t type, uint16_t arg);
+
+/**
+ * @brief Stops recording and prepares the JSON export of the ring.
+ * @return Number of events that will be exported
+ */
+uint16_t Trace_exportStart(void);
+
+/**
+ * @brief Passes export lines to 'emit' until it refuses one or the export
+ * is complete: "[", a thread_name record per track, one line per event and
+ * a closing "trace_end" instant with "]".
+ * @return 1 while lines remain, 0 once the export is complete
+ * @note Called from the main loop, so a full UART ring only delays it.
+ */
+uint8_t Trace_exportStep(trace_emit_fn emit);
+
+/**
+ * @brief Clock switch notifier: refuses switches while recording, so every
+ * timestamp of a trace runs at the same rate.
+ * @note Register with ClockMgr_registerNotifier.
+ */
+uint8_t Trace_clockNotifier(clock_event_t event, const clock_info_t *info);
+
+#endif /* TRACE_H_ */
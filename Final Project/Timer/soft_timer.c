@@ -0,0 +1,323 @@
+#include "soft_timer.h"
+
+/* The firmware masks interrupts around wheel updates; a host build of the
+ * wheel (SOFT_TIMER_HOST) is single-threaded and needs no locking */
+#ifdef SOFT_TIMER_HOST
+#define TIMER_LOCK()    do { } while (0)
+#define TIMER_UNLOCK()  do { } while (0)
+#else
+#include "stm32f4xx.h"
+#define TIMER_LOCK()    uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define TIMER_UNLOCK()  __set_PRIMASK(primask)
+#define TIMER_RELOCK()  __disable_irq()
+#endif
+
+#ifndef TIMER_RELOCK
+#define TIMER_RELOCK()  do { } while (0)
+#endif
+
+#define LEVEL0_SIZE     (1UL << SOFT_TIMER_LEVEL0_BITS)
+#define LEVEL0_MASK     (LEVEL0_SIZE - 1)
+#define LEVEL_SIZE      (1UL << SOFT_TIMER_LEVEL_BITS)
+#define LEVEL_MASK      (LEVEL_SIZE - 1)
+
+/* First bit of the tick that selects a slot in upper level n (1-based) */
+#define LEVEL_SHIFT(n)  (SOFT_TIMER_LEVEL0_BITS + ((n) - 1) * SOFT_TIMER_LEVEL_BITS)
+
+static soft_timer_t *level0[LEVEL0_SIZE];
+static soft_timer_t *levels[SOFT_TIMER_LEVELS - 1][LEVEL_SIZE];
+static soft_timer_t *expiring = 0;          /* Slot being expired by the tick */
+static volatile uint32_t wheel_now = 0;     /* Next tick to process */
+
+static soft_timer_t *deferred_head = 0;
+static soft_timer_t **deferred_tail = &deferred_head;
+
+static soft_timer_stats_t timer_stats;
+
+/**
+ * @brief Inserts a timer at the head of a slot list.
+ */
+static void list_push(soft_timer_t **slot, soft_timer_t *t) {
+    t->next = *slot;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    *slot = t;
+    t->pprev = slot;
+}
+
+/**
+ * @brief Removes a timer from whichever slot list holds it.
+ */
+static void list_unlink(soft_timer_t *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->pprev = 0;
+}
+
+/**
+ * @brief Files a timer in the slot matching its distance to wheel_now.
+ */
+static void wheel_add(soft_timer_t *t) {
+    uint32_t expires = t->expires;
+    uint32_t distance = expires - wheel_now;
+
+    if ((int32_t) distance < 0) {
+        /* Already due: expire on the next tick */
+        list_push(&level0[wheel_now & LEVEL0_MASK], t);
+        return;
+    }
+    if (distance < LEVEL0_SIZE) {
+        list_push(&level0[expires & LEVEL0_MASK], t);
+        return;
+    }
+    for (uint8_t n = 1; n < SOFT_TIMER_LEVELS; n++) {
+        if (n == SOFT_TIMER_LEVELS - 1 || distance < (1UL << LEVEL_SHIFT(n + 1))) {
+            list_push(&levels[n - 1][(expires >> LEVEL_SHIFT(n)) & LEVEL_MASK], t);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Moves every timer of one upper-level slot down the wheel.
+ * @return The slot index, 0 when this level wrapped as well
+ */
+static uint32_t wheel_cascade(uint8_t n) {
+    uint32_t index = (wheel_now >> LEVEL_SHIFT(n)) & LEVEL_MASK;
+    soft_timer_t *t = levels[n - 1][index];
+
+    levels[n - 1][index] = 0;
+    while (t) {
+        soft_timer_t *next = t->next;
+        wheel_add(t);
+        timer_stats.cascaded++;
+        t = next;
+    }
+    return index;
+}
+
+/**
+ * @brief Appends a timer to the deferred queue, or counts an overrun if
+ * its previous expiry has not been processed yet.
+ */
+static void deferred_push(soft_timer_t *t) {
+    if (t->dpprev) {
+        timer_stats.overruns++;
+        return;
+    }
+    t->dnext = 0;
+    t->dpprev = deferred_tail;
+    *deferred_tail = t;
+    deferred_tail = &t->dnext;
+}
+
+/**
+ * @brief Removes a timer from the deferred queue.
+ */
+static void deferred_unlink(soft_timer_t *t) {
+    *t->dpprev = t->dnext;
+    if (t->dnext) {
+        t->dnext->dpprev = t->dpprev;
+    } else {
+        deferred_tail = t->dpprev;
+    }
+    t->dpprev = 0;
+}
+
+/**
+ * @brief Prepares a timer.
+ */
+void SoftTimer_init(soft_timer_t *t, soft_timer_fn callback, void *arg,
+        uint8_t flags) {
+    t->next = 0;
+    t->pprev = 0;
+    t->dnext = 0;
+    t->dpprev = 0;
+    t->expires = 0;
+    t->period = 0;
+    t->callback = callback;
+    t->arg = arg;
+    t->flags = flags;
+}
+
+/**
+ * @brief (Re)starts a timer.
+ */
+void SoftTimer_start(soft_timer_t *t, uint32_t delay, uint32_t period) {
+    if (delay > SOFT_TIMER_MAX_DELAY) {
+        delay = SOFT_TIMER_MAX_DELAY;
+    }
+    if (period > SOFT_TIMER_MAX_DELAY) {
+        period = SOFT_TIMER_MAX_DELAY;
+    }
+
+    TIMER_LOCK();
+    if (t->pprev) {
+        list_unlink(t);
+    }
+    t->period = period;
+    /* wheel_now is the tick processed next, which is 1 tick away */
+    t->expires = wheel_now + (delay ? delay - 1 : 0);
+    wheel_add(t);
+    TIMER_UNLOCK();
+}
+
+/**
+ * @brief Stops a timer and drops its queued deferred callback.
+ */
+void SoftTimer_cancel(soft_timer_t *t) {
+    TIMER_LOCK();
+    if (t->pprev) {
+        list_unlink(t);
+    }
+    if (t->dpprev) {
+        deferred_unlink(t);
+    }
+    TIMER_UNLOCK();
+}
+
+/**
+ * @brief Returns 1 while the timer is scheduled or queued.
+ */
+uint8_t SoftTimer_isActive(const soft_timer_t *t) {
+    return t->pprev != 0 || t->dpprev != 0;
+}
+
+/**
+ * @brief Advances the wheel by one tick and expires due timers.
+ * Callbacks run with interrupts enabled; they may start or cancel any
+ * timer, including the one being expired.
+ */
+void SoftTimer_tick(void) {
+    TIMER_LOCK();
+
+    uint32_t index = wheel_now & LEVEL0_MASK;
+    if (index == 0) {
+        for (uint8_t n = 1; n < SOFT_TIMER_LEVELS; n++) {
+            if (wheel_cascade(n) != 0) {
+                break;
+            }
+        }
+    }
+    wheel_now++;
+
+    /* Move the slot to 'expiring' so that cancels during callbacks still
+     * find a valid pprev */
+    expiring = level0[index];
+    level0[index] = 0;
+    if (expiring) {
+        expiring->pprev = &expiring;
+    }
+
+    soft_timer_t *t;
+    while ((t = expiring) != 0) {
+        list_unlink(t);
+        timer_stats.expired++;
+        if (t->period) {
+            t->expires += t->period;
+            wheel_add(t);
+        }
+        if (t->flags & SOFT_TIMER_DEFERRED) {
+            deferred_push(t);
+            continue;
+        }
+
+        soft_timer_fn callback = t->callback;
+        void *arg = t->arg;
+        TIMER_UNLOCK();
+        callback(arg);
+        TIMER_RELOCK();
+    }
+    TIMER_UNLOCK();
+}
+
+/**
+ * @brief Runs the callbacks of expired deferred timers.
+ */
+uint32_t SoftTimer_process(void) {
+    uint32_t runs = 0;
+
+    for (;;) {
+        TIMER_LOCK();
+        soft_timer_t *t = deferred_head;
+        if (t == 0) {
+            TIMER_UNLOCK();
+            break;
+        }
+        deferred_unlink(t);
+        timer_stats.deferred_runs++;
+        soft_timer_fn callback = t->callback;
+        void *arg = t->arg;
+        TIMER_UNLOCK();
+
+        callback(arg);
+        runs++;
+    }
+    return runs;
+}
+
+/**
+ * @brief Returns how many ticks may pass before one needs processing.
+ * Level 0 holds only timers less than 64 ticks away, so the first non-empty
+ * slot is the exact next expiry; the next level-0 wrap may cascade timers
+ * down and is treated as an expiry.
+ */
+uint32_t SoftTimer_ticksToNext(void) {
+    uint32_t now = wheel_now;
+
+    for (uint32_t i = 0; i < LEVEL0_SIZE; i++) {
+        uint32_t index = (now + i) & LEVEL0_MASK;
+        if (level0[index] != 0 || index == 0) {
+            return i + 1;
+        }
+    }
+    return LEVEL0_SIZE;
+}
+
+/**
+ * @brief Returns 1 if deferred callbacks wait for SoftTimer_process.
+ */
+uint8_t SoftTimer_hasDeferred(void) {
+    return deferred_head != 0;
+}
+
+/**
+ * @brief Returns 1 if no timer is scheduled or waiting to be processed.
+ */
+uint8_t SoftTimer_isIdle(void) {
+    if (deferred_head || expiring) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < LEVEL0_SIZE; i++) {
+        if (level0[i]) {
+            return 0;
+        }
+    }
+    for (uint8_t n = 0; n < SOFT_TIMER_LEVELS - 1; n++) {
+        for (uint32_t i = 0; i < LEVEL_SIZE; i++) {
+            if (levels[n][i]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns the current tick.
+ */
+uint32_t SoftTimer_now(void) {
+    return wheel_now;
+}
+
+/**
+ * @brief Copies the wheel counters.
+ */
+void SoftTimer_getStats(soft_timer_stats_t *stats) {
+    TIMER_LOCK();
+    *stats = timer_stats;
+    TIMER_UNLOCK();
+}
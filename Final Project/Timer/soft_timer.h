@@ -0,0 +1,133 @@
+#ifndef SOFT_TIMER_H_
+#define SOFT_TIMER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel, one tick per SysTick millisecond.
+ * Level 0 has 64 one-tick slots; each of the four upper levels has 64 slots
+ * that are 64 times coarser and cascade down when the level below wraps.
+ * Start and cancel are O(1), expiry is amortised O(1) per timer, and the
+ * tick only touches one slot unless a level wraps.
+ */
+#define SOFT_TIMER_LEVEL0_BITS  6
+#define SOFT_TIMER_LEVEL_BITS   6
+#define SOFT_TIMER_LEVELS       5
+
+/* Longest delay or period, in ticks (about 12 days) */
+#define SOFT_TIMER_MAX_DELAY    ((1UL << (SOFT_TIMER_LEVEL0_BITS \
+        + (SOFT_TIMER_LEVELS - 1) * SOFT_TIMER_LEVEL_BITS)) - 1)
+
+/* Options for SoftTimer_init */
+#define SOFT_TIMER_DEFERRED     0x01    /* Run the callback from SoftTimer_process */
+
+typedef void (*soft_timer_fn)(void *arg);
+
+/**
+ * @brief One timer, owned by the caller. Every field is private.
+ */
+typedef struct soft_timer {
+    struct soft_timer *next;        /* Wheel slot list */
+    struct soft_timer **pprev;      /* 0 while not in the wheel */
+    struct soft_timer *dnext;       /* Deferred queue */
+    struct soft_timer **dpprev;     /* 0 while not queued */
+    uint32_t expires;               /* Absolute tick */
+    uint32_t period;                /* 0 for a one-shot timer */
+    soft_timer_fn callback;
+    void *arg;
+    uint8_t flags;
+} soft_timer_t;
+
+/**
+ * @brief Wheel counters.
+ */
+typedef struct {
+    uint32_t expired;       /* Expiries, including deferred ones */
+    uint32_t deferred_runs; /* Callbacks run by SoftTimer_process */
+    uint32_t cascaded;      /* Timers moved down a level */
+    uint32_t overruns;      /* Deferred expiries merged because not yet processed */
+} soft_timer_stats_t;
+
+/**
+ * @brief Prepares a timer. Call once before the first start.
+ * @param callback Called on expiry, from SoftTimer_tick or, with
+ * SOFT_TIMER_DEFERRED, from SoftTimer_process
+ * @param flags SOFT_TIMER_DEFERRED or 0
+ */
+void SoftTimer_init(soft_timer_t *t, soft_timer_fn callback, void *arg,
+        uint8_t flags);
+
+/**
+ * @brief (Re)starts a timer; a running timer is rescheduled.
+ * @param delay Ticks until the first expiry; 0 and 1 both expire on the
+ * next tick
+ * @param period Ticks between later expiries, 0 for a one-shot timer.
+ * Periodic expiries are scheduled from the previous deadline, not from the
+ * time the callback ran, so they do not drift.
+ * Both are clamped to SOFT_TIMER_MAX_DELAY.
+ */
+void SoftTimer_start(soft_timer_t *t, uint32_t delay, uint32_t period);
+
+/**
+ * @brief Stops a timer and drops any deferred callback still queued.
+ */
+void SoftTimer_cancel(soft_timer_t *t);
+
+/**
+ * @brief Returns 1 while the timer is scheduled or its deferred callback
+ * is queued.
+ */
+uint8_t SoftTimer_isActive(const soft_timer_t *t);
+
+/**
+ * @brief Advances the wheel by one tick and expires due timers.
+ * @note Called from the 1 ms SysTick interrupt.
+ */
+void SoftTimer_tick(void);
+
+/**
+ * @brief Runs the callbacks of deferred timers that have expired.
+ * @return Number of callbacks run
+ * @note Called from the main loop (thread context).
+ */
+uint32_t SoftTimer_process(void);
+
+/**
+ * @brief Returns how many ticks may pass before one needs processing.
+ * @return 1 if the next tick must run normally, at most 64 otherwise;
+ * a level-0 wrap, which may cascade timers down, also counts as work.
+ * @note Used by tickless idle; call with interrupts masked.
+ */
+uint32_t SoftTimer_ticksToNext(void);
+
+/**
+ * @brief Returns 1 if deferred callbacks wait for SoftTimer_process.
+ */
+uint8_t SoftTimer_hasDeferred(void);
+
+/**
+ * @brief Returns 1 if no timer is scheduled or waiting to be processed.
+ * @note Scans the whole wheel; meant for the sleep manager, which may only
+ * stop the tick when nothing depends on it. Call with interrupts masked.
+ */
+uint8_t SoftTimer_isIdle(void);
+
+/**
+ * @brief Returns the current tick.
+ */
+uint32_t SoftTimer_now(void);
+
+/**
+ * @brief Copies the wheel counters.
+ */
+void SoftTimer_getStats(soft_timer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOFT_TIMER_H_ */
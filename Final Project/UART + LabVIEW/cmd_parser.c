@@ -0,0 +1,359 @@
+#include "cmd_parser.h"
+
+/* Time matcher states */
+enum {
+    T_IDLE = 0,
+    T_HOUR,         /* Hour digits */
+    T_MIN_START,    /* After the first ':' */
+    T_MIN_SIGN,     /* Got the minute's '+' or '-' */
+    T_MIN,          /* Minute digits */
+    T_SEC_START,    /* After the second ':' */
+    T_SEC_SIGN,     /* Got the second's '+' or '-' */
+    T_SEC,          /* Second digits */
+    T_SPACE,        /* Whitespace before AM/PM */
+    T_MERIDIEM,     /* Got 'A' or 'P', expecting 'M' */
+    T_PUMP,         /* Time matched, an optional '0'/'1' may follow */
+    T_DONE          /* Time matched, rest of the line ignored */
+};
+
+/* Keyed-command matcher states */
+enum {
+    K_KEY = 0,      /* Keyword characters */
+    K_ARG_START,    /* Expecting an argument */
+    K_ARG_SIGN,     /* Got '-', expecting a digit */
+    K_ARG,          /* Argument digits */
+    K_FAIL          /* Line is not a keyed command */
+};
+
+#define FIELD_HOUR 0
+#define FIELD_MIN  1
+#define FIELD_SEC  2
+
+/* Longest argument accepted, keeps int32_t from overflowing */
+#define CMD_ARG_DIGITS_MAX 9
+
+static uint8_t is_digit(char c) {
+    return (c >= '0' && c <= '9');
+}
+
+/* Whitespace as sscanf skips it; CR and LF end the line before this */
+static uint8_t is_space(char c) {
+    return (c == ' ' || c == '\t' || c == '\v' || c == '\f');
+}
+
+/**
+ * @brief Appends a digit to the hour, keeping only the last two.
+ */
+static void hour_push(cmd_parser_t *p, char c) {
+    p->field[FIELD_HOUR] = (uint8_t) ((p->field[FIELD_HOUR] % 10) * 10 + (c - '0'));
+}
+
+/**
+ * @brief Starts a new hour field with the digit just received.
+ */
+static void start_hour(cmd_parser_t *p, char c) {
+    p->field[FIELD_HOUR] = (uint8_t) (c - '0');
+    p->negative = 0;
+    p->time_state = T_HOUR;
+}
+
+/**
+ * @brief Restarts after a mismatch at character c.
+ * A digit can always begin a new candidate hour.
+ */
+static void time_restart(cmd_parser_t *p, char c) {
+    if (is_digit(c)) {
+        start_hour(p, c);
+    } else {
+        p->time_state = T_IDLE;
+    }
+}
+
+/**
+ * @brief Appends a digit to a minute/second field. Leading zeros are
+ * allowed; a value past two digits cannot match there, but its last two
+ * digits can still begin an hour.
+ */
+static void field_push(cmd_parser_t *p, uint8_t f, char c) {
+    uint16_t value = (uint16_t) (p->field[f] * 10 + (c - '0'));
+
+    if (value > 99) {
+        p->field[FIELD_HOUR] = p->field[f];
+        hour_push(p, c);
+        p->negative = 0;
+        p->time_state = T_HOUR;
+    } else {
+        p->field[f] = (uint8_t) value;
+    }
+}
+
+/**
+ * @brief Validates the matched fields and stores them as 24-hour time.
+ * @return 1 if valid. A two-digit hour outside 1-12 falls back to its last
+ * digit, as scanning from the next offset would.
+ */
+static uint8_t time_accept(cmd_parser_t *p) {
+    uint8_t hour = p->field[FIELD_HOUR];
+
+    if (hour < 1 || hour > 12) {
+        hour %= 10;
+    }
+    if (hour < 1 || hour > 12 || p->field[FIELD_MIN] > 59
+            || p->field[FIELD_SEC] > 59) {
+        return 0;
+    }
+    /* "%d" reads "-0" as 0; any other negative value is out of range */
+    if (((p->negative & (1 << FIELD_MIN)) && p->field[FIELD_MIN] != 0)
+            || ((p->negative & (1 << FIELD_SEC)) && p->field[FIELD_SEC] != 0)) {
+        return 0;
+    }
+
+    if (p->pm && hour != 12) {
+        hour += 12;
+    } else if (!p->pm && hour == 12) {
+        hour = 0;
+    }
+    p->time.hour = hour;
+    p->time.minute = p->field[FIELD_MIN];
+    p->time.second = p->field[FIELD_SEC];
+    p->time.pump = -1;
+    return 1;
+}
+
+/**
+ * @brief Advances the "hh:mm:ss AM|PM[0|1]" matcher by one character.
+ */
+static void time_feed(cmd_parser_t *p, char c) {
+    switch (p->time_state) {
+    case T_IDLE:
+        time_restart(p, c);
+        break;
+    case T_HOUR:
+        if (is_digit(c)) {
+            hour_push(p, c);
+        } else if (c == ':') {
+            p->time_state = T_MIN_START;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    case T_MIN_START:
+    case T_SEC_START:
+    case T_MIN_SIGN:
+    case T_SEC_SIGN: {
+        uint8_t minute = (p->time_state == T_MIN_START
+                || p->time_state == T_MIN_SIGN);
+        uint8_t f = minute ? FIELD_MIN : FIELD_SEC;
+        uint8_t has_sign = (p->time_state == T_MIN_SIGN
+                || p->time_state == T_SEC_SIGN);
+        if (is_digit(c)) {
+            p->field[f] = (uint8_t) (c - '0');
+            p->time_state = minute ? T_MIN : T_SEC;
+        } else if (!has_sign && is_space(c)) {
+            /* Whitespace may precede a number */
+        } else if (!has_sign && (c == '+' || c == '-')) {
+            /* A sign may precede the digits, as "%d" allows */
+            if (c == '-') {
+                p->negative |= (uint8_t) (1 << f);
+            } else {
+                p->negative &= (uint8_t) ~(1 << f);
+            }
+            p->time_state = minute ? T_MIN_SIGN : T_SEC_SIGN;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    }
+    case T_MIN:
+        if (is_digit(c)) {
+            field_push(p, FIELD_MIN, c);
+        } else if (c == ':') {
+            p->time_state = T_SEC_START;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    case T_SEC:
+        if (is_digit(c)) {
+            field_push(p, FIELD_SEC, c);
+        } else if (c == ':') {
+            /* "a:b:c:" - retry with b as the hour; the hour starts at
+             * b's digits, so only c keeps its sign */
+            p->field[FIELD_HOUR] = p->field[FIELD_MIN];
+            p->field[FIELD_MIN] = p->field[FIELD_SEC];
+            p->negative = (p->negative & (1 << FIELD_SEC)) ? (1 << FIELD_MIN)
+                    : 0;
+            p->time_state = T_SEC_START;
+        } else if (is_space(c)) {
+            p->time_state = T_SPACE;
+        } else if (c == 'A' || c == 'P') {
+            p->pm = (c == 'P');
+            p->time_state = T_MERIDIEM;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    case T_SPACE:
+        if (is_space(c)) {
+            break;
+        }
+        if (c == 'A' || c == 'P') {
+            p->pm = (c == 'P');
+            p->time_state = T_MERIDIEM;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    case T_MERIDIEM:
+        if (c == 'M' && time_accept(p)) {
+            p->time_state = T_PUMP;
+        } else {
+            time_restart(p, c);
+        }
+        break;
+    case T_PUMP:
+        if (c == '0' || c == '1') {
+            p->time.pump = (int8_t) (c - '0');
+        }
+        p->time_state = T_DONE;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Advances the "KEY[ arg[,arg...]]" matcher by one character.
+ */
+static void keyed_feed(cmd_parser_t *p, char c) {
+    cmd_t *k = &p->keyed;
+
+    switch (p->key_state) {
+    case K_KEY:
+        if ((c >= 'A' && c <= 'Z')
+                || (p->key_len > 0 && (is_digit(c) || c == '_'))) {
+            if (p->key_len == CMD_KEY_MAX) {
+                p->key_state = K_FAIL;
+            } else {
+                k->key[p->key_len++] = c;
+            }
+        } else if (c == ' ' && p->key_len > 0) {
+            p->key_state = K_ARG_START;
+        } else {
+            p->key_state = K_FAIL;
+        }
+        break;
+    case K_ARG_START:
+    case K_ARG_SIGN:
+        if (c == ' ' && p->key_state == K_ARG_START) {
+            break;
+        }
+        if (c == '-' && p->key_state == K_ARG_START) {
+            p->arg_negative = 1;
+            p->key_state = K_ARG_SIGN;
+        } else if (is_digit(c) && k->argc < CMD_ARGS_MAX) {
+            k->args[k->argc] = c - '0';
+            p->arg_digits = 1;
+            p->key_state = K_ARG;
+        } else {
+            p->key_state = K_FAIL;
+        }
+        break;
+    case K_ARG:
+        if (is_digit(c) && p->arg_digits < CMD_ARG_DIGITS_MAX) {
+            k->args[k->argc] = k->args[k->argc] * 10 + (c - '0');
+            p->arg_digits++;
+        } else if (c == ',') {
+            if (p->arg_negative) {
+                k->args[k->argc] = -k->args[k->argc];
+            }
+            k->argc++;
+            p->arg_negative = 0;
+            p->key_state = K_ARG_START;
+        } else {
+            p->key_state = K_FAIL;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Closes the keyed matcher at end of line.
+ * @return 1 if the whole line was a keyed command.
+ */
+static uint8_t keyed_finish(cmd_parser_t *p) {
+    cmd_t *k = &p->keyed;
+
+    if (p->key_state == K_ARG) {
+        if (p->arg_negative) {
+            k->args[k->argc] = -k->args[k->argc];
+        }
+        k->argc++;
+    } else if (p->key_state != K_KEY && p->key_state != K_ARG_START) {
+        return 0;
+    }
+    if (p->key_len == 0 || (p->key_state == K_ARG_START && k->argc > 0)) {
+        /* Empty keyword or a trailing comma */
+        return 0;
+    }
+    k->key[p->key_len] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Prepares the parser for a new line.
+ */
+void CmdParser_reset(cmd_parser_t *p) {
+    p->length = 0;
+    p->first = '\0';
+    p->time_state = T_IDLE;
+    p->negative = 0;
+    p->pm = 0;
+    p->key_state = K_KEY;
+    p->key_len = 0;
+    p->arg_digits = 0;
+    p->arg_negative = 0;
+    p->keyed.argc = 0;
+}
+
+/**
+ * @brief Feeds one character; reports the command when the line ends.
+ */
+cmd_type_t CmdParser_putChar(cmd_parser_t *p, char c, cmd_t *cmd) {
+    if (c != '\r' && c != '\n' && c != '\0') {
+        if (p->length == 0) {
+            p->first = c;
+        }
+        if (p->length < UINT16_MAX) {
+            p->length++;
+        }
+        time_feed(p, c);
+        keyed_feed(p, c);
+        return CMD_NONE;
+    }
+
+    cmd_type_t type;
+    if (p->length == 0) {
+        type = CMD_NONE;
+    } else if (p->time_state == T_PUMP || p->time_state == T_DONE) {
+        *cmd = p->time;
+        type = CMD_SET_TIME;
+    } else if (p->length == 1 && (p->first == '0' || p->first == '1')) {
+        cmd->pump = (int8_t) (p->first - '0');
+        type = CMD_PUMP;
+    } else if (keyed_finish(p)) {
+        *cmd = p->keyed;
+        type = CMD_KEYED;
+    } else if (p->length == 1) {
+        /* A lone stray character is ignored, as before */
+        type = CMD_NONE;
+    } else {
+        type = CMD_ERROR;
+    }
+
+    cmd->type = type;
+    CmdParser_reset(p);
+    return type;
+}
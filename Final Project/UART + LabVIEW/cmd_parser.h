@@ -0,0 +1,81 @@
+#ifndef CMD_PARSER_H_
+#define CMD_PARSER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define CMD_KEY_MAX   8     /* Characters in a command keyword */
+#define CMD_ARGS_MAX  4     /* Integer arguments per keyed command */
+
+/**
+ * @brief Kind of line recognised by the parser.
+ */
+typedef enum {
+    CMD_NONE = 0,   /* Empty line or a lone unrecognised character */
+    CMD_SET_TIME,   /* "hh:mm:ss AM|PM[0|1]" anywhere in the line, read
+                     * as sscanf("%d:%d:%d %2s") would: minute and second
+                     * may be signed ("12:+5:-0 AM") and preceded by
+                     * whitespace */
+    CMD_PUMP,       /* A bare "0" or "1" */
+    CMD_KEYED,      /* "KEY[ arg[,arg...]]", KEY is [A-Z][A-Z0-9_]* */
+    CMD_ERROR       /* Anything else */
+} cmd_type_t;
+
+/**
+ * @brief One parsed command line.
+ */
+typedef struct {
+    cmd_type_t type;
+    uint8_t hour;       /* CMD_SET_TIME: 0-23 */
+    uint8_t minute;     /* CMD_SET_TIME: 0-59 */
+    uint8_t second;     /* CMD_SET_TIME: 0-59 */
+    int8_t pump;        /* CMD_SET_TIME/CMD_PUMP: 0, 1, or -1 if absent */
+    uint8_t argc;       /* CMD_KEYED: number of arguments */
+    char key[CMD_KEY_MAX + 1];
+    int32_t args[CMD_ARGS_MAX];
+} cmd_t;
+
+/**
+ * @brief Incremental parser state. Every field is private.
+ * The time matcher keeps only the last two hour digits and slides its
+ * fields on mismatch, so one pass over the line finds the same
+ * "hh:mm:ss AM" match as rescanning from every offset with sscanf would.
+ */
+typedef struct {
+    uint16_t length;        /* Characters seen on this line */
+    char first;             /* First character of the line */
+    /* Time matcher */
+    uint8_t time_state;
+    uint8_t field[3];       /* Hour (last two digits), minute, second */
+    uint8_t negative;       /* Bit per field: minute or second had a '-' */
+    uint8_t pm;
+    cmd_t time;             /* Filled once a time has matched */
+    /* Keyed-command matcher */
+    uint8_t key_state;
+    uint8_t key_len;
+    uint8_t arg_digits;
+    uint8_t arg_negative;
+    cmd_t keyed;
+} cmd_parser_t;
+
+/**
+ * @brief Prepares the parser for a new line.
+ */
+void CmdParser_reset(cmd_parser_t *p);
+
+/**
+ * @brief Feeds one character; constant time, no allocation, ISR-safe.
+ * @param cmd Receives the parsed command when a line ends
+ * @return CMD_NONE while the line is in progress, otherwise the type
+ * written to *cmd. CR, LF and NUL end a line.
+ */
+cmd_type_t CmdParser_putChar(cmd_parser_t *p, char c, cmd_t *cmd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CMD_PARSER_H_ */
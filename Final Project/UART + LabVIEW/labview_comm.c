@@ -1,34 +1,120 @@
 #include "labview_comm.h"
-#include <stdio.h>
+#include "fast_format.h"
+#include "line_queue.h"
+#include "cmd_parser.h"
+#include "labview_sub.h"
+#include "uart_mux.h"
+#include "trace.h"
+#include "health.h"
+#include "delay.h"
+#include "flash_log.h"
 #include <string.h>
-#include <stdlib.h>
 
 
-#define PCLK1_FREQ              42000000UL  /* PCLK1 frequency in Hz */
-#define USART_BAUDRATE          115200UL    /* Desired baud rate for USART2 */
-#define RX_BUFFER_SIZE          128
+#define USART2_RX_PIN_MASK      (1UL << 3)  /* PA3 */
+#define RX_DMA_BUFFER_SIZE      256         /* Must be a power of two */
+#define RX_DMA_BUFFER_MASK      (RX_DMA_BUFFER_SIZE - 1)
+/* Per-channel TX rings, each a power of two */
+#define TX_CONTROL_SIZE         128
+#define TX_TELEMETRY_SIZE       512
+#define TX_LOG_SIZE             256
+#define TX_BULK_SIZE            1024
+#define RX_FRAME_SLOTS          4           /* Must be a power of two */
+
+/* USART2_TX request: DMA1 Stream 6, Channel 4 */
+#define USART2_TX_DMA_STREAM    DMA1_Stream6
+#define USART2_TX_DMA_CHANNEL   (4UL << DMA_SxCR_CHSEL_Pos)
+#define USART2_TX_DMA_IRQn      DMA1_Stream6_IRQn
+#define USART2_TX_DMA_FLAGS     (DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 \
+                                | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 \
+                                | DMA_HIFCR_CFEIF6)
+
+/* USART2_RX request: DMA1 Stream 5, Channel 4 */
+#define USART2_RX_DMA_STREAM    DMA1_Stream5
+#define USART2_RX_DMA_CHANNEL   (4UL << DMA_SxCR_CHSEL_Pos)
+#define USART2_RX_DMA_IRQn      DMA1_Stream5_IRQn
+#define USART2_RX_DMA_FLAGS     (DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 \
+                                | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 \
+                                | DMA_HIFCR_CFEIF5)
 
 volatile uint8_t parsed_hour = 0;
 volatile uint8_t parsed_minute = 0;
 volatile uint8_t parsed_second = 0;
 volatile uint8_t labview_pump_command = 0;
 
-/* The UART reception buffer. 'static' makes it private to this file. */
-static volatile char rx_buffer[RX_BUFFER_SIZE];
-/* Current index in the reception buffer. */
-static volatile uint8_t rx_index = 0;
-/* Flag to indicate a complete line has been received from LabVIEW. */
-static volatile uint8_t new_data_received_flag = 0;
+/* Circular buffer written by DMA1 Stream 5. 'static' makes it private to this file. */
+static volatile uint8_t rx_dma_buffer[RX_DMA_BUFFER_SIZE];
+/* Last DMA write offset consumed by USART2_RX_DMA_Update. */
+static uint32_t rx_dma_last_pos = 0;
+/* Half-buffer events seen by LabVIEW_UART_rxStallHandler, not yet consumed */
+static volatile uint32_t rx_dma_stall_halves = 0;
+/* Tick of the last received byte */
+static volatile uint32_t rx_last_tick = 0;
+/* Complete lines, produced by the USART2/DMA interrupts, consumed by the main loop. */
+static line_queue_t rx_queue;
+/* Reception error statistics. */
+static volatile labview_rx_stats_t rx_stats;
+/* Text command parser, fed one line at a time by LabVIEW_UART_ProcessData. */
+static cmd_parser_t rx_parser;
+
+/* Keyed text commands registered with LabVIEW_registerCommand. */
+static struct {
+    const char *key;
+    labview_cmd_handler_t handler;
+} labview_commands[LABVIEW_MAX_COMMANDS];
+static uint8_t labview_command_count = 0;
+
+/* Binary frames: decoded by the receive interrupts, consumed by the main loop. */
+static proto_decoder_t rx_decoder;
+static proto_frame_t rx_frames[RX_FRAME_SLOTS];
+static volatile uint32_t rx_frame_head = 0;   /* Written by the ISR only */
+static volatile uint32_t rx_frame_tail = 0;   /* Written by the main loop only */
+/* 1 between a leading 0x00 delimiter and the end of its frame. */
+static uint8_t rx_in_frame = 0;
+/* Protocol last used by the host; telemetry is answered in kind. */
+static labview_protocol_t labview_protocol = LABVIEW_PROTOCOL_TEXT;
+/* Sequence number of the next frame sent to the host. */
+static uint8_t tx_seq = 0;
+
+/* Line rate currently programmed into USART2. */
+static labview_baud_t baud_info;
+
+/* Rates LabVIEW_UART_AutoBaud snaps a measurement to. */
+static const uint32_t autobaud_rates[] = {
+    9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000,
+    2000000
+};
+
+/* One ring per logical channel, drained by DMA in priority order. */
+static uint8_t tx_control_buffer[TX_CONTROL_SIZE];
+static uint8_t tx_telemetry_buffer[TX_TELEMETRY_SIZE];
+static uint8_t tx_log_buffer[TX_LOG_SIZE];
+static uint8_t tx_bulk_buffer[TX_BULK_SIZE];
+/* Accessed only with interrupts masked. */
+static uart_mux_t tx_mux;
+/* Length of the run currently owned by the DMA, 0 when idle. */
+static volatile uint16_t tx_dma_len = 0;
+/* Bytes lost to DMA transfer errors. */
+static volatile uint32_t tx_dma_error_bytes = 0;
 
 extern void controlPump(uint8_t state);
 extern void DS3231_setTime(uint8_t hh, uint8_t mm, uint8_t ss);
 extern void Activate_LabVIEW_Override(void);
+extern void Error_Handler(void);
 
 /* Private (Static) Function Prototypes */
 static void GPIO_Init_USART2(void);
 static void USART2_Init(void);
-static void USART2_SendChar(char c);
-static void parse_token(const char* data_str);
+static uint32_t USART2_getPclk(void);
+static uint8_t USART2_computeBaud(uint32_t baud, uint32_t pclk,
+        labview_baud_t *info, uint32_t *brr);
+static void USART2_TX_DMA_Init(void);
+static void USART2_TX_DMA_Kick(void);
+static void USART2_RX_DMA_Init(void);
+static void USART2_RX_DMA_Update(void);
+static void USART2_RX_routeByte(uint8_t byte);
+static void handle_line(const char *line);
+static void handle_frame(const proto_frame_t *frame);
 
 /**
  * @brief Initializes USART2 peripheral and corresponding GPIO pins.
@@ -36,44 +122,249 @@ static void parse_token(const char* data_str);
 void LabVIEW_UART_Init(void) {
     GPIO_Init_USART2();
     USART2_Init();
+    USART2_TX_DMA_Init();
+    USART2_RX_DMA_Init();
+}
+
+/**
+ * @brief Queues a block of bytes for transmission to LabVIEW.
+ * Legacy text output goes on the telemetry channel.
+ * @return 1 if queued, 0 if dropped.
+ */
+uint8_t LabVIEW_UART_SendBuffer(const uint8_t *data, uint16_t length) {
+    return LabVIEW_UART_SendOn(PROTO_CH_TELEMETRY, data, length);
+}
+
+/**
+ * @brief Queues a block of bytes on one logical channel.
+ * The block is copied into the channel ring and the DMA is started if idle.
+ * A block that does not fit entirely is dropped so lines are never torn.
+ * The copy runs with interrupts masked so interrupt handlers may send too.
+ * @return 1 if queued, 0 if dropped.
+ */
+uint8_t LabVIEW_UART_SendOn(uint8_t channel, const uint8_t *data,
+        uint16_t length) {
+    if (channel >= UART_MUX_CHANNELS) {
+        return 0;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint8_t queued = UartMux_write(&tx_mux, channel, data, length);
+    __set_PRIMASK(primask);
+
+    if (queued) {
+        USART2_TX_DMA_Kick();
+    } else {
+        HEALTH_INC(HEALTH_UART_TX_DROP);
+    }
+    return queued;
+}
+
+/**
+ * @brief Sends a single character to LabVIEW via USART2.
+ */
+void LabVIEW_UART_SendChar(char c) {
+    LabVIEW_UART_SendBuffer((const uint8_t*) &c, 1);
 }
 
 /**
  * @brief Sends a string to LabVIEW via USART2.
+ * Returns as soon as the string is copied into the TX ring.
  */
 void LabVIEW_UART_SendString(const char* str) {
-    while (*str) {
-        USART2_SendChar(*str++);
+    LabVIEW_UART_SendBuffer((const uint8_t*) str, (uint16_t) strlen(str));
+}
+
+/**
+ * @brief Copies the transmit statistics, summed over every channel.
+ */
+void LabVIEW_UART_getTxStats(labview_tx_stats_t *stats) {
+    uart_mux_stats_t ch;
+
+    stats->dropped_bytes = tx_dma_error_bytes;
+    stats->dropped_blocks = 0;
+    stats->high_watermark = 0;
+    stats->used = 0;
+    for (uint8_t i = 0; i < UART_MUX_CHANNELS; i++) {
+        LabVIEW_UART_getChannelStats(i, &ch);
+        stats->dropped_bytes += ch.dropped_bytes;
+        stats->dropped_blocks += ch.dropped_blocks;
+        stats->used += ch.used;
+        if (ch.high_watermark > stats->high_watermark) {
+            stats->high_watermark = ch.high_watermark;
+        }
     }
 }
 
+/**
+ * @brief Copies one channel's byte and drop counters.
+ */
+void LabVIEW_UART_getChannelStats(uint8_t channel, uart_mux_stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    UartMux_getStats(&tx_mux, channel, stats);
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Returns 1 while queued bytes are still being transmitted.
+ */
+uint8_t LabVIEW_UART_isTxBusy(void) {
+    return UartMux_isBusy(&tx_mux) || !(USART2->SR & USART_SR_TC);
+}
+
+/**
+ * @brief Returns 1 if received lines or frames wait to be processed.
+ */
+uint8_t LabVIEW_UART_hasPending(void) {
+    return LineQueue_peek(&rx_queue) != NULL || rx_frame_tail != rx_frame_head;
+}
+
+/**
+ * @brief Returns 1 if no byte arrived for 'ms' and nothing waits.
+ */
+uint8_t LabVIEW_UART_isRxQuiet(uint32_t ms) {
+    return (Delay_getTick() - rx_last_tick) >= ms && !LabVIEW_UART_hasPending();
+}
+
+/**
+ * @brief Sends a debug log line on the log channel.
+ * Text hosts read raw lines and cannot demultiplex, so logs are only sent
+ * to hosts speaking the binary protocol; otherwise they count as dropped.
+ */
+uint8_t LabVIEW_Log(const char *text) {
+    uint16_t length = (uint16_t) strlen(text);
+
+    if (labview_protocol != LABVIEW_PROTOCOL_BINARY) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        UartMux_countDrop(&tx_mux, PROTO_CH_LOG, length);
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    if (length > PROTO_MAX_PAYLOAD) {
+        length = PROTO_MAX_PAYLOAD; /* Long lines are truncated */
+    }
+    return LabVIEW_Send_Frame(PROTO_MSG_LOG, (const uint8_t*) text,
+            (uint8_t) length);
+}
+
 /**
  * @brief Checks for and processes any complete commands received from LabVIEW.
+ * Drains every line queued by the receive interrupts since the last call.
  */
 void LabVIEW_UART_ProcessData(void) {
-    if (new_data_received_flag != 1) {
-        return; /* No new complete command to process */
+    const char *line;
+
+    while ((line = LineQueue_peek(&rx_queue)) != NULL) {
+        labview_protocol = LABVIEW_PROTOCOL_TEXT;
+        handle_line(line);
+        LineQueue_release(&rx_queue);
     }
 
-    rx_buffer[rx_index] = '\0'; /* Null-terminate the received data */
+    while (rx_frame_tail != rx_frame_head) {
+        /* Read the slot only after seeing the head that published it */
+        __DMB();
+        labview_protocol = LABVIEW_PROTOCOL_BINARY;
+        handle_frame(&rx_frames[rx_frame_tail & (RX_FRAME_SLOTS - 1)]);
+        __DMB();
+        rx_frame_tail = rx_frame_tail + 1;
+    }
+}
 
-    /* Use strtok to handle multiple commands in one buffer */
-    char *token = strtok((char*) rx_buffer, "\n\r");
-    while (token != NULL) {
-        if (strlen(token) > 0) {
-            if ((strlen(token) == 1 && (token[0] == '0' || token[0] == '1'))
-                    || (strchr(token, ':') != NULL
-                            && (token[strlen(token) - 1] == '0'
-                                    || token[strlen(token) - 1] == '1'))) {
-            }
-            parse_token(token);
-        }
-        token = strtok(NULL, "\n\r");
+/**
+ * @brief Sends a binary protocol frame to LabVIEW.
+ * @return 1 if queued, 0 if dropped (TX ring full or payload too long).
+ */
+uint8_t LabVIEW_Send_Frame(uint8_t msg_id, const uint8_t *payload,
+        uint8_t length) {
+    return LabVIEW_Send_FrameParts(msg_id, payload, length, NULL, 0);
+}
+
+/**
+ * @brief Sends a frame whose payload is 'header' followed by 'data'.
+ * The frame is COBS-encoded straight into the ring of the channel its
+ * msg_id belongs to, so each payload byte is read once and copied once.
+ */
+uint8_t LabVIEW_Send_FrameParts(uint8_t msg_id, const uint8_t *header,
+        uint8_t header_len, const uint8_t *data, uint8_t data_len) {
+    uint16_t length = (uint16_t) header_len + data_len;
+    uint8_t channel = Proto_channelOf(msg_id);
+    proto_encoder_t enc;
+    uint8_t *ring;
+    uint16_t mask;
+
+    if (length > PROTO_MAX_PAYLOAD) {
+        return 0;
     }
 
-    /* Reset for the next reception */
-    rx_index = 0;
-    new_data_received_flag = 0;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    int32_t start = UartMux_reserve(&tx_mux, channel, PROTO_WIRE_SIZE(length));
+    if (start < 0) {
+        __set_PRIMASK(primask);
+        HEALTH_INC(HEALTH_UART_TX_DROP);
+        return 0;
+    }
+
+    ring = UartMux_getRing(&tx_mux, channel, &mask);
+    Proto_encoderBegin(&enc, ring, mask, (uint16_t) start,
+            msg_id, tx_seq++, (uint8_t) length);
+    Proto_encoderPut(&enc, header, header_len);
+    Proto_encoderPut(&enc, data, data_len);
+    UartMux_commit(&tx_mux, channel, Proto_encoderEnd(&enc));
+
+    __set_PRIMASK(primask);
+    USART2_TX_DMA_Kick();
+    return 1;
+}
+
+/**
+ * @brief Sends a status record in the protocol the host last used.
+ * Text hosts get the legacy LabVIEW_Send_Value line. Once the host has
+ * subscribed to fields, only changed or due fields are sent.
+ */
+void LabVIEW_Send_Telemetry(const proto_telemetry_t *telemetry) {
+    if (LabVIEW_Sub_isActive()) {
+        LabVIEW_Sub_update(telemetry);
+    } else if (labview_protocol == LABVIEW_PROTOCOL_BINARY) {
+        uint8_t payload[PROTO_TELEMETRY_SIZE];
+        uint8_t n = Proto_packTelemetry(telemetry, payload);
+        LabVIEW_Send_Frame(PROTO_MSG_TELEMETRY, payload, n);
+    } else {
+        LabVIEW_Send_Value(telemetry->moisture_raw, telemetry->mode,
+                telemetry->pump);
+    }
+}
+
+/**
+ * @brief Returns the protocol the host last used.
+ */
+labview_protocol_t LabVIEW_getProtocol(void) {
+    return labview_protocol;
+}
+
+/**
+ * @brief Copies the reception statistics.
+ */
+void LabVIEW_UART_getRxStats(labview_rx_stats_t *stats) {
+    line_queue_stats_t queue_stats;
+    LineQueue_getStats(&rx_queue, &queue_stats);
+
+    stats->overruns = rx_stats.overruns;
+    stats->framing_errors = rx_stats.framing_errors;
+    stats->parse_errors = rx_stats.parse_errors;
+    stats->lines = queue_stats.lines;
+    stats->queue_full_drops = queue_stats.full_drops;
+    stats->line_overflows = queue_stats.long_drops;
+    stats->queue_high_watermark = queue_stats.high_watermark;
+    stats->frames = rx_stats.frames;
+    stats->frame_drops = rx_stats.frame_drops;
+    stats->frame_crc_errors = rx_decoder.crc_errors;
+    stats->frame_format_errors = rx_decoder.format_errors;
+    stats->dma_laps = rx_stats.dma_laps;
 }
 
 void LabVIEW_Send_Value(uint16_t value, uint8_t mode, uint8_t pump_state) {
@@ -91,7 +382,9 @@ void LabVIEW_Send_Value(uint16_t value, uint8_t mode, uint8_t pump_state) {
     else { /* Pump OFF */
         temp = temp * 10;
     }
-    sprintf(buffer, "%d\n", temp);
+    char *end = FMT_uint(buffer, temp, 0);
+    *end++ = '\n';
+    *end = '\0';
     LabVIEW_UART_SendString(buffer);
 }
 
@@ -109,6 +402,176 @@ static void GPIO_Init_USART2(void) {
     GPIOA->AFR[0] |= (7U << (2*4)) | (7U << (3*4));
 }
 
+/**
+ * @brief Returns the APB1 (USART2) clock derived from the live RCC settings.
+ */
+static uint32_t USART2_getPclk(void) {
+    clock_info_t clocks;
+
+    ClockMgr_getInfo(&clocks);
+    return clocks.pclk1_hz;
+}
+
+/**
+ * @brief Computes BRR for a baud rate from an APB1 clock.
+ * The rounded divider is the same in both modes, so 16x oversampling is
+ * kept for its noise margin and 8x is used only above PCLK1/16.
+ * @return 1 if the rate is reachable within LABVIEW_UART_MAX_BAUD_ERROR_PPM.
+ * On 0, *info and *brr must not be used.
+ */
+static uint8_t USART2_computeBaud(uint32_t baud, uint32_t pclk,
+        labview_baud_t *info, uint32_t *brr) {
+    uint32_t div;
+
+    if (baud == 0) {
+        return 0;
+    }
+    /* Clock periods per bit: 16 * USARTDIV, or 8 * USARTDIV with OVER8 */
+    div = (pclk + baud / 2) / baud;
+    if (div < 8 || div > 0xFFFF) {
+        return 0;
+    }
+
+    info->requested = baud;
+    info->pclk = pclk;
+    info->over8 = (div < 16);
+    info->actual = (pclk + div / 2) / div;
+    info->error_ppm = (int32_t) (((int64_t) pclk * 1000000) / ((int64_t) div * baud)
+            - 1000000);
+    if (info->over8) {
+        /* DIV_Fraction[2:0] holds eighths, bit 3 must stay clear */
+        *brr = ((div >> 3) << 4) | (div & 7U);
+    } else {
+        *brr = div;
+    }
+
+    return (info->error_ppm <= LABVIEW_UART_MAX_BAUD_ERROR_PPM
+            && info->error_ppm >= -LABVIEW_UART_MAX_BAUD_ERROR_PPM);
+}
+
+/**
+ * @brief Reprograms USART2 for a new baud rate once the transmitter drains.
+ */
+uint8_t LabVIEW_UART_SetBaud(uint32_t baud) {
+    labview_baud_t info;
+    uint32_t brr;
+
+    if (!USART2_computeBaud(baud, USART2_getPclk(), &info, &brr)) {
+        return 0;
+    }
+
+    while (LabVIEW_UART_isTxBusy());
+
+    USART2->CR1 &= ~USART_CR1_UE;
+    USART2->BRR = brr;
+    if (info.over8) {
+        USART2->CR1 |= USART_CR1_OVER8;
+    } else {
+        USART2->CR1 &= ~USART_CR1_OVER8;
+    }
+    USART2->CR1 |= USART_CR1_UE;
+
+    baud_info = info;
+    return 1;
+}
+
+/**
+ * @brief Clock switch notifier: recomputes BRR for the new PCLK1.
+ * The divider for the target clock is computed at PRE_CHANGE, so a rate the
+ * new clock cannot reach refuses the switch instead of breaking the link.
+ */
+uint8_t LabVIEW_UART_clockNotifier(clock_event_t event,
+        const clock_info_t *info) {
+    static labview_baud_t next_info;
+    static uint32_t next_brr;
+
+    switch (event) {
+    case CLOCK_PRE_CHANGE:
+        return !LabVIEW_UART_isTxBusy()
+                && USART2_computeBaud(baud_info.requested, info->pclk1_hz,
+                        &next_info, &next_brr);
+    case CLOCK_POST_CHANGE:
+        USART2->CR1 &= ~USART_CR1_UE;
+        USART2->BRR = next_brr;
+        if (next_info.over8) {
+            USART2->CR1 |= USART_CR1_OVER8;
+        } else {
+            USART2->CR1 &= ~USART_CR1_OVER8;
+        }
+        USART2->CR1 |= USART_CR1_UE;
+        baud_info = next_info;
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Copies the programmed baud rate and its error.
+ */
+void LabVIEW_UART_getBaud(labview_baud_t *info) {
+    *info = baud_info;
+}
+
+/**
+ * @brief Measures the host's baud rate from a 'U' (0x55) on PA3.
+ * 0x55 sent LSB first toggles on every bit, so its first and fifth rising
+ * edges are exactly 8 bit times apart. The edges are timed with the cycle
+ * counter and the result is snapped to the nearest standard rate.
+ */
+uint32_t LabVIEW_UART_AutoBaud(uint32_t timeout_ms) {
+    uint32_t timeout = timeout_ms * (SystemCoreClock / 1000U);
+    uint32_t primask = __get_PRIMASK();
+    uint32_t first_rise = 0;
+    uint32_t last_rise = 0;
+    uint32_t start;
+    uint8_t in_time = 1;
+    uint32_t best = 0;
+
+    /* Keep the character being measured out of the receive path */
+    USART2->CR1 &= ~USART_CR1_RE;
+    __disable_irq();
+    start = DWT->CYCCNT;
+
+    for (uint8_t rise = 0; rise < 5 && in_time; rise++) {
+        while ((GPIOA->IDR & USART2_RX_PIN_MASK) && in_time) {
+            in_time = (DWT->CYCCNT - start) < timeout;
+        }
+        while (!(GPIOA->IDR & USART2_RX_PIN_MASK) && in_time) {
+            in_time = (DWT->CYCCNT - start) < timeout;
+        }
+        last_rise = DWT->CYCCNT;
+        if (rise == 0) {
+            first_rise = last_rise;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    if (in_time && last_rise != first_rise) {
+        uint32_t measured = (uint32_t) (((uint64_t) SystemCoreClock * 8U)
+                / (last_rise - first_rise));
+        uint32_t best_diff = UINT32_MAX;
+
+        for (uint8_t i = 0; i < sizeof(autobaud_rates) / sizeof(autobaud_rates[0]); i++) {
+            uint32_t rate = autobaud_rates[i];
+            uint32_t diff = (measured > rate) ? measured - rate : rate - measured;
+            /* Accept within 5 %, compared relative to the candidate */
+            if ((uint64_t) diff * 20U <= rate
+                    && (uint64_t) diff * best < (uint64_t) best_diff * rate) {
+                best = rate;
+                best_diff = diff;
+            }
+        }
+        if (best != 0 && !LabVIEW_UART_SetBaud(best)) {
+            best = 0;
+        }
+    }
+
+    USART2->CR1 |= USART_CR1_RE;
+    return best;
+}
+
 /**
  * @brief Initializes the USART2 peripheral.
  */
@@ -117,11 +580,26 @@ static void USART2_Init(void) {
     volatile uint32_t dummy_read = RCC->APB1ENR; (void)dummy_read;
 
     USART2->CR1 &= ~USART_CR1_UE;
-    USART2->BRR = 0x16D; /* 0x16D corresponds to 115200 baud rate with PCLK1_FREQ of 42MHz */
+    uint32_t brr;
+    uint32_t pclk = USART2_getPclk();
+    /* A rate the clock cannot reach leaves brr unset: fall back to a slow
+     * rate every APB1 clock can produce rather than program garbage */
+    if (!USART2_computeBaud(LABVIEW_UART_BAUDRATE, pclk, &baud_info, &brr)
+            && !USART2_computeBaud(LABVIEW_UART_FALLBACK_BAUDRATE, pclk,
+                    &baud_info, &brr)) {
+        Error_Handler();
+    }
+    USART2->BRR = brr;
+    if (baud_info.over8) {
+        USART2->CR1 |= USART_CR1_OVER8;
+    } else {
+        USART2->CR1 &= ~USART_CR1_OVER8;
+    }
 
     USART2->CR1 &= ~(USART_CR1_M | USART_CR1_PCE);
     USART2->CR2 &= ~USART_CR2_STOP;
-    USART2->CR1 |= (USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE);
+    /* Reception is done by DMA; only the IDLE line event interrupts the CPU */
+    USART2->CR1 |= (USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE);
 
     NVIC_SetPriority(USART2_IRQn, 0);
     NVIC_EnableIRQ(USART2_IRQn);
@@ -130,100 +608,379 @@ static void USART2_Init(void) {
 }
 
 /**
- * @brief Sends a single character via USART2.
+ * @brief Configures DMA1 Stream 5 (Channel 4) to fill the circular RX buffer.
+ * Half-transfer and transfer-complete interrupts together with USART IDLE
+ * detection hand new bytes to the line queue, so at most half a buffer is
+ * ever waiting to be scanned.
  */
-static void USART2_SendChar(char c) {
-    while (!(USART2->SR & USART_SR_TXE));
-    USART2->DR = (c & 0xFF);
+static void USART2_RX_DMA_Init(void) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    (void) RCC->AHB1ENR;
+
+    USART2_RX_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+    while (USART2_RX_DMA_STREAM->CR & DMA_SxCR_EN);
+    DMA1->HIFCR = USART2_RX_DMA_FLAGS;
+
+    USART2_RX_DMA_STREAM->PAR = (uint32_t) &(USART2->DR);
+    USART2_RX_DMA_STREAM->M0AR = (uint32_t) rx_dma_buffer;
+    USART2_RX_DMA_STREAM->NDTR = RX_DMA_BUFFER_SIZE;
+    /* Peripheral-to-memory, byte size, memory increment, circular, HT/TC interrupts */
+    USART2_RX_DMA_STREAM->CR = USART2_RX_DMA_CHANNEL | DMA_SxCR_MINC
+            | DMA_SxCR_CIRC | DMA_SxCR_PL_1 | DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+    /* Direct mode */
+    USART2_RX_DMA_STREAM->FCR = 0;
+
+    rx_dma_last_pos = 0;
+    rx_dma_stall_halves = 0;
+    LineQueue_init(&rx_queue);
+    CmdParser_reset(&rx_parser);
+    Proto_decoderReset(&rx_decoder);
+    rx_in_frame = 0;
+
+    /* Overrun/framing/noise errors raise the USART2 interrupt in DMA mode */
+    USART2->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+    USART2_RX_DMA_STREAM->CR |= DMA_SxCR_EN;
+
+    /* Same priority as USART2 so the two head updates never preempt each other */
+    NVIC_SetPriority(USART2_RX_DMA_IRQn, 0);
+    NVIC_EnableIRQ(USART2_RX_DMA_IRQn);
 }
 
 /**
- * @brief Parses a combined string to find time and an accompanying pump command.
+ * @brief Scans the bytes written by the DMA since the last call into the line queue.
+ * @note Called from the USART2 IDLE and DMA HT/TC interrupts only (single
+ * producer). Since those fire at least twice per buffer lap, the new region
+ * is never ambiguous, except after a flash erase held them back: if the
+ * DMA passed more half-buffer boundaries meanwhile than lie between the
+ * last and the current position, the ring was lapped. The overwritten
+ * bytes are lost; the line or frame they belonged to is dropped.
  */
-static void parse_token(const char* data_str) {
-    int h = 0, m = 0, s = 0;
-    char am_pm_str[3] = {0};
-    int items_matched = 0;
-    int chars_consumed = 0;
-    const char* ptr_search = data_str;
+static void USART2_RX_DMA_Update(void) {
+    uint32_t pos = (RX_DMA_BUFFER_SIZE - USART2_RX_DMA_STREAM->NDTR)
+            & RX_DMA_BUFFER_MASK;
+    uint32_t fresh = (pos - rx_dma_last_pos) & RX_DMA_BUFFER_MASK;
+    uint32_t halves = rx_dma_stall_halves;
 
-    /* Search for the time pattern within the token */
-    while (*ptr_search != '\0') {
-        items_matched = sscanf(ptr_search, "%d:%d:%d %2s%n", &h, &m, &s, am_pm_str, &chars_consumed);
-        if (items_matched == 4) {
-            if ((strcmp(am_pm_str, "AM") == 0 || strcmp(am_pm_str, "PM") == 0) &&
-                (h >= 1 && h <= 12) && (m >= 0 && m <= 59) && (s >= 0 && s <= 59)) {
-                break; /* Found a valid time pattern */
-            } else {
-                items_matched = 0; /* Invalid values, continue search */
-            }
+    if (fresh || halves) {
+        rx_last_tick = Delay_getTick();
+    }
+    if (halves) {
+        uint32_t crossed = (rx_dma_last_pos + fresh) / (RX_DMA_BUFFER_SIZE / 2)
+                - rx_dma_last_pos / (RX_DMA_BUFFER_SIZE / 2);
+        rx_dma_stall_halves = 0;
+        if (halves > crossed) {
+            rx_stats.dma_laps++;
+            HEALTH_INC(HEALTH_UART_RX_LAP);
+            LineQueue_dropLine(&rx_queue);
+            rx_in_frame = 0;
+            rx_dma_last_pos = pos;
         }
-        ptr_search++;
     }
 
-    if (items_matched == 4) {
-        /* Time part was valid, update globals */
-        parsed_hour = (uint8_t)h;
-        parsed_minute = (uint8_t)m;
-        parsed_second = (uint8_t)s;
-        if (strcmp(am_pm_str, "PM") == 0 && parsed_hour != 12) parsed_hour += 12;
-        else if (strcmp(am_pm_str, "AM") == 0 && parsed_hour == 12) parsed_hour = 0;
+    while (rx_dma_last_pos != pos) {
+        USART2_RX_routeByte(rx_dma_buffer[rx_dma_last_pos]);
+        rx_dma_last_pos = (rx_dma_last_pos + 1) & RX_DMA_BUFFER_MASK;
+    }
+}
 
-        /* Now, check for an accompanying pump command */
-        char pump_cmd_char = ptr_search[chars_consumed];
-        if (pump_cmd_char == '1') {
-            labview_pump_command = 1;
-        } else if (pump_cmd_char == '0') {
-            labview_pump_command = 0;
+/**
+ * @brief Sends one received byte to the text line queue or the frame decoder.
+ * A 0x00 outside a frame opens a binary frame, the next 0x00 after frame
+ * data closes it; everything else is text.
+ */
+static void USART2_RX_routeByte(uint8_t byte) {
+    if (!rx_in_frame) {
+        if (byte == 0x00) {
+            rx_in_frame = 1;
+            Proto_decoderReset(&rx_decoder);
+        } else {
+            LineQueue_putChar(&rx_queue, (char) byte);
         }
+        return;
+    }
 
-        /* Perform actions based on newly parsed data */
-        DS3231_setTime(parsed_hour, parsed_minute, parsed_second);
+    proto_frame_t frame;
+    proto_decode_result_t result = Proto_decoderPut(&rx_decoder, byte, &frame);
 
-    } else if (strlen(data_str) == 1) { /* Check if it was a simple pump command */
-        if (data_str[0] == '1') {
-            labview_pump_command = 1;
-        } else if (data_str[0] == '0') {
-            labview_pump_command = 0;
+    if (result == PROTO_DECODE_FRAME) {
+        uint32_t head = rx_frame_head;
+        if (head - rx_frame_tail < RX_FRAME_SLOTS) {
+            rx_frames[head & (RX_FRAME_SLOTS - 1)] = frame;
+            /* Publish the slot before the new head */
+            __DMB();
+            rx_frame_head = head + 1;
+            rx_stats.frames++;
+        } else {
+            rx_stats.frame_drops++;
+            HEALTH_INC(HEALTH_UART_RX_DROP);
         }
-    } else {
-        /* If no valid time pattern was found, set error flag */
-        new_data_received_flag = 2; /* Set error flag */
+    } else if (result == PROTO_DECODE_ERROR) {
+        HEALTH_INC(HEALTH_UART_BAD_FRAME);
+    }
+    /* A delimiter after frame data ends the frame; back-to-back 0x00 are idle */
+    if (result != PROTO_DECODE_BUSY) {
+        rx_in_frame = 0;
+    }
+}
+
+/**
+ * @brief Configures DMA1 Stream 6 (Channel 4) to feed USART2_DR from the TX ring.
+ */
+static void USART2_TX_DMA_Init(void) {
+    UartMux_initChannel(&tx_mux, PROTO_CH_CONTROL, tx_control_buffer,
+            TX_CONTROL_SIZE);
+    UartMux_initChannel(&tx_mux, PROTO_CH_TELEMETRY, tx_telemetry_buffer,
+            TX_TELEMETRY_SIZE);
+    UartMux_initChannel(&tx_mux, PROTO_CH_LOG, tx_log_buffer, TX_LOG_SIZE);
+    UartMux_initChannel(&tx_mux, PROTO_CH_BULK, tx_bulk_buffer, TX_BULK_SIZE);
+    UartMux_reset(&tx_mux);
+    tx_dma_len = 0;
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    (void) RCC->AHB1ENR;
+
+    USART2_TX_DMA_STREAM->CR &= ~DMA_SxCR_EN;
+    while (USART2_TX_DMA_STREAM->CR & DMA_SxCR_EN);
+    DMA1->HIFCR = USART2_TX_DMA_FLAGS;
+
+    USART2_TX_DMA_STREAM->PAR = (uint32_t) &(USART2->DR);
+    /* Memory-to-peripheral, byte size, memory increment, TC and TE interrupts */
+    USART2_TX_DMA_STREAM->CR = USART2_TX_DMA_CHANNEL | DMA_SxCR_DIR_0
+            | DMA_SxCR_MINC | DMA_SxCR_PL_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    /* Direct mode */
+    USART2_TX_DMA_STREAM->FCR = 0;
+
+    USART2->CR3 |= USART_CR3_DMAT;
+
+    NVIC_SetPriority(USART2_TX_DMA_IRQn, 1);
+    NVIC_EnableIRQ(USART2_TX_DMA_IRQn);
+}
+
+/**
+ * @brief Starts a DMA transfer of the next contiguous run if idle.
+ * The multiplexer picks the run: the rest of the current block, or the
+ * next block of the highest-priority channel.
+ * @note Safe to call from thread and interrupt context.
+ */
+static void USART2_TX_DMA_Kick(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (tx_dma_len == 0) {
+        const uint8_t *data;
+        uint16_t length = UartMux_next(&tx_mux, &data);
+
+        if (length != 0) {
+            tx_dma_len = length;
+            DMA1->HIFCR = USART2_TX_DMA_FLAGS;
+            USART2_TX_DMA_STREAM->M0AR = (uint32_t) data;
+            USART2_TX_DMA_STREAM->NDTR = length;
+            USART2_TX_DMA_STREAM->CR |= DMA_SxCR_EN;
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Runs one received line through the command parser and acts on it.
+ * Single linear pass; no libc scanning.
+ */
+static void handle_line(const char *line) {
+    cmd_t cmd;
+    cmd_type_t type;
+
+    while (*line != '\0') {
+        CmdParser_putChar(&rx_parser, *line++, &cmd);
+    }
+    type = CmdParser_putChar(&rx_parser, '\n', &cmd);
+
+    switch (type) {
+    case CMD_SET_TIME:
+        parsed_hour = cmd.hour;
+        parsed_minute = cmd.minute;
+        parsed_second = cmd.second;
+        if (cmd.pump >= 0) {
+            labview_pump_command = (uint8_t) cmd.pump;
+        }
+        DS3231_setTime(parsed_hour, parsed_minute, parsed_second);
+        break;
+    case CMD_PUMP:
+        labview_pump_command = (uint8_t) cmd.pump;
+        break;
+    case CMD_KEYED:
+        for (uint8_t i = 0; i < labview_command_count; i++) {
+            if (strcmp(labview_commands[i].key, cmd.key) == 0) {
+                labview_commands[i].handler(cmd.args, cmd.argc);
+                return;
+            }
+        }
+        rx_stats.parse_errors++;
+        HEALTH_INC(HEALTH_UART_PARSE);
+        break;
+    case CMD_ERROR:
+        /* No valid command found, count the parse error */
+        rx_stats.parse_errors++;
+        HEALTH_INC(HEALTH_UART_PARSE);
         parsed_hour = 0;
         parsed_minute = 0;
         parsed_second = 0;
         labview_pump_command = 0; /* Reset pump command */
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Registers a handler for the keyed text command "KEY[ arg,...]".
+ */
+uint8_t LabVIEW_registerCommand(const char *key, labview_cmd_handler_t handler) {
+    if (labview_command_count >= LABVIEW_MAX_COMMANDS || handler == NULL) {
+        return 0;
     }
+    labview_commands[labview_command_count].key = key;
+    labview_commands[labview_command_count].handler = handler;
+    labview_command_count++;
+    return 1;
 }
 
 
+/**
+ * @brief Acts on a binary command frame and answers with ACK or ERROR.
+ */
+static void handle_frame(const proto_frame_t *frame) {
+    uint8_t reply[3];
+    uint8_t error = 0;
+
+    switch (frame->msg_id) {
+    case PROTO_MSG_SET_TIME:
+        if (frame->len != 3) {
+            error = PROTO_ERR_BAD_LENGTH;
+        } else if (frame->payload[0] > 23 || frame->payload[1] > 59
+                || frame->payload[2] > 59) {
+            error = PROTO_ERR_BAD_VALUE;
+        } else {
+            parsed_hour = frame->payload[0];
+            parsed_minute = frame->payload[1];
+            parsed_second = frame->payload[2];
+            DS3231_setTime(parsed_hour, parsed_minute, parsed_second);
+        }
+        break;
+    case PROTO_MSG_PUMP:
+        if (frame->len != 1) {
+            error = PROTO_ERR_BAD_LENGTH;
+        } else if (frame->payload[0] > 1) {
+            error = PROTO_ERR_BAD_VALUE;
+        } else {
+            labview_pump_command = frame->payload[0];
+        }
+        break;
+    case PROTO_MSG_SUBSCRIBE:
+        if (frame->len != 7) {
+            error = PROTO_ERR_BAD_LENGTH;
+        } else if (!LabVIEW_Sub_subscribe(frame->payload[0],
+                (uint32_t) (frame->payload[1] | (frame->payload[2] << 8)),
+                (uint16_t) (frame->payload[3] | (frame->payload[4] << 8)),
+                (uint16_t) (frame->payload[5] | (frame->payload[6] << 8)))) {
+            error = PROTO_ERR_BAD_VALUE;
+        }
+        break;
+    case PROTO_MSG_UNSUBSCRIBE:
+        if (frame->len != 1) {
+            error = PROTO_ERR_BAD_LENGTH;
+        } else if (!LabVIEW_Sub_unsubscribe(frame->payload[0])) {
+            error = PROTO_ERR_BAD_VALUE;
+        }
+        break;
+    default:
+        error = PROTO_ERR_UNKNOWN_MSG;
+        break;
+    }
+
+    if (error) {
+        reply[0] = error;
+        reply[1] = frame->msg_id;
+        reply[2] = frame->seq;
+        LabVIEW_Send_Frame(PROTO_MSG_ERROR, reply, 3);
+    } else {
+        reply[0] = frame->msg_id;
+        reply[1] = frame->seq;
+        LabVIEW_Send_Frame(PROTO_MSG_ACK, reply, 2);
+    }
+}
+
 /**
  * @brief This function handles the USART2 global interrupt.
+ * Only IDLE line and receive errors are enabled; data is moved by DMA.
  */
 void USART2_IRQHandler(void) {
-    /* Check for Overrun Error (ORE) */
-    if (USART2->SR & USART_SR_ORE) {
-        volatile uint32_t temp_read = USART2->DR; /* Read DR to clear ORE */
+    uint32_t status = USART2->SR;
+
+    TRACE_BEGIN(TRACE_ID_USART2);
+    if (status & (USART_SR_IDLE | USART_SR_ORE | USART_SR_FE | USART_SR_NE)) {
+        /* SR read followed by DR read clears IDLE and the error flags */
+        volatile uint32_t temp_read = USART2->DR;
         (void)temp_read; /* Prevent unused variable warning */
-        rx_index = 0; /* Reset index on overrun error */
-        new_data_received_flag = 0; /* Reset new data flag */
-        return;
+
+        if (status & USART_SR_ORE) {
+            rx_stats.overruns++;
+            HEALTH_INC(HEALTH_UART_OVERRUN);
+        }
+        if (status & (USART_SR_FE | USART_SR_NE)) {
+            rx_stats.framing_errors++;
+            HEALTH_INC(HEALTH_UART_FRAMING);
+        }
+        USART2_RX_DMA_Update();
     }
+    TRACE_END(TRACE_ID_USART2);
+}
 
-    if (USART2->SR & USART_SR_RXNE) {
-        char received_char = (char)(USART2->DR & 0xFF);
-        if (new_data_received_flag == 0) {
-            if (received_char == '\n' || received_char == '\r') {
-                if (rx_index > 0) {
-                    new_data_received_flag = 1;
-                }
-            } else {
-                if (rx_index < RX_BUFFER_SIZE - 1) {
-                    rx_buffer[rx_index++] = received_char;
-                } else {
-                    rx_index = 0;
-                }
-            }
+/**
+ * @brief This function handles DMA1 Stream 5 (USART2_RX) interrupts.
+ * Half and full buffer events publish the bytes received so far.
+ */
+void DMA1_Stream5_IRQHandler(void) {
+    uint32_t status = DMA1->HISR;
+
+    TRACE_BEGIN(TRACE_ID_RX_DMA);
+    /* Also pended with no flag set after a flash erase, to catch up */
+    if (status & (DMA_HISR_HTIF5 | DMA_HISR_TCIF5 | DMA_HISR_TEIF5)) {
+        DMA1->HIFCR = USART2_RX_DMA_FLAGS;
+    }
+    USART2_RX_DMA_Update();
+    TRACE_END(TRACE_ID_RX_DMA);
+}
+
+/**
+ * @brief Runs instead of DMA1_Stream5_IRQHandler during a flash erase.
+ * Touches RAM and peripheral registers only.
+ */
+FLASHLOG_RAMFUNC void LabVIEW_UART_rxStallHandler(void) {
+    uint32_t status = DMA1->HISR;
+
+    DMA1->HIFCR = USART2_RX_DMA_FLAGS;
+    rx_dma_stall_halves += ((status & DMA_HISR_HTIF5) ? 1 : 0)
+            + ((status & DMA_HISR_TCIF5) ? 1 : 0);
+}
+
+/**
+ * @brief This function handles DMA1 Stream 6 (USART2_TX) interrupts.
+ * Releases the run just sent and chains the next one.
+ */
+void DMA1_Stream6_IRQHandler(void) {
+    uint32_t status = DMA1->HISR;
+
+    TRACE_BEGIN(TRACE_ID_TX_DMA);
+    if (status & (DMA_HISR_TCIF6 | DMA_HISR_TEIF6)) {
+        DMA1->HIFCR = USART2_TX_DMA_FLAGS;
+        if (status & DMA_HISR_TEIF6) {
+            /* Count what the failed transfer was carrying as dropped */
+            tx_dma_error_bytes += tx_dma_len;
         }
+        UartMux_complete(&tx_mux);
+        tx_dma_len = 0;
+        USART2_TX_DMA_Kick();
     }
+    TRACE_END(TRACE_ID_TX_DMA);
 }
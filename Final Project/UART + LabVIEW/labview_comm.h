@@ -4,6 +4,17 @@
 #include "stm32f4xx.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include "labview_proto.h"
+#include "uart_mux.h"
+#include "clock_mgr.h"
+
+/**
+ * @brief  Wire protocol spoken with the host.
+ */
+typedef enum {
+    LABVIEW_PROTOCOL_TEXT = 0,  /* Decimal lines, see LabVIEW_Send_Value */
+    LABVIEW_PROTOCOL_BINARY     /* COBS/CRC16 frames, see labview_proto.h */
+} labview_protocol_t;
 
 /*
  * @brief  Global variables to store the last successfully parsed data from LabVIEW.
@@ -16,12 +27,180 @@ extern volatile uint8_t parsed_minute;
 extern volatile uint8_t parsed_second;
 extern volatile uint8_t labview_pump_command;
 
+/* Line rate programmed by LabVIEW_UART_Init */
+#define LABVIEW_UART_BAUDRATE            115200UL
+/* Used instead when the APB1 clock cannot produce LABVIEW_UART_BAUDRATE */
+#define LABVIEW_UART_FALLBACK_BAUDRATE   9600UL
+/* Largest baud rate error accepted by LabVIEW_UART_SetBaud, in ppm */
+#define LABVIEW_UART_MAX_BAUD_ERROR_PPM  20000
+/* 1: after boot, wait for a 'U' from the host and adopt its baud rate */
+#define LABVIEW_UART_AUTOBAUD            0
+#define LABVIEW_UART_AUTOBAUD_TIMEOUT_MS 2000U
+
+/* Keyed text commands that can be registered */
+#define LABVIEW_MAX_COMMANDS  8
+
+/**
+ * @brief  Handler for a keyed text command "KEY[ arg[,arg...]]".
+ * @param  args Parsed integer arguments
+ * @param  argc Number of arguments (0 to CMD_ARGS_MAX)
+ */
+typedef void (*labview_cmd_handler_t)(const int32_t *args, uint8_t argc);
+
+/**
+ * @brief  Baud rate currently programmed into USART2.
+ */
+typedef struct {
+    uint32_t requested;  /* Rate asked for, in baud */
+    uint32_t actual;     /* Rate produced by the BRR divider, in baud */
+    uint32_t pclk;       /* APB1 clock the divider was computed from, in Hz */
+    int32_t error_ppm;   /* (actual - requested) / requested, in ppm */
+    uint8_t over8;       /* 1 if 8x oversampling was needed */
+} labview_baud_t;
+
+/**
+ * @brief  Transmit path statistics.
+ */
+typedef struct {
+    uint32_t dropped_bytes;  /* Bytes rejected because a TX ring was full */
+    uint32_t dropped_blocks; /* Calls to the send functions that were dropped */
+    uint16_t high_watermark; /* Highest fill level seen in any TX ring, in bytes */
+    uint16_t used;           /* Bytes currently waiting in the TX rings */
+} labview_tx_stats_t;
+
+/**
+ * @brief  Receive path statistics.
+ */
+typedef struct {
+    uint32_t overruns;         /* USART overrun errors (ORE) */
+    uint32_t framing_errors;   /* Framing or noise errors (FE/NE) */
+    uint32_t parse_errors;     /* Lines that matched no known command */
+    uint32_t lines;            /* Complete lines queued by the receive ISR */
+    uint32_t queue_full_drops; /* Lines dropped because the line queue was full */
+    uint32_t line_overflows;   /* Lines longer than a queue slot, discarded */
+    uint8_t queue_high_watermark; /* Most lines ever pending at once */
+    uint32_t frames;              /* Valid binary frames received */
+    uint32_t frame_drops;         /* Valid frames dropped, frame queue full */
+    uint32_t frame_crc_errors;    /* Binary frames failing the CRC16 check */
+    uint32_t frame_format_errors; /* Truncated, oversized or wrong-version frames */
+    uint32_t dma_laps;            /* RX DMA ring overwritten before it was read */
+} labview_rx_stats_t;
+
 /**
  * @brief  Initializes the UART peripheral and GPIO pins for LabVIEW communication.
  * @note   This function must be called once during system initialization.
  */
 void LabVIEW_UART_Init(void);
 
+/**
+ * @brief  Changes the USART2 baud rate.
+ * @param  baud Rate in baud, up to PCLK1/8 (5.25 Mbaud at 42 MHz)
+ * @return 1 if set, 0 if unreachable within LABVIEW_UART_MAX_BAUD_ERROR_PPM
+ * @note   BRR is computed from the live APB1 clock. Blocks until the
+ * transmitter is idle; do not call with interrupts disabled.
+ */
+uint8_t LabVIEW_UART_SetBaud(uint32_t baud);
+
+/**
+ * @brief  Copies the programmed baud rate and its error.
+ * @param  info Destination structure
+ */
+void LabVIEW_UART_getBaud(labview_baud_t *info);
+
+/**
+ * @brief  Detects the host's baud rate from one 'U' (0x55) character.
+ * @param  timeout_ms How long to wait for the character, at most 50000
+ * @return The rate adopted, or 0 on timeout or an unrecognised rate
+ * @note   Blocking, with interrupts masked while waiting: intended for
+ * start-up. Recognises 9600 to 2000000 baud.
+ */
+uint32_t LabVIEW_UART_AutoBaud(uint32_t timeout_ms);
+
+/**
+ * @brief  Queues a block of bytes for transmission to LabVIEW.
+ * @param  data Pointer to the bytes to send
+ * @param  length Number of bytes
+ * @return 1 if queued, 0 if the TX ring had no room (block dropped)
+ * @note   Non-blocking: the bytes are copied into the telemetry channel ring,
+ * drained by DMA1 Stream 6. Safe to call from thread context and from
+ * interrupt handlers.
+ */
+uint8_t LabVIEW_UART_SendBuffer(const uint8_t *data, uint16_t length);
+
+/**
+ * @brief  Queues a block of bytes on one logical channel.
+ * @param  channel proto_channel_t; lower channels are sent first, switching
+ * only between blocks
+ * @return 1 if queued, 0 if the channel ring had no room (block dropped)
+ */
+uint8_t LabVIEW_UART_SendOn(uint8_t channel, const uint8_t *data,
+        uint16_t length);
+
+/**
+ * @brief  Sends a debug log line on the log channel (PROTO_MSG_LOG).
+ * @param  text NUL-terminated text, truncated to PROTO_MAX_PAYLOAD
+ * @return 1 if queued, 0 if dropped
+ * @note   Only sent while the host speaks the binary protocol, so logs never
+ * corrupt a text-mode LabVIEW stream.
+ */
+uint8_t LabVIEW_Log(const char *text);
+
+/**
+ * @brief  Copies the TX drop and high-watermark counters of all channels.
+ * @param  stats Destination structure
+ */
+void LabVIEW_UART_getTxStats(labview_tx_stats_t *stats);
+
+/**
+ * @brief  Copies the byte, drop and preemption counters of one channel.
+ * @param  channel proto_channel_t
+ * @param  stats Destination structure
+ */
+void LabVIEW_UART_getChannelStats(uint8_t channel, uart_mux_stats_t *stats);
+
+/**
+ * @brief  Copies the reception error counters.
+ * @param  stats Destination structure
+ */
+void LabVIEW_UART_getRxStats(labview_rx_stats_t *stats);
+
+/**
+ * @brief  Reports whether the transmitter still has bytes to send.
+ * @return 1 while the TX ring or the shift register is not empty
+ */
+uint8_t LabVIEW_UART_isTxBusy(void);
+
+/**
+ * @brief  Clock switch notifier for USART2.
+ * @note   Register with ClockMgr_registerNotifier. Refuses a switch while
+ *         bytes wait to be sent or when the new PCLK1 cannot reach the
+ *         current baud rate within LABVIEW_UART_MAX_BAUD_ERROR_PPM.
+ */
+uint8_t LabVIEW_UART_clockNotifier(clock_event_t event,
+        const clock_info_t *info);
+
+/**
+ * @brief  Reports whether received lines or frames wait for
+ *         LabVIEW_UART_ProcessData.
+ * @return 1 if there is input to process
+ */
+uint8_t LabVIEW_UART_hasPending(void);
+
+/**
+ * @brief  Reports whether the receive side has been idle for a while.
+ * @param  ms Time without received bytes, in milliseconds
+ * @return 1 if nothing arrived for 'ms' and no input waits to be processed
+ */
+uint8_t LabVIEW_UART_isRxQuiet(uint32_t ms);
+
+/**
+ * @brief  Stand-in for DMA1_Stream5_IRQHandler while a flash sector is
+ *         erased: counts the half-buffer events so that the next update can
+ *         tell whether the DMA ring was lapped meanwhile.
+ * @note   Register with FlashLog_registerStallHandler. Runs from RAM.
+ */
+void LabVIEW_UART_rxStallHandler(void);
+
 /**
  * @brief  Sends a single character to LabVIEW via UART.
  * @param  c Character to send
@@ -31,17 +210,27 @@ void LabVIEW_UART_SendChar(char c);
 /**
  * @brief  Sends a string to LabVIEW via UART.
  * @param  str Pointer to the null-terminated string to send
+ * @note   Non-blocking: the string is queued in the TX ring.
  */
 void LabVIEW_UART_SendString(const char* str);
 
 /**
  * @brief  Checks for and processes any complete data lines received from LabVIEW.
  * @note   This function should be called repeatedly in the main application loop.
- * It is non-blocking. It handles tokenizing the buffer if multiple
- * commands are received in one batch.
+ * It is non-blocking. The receive interrupts split the DMA stream into
+ * lines on a lock-free queue; every pending line is handled per call.
  */
 void LabVIEW_UART_ProcessData(void);
 
+/**
+ * @brief  Registers a handler for a keyed text command.
+ * @param  key Keyword, [A-Z][A-Z0-9_]*, at most CMD_KEY_MAX characters.
+ * The string is not copied and must outlive the registration.
+ * @param  handler Called from LabVIEW_UART_ProcessData when the key arrives
+ * @return 1 if registered, 0 if the table is full
+ */
+uint8_t LabVIEW_registerCommand(const char *key, labview_cmd_handler_t handler);
+
 /**
  * @brief  Sends a value to LabVIEW.
  * @param  value The value to send (e.g., soil moisture percentage)
@@ -50,5 +239,40 @@ void LabVIEW_UART_ProcessData(void);
  */
 void LabVIEW_Send_Value(uint16_t value, uint8_t mode, uint8_t pump_state);
 
+/**
+ * @brief  Sends a binary protocol frame (COBS, CRC16) to LabVIEW.
+ * @param  msg_id Message identifier (proto_msg_id_t)
+ * @param  payload Payload bytes
+ * @param  length Payload length, at most PROTO_MAX_PAYLOAD
+ * @return 1 if queued, 0 if dropped
+ */
+uint8_t LabVIEW_Send_Frame(uint8_t msg_id, const uint8_t *payload,
+        uint8_t length);
+
+/**
+ * @brief  Sends a binary frame whose payload is 'header' then 'data'.
+ * @param  header First payload part (may be NULL if header_len is 0)
+ * @param  data Second payload part, e.g. a DMA buffer (NULL if data_len is 0)
+ * @return 1 if queued, 0 if dropped
+ * @note   Encodes straight into the TX ring (one copy). Safe to call from
+ * interrupt handlers.
+ */
+uint8_t LabVIEW_Send_FrameParts(uint8_t msg_id, const uint8_t *header,
+        uint8_t header_len, const uint8_t *data, uint8_t data_len);
+
+/**
+ * @brief  Sends the system status in the protocol the host last used.
+ * @param  telemetry Status record; text hosts receive LabVIEW_Send_Value.
+ * @note   Receiving a valid binary frame switches to binary telemetry,
+ * receiving a text line switches back. While fields are subscribed
+ * (labview_sub.h) only changed or due fields are sent.
+ */
+void LabVIEW_Send_Telemetry(const proto_telemetry_t *telemetry);
+
+/**
+ * @brief  Returns the protocol the host last used.
+ */
+labview_protocol_t LabVIEW_getProtocol(void);
+
 #endif // _LABVIEW_COMM_H_
 
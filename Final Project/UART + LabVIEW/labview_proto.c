@@ -0,0 +1,287 @@
+#include "labview_proto.h"
+
+/* CRC-16/CCITT-FALSE lookup table, one entry per byte value */
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+/**
+ * @brief Writes one output byte, wrapping when the output is a ring.
+ */
+static void enc_write(proto_encoder_t *e, uint16_t pos, uint8_t byte) {
+    e->out[pos & e->mask] = byte;
+}
+
+/**
+ * @brief Appends one byte, closing the block on zero or at 254 literals.
+ * The code byte of the current block is reserved and back-patched when
+ * the block ends, so no intermediate buffer is needed.
+ */
+static void cobs_put(proto_encoder_t *e, uint8_t byte) {
+    if (byte == 0) {
+        enc_write(e, e->code_pos, e->code);
+        e->code_pos = e->pos++;
+        e->code = 1;
+        return;
+    }
+    enc_write(e, e->pos++, byte);
+    if (++e->code == 0xFF) {
+        /* Maximum block length reached, start a new block */
+        enc_write(e, e->code_pos, e->code);
+        e->code_pos = e->pos++;
+        e->code = 1;
+    }
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE update.
+ */
+uint16_t Proto_crc16(uint16_t crc, const uint8_t *data, uint16_t length) {
+    while (length--) {
+        crc = (uint16_t) ((crc << 8) ^ crc16_table[(uint8_t) (crc >> 8) ^ *data++]);
+    }
+    return crc;
+}
+
+/**
+ * @brief Starts a frame: leading delimiter and header.
+ */
+uint8_t Proto_encoderBegin(proto_encoder_t *e, uint8_t *out, uint16_t mask,
+        uint16_t start, uint8_t msg_id, uint8_t seq, uint8_t length) {
+    uint8_t header[PROTO_HEADER_SIZE] = { PROTO_VERSION, msg_id, seq, length };
+
+    if (length > PROTO_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    e->out = out;
+    e->mask = mask;
+    e->start = start;
+    enc_write(e, start, 0x00);
+    e->code_pos = (uint16_t) (start + 1);
+    e->pos = (uint16_t) (start + 2);
+    e->code = 1;
+    e->crc = 0xFFFF;
+    Proto_encoderPut(e, header, PROTO_HEADER_SIZE);
+    return 1;
+}
+
+/**
+ * @brief Appends payload bytes: CRC and COBS in the same pass.
+ */
+void Proto_encoderPut(proto_encoder_t *e, const uint8_t *data, uint16_t length) {
+    uint16_t crc = e->crc;
+
+    while (length--) {
+        uint8_t byte = *data++;
+        crc = (uint16_t) ((crc << 8) ^ crc16_table[(uint8_t) (crc >> 8) ^ byte]);
+        cobs_put(e, byte);
+    }
+    e->crc = crc;
+}
+
+/**
+ * @brief Appends the CRC, closes the last block and the frame.
+ */
+uint16_t Proto_encoderEnd(proto_encoder_t *e) {
+    uint16_t crc = e->crc;
+
+    cobs_put(e, (uint8_t) crc);
+    cobs_put(e, (uint8_t) (crc >> 8));
+    enc_write(e, e->code_pos, e->code);
+    enc_write(e, e->pos++, 0x00);
+    return (uint16_t) (e->pos - e->start);
+}
+
+/**
+ * @brief Builds a complete wire frame (delimiters included).
+ */
+uint16_t Proto_encodeFrame(uint8_t msg_id, uint8_t seq, const uint8_t *payload,
+        uint8_t length, uint8_t *out) {
+    proto_encoder_t enc;
+
+    if (!Proto_encoderBegin(&enc, out, 0xFFFF, 0, msg_id, seq, length)) {
+        return 0;
+    }
+    Proto_encoderPut(&enc, payload, length);
+    return Proto_encoderEnd(&enc);
+}
+
+/**
+ * @brief Returns the logical channel of a message.
+ */
+uint8_t Proto_channelOf(uint8_t msg_id) {
+    switch (msg_id) {
+    case PROTO_MSG_ACK:
+    case PROTO_MSG_ERROR:
+        return PROTO_CH_CONTROL;
+    case PROTO_MSG_LOG:
+        return PROTO_CH_LOG;
+    case PROTO_MSG_ADC_BLOCK:
+    case PROTO_MSG_LOG_DUMP:
+    case PROTO_MSG_HISTORY:
+        return PROTO_CH_BULK;
+    default:
+        return PROTO_CH_TELEMETRY;
+    }
+}
+
+/**
+ * @brief Serialises a telemetry record into a payload buffer.
+ */
+uint8_t Proto_packTelemetry(const proto_telemetry_t *t, uint8_t *payload) {
+    payload[0] = (uint8_t) t->timestamp_ms;
+    payload[1] = (uint8_t) (t->timestamp_ms >> 8);
+    payload[2] = (uint8_t) (t->timestamp_ms >> 16);
+    payload[3] = (uint8_t) (t->timestamp_ms >> 24);
+    payload[4] = (uint8_t) t->moisture_raw;
+    payload[5] = (uint8_t) (t->moisture_raw >> 8);
+    payload[6] = t->moisture_percent;
+    payload[7] = t->mode;
+    payload[8] = t->pump;
+    payload[9] = t->threshold_low;
+    payload[10] = t->threshold_high;
+    payload[11] = t->hours;
+    payload[12] = t->minutes;
+    payload[13] = t->seconds;
+    return PROTO_TELEMETRY_SIZE;
+}
+
+/**
+ * @brief Parses a telemetry payload (host side).
+ */
+uint8_t Proto_unpackTelemetry(const uint8_t *payload, uint8_t length,
+        proto_telemetry_t *t) {
+    if (length != PROTO_TELEMETRY_SIZE) {
+        return 0;
+    }
+    t->timestamp_ms = (uint32_t) payload[0] | ((uint32_t) payload[1] << 8)
+            | ((uint32_t) payload[2] << 16) | ((uint32_t) payload[3] << 24);
+    t->moisture_raw = (uint16_t) (payload[4] | (payload[5] << 8));
+    t->moisture_percent = payload[6];
+    t->mode = payload[7];
+    t->pump = payload[8];
+    t->threshold_low = payload[9];
+    t->threshold_high = payload[10];
+    t->hours = payload[11];
+    t->minutes = payload[12];
+    t->seconds = payload[13];
+    return 1;
+}
+
+/**
+ * @brief Resets the decoder to wait for the next frame.
+ */
+void Proto_decoderReset(proto_decoder_t *d) {
+    d->len = 0;
+    d->remaining = 0;
+    d->code = 0;
+    d->started = 0;
+    d->overflow = 0;
+}
+
+/**
+ * @brief Checks version, length and CRC of a decoded raw frame.
+ */
+static proto_decode_result_t Proto_validate(proto_decoder_t *d,
+        proto_frame_t *frame) {
+    const uint8_t *raw = d->raw;
+
+    if (d->len < PROTO_HEADER_SIZE + PROTO_CRC_SIZE || raw[0] != PROTO_VERSION
+            || raw[3] != d->len - PROTO_HEADER_SIZE - PROTO_CRC_SIZE) {
+        d->format_errors++;
+        return PROTO_DECODE_ERROR;
+    }
+
+    uint16_t crc = Proto_crc16(0xFFFF, raw, d->len - PROTO_CRC_SIZE);
+    if ((uint8_t) crc != raw[d->len - 2] || (uint8_t) (crc >> 8) != raw[d->len - 1]) {
+        d->crc_errors++;
+        return PROTO_DECODE_ERROR;
+    }
+
+    frame->msg_id = raw[1];
+    frame->seq = raw[2];
+    frame->len = raw[3];
+    for (uint8_t i = 0; i < frame->len; i++) {
+        frame->payload[i] = raw[PROTO_HEADER_SIZE + i];
+    }
+    return PROTO_DECODE_FRAME;
+}
+
+/**
+ * @brief Feeds one wire byte to the decoder.
+ * COBS is undone on the fly: each code byte announces how many literal
+ * bytes follow, and every block shorter than 0xFF implies a zero before
+ * the next block. The implied zero of the last block is dropped.
+ */
+proto_decode_result_t Proto_decoderPut(proto_decoder_t *d, uint8_t byte,
+        proto_frame_t *frame) {
+    proto_decode_result_t result = PROTO_DECODE_BUSY;
+
+    if (byte == 0x00) {
+        if (d->started) {
+            if (d->remaining != 0 || d->overflow) {
+                d->format_errors++;
+                result = PROTO_DECODE_ERROR;
+            } else {
+                result = Proto_validate(d, frame);
+            }
+        }
+        Proto_decoderReset(d);
+        return result;
+    }
+
+    if (d->remaining == 0) {
+        /* Code byte: the previous short block ended with an implied zero */
+        if (d->started && d->code != 0xFF) {
+            if (d->len < PROTO_MAX_RAW) {
+                d->raw[d->len++] = 0x00;
+            } else {
+                d->overflow = 1;
+            }
+        }
+        d->code = byte;
+        d->remaining = byte - 1;
+        d->started = 1;
+        return result;
+    }
+
+    if (d->len < PROTO_MAX_RAW) {
+        d->raw[d->len++] = byte;
+    } else {
+        d->overflow = 1;
+    }
+    d->remaining--;
+    return result;
+}
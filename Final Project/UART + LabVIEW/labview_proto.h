@@ -0,0 +1,208 @@
+#ifndef LABVIEW_PROTO_H_
+#define LABVIEW_PROTO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Binary LabVIEW protocol, version 1.
+ *
+ * Wire format:  0x00 | COBS( raw frame ) | 0x00
+ * Raw frame:    version | msg_id | seq | len | payload[len] | crc16_lo | crc16_hi
+ *
+ * The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over version..payload.
+ * COBS removes every 0x00 from the frame so the delimiters are unambiguous,
+ * and text lines (which never contain 0x00) can share the same link.
+ * All multi-byte payload fields are little-endian.
+ */
+
+#define PROTO_VERSION           1
+#define PROTO_HEADER_SIZE       4
+#define PROTO_CRC_SIZE          2
+#define PROTO_MAX_PAYLOAD       80  /* Fits a 32-sample PROTO_MSG_ADC_BLOCK */
+#define PROTO_MAX_RAW           (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE)
+/* Wire bytes for a payload: delimiters + COBS overhead (one code byte per 254) */
+#define PROTO_WIRE_SIZE(len)    ((len) + PROTO_HEADER_SIZE + PROTO_CRC_SIZE \
+                                + ((len) + PROTO_HEADER_SIZE + PROTO_CRC_SIZE) / 254 + 3)
+#define PROTO_MAX_WIRE          PROTO_WIRE_SIZE(PROTO_MAX_PAYLOAD)
+
+/**
+ * @brief Message identifiers.
+ */
+typedef enum {
+    PROTO_MSG_TELEMETRY  = 0x01, /* MCU -> host, proto_telemetry_t */
+    PROTO_MSG_ADC_BLOCK  = 0x02, /* MCU -> host, block_seq u32, cycles u32, samples u16[] */
+    PROTO_MSG_FIELDS     = 0x03, /* MCU -> host, subscribed fields, see labview_sub.h */
+    PROTO_MSG_LOG        = 0x04, /* MCU -> host, debug text (no terminator) */
+    PROTO_MSG_HEALTH     = 0x05, /* MCU -> host, u32 counters[], see health.h */
+    PROTO_MSG_LOG_DUMP   = 0x06, /* MCU -> host, 8-byte log slots, see log_record.h */
+    PROTO_MSG_HISTORY    = 0x07, /* MCU -> host, one ts_codec block, see history.h */
+    PROTO_MSG_SET_TIME   = 0x10, /* host -> MCU, hh mm ss (24 h) */
+    PROTO_MSG_PUMP       = 0x11, /* host -> MCU, state (0/1) */
+    PROTO_MSG_SUBSCRIBE  = 0x12, /* host -> MCU, field, deadband, min_ms, heartbeat_ms */
+    PROTO_MSG_UNSUBSCRIBE = 0x13, /* host -> MCU, field */
+    PROTO_MSG_ACK        = 0x20, /* MCU -> host, acked msg_id, acked seq */
+    PROTO_MSG_ERROR      = 0x21  /* MCU -> host, error code, msg_id, seq */
+} proto_msg_id_t;
+
+/**
+ * @brief Logical channels sharing the link, highest priority first.
+ * Each message belongs to one channel (Proto_channelOf); the firmware
+ * queues channels separately and lets higher channels overtake lower ones
+ * at frame boundaries. Legacy text lines travel on PROTO_CH_TELEMETRY.
+ */
+typedef enum {
+    PROTO_CH_CONTROL = 0,        /* ACK / ERROR responses */
+    PROTO_CH_TELEMETRY,          /* Status records, subscribed fields, text lines */
+    PROTO_CH_LOG,                /* Debug logs */
+    PROTO_CH_BULK                /* Waveform blocks, dumps */
+} proto_channel_t;
+
+/**
+ * @brief Error codes carried by PROTO_MSG_ERROR.
+ */
+typedef enum {
+    PROTO_ERR_UNKNOWN_MSG = 1,   /* msg_id not handled by the firmware */
+    PROTO_ERR_BAD_LENGTH  = 2,   /* Payload length wrong for msg_id */
+    PROTO_ERR_BAD_VALUE   = 3    /* Field out of range */
+} proto_error_t;
+
+/**
+ * @brief Telemetry payload (PROTO_MSG_TELEMETRY), 14 bytes on the wire.
+ */
+typedef struct {
+    uint32_t timestamp_ms;   /* Milliseconds since boot */
+    uint16_t moisture_raw;   /* Averaged ADC reading */
+    uint8_t moisture_percent;
+    uint8_t mode;            /* 0 = AUTO, 1 = MANUAL */
+    uint8_t pump;            /* 0 = OFF, 1 = ON */
+    uint8_t threshold_low;   /* Pump on below this percentage (AUTO) */
+    uint8_t threshold_high;  /* Pump off at or above this percentage (AUTO) */
+    uint8_t hours;
+    uint8_t minutes;
+    uint8_t seconds;
+} proto_telemetry_t;
+
+#define PROTO_TELEMETRY_SIZE    14
+
+/**
+ * @brief A decoded, CRC-checked frame.
+ */
+typedef struct {
+    uint8_t msg_id;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+} proto_frame_t;
+
+/**
+ * @brief Result of feeding a byte to the decoder.
+ */
+typedef enum {
+    PROTO_DECODE_BUSY = 0,   /* Frame in progress (or idle delimiter) */
+    PROTO_DECODE_FRAME,      /* A valid frame was decoded */
+    PROTO_DECODE_ERROR       /* Delimiter reached on a malformed frame */
+} proto_decode_result_t;
+
+/**
+ * @brief Byte-at-a-time COBS decoder state.
+ */
+typedef struct {
+    uint8_t raw[PROTO_MAX_RAW];
+    uint8_t len;             /* Decoded bytes so far */
+    uint8_t remaining;       /* Bytes left in the current COBS block */
+    uint8_t code;            /* Current COBS code byte */
+    uint8_t started;         /* At least one code byte seen */
+    uint8_t overflow;        /* Frame exceeded PROTO_MAX_RAW */
+    uint32_t crc_errors;     /* Frames dropped on CRC mismatch */
+    uint32_t format_errors;  /* Truncated, oversized or bad version frames */
+} proto_decoder_t;
+
+/**
+ * @brief Incremental frame encoder.
+ * Writes COBS output directly into a flat buffer (mask 0xFFFF) or a
+ * power-of-two ring (mask = size - 1), computing the CRC in the same pass.
+ */
+typedef struct {
+    uint8_t *out;
+    uint16_t mask;           /* Output index mask */
+    uint16_t start;          /* Index of the leading delimiter */
+    uint16_t pos;            /* Next output index */
+    uint16_t code_pos;       /* Index reserved for the current code byte */
+    uint8_t code;            /* Length of the current block + 1 */
+    uint16_t crc;            /* Running CRC over version..payload */
+} proto_encoder_t;
+
+/**
+ * @brief CRC-16/CCITT-FALSE update.
+ * @param crc Running value (0xFFFF to start).
+ */
+uint16_t Proto_crc16(uint16_t crc, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Builds a complete wire frame (delimiters included).
+ * @param out Destination, at least PROTO_MAX_WIRE bytes.
+ * @return Number of bytes written, 0 if the payload is too long.
+ */
+uint16_t Proto_encodeFrame(uint8_t msg_id, uint8_t seq, const uint8_t *payload,
+        uint8_t length, uint8_t *out);
+
+/**
+ * @brief Starts an incremental frame at out[start & mask].
+ * @param length Total payload bytes that Proto_encoderPut will supply
+ * @return 1 on success, 0 if the payload is too long.
+ * @note The caller must have PROTO_WIRE_SIZE(length) bytes free.
+ */
+uint8_t Proto_encoderBegin(proto_encoder_t *e, uint8_t *out, uint16_t mask,
+        uint16_t start, uint8_t msg_id, uint8_t seq, uint8_t length);
+
+/**
+ * @brief Appends payload bytes; may be called several times per frame.
+ */
+void Proto_encoderPut(proto_encoder_t *e, const uint8_t *data, uint16_t length);
+
+/**
+ * @brief Finishes the frame.
+ * @return Number of bytes written, delimiters included.
+ */
+uint16_t Proto_encoderEnd(proto_encoder_t *e);
+
+/**
+ * @brief Returns the logical channel (proto_channel_t) of a message.
+ * Hosts use it to split a decoded stream per channel.
+ */
+uint8_t Proto_channelOf(uint8_t msg_id);
+
+/**
+ * @brief Serialises a telemetry record into a payload buffer.
+ * @return PROTO_TELEMETRY_SIZE.
+ */
+uint8_t Proto_packTelemetry(const proto_telemetry_t *t, uint8_t *payload);
+
+/**
+ * @brief Parses a telemetry payload (host side).
+ * @return 1 on success, 0 if the length is wrong.
+ */
+uint8_t Proto_unpackTelemetry(const uint8_t *payload, uint8_t length,
+        proto_telemetry_t *t);
+
+/**
+ * @brief Resets the decoder to wait for the next frame.
+ */
+void Proto_decoderReset(proto_decoder_t *d);
+
+/**
+ * @brief Feeds one wire byte to the decoder.
+ * @param frame Receives the frame when PROTO_DECODE_FRAME is returned.
+ */
+proto_decode_result_t Proto_decoderPut(proto_decoder_t *d, uint8_t byte,
+        proto_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LABVIEW_PROTO_H_ */
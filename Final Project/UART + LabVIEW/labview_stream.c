@@ -0,0 +1,221 @@
+#include "labview_stream.h"
+#include "labview_comm.h"
+#include "adc.h"
+#include "trace.h"
+
+/* ADC1 transfers on DMA2 Stream 0 */
+#define STREAM_ADC              ADC1
+#define STREAM_DMA_IRQn         DMA2_Stream0_IRQn
+/* 8N1: start, 8 data and stop bits per byte */
+#define STREAM_UART_BITS        10U
+
+static const uint16_t *stream_buffer = 0;
+static uint16_t stream_half = 0;            /* Samples per half-buffer */
+static volatile uint8_t stream_active = 0;
+static uint8_t stream_requested = 0;        /* Started, possibly held */
+static uint8_t stream_hold = 0;
+static uint16_t stream_decimation = 1;
+static uint16_t stream_skip = 0;            /* Blocks left before the next send */
+static uint32_t stream_seq = 0;             /* Half-buffers completed */
+static volatile labview_stream_stats_t stream_stats;
+
+static void LabVIEW_Stream_sendBlock(const uint16_t *samples, uint32_t cycles);
+static void LabVIEW_Stream_command(const int32_t *args, uint8_t argc);
+static void LabVIEW_Stream_enable(void);
+static uint16_t LabVIEW_Stream_minDecimation(void);
+
+/**
+ * @brief Attaches the stream to the ADC1 circular DMA buffer.
+ */
+void LabVIEW_Stream_Init(const uint16_t *buffer, uint16_t length) {
+    if (length / 2 > LABVIEW_STREAM_MAX_SAMPLES) {
+        return; /* A half-buffer would not fit in one frame */
+    }
+    stream_buffer = buffer;
+    stream_half = length / 2;
+
+    NVIC_SetPriority(STREAM_DMA_IRQn, 1);
+    NVIC_EnableIRQ(STREAM_DMA_IRQn);
+
+    LabVIEW_registerCommand("STREAM", LabVIEW_Stream_command);
+}
+
+/**
+ * @brief Starts streaming one block out of every 'decimation'.
+ */
+void LabVIEW_Stream_Start(uint16_t decimation) {
+    if (stream_buffer == 0) {
+        return;
+    }
+    stream_decimation = (decimation == 0) ? 1 : decimation;
+    stream_requested = 1;
+    if (!stream_hold) {
+        LabVIEW_Stream_enable();
+    }
+}
+
+/**
+ * @brief Sends blocks from the next ADC DMA interrupt on.
+ */
+static void LabVIEW_Stream_enable(void) {
+    uint16_t min_decimation = LabVIEW_Stream_minDecimation();
+
+    if (stream_decimation < min_decimation) {
+        stream_decimation = min_decimation;
+    }
+    stream_skip = 0;
+    stream_active = 1;
+
+    ADC_DMA_clearFlag(STREAM_ADC, ADC_DMA_FLAG_HT);
+    ADC_DMA_clearFlag(STREAM_ADC, ADC_DMA_FLAG_TC);
+    ADC_DMA_enableInterrupt(STREAM_ADC, ADC_DMA_FLAG_HT);
+    ADC_DMA_enableInterrupt(STREAM_ADC, ADC_DMA_FLAG_TC);
+}
+
+/**
+ * @brief Smallest decimation whose blocks the UART can carry: the ADC
+ * block rate at the live APB2 clock, times the framed block size, against
+ * LABVIEW_STREAM_LINK_SHARE_PCT of the actual baud rate.
+ */
+static uint16_t LabVIEW_Stream_minDecimation(void) {
+    clock_info_t clocks;
+    labview_baud_t baud;
+
+    ClockMgr_getInfo(&clocks);
+    LabVIEW_UART_getBaud(&baud);
+
+    uint32_t block_rate = ADC_getSampleRate(STREAM_ADC, clocks.pclk2_hz)
+            / stream_half;
+    uint32_t capacity = baud.actual / STREAM_UART_BITS
+            * LABVIEW_STREAM_LINK_SHARE_PCT / 100U;
+    uint32_t demand = block_rate
+            * PROTO_WIRE_SIZE(LABVIEW_STREAM_HEADER_SIZE + 2U * stream_half);
+
+    if (capacity == 0) {
+        return UINT16_MAX;
+    }
+    uint32_t decimation = (demand + capacity - 1) / capacity;
+    if (decimation < 1) {
+        return 1;
+    }
+    return (decimation > UINT16_MAX) ? UINT16_MAX : (uint16_t) decimation;
+}
+
+/**
+ * @brief Stops streaming and disables the DMA interrupts.
+ */
+void LabVIEW_Stream_Stop(void) {
+    ADC_DMA_disableInterrupt(STREAM_ADC, ADC_DMA_FLAG_HT);
+    ADC_DMA_disableInterrupt(STREAM_ADC, ADC_DMA_FLAG_TC);
+    stream_active = 0;
+    stream_requested = 0;
+}
+
+/**
+ * @brief Returns 1 while streaming.
+ */
+uint8_t LabVIEW_Stream_isActive(void) {
+    return stream_active;
+}
+
+/**
+ * @brief Returns 1 once started until stopped.
+ */
+uint8_t LabVIEW_Stream_isRequested(void) {
+    return stream_requested;
+}
+
+/**
+ * @brief Holds a started stream back, or releases it.
+ */
+void LabVIEW_Stream_setHold(uint8_t hold) {
+    stream_hold = hold;
+    if (!hold && stream_requested && !stream_active) {
+        LabVIEW_Stream_enable();
+    }
+}
+
+/**
+ * @brief Copies the streaming statistics.
+ */
+void LabVIEW_Stream_getStats(labview_stream_stats_t *stats) {
+    stats->blocks = stream_stats.blocks;
+    stats->sent = stream_stats.sent;
+    stats->dropped = stream_stats.dropped;
+    stats->decimation = stream_decimation;
+}
+
+/**
+ * @brief Sends one half-buffer, or skips it to honour the decimation.
+ * The samples are COBS-encoded from the DMA buffer straight into the TX
+ * ring; the DMA is filling the other half meanwhile.
+ */
+static void LabVIEW_Stream_sendBlock(const uint16_t *samples, uint32_t cycles) {
+    uint32_t seq = stream_seq++;
+    uint8_t header[LABVIEW_STREAM_HEADER_SIZE];
+
+    stream_stats.blocks++;
+    if (stream_skip > 0) {
+        stream_skip--;
+        return;
+    }
+    stream_skip = stream_decimation - 1;
+
+    header[0] = (uint8_t) seq;
+    header[1] = (uint8_t) (seq >> 8);
+    header[2] = (uint8_t) (seq >> 16);
+    header[3] = (uint8_t) (seq >> 24);
+    header[4] = (uint8_t) cycles;
+    header[5] = (uint8_t) (cycles >> 8);
+    header[6] = (uint8_t) (cycles >> 16);
+    header[7] = (uint8_t) (cycles >> 24);
+
+    /* Cortex-M is little-endian: the samples are already in wire order */
+    if (LabVIEW_Send_FrameParts(PROTO_MSG_ADC_BLOCK, header, sizeof(header),
+            (const uint8_t*) samples, (uint8_t) (stream_half * 2))) {
+        stream_stats.sent++;
+    } else {
+        stream_stats.dropped++;
+    }
+}
+
+/**
+ * @brief "STREAM 1[,decimation]" starts, "STREAM 0" stops. A decimation
+ * the link cannot carry is raised when the stream is enabled.
+ */
+static void LabVIEW_Stream_command(const int32_t *args, uint8_t argc) {
+    if (argc >= 1 && args[0] != 0) {
+        int32_t decimation = (argc >= 2) ? args[1] : 1;
+        if (decimation < 1) {
+            decimation = 1;
+        } else if (decimation > UINT16_MAX) {
+            decimation = UINT16_MAX;
+        }
+        LabVIEW_Stream_Start((uint16_t) decimation);
+    } else {
+        LabVIEW_Stream_Stop();
+    }
+}
+
+/**
+ * @brief This function handles DMA2 Stream 0 (ADC1) interrupts.
+ * Half transfer: the first half is stable. Transfer complete: the second.
+ */
+void DMA2_Stream0_IRQHandler(void) {
+    uint32_t cycles = DWT->CYCCNT;
+
+    TRACE_BEGIN(TRACE_ID_ADC_DMA);
+    if (ADC_DMA_getFlagStatus(STREAM_ADC, ADC_DMA_FLAG_HT)) {
+        ADC_DMA_clearFlag(STREAM_ADC, ADC_DMA_FLAG_HT);
+        if (stream_active) {
+            LabVIEW_Stream_sendBlock(&stream_buffer[0], cycles);
+        }
+    }
+    if (ADC_DMA_getFlagStatus(STREAM_ADC, ADC_DMA_FLAG_TC)) {
+        ADC_DMA_clearFlag(STREAM_ADC, ADC_DMA_FLAG_TC);
+        if (stream_active) {
+            LabVIEW_Stream_sendBlock(&stream_buffer[stream_half], cycles);
+        }
+    }
+    TRACE_END(TRACE_ID_ADC_DMA);
+}
@@ -0,0 +1,88 @@
+#ifndef _LABVIEW_STREAM_H_
+#define _LABVIEW_STREAM_H_
+
+#include "stm32f4xx.h"
+#include "labview_proto.h"
+#include <stdint.h>
+
+/*
+ * Raw ADC waveform streaming.
+ *
+ * While active, every half of the ADC1 circular DMA buffer is sent as a
+ * PROTO_MSG_ADC_BLOCK frame straight from the DMA half/transfer-complete
+ * interrupt. Payload (little-endian):
+ *   block_seq u32 | cycles u32 | samples u16[n]
+ * block_seq counts every half-buffer the DMA filled, sent or not, so the
+ * host sees decimated or dropped blocks as gaps. cycles is the DWT cycle
+ * counter (SystemCoreClock) when the block completed.
+ *
+ * Every decimation-th block is sent. At FULL clock the ADC completes a
+ * 32-sample block about every 240 us, some 330 KB/s framed, far beyond
+ * the UART; the decimation is therefore raised when the stream is enabled
+ * to the smallest one whose frames fit LABVIEW_STREAM_LINK_SHARE_PCT of
+ * the actual baud rate, leaving the rest for replies and logs.
+ *
+ * Text command: "STREAM 1[,decimation]" starts, "STREAM 0" stops.
+ */
+
+#define LABVIEW_STREAM_HEADER_SIZE  8
+/* Share of the UART byte rate the stream may take */
+#define LABVIEW_STREAM_LINK_SHARE_PCT   80U
+/* Largest half-buffer that fits one frame */
+#define LABVIEW_STREAM_MAX_SAMPLES  ((PROTO_MAX_PAYLOAD - LABVIEW_STREAM_HEADER_SIZE) / 2)
+
+/**
+ * @brief Streaming statistics.
+ */
+typedef struct {
+    uint32_t blocks;    /* Half-buffers completed by the DMA while active */
+    uint32_t sent;      /* Blocks queued for transmission */
+    uint32_t dropped;   /* Blocks lost because the TX ring was full */
+    uint16_t decimation; /* In use, after raising it to fit the link */
+} labview_stream_stats_t;
+
+/**
+ * @brief  Attaches the stream to the ADC1 circular DMA buffer.
+ * @param  buffer The buffer given to ADC_DMA_Config
+ * @param  length Buffer length in samples; even, at most
+ * 2 * LABVIEW_STREAM_MAX_SAMPLES
+ * @note   Registers the "STREAM" text command. Call after LabVIEW_UART_Init
+ * and ADC_DMA_Config.
+ */
+void LabVIEW_Stream_Init(const uint16_t *buffer, uint16_t length);
+
+/**
+ * @brief  Starts streaming, or arms the stream while it is held.
+ * @param  decimation Send one block out of every 'decimation' (1 = all);
+ * raised on enable to what the UART can carry
+ */
+void LabVIEW_Stream_Start(uint16_t decimation);
+
+/**
+ * @brief  Stops streaming and disables the DMA interrupts.
+ */
+void LabVIEW_Stream_Stop(void);
+
+/**
+ * @brief  Returns 1 while streaming.
+ */
+uint8_t LabVIEW_Stream_isActive(void);
+
+/**
+ * @brief  Returns 1 once started until stopped, held or not.
+ */
+uint8_t LabVIEW_Stream_isRequested(void);
+
+/**
+ * @brief  Holds a started stream back until released, e.g. while the
+ * clock cannot be boosted yet. A stream already running is not held.
+ * @param  hold 1 to hold, 0 to release and start an armed stream
+ */
+void LabVIEW_Stream_setHold(uint8_t hold);
+
+/**
+ * @brief  Copies the streaming statistics.
+ */
+void LabVIEW_Stream_getStats(labview_stream_stats_t *stats);
+
+#endif /* _LABVIEW_STREAM_H_ */
@@ -0,0 +1,209 @@
+#include "labview_sub.h"
+#include "labview_comm.h"
+#include "fast_format.h"
+
+/* One reported field: 5 bytes in a PROTO_MSG_FIELDS frame */
+#define FIELD_RECORD_SIZE   5
+#define FIELDS_HEADER_SIZE  4
+
+typedef struct {
+    uint8_t active;
+    uint8_t pending;         /* Report on the next update regardless */
+    uint32_t deadband;
+    uint16_t min_interval_ms;
+    uint16_t heartbeat_ms;
+    uint32_t last_value;     /* Value last reported */
+    uint32_t last_sent_ms;   /* Time of the last report */
+} labview_sub_t;
+
+static labview_sub_t subs[LABVIEW_FIELD_COUNT];
+static uint8_t sub_count = 0;
+
+static uint32_t LabVIEW_Sub_value(uint8_t field, const proto_telemetry_t *t);
+static void LabVIEW_Sub_command(const int32_t *args, uint8_t argc);
+static void LabVIEW_Unsub_command(const int32_t *args, uint8_t argc);
+
+/**
+ * @brief Registers the "SUB" and "UNSUB" text commands.
+ */
+void LabVIEW_Sub_Init(void) {
+    LabVIEW_registerCommand("SUB", LabVIEW_Sub_command);
+    LabVIEW_registerCommand("UNSUB", LabVIEW_Unsub_command);
+}
+
+/**
+ * @brief Subscribes to a field, or updates its subscription.
+ */
+uint8_t LabVIEW_Sub_subscribe(uint8_t field, uint32_t deadband,
+        uint16_t min_interval_ms, uint16_t heartbeat_ms) {
+    if (field >= LABVIEW_FIELD_COUNT) {
+        return 0;
+    }
+    labview_sub_t *s = &subs[field];
+
+    if (!s->active) {
+        sub_count++;
+    }
+    s->active = 1;
+    s->pending = 1;
+    s->deadband = deadband;
+    s->min_interval_ms = min_interval_ms;
+    s->heartbeat_ms = heartbeat_ms;
+    return 1;
+}
+
+/**
+ * @brief Cancels one subscription or all of them.
+ */
+uint8_t LabVIEW_Sub_unsubscribe(uint8_t field) {
+    if (field == LABVIEW_FIELD_ALL) {
+        for (uint8_t i = 0; i < LABVIEW_FIELD_COUNT; i++) {
+            subs[i].active = 0;
+        }
+        sub_count = 0;
+        return 1;
+    }
+    if (field >= LABVIEW_FIELD_COUNT) {
+        return 0;
+    }
+    if (subs[field].active) {
+        subs[field].active = 0;
+        sub_count--;
+    }
+    return 1;
+}
+
+/**
+ * @brief Returns 1 if at least one field is subscribed.
+ */
+uint8_t LabVIEW_Sub_isActive(void) {
+    return sub_count != 0;
+}
+
+/**
+ * @brief Reports the subscribed fields that changed or are due.
+ * Due fields are batched into one frame (binary) or one line (text).
+ */
+void LabVIEW_Sub_update(const proto_telemetry_t *telemetry) {
+    uint8_t binary = (LabVIEW_getProtocol() == LABVIEW_PROTOCOL_BINARY);
+    uint32_t now = telemetry->timestamp_ms;
+    uint8_t payload[FIELDS_HEADER_SIZE + LABVIEW_FIELD_COUNT * FIELD_RECORD_SIZE];
+    char line[LABVIEW_FIELD_COUNT * 15 + 8];
+    uint8_t *rec = &payload[FIELDS_HEADER_SIZE];
+    char *p = FMT_str(line, "F:");
+    uint8_t reported = 0;
+
+    for (uint8_t field = 0; field < LABVIEW_FIELD_COUNT; field++) {
+        labview_sub_t *s = &subs[field];
+        if (!s->active) {
+            continue;
+        }
+
+        uint32_t value = LabVIEW_Sub_value(field, telemetry);
+        uint32_t since = now - s->last_sent_ms;
+        uint32_t change = (value > s->last_value) ? value - s->last_value
+                : s->last_value - value;
+        uint8_t due = s->pending
+                || (s->heartbeat_ms != 0 && since >= s->heartbeat_ms)
+                || (change > s->deadband && since >= s->min_interval_ms);
+        if (!due) {
+            continue;
+        }
+
+        s->pending = 0;
+        s->last_value = value;
+        s->last_sent_ms = now;
+
+        if (binary) {
+            rec[0] = field;
+            rec[1] = (uint8_t) value;
+            rec[2] = (uint8_t) (value >> 8);
+            rec[3] = (uint8_t) (value >> 16);
+            rec[4] = (uint8_t) (value >> 24);
+            rec += FIELD_RECORD_SIZE;
+        } else {
+            if (reported) {
+                *p++ = ',';
+            }
+            p = FMT_uint(p, field, 0);
+            *p++ = '=';
+            p = FMT_uint(p, value, 0);
+        }
+        reported++;
+    }
+
+    if (!reported) {
+        return;
+    }
+    if (binary) {
+        payload[0] = (uint8_t) now;
+        payload[1] = (uint8_t) (now >> 8);
+        payload[2] = (uint8_t) (now >> 16);
+        payload[3] = (uint8_t) (now >> 24);
+        LabVIEW_Send_Frame(PROTO_MSG_FIELDS, payload,
+                (uint8_t) (rec - payload));
+    } else {
+        *p++ = '\n';
+        LabVIEW_UART_SendBuffer((const uint8_t*) line, (uint16_t) (p - line));
+    }
+}
+
+/**
+ * @brief Reads the current value of a field.
+ */
+static uint32_t LabVIEW_Sub_value(uint8_t field, const proto_telemetry_t *t) {
+    switch (field) {
+    case LABVIEW_FIELD_MOISTURE_RAW:
+        return t->moisture_raw;
+    case LABVIEW_FIELD_MOISTURE_PERCENT:
+        return t->moisture_percent;
+    case LABVIEW_FIELD_PUMP:
+        return t->pump;
+    case LABVIEW_FIELD_MODE:
+        return t->mode;
+    case LABVIEW_FIELD_TIME:
+        return (uint32_t) t->hours * 3600U + (uint32_t) t->minutes * 60U
+                + t->seconds;
+    case LABVIEW_FIELD_TX_DROPS: {
+        labview_tx_stats_t tx;
+        LabVIEW_UART_getTxStats(&tx);
+        return tx.dropped_blocks;
+    }
+    case LABVIEW_FIELD_RX_ERRORS: {
+        labview_rx_stats_t rx;
+        LabVIEW_UART_getRxStats(&rx);
+        return rx.overruns + rx.framing_errors + rx.parse_errors
+                + rx.frame_crc_errors + rx.frame_format_errors + rx.dma_laps;
+    }
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief "SUB field,deadband,min_ms,heartbeat_ms"; missing values are 0.
+ */
+static void LabVIEW_Sub_command(const int32_t *args, uint8_t argc) {
+    int32_t v[4] = { -1, 0, 0, 0 };
+
+    for (uint8_t i = 0; i < argc && i < 4; i++) {
+        v[i] = args[i];
+    }
+    if (v[0] < 0 || v[1] < 0 || v[2] < 0 || v[2] > UINT16_MAX
+            || v[3] < 0 || v[3] > UINT16_MAX) {
+        return;
+    }
+    LabVIEW_Sub_subscribe((uint8_t) v[0], (uint32_t) v[1], (uint16_t) v[2],
+            (uint16_t) v[3]);
+}
+
+/**
+ * @brief "UNSUB field"; "UNSUB" alone cancels every subscription.
+ */
+static void LabVIEW_Unsub_command(const int32_t *args, uint8_t argc) {
+    if (argc == 0) {
+        LabVIEW_Sub_unsubscribe(LABVIEW_FIELD_ALL);
+    } else if (args[0] >= 0 && args[0] < LABVIEW_FIELD_COUNT) {
+        LabVIEW_Sub_unsubscribe((uint8_t) args[0]);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef _LABVIEW_SUB_H_
+#define _LABVIEW_SUB_H_
+
+#include <stdint.h>
+#include "labview_proto.h"
+
+/*
+ * Change-only telemetry subscriptions.
+ *
+ * The host subscribes to individual fields, each with a deadband, a
+ * minimum interval and a heartbeat. A field is reported when it moves by
+ * more than its deadband (no sooner than the minimum interval after its
+ * previous report) or when its heartbeat expires. While any field is
+ * subscribed, LabVIEW_Send_Telemetry reports only those fields.
+ *
+ * Binary:  PROTO_MSG_SUBSCRIBE   field u8, deadband u16, min_ms u16, heartbeat_ms u16
+ *          PROTO_MSG_UNSUBSCRIBE field u8 (LABVIEW_FIELD_ALL for every field)
+ *          PROTO_MSG_FIELDS      timestamp_ms u32, then { field u8, value u32 } per field
+ * Text:    "SUB field,deadband,min_ms,heartbeat_ms" / "UNSUB field"
+ *          reported as "F:field=value,field=value"
+ */
+
+/**
+ * @brief Fields a host can subscribe to.
+ */
+typedef enum {
+    LABVIEW_FIELD_MOISTURE_RAW = 0,  /* Averaged ADC reading */
+    LABVIEW_FIELD_MOISTURE_PERCENT,
+    LABVIEW_FIELD_PUMP,              /* 0 = OFF, 1 = ON */
+    LABVIEW_FIELD_MODE,              /* 0 = AUTO, 1 = MANUAL */
+    LABVIEW_FIELD_TIME,              /* Seconds since midnight */
+    LABVIEW_FIELD_TX_DROPS,          /* Blocks dropped by the TX ring */
+    LABVIEW_FIELD_RX_ERRORS,         /* Receive, parse and frame errors */
+    LABVIEW_FIELD_COUNT,
+    LABVIEW_FIELD_ALL = 0xFF
+} labview_field_t;
+
+/**
+ * @brief  Registers the "SUB" and "UNSUB" text commands.
+ */
+void LabVIEW_Sub_Init(void);
+
+/**
+ * @brief  Subscribes to a field, or updates its subscription.
+ * @param  field Field to report
+ * @param  deadband Change, in field units, that triggers a report
+ * (0 = any change)
+ * @param  min_interval_ms Minimum time between change reports (0 = none)
+ * @param  heartbeat_ms Report at least this often (0 = changes only)
+ * @return 1 on success, 0 for an unknown field
+ * @note   The field is reported on the next update.
+ */
+uint8_t LabVIEW_Sub_subscribe(uint8_t field, uint32_t deadband,
+        uint16_t min_interval_ms, uint16_t heartbeat_ms);
+
+/**
+ * @brief  Cancels a subscription.
+ * @param  field Field, or LABVIEW_FIELD_ALL
+ * @return 1 on success, 0 for an unknown field
+ */
+uint8_t LabVIEW_Sub_unsubscribe(uint8_t field);
+
+/**
+ * @brief  Returns 1 if at least one field is subscribed.
+ */
+uint8_t LabVIEW_Sub_isActive(void);
+
+/**
+ * @brief  Reports the subscribed fields that changed or are due.
+ * @param  telemetry Current system status
+ * @note   Called by LabVIEW_Send_Telemetry; sends nothing if no field is due.
+ */
+void LabVIEW_Sub_update(const proto_telemetry_t *telemetry);
+
+#endif /* _LABVIEW_SUB_H_ */
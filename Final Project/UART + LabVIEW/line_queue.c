@@ -0,0 +1,103 @@
+#include "line_queue.h"
+
+/**
+ * @brief Empties the queue and clears its statistics.
+ */
+void LineQueue_init(line_queue_t *q) {
+    q->head = 0;
+    q->tail = 0;
+    q->fill = 0;
+    q->discarding = 0;
+    q->stats.lines = 0;
+    q->stats.full_drops = 0;
+    q->stats.long_drops = 0;
+    q->stats.high_watermark = 0;
+}
+
+/**
+ * @brief Producer: appends one received character.
+ */
+void LineQueue_putChar(line_queue_t *q, char c) {
+    uint32_t head = q->head;
+
+    if (c == '\n' || c == '\r') {
+        if (q->discarding) {
+            /* End of a dropped line, resume with the next one */
+            q->discarding = 0;
+            q->fill = 0;
+            return;
+        }
+        if (q->fill == 0) {
+            return;
+        }
+        q->line[head & (LINE_QUEUE_SLOTS - 1)][q->fill] = '\0';
+        q->fill = 0;
+        /* The line must be visible before the consumer sees the new head */
+        LINE_QUEUE_BARRIER();
+        q->head = head + 1;
+        q->stats.lines++;
+
+        uint32_t pending = head + 1 - q->tail;
+        if (pending > q->stats.high_watermark) {
+            q->stats.high_watermark = (uint8_t) pending;
+        }
+        return;
+    }
+
+    if (q->discarding) {
+        return;
+    }
+
+    if (q->fill == 0 && head - q->tail >= LINE_QUEUE_SLOTS) {
+        /* No free slot for a new line: drop it entirely */
+        q->stats.full_drops++;
+        q->discarding = 1;
+        return;
+    }
+
+    if (q->fill >= LINE_QUEUE_LINE_MAX - 1) {
+        q->stats.long_drops++;
+        q->discarding = 1;
+        return;
+    }
+
+    q->line[head & (LINE_QUEUE_SLOTS - 1)][q->fill++] = c;
+}
+
+/**
+ * @brief Producer: drops the rest of the current line.
+ */
+void LineQueue_dropLine(line_queue_t *q) {
+    q->fill = 0;
+    q->discarding = 1;
+}
+
+/**
+ * @brief Consumer: returns the oldest complete line, or NULL.
+ */
+const char *LineQueue_peek(line_queue_t *q) {
+    uint32_t tail = q->tail;
+
+    if (tail == q->head) {
+        return NULL;
+    }
+    /* Do not read the slot before the head that published it */
+    LINE_QUEUE_BARRIER();
+    return q->line[tail & (LINE_QUEUE_SLOTS - 1)];
+}
+
+/**
+ * @brief Consumer: frees the line returned by LineQueue_peek.
+ */
+void LineQueue_release(line_queue_t *q) {
+    /* Finish reading the slot before handing it back to the producer */
+    LINE_QUEUE_BARRIER();
+    q->tail = q->tail + 1;
+}
+
+/**
+ * @brief Copies the queue statistics.
+ */
+void LineQueue_getStats(const line_queue_t *q, line_queue_stats_t *stats) {
+    *stats = q->stats;
+}
@@ -0,0 +1,82 @@
+#ifndef LINE_QUEUE_H_
+#define LINE_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LINE_QUEUE_SLOTS     8      /* Must be a power of two */
+#define LINE_QUEUE_LINE_MAX  128    /* Bytes per slot, including the NUL */
+
+/* Full barrier: DMB on Cortex-M, a fence on the host */
+#define LINE_QUEUE_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/**
+ * @brief Per-queue overflow statistics.
+ */
+typedef struct {
+    uint32_t lines;          /* Lines committed by the producer */
+    uint32_t full_drops;     /* Lines discarded because every slot was in use */
+    uint32_t long_drops;     /* Lines discarded for exceeding LINE_QUEUE_LINE_MAX */
+    uint8_t high_watermark;  /* Most slots ever pending at once */
+} line_queue_stats_t;
+
+/**
+ * @brief Lock-free single-producer/single-consumer queue of text lines.
+ * The producer (an ISR) assembles a line in place in the slot at 'head' and
+ * publishes it by advancing 'head'; the consumer reads the slot at 'tail'
+ * and frees it by advancing 'tail'. Each index has exactly one writer.
+ */
+typedef struct {
+    char line[LINE_QUEUE_SLOTS][LINE_QUEUE_LINE_MAX];
+    volatile uint32_t head;  /* Written by the producer only */
+    volatile uint32_t tail;  /* Written by the consumer only */
+    /* Producer-private state */
+    uint16_t fill;           /* Length of the line being assembled */
+    uint8_t discarding;      /* Skipping the rest of a dropped line */
+    line_queue_stats_t stats;
+} line_queue_t;
+
+/**
+ * @brief Empties the queue and clears its statistics.
+ * @note Neither side may be running while the queue is reset.
+ */
+void LineQueue_init(line_queue_t *q);
+
+/**
+ * @brief Producer: appends one received character.
+ * CR or LF terminates the current line; empty lines are ignored.
+ */
+void LineQueue_putChar(line_queue_t *q, char c);
+
+/**
+ * @brief Producer: drops the line being assembled and everything up to the
+ * next line end, after bytes were lost in the middle of the stream.
+ */
+void LineQueue_dropLine(line_queue_t *q);
+
+/**
+ * @brief Consumer: returns the oldest complete line, NUL-terminated.
+ * @return Pointer into the queue, or NULL if no line is pending.
+ * @note The line stays valid until LineQueue_release is called.
+ */
+const char *LineQueue_peek(line_queue_t *q);
+
+/**
+ * @brief Consumer: frees the line returned by LineQueue_peek.
+ */
+void LineQueue_release(line_queue_t *q);
+
+/**
+ * @brief Copies the queue statistics.
+ */
+void LineQueue_getStats(const line_queue_t *q, line_queue_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_QUEUE_H_ */
@@ -0,0 +1,185 @@
+#include "uart_mux.h"
+
+/**
+ * @brief Attaches a ring buffer to a channel and clears its counters.
+ */
+void UartMux_initChannel(uart_mux_t *m, uint8_t ch, uint8_t *buffer,
+        uint16_t size) {
+    uart_mux_channel_t *c = &m->ch[ch];
+    uart_mux_stats_t zero = { 0 };
+
+    c->buffer = buffer;
+    c->mask = (uint16_t) (size - 1);
+    c->head = 0;
+    c->tail = 0;
+    c->block_remaining = 0;
+    c->stats = zero;
+}
+
+/**
+ * @brief Empties the multiplexer state.
+ */
+void UartMux_reset(uart_mux_t *m) {
+    m->active = -1;
+    m->in_flight = 0;
+}
+
+/**
+ * @brief Producer: checks for room for a block of 'length' bytes.
+ */
+int32_t UartMux_reserve(uart_mux_t *m, uint8_t ch, uint16_t length) {
+    uart_mux_channel_t *c = &m->ch[ch];
+    uint32_t used = c->head - c->tail;
+
+    if ((uint32_t) length + UART_MUX_PREFIX > (uint32_t) c->mask + 1 - used) {
+        UartMux_countDrop(m, ch, length);
+        return -1;
+    }
+    return (int32_t) ((c->head + UART_MUX_PREFIX) & c->mask);
+}
+
+/**
+ * @brief Producer: writes the length prefix and publishes the block.
+ */
+void UartMux_commit(uart_mux_t *m, uint8_t ch, uint16_t length) {
+    uart_mux_channel_t *c = &m->ch[ch];
+
+    if (length == 0) {
+        return; /* Nothing to send; an empty block would stall the consumer */
+    }
+    c->buffer[c->head & c->mask] = (uint8_t) length;
+    c->buffer[(c->head + 1) & c->mask] = (uint8_t) (length >> 8);
+    c->head += (uint32_t) length + UART_MUX_PREFIX;
+
+    uint32_t used = c->head - c->tail;
+    if (used > c->stats.high_watermark) {
+        c->stats.high_watermark = (uint16_t) used;
+    }
+}
+
+/**
+ * @brief Producer: copies a block into a channel.
+ */
+uint8_t UartMux_write(uart_mux_t *m, uint8_t ch, const uint8_t *data,
+        uint16_t length) {
+    int32_t start = UartMux_reserve(m, ch, length);
+
+    if (start < 0) {
+        return 0;
+    }
+    uart_mux_channel_t *c = &m->ch[ch];
+    for (uint16_t i = 0; i < length; i++) {
+        c->buffer[(start + i) & c->mask] = data[i];
+    }
+    UartMux_commit(m, ch, length);
+    return 1;
+}
+
+/**
+ * @brief Producer: counts a block rejected before it reached the channel.
+ */
+void UartMux_countDrop(uart_mux_t *m, uint8_t ch, uint16_t length) {
+    m->ch[ch].stats.dropped_bytes += length;
+    m->ch[ch].stats.dropped_blocks++;
+}
+
+/**
+ * @brief Producer: returns a channel's ring and its index mask.
+ */
+uint8_t *UartMux_getRing(uart_mux_t *m, uint8_t ch, uint16_t *mask) {
+    *mask = m->ch[ch].mask;
+    return m->ch[ch].buffer;
+}
+
+/**
+ * @brief Consumer: returns the next contiguous run of bytes to transmit.
+ * Continues the block in progress, otherwise opens the next block of the
+ * highest-priority channel that has one.
+ */
+uint16_t UartMux_next(uart_mux_t *m, const uint8_t **data) {
+    uart_mux_channel_t *c;
+
+    if (m->in_flight != 0) {
+        return 0;
+    }
+
+    if (m->active < 0) {
+        for (uint8_t i = 0; i < UART_MUX_CHANNELS; i++) {
+            c = &m->ch[i];
+            if (c->head == c->tail) {
+                continue;
+            }
+            /* Lower channels with data waiting are overtaken */
+            for (uint8_t j = i + 1; j < UART_MUX_CHANNELS; j++) {
+                if (m->ch[j].head != m->ch[j].tail) {
+                    m->ch[j].stats.preemptions++;
+                }
+            }
+            c->block_remaining = (uint16_t) (c->buffer[c->tail & c->mask]
+                    | (c->buffer[(c->tail + 1) & c->mask] << 8));
+            c->tail += UART_MUX_PREFIX;
+            m->active = (int8_t) i;
+            break;
+        }
+        if (m->active < 0) {
+            return 0;
+        }
+    }
+
+    c = &m->ch[m->active];
+    uint32_t start = c->tail & c->mask;
+    /* Stop at the end of the ring; the wrap is the next run */
+    uint32_t length = (uint32_t) c->mask + 1 - start;
+    if (length > c->block_remaining) {
+        length = c->block_remaining;
+    }
+
+    *data = &c->buffer[start];
+    m->in_flight = (uint16_t) length;
+    return (uint16_t) length;
+}
+
+/**
+ * @brief Consumer: releases the run returned by UartMux_next.
+ */
+void UartMux_complete(uart_mux_t *m) {
+    if (m->active < 0) {
+        return;
+    }
+    uart_mux_channel_t *c = &m->ch[m->active];
+
+    c->tail += m->in_flight;
+    c->block_remaining -= m->in_flight;
+    c->stats.bytes_sent += m->in_flight;
+    m->in_flight = 0;
+
+    if (c->block_remaining == 0) {
+        c->stats.blocks_sent++;
+        m->active = -1;
+    }
+}
+
+/**
+ * @brief Returns 1 if any channel has bytes queued or in flight.
+ */
+uint8_t UartMux_isBusy(const uart_mux_t *m) {
+    if (m->in_flight != 0 || m->active >= 0) {
+        return 1;
+    }
+    for (uint8_t i = 0; i < UART_MUX_CHANNELS; i++) {
+        if (m->ch[i].head != m->ch[i].tail) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copies a channel's counters.
+ */
+void UartMux_getStats(const uart_mux_t *m, uint8_t ch, uart_mux_stats_t *stats) {
+    const uart_mux_channel_t *c = &m->ch[ch];
+
+    *stats = c->stats;
+    stats->used = (uint16_t) (c->head - c->tail);
+}
@@ -0,0 +1,124 @@
+#ifndef UART_MUX_H_
+#define UART_MUX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define UART_MUX_CHANNELS   4       /* Channel 0 has the highest priority */
+#define UART_MUX_PREFIX     2       /* Length prefix stored before each block */
+
+/**
+ * @brief Per-channel counters.
+ */
+typedef struct {
+    uint32_t bytes_sent;     /* Bytes handed to the transmitter */
+    uint32_t blocks_sent;    /* Frames or lines fully handed over */
+    uint32_t dropped_bytes;  /* Bytes rejected because the channel was full */
+    uint32_t dropped_blocks; /* Frames or lines rejected */
+    uint32_t preemptions;    /* Times a higher channel went ahead of this one */
+    uint16_t high_watermark; /* Highest fill level seen, in bytes */
+    uint16_t used;           /* Bytes currently queued */
+} uart_mux_stats_t;
+
+/**
+ * @brief One channel: a byte ring of length-prefixed blocks.
+ * Private: use the UartMux_ functions.
+ */
+typedef struct {
+    uint8_t *buffer;
+    uint16_t mask;           /* Ring size - 1, size a power of two */
+    uint32_t head;           /* Producer index, free running */
+    uint32_t tail;           /* Consumer index, free running */
+    uint16_t block_remaining;/* Bytes of the block in progress still to send */
+    uart_mux_stats_t stats;
+} uart_mux_channel_t;
+
+/**
+ * @brief Priority multiplexer over several channel rings.
+ * The transmitter always finishes the block (frame or line) it started,
+ * then takes the next block from the highest-priority non-empty channel,
+ * so urgent frames overtake bulk data only at block boundaries.
+ * @note Not reentrant: the caller serialises every call, e.g. by masking
+ * interrupts around it.
+ */
+typedef struct {
+    uart_mux_channel_t ch[UART_MUX_CHANNELS];
+    int8_t active;           /* Channel whose block is in progress, -1 if none */
+    uint16_t in_flight;      /* Bytes handed out by UartMux_next, not yet completed */
+} uart_mux_t;
+
+/**
+ * @brief Attaches a ring buffer to a channel and clears its counters.
+ * @param size Ring size, a power of two
+ */
+void UartMux_initChannel(uart_mux_t *m, uint8_t ch, uint8_t *buffer,
+        uint16_t size);
+
+/**
+ * @brief Empties the multiplexer state (call after every UartMux_initChannel).
+ */
+void UartMux_reset(uart_mux_t *m);
+
+/**
+ * @brief Producer: checks for room for a block of 'length' bytes.
+ * @return Ring index where the block data starts, or -1 if the channel is
+ * full (the block is counted as dropped).
+ */
+int32_t UartMux_reserve(uart_mux_t *m, uint8_t ch, uint16_t length);
+
+/**
+ * @brief Producer: publishes the block written at the reserved index.
+ * @param length Actual block length, at most the reserved length
+ */
+void UartMux_commit(uart_mux_t *m, uint8_t ch, uint16_t length);
+
+/**
+ * @brief Producer: copies a block into a channel.
+ * @return 1 if queued, 0 if dropped
+ */
+uint8_t UartMux_write(uart_mux_t *m, uint8_t ch, const uint8_t *data,
+        uint16_t length);
+
+/**
+ * @brief Producer: counts a block of 'length' bytes rejected before it
+ * reached the channel, e.g. because the link cannot carry it.
+ */
+void UartMux_countDrop(uart_mux_t *m, uint8_t ch, uint16_t length);
+
+/**
+ * @brief Producer: returns a channel's ring, for writing a block in place
+ * at the index returned by UartMux_reserve.
+ * @param mask Receives the ring index mask (size - 1)
+ */
+uint8_t *UartMux_getRing(uart_mux_t *m, uint8_t ch, uint16_t *mask);
+
+/**
+ * @brief Consumer: returns the next contiguous run of bytes to transmit.
+ * @param data Receives the start of the run
+ * @return Run length, 0 if nothing is pending or a run is still in flight
+ */
+uint16_t UartMux_next(uart_mux_t *m, const uint8_t **data);
+
+/**
+ * @brief Consumer: releases the run returned by UartMux_next.
+ */
+void UartMux_complete(uart_mux_t *m);
+
+/**
+ * @brief Returns 1 if any channel has bytes queued or in flight.
+ */
+uint8_t UartMux_isBusy(const uart_mux_t *m);
+
+/**
+ * @brief Copies a channel's counters.
+ */
+void UartMux_getStats(const uart_mux_t *m, uint8_t ch, uart_mux_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_MUX_H_ */
@@ -0,0 +1,16 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief Monotonic time in nanoseconds, for the host benchmarks.
+ */
+static inline uint64_t Bench_nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,120 @@
+/*
+ * fast_format against snprintf on the lines updateLCD and
+ * LabVIEW_Send_Value build. Every line is also compared byte for byte with
+ * the snprintf output, so the benchmark fails on any formatting difference.
+ *
+ * Usage: bench_fast_format [iterations]
+ */
+#include "bench.h"
+#include "fast_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*line_fn)(char *line, uint32_t i);
+
+/* "AUTO hh:mm:ss" */
+static void autoSprintf(char *line, uint32_t i) {
+    snprintf(line, 32, "AUTO %02d:%02d:%02d", (int) (i % 24),
+            (int) (i % 60), (int) ((i / 60) % 60));
+}
+
+static void autoFmt(char *line, uint32_t i) {
+    char *p = FMT_str(line, "AUTO ");
+    p = FMT_time(p, i % 24, i % 60, (i / 60) % 60);
+    *p = '\0';
+}
+
+/* "Moist:%3d%% P:%s" */
+static void moistSprintf(char *line, uint32_t i) {
+    snprintf(line, 32, "Moist:%3d%% P:%s", (int) (i % 101),
+            (i & 1) ? "ON" : "OFF");
+}
+
+static void moistFmt(char *line, uint32_t i) {
+    char *p = FMT_str(line, "Moist:");
+    p = FMT_percent(p, i % 101);
+    p = FMT_str(p, " P:");
+    p = FMT_onOff(p, i & 1);
+    *p = '\0';
+}
+
+/* Manual status line "S:hh:mm E:hh:mm P:%s" */
+static void manualSprintf(char *line, uint32_t i) {
+    snprintf(line, 32, "S:%02d:%02d E:%02d:%02d P:%s", (int) (i % 24),
+            (int) (i % 60), (int) ((i + 7) % 24), (int) ((i + 13) % 60),
+            (i & 2) ? "ON" : "OFF");
+}
+
+static void manualFmt(char *line, uint32_t i) {
+    char *p = FMT_str(line, "S:");
+    p = FMT_hourMinute(p, i % 24, i % 60);
+    p = FMT_str(p, " E:");
+    p = FMT_hourMinute(p, (i + 7) % 24, (i + 13) % 60);
+    p = FMT_str(p, " P:");
+    p = FMT_onOff(p, i & 2);
+    *p = '\0';
+}
+
+/* LabVIEW_Send_Value "%d\n" over the whole packed value range */
+static void valueSprintf(char *line, uint32_t i) {
+    snprintf(line, 32, "%d\n", (int) ((i % 4096) * 100 + (i & 1) * 10));
+}
+
+static void valueFmt(char *line, uint32_t i) {
+    char *p = FMT_uint(line, (i % 4096) * 100 + (i & 1) * 10, 1);
+    *p++ = '\n';
+    *p = '\0';
+}
+
+static const struct {
+    const char *name;
+    line_fn reference;
+    line_fn fast;
+} cases[] = {
+    { "auto time line", autoSprintf, autoFmt },
+    { "moisture line", moistSprintf, moistFmt },
+    { "manual status line", manualSprintf, manualFmt },
+    { "LabVIEW value line", valueSprintf, valueFmt },
+};
+
+/* Keeps the compiler from dropping the formatted lines */
+static volatile uint32_t sink;
+
+static double timeLines(line_fn fn, uint32_t iterations) {
+    char line[32];
+    uint64_t start = Bench_nowNs();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn(line, i);
+        sink += (uint8_t) line[5];
+    }
+    return (double) (Bench_nowNs() - start) / iterations;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = (argc > 1) ? (uint32_t) strtoul(argv[1], 0, 0)
+            : 1000000;
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (uint32_t i = 0; i < 100000; i++) {
+            char expected[32];
+            char actual[32];
+            cases[c].reference(expected, i);
+            cases[c].fast(actual, i);
+            if (strcmp(expected, actual) != 0) {
+                printf("%s: mismatch at %u: \"%s\" != \"%s\"\n",
+                        cases[c].name, i, actual, expected);
+                failures++;
+                break;
+            }
+        }
+
+        double slow = timeLines(cases[c].reference, iterations);
+        double fast = timeLines(cases[c].fast, iterations);
+        printf("%-20s snprintf %7.1f ns  fast_format %6.1f ns  x%.1f\n",
+                cases[c].name, slow, fast, slow / fast);
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
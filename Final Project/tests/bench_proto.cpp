@@ -0,0 +1,95 @@
+/*
+ * Throughput of the binary LabVIEW protocol through the host C++ wrapper:
+ * a stream of telemetry and full 80-byte ADC block frames is encoded into
+ * one buffer, then decoded and checked frame by frame.
+ *
+ * Usage: bench_proto [frames]
+ */
+#include "labview_proto.hpp"
+#include "bench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static void fillBlock(uint8_t *payload, uint32_t n) {
+    for (uint8_t i = 0; i < PROTO_MAX_PAYLOAD; i++) {
+        /* Includes zeros, so COBS has work to do */
+        payload[i] = static_cast<uint8_t>((n + i * 7) & ((i & 3) ? 0xFF : 0x0F));
+    }
+}
+
+static proto_telemetry_t makeTelemetry(uint32_t n) {
+    proto_telemetry_t t = {};
+    t.timestamp_ms = n * 100;
+    t.moisture_raw = static_cast<uint16_t>(n & 0x0FFF);
+    t.moisture_percent = static_cast<uint8_t>(n % 101);
+    t.pump = n & 1;
+    t.hours = static_cast<uint8_t>(n % 24);
+    return t;
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], 0, 0))
+            : 1000000;
+    /* The stream buffer is the only allocation, outside the timed codec */
+    std::vector<uint8_t> wire(static_cast<size_t>(frames) * PROTO_MAX_WIRE);
+    size_t wire_size = 0;
+    size_t payload_bytes = 0;
+    labview::WireFrame frame;
+
+    uint64_t start = Bench_nowNs();
+    for (uint32_t n = 0; n < frames; n++) {
+        if (n % 4 == 0) {
+            labview::encode(static_cast<uint8_t>(n), makeTelemetry(n), frame);
+            payload_bytes += PROTO_TELEMETRY_SIZE;
+        } else {
+            uint8_t payload[PROTO_MAX_PAYLOAD];
+            fillBlock(payload, n);
+            labview::encode(PROTO_MSG_ADC_BLOCK, static_cast<uint8_t>(n),
+                    payload, PROTO_MAX_PAYLOAD, frame);
+            payload_bytes += PROTO_MAX_PAYLOAD;
+        }
+        memcpy(&wire[wire_size], frame.bytes, frame.size);
+        wire_size += frame.size;
+    }
+    double encode_s = (Bench_nowNs() - start) / 1e9;
+
+    labview::FrameDecoder decoder;
+    uint32_t next = 0;
+    int mismatches = 0;
+    start = Bench_nowNs();
+    size_t decoded = decoder.feed(wire.data(), wire_size,
+            [&](const proto_frame_t &f) {
+                uint32_t n = next++;
+                bool ok = f.seq == static_cast<uint8_t>(n);
+                if (n % 4 == 0) {
+                    proto_telemetry_t t;
+                    ok = ok && labview::unpackTelemetry(f, t)
+                            && t.timestamp_ms == n * 100;
+                } else {
+                    uint8_t payload[PROTO_MAX_PAYLOAD];
+                    fillBlock(payload, n);
+                    ok = ok && f.msg_id == PROTO_MSG_ADC_BLOCK
+                            && f.len == PROTO_MAX_PAYLOAD
+                            && memcmp(f.payload, payload, f.len) == 0;
+                }
+                mismatches += !ok;
+            });
+    double decode_s = (Bench_nowNs() - start) / 1e9;
+
+    printf("%u frames, %zu wire bytes (%.1f%% overhead)\n", frames, wire_size,
+            100.0 * (wire_size - payload_bytes) / payload_bytes);
+    printf("encode %8.1f Mbit/s wire, %6.0f ns/frame\n",
+            wire_size * 8 / encode_s / 1e6, encode_s * 1e9 / frames);
+    printf("decode %8.1f Mbit/s wire, %6.0f ns/frame\n",
+            wire_size * 8 / decode_s / 1e6, decode_s * 1e9 / frames);
+
+    bool ok = decoded == frames && mismatches == 0
+            && decoder.crcErrors() == 0 && decoder.formatErrors() == 0;
+    if (!ok) {
+        printf("FAILED: %zu frames decoded, %d mismatches\n", decoded,
+                mismatches);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,170 @@
+/*
+ * Timer wheel under load: thousands of concurrent one-shot and periodic
+ * timers with delays spread over every level, restarted from their own
+ * callbacks and cancelled or rescheduled between ticks. Every expiry is
+ * checked against the tick it was due on, and every timer that is still
+ * pending at the end must not be overdue, so a lost or early expiry fails
+ * the run. Then start/cancel and tick costs are timed.
+ *
+ * Usage: bench_soft_timer [ticks [timers]]
+ */
+#include "bench.h"
+#include "soft_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_TICKS   2000000UL
+#define DEFAULT_TIMERS  20000UL
+#define MAX_DELAY_BITS  22          /* Delays up to 4M ticks, level 3 */
+#define CHURN_PER_TICK  4           /* Cancels or restarts between ticks */
+
+typedef struct {
+    soft_timer_t timer;
+    uint32_t due;                   /* Tick the next expiry is expected on */
+    uint32_t period;
+    uint8_t armed;
+} bench_timer_t;
+
+static bench_timer_t *timers;
+static uint32_t timer_count;
+static uint32_t rng = 0x2545F491U;
+static uint32_t late_or_early = 0;
+static uint32_t unexpected = 0;
+static uint32_t fired = 0;
+
+static uint32_t nextRandom(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/**
+ * @brief Log-uniform delay, so that every wheel level gets timers.
+ */
+static uint32_t randomDelay(void) {
+    uint32_t bits = 1 + nextRandom() % MAX_DELAY_BITS;
+    return 1 + nextRandom() % (1UL << bits);
+}
+
+/**
+ * @brief Starts a timer and records when it must expire.
+ * SoftTimer_now is the tick processed next, which is 1 tick away; a
+ * callback sees it already advanced past its own tick.
+ */
+static void arm(bench_timer_t *b) {
+    uint32_t delay = randomDelay();
+
+    b->period = (nextRandom() & 3) == 0 ? randomDelay() : 0;
+    b->due = SoftTimer_now() + delay;
+    b->armed = 1;
+    SoftTimer_start(&b->timer, delay, b->period);
+}
+
+static void onExpiry(void *arg) {
+    bench_timer_t *b = arg;
+
+    fired++;
+    if (!b->armed) {
+        unexpected++;
+        return;
+    }
+    if (SoftTimer_now() != b->due) {
+        late_or_early++;
+    }
+    if (b->period) {
+        b->due += b->period;
+    } else if (nextRandom() & 1) {
+        /* Restart from the callback, as the firmware's timers do */
+        arm(b);
+    } else {
+        b->armed = 0;
+    }
+}
+
+/**
+ * @brief Cancels or reschedules a random timer between ticks.
+ */
+static void churn(void) {
+    bench_timer_t *b = &timers[nextRandom() % timer_count];
+
+    if (nextRandom() & 1) {
+        SoftTimer_cancel(&b->timer);
+        b->armed = 0;
+    } else {
+        arm(b);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t ticks = argc > 1 ? strtoul(argv[1], 0, 10) : DEFAULT_TICKS;
+    timer_count = argc > 2 ? strtoul(argv[2], 0, 10) : DEFAULT_TIMERS;
+    timers = calloc(timer_count, sizeof(*timers));
+    if (timers == 0 || timer_count == 0) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < timer_count; i++) {
+        /* A quarter defer their callback to SoftTimer_process */
+        SoftTimer_init(&timers[i].timer, onExpiry, &timers[i],
+                (i & 3) == 0 ? SOFT_TIMER_DEFERRED : 0);
+        arm(&timers[i]);
+    }
+
+    uint64_t start = Bench_nowNs();
+    for (uint32_t i = 0; i < ticks; i++) {
+        SoftTimer_tick();
+        SoftTimer_process();
+        for (uint32_t c = 0; c < CHURN_PER_TICK; c++) {
+            churn();
+        }
+    }
+    uint64_t run_ns = Bench_nowNs() - start;
+
+    uint32_t overdue = 0;
+    uint32_t lost = 0;
+    uint32_t armed = 0;
+    for (uint32_t i = 0; i < timer_count; i++) {
+        bench_timer_t *b = &timers[i];
+        if (!b->armed) {
+            continue;
+        }
+        armed++;
+        if (!SoftTimer_isActive(&b->timer)) {
+            lost++;
+        } else if ((int32_t) (b->due - SoftTimer_now()) < 0) {
+            overdue++;
+        }
+        SoftTimer_cancel(&b->timer);
+    }
+
+    soft_timer_stats_t stats;
+    SoftTimer_getStats(&stats);
+    printf("%lu timers, %lu ticks: %lu expiries, %lu cascaded, %lu armed "
+            "at the end\n", (unsigned long) timer_count, (unsigned long) ticks,
+            (unsigned long) fired, (unsigned long) stats.cascaded,
+            (unsigned long) armed);
+    printf("  %.1f ns per tick, including %d start/cancel and %.2f expiries\n",
+            (double) run_ns / ticks, CHURN_PER_TICK, (double) fired / ticks);
+
+    /* Raw start/cancel cost, timers spread over every level */
+    const uint32_t ops = 1000000;
+    start = Bench_nowNs();
+    for (uint32_t i = 0; i < ops; i++) {
+        bench_timer_t *b = &timers[i % timer_count];
+        SoftTimer_start(&b->timer, randomDelay(), 0);
+        SoftTimer_cancel(&b->timer);
+    }
+    uint64_t op_ns = Bench_nowNs() - start;
+    printf("  %.1f ns per start + cancel\n", (double) op_ns / ops);
+
+    if (late_or_early || unexpected || lost || overdue
+            || stats.overruns || !SoftTimer_isIdle()) {
+        printf("FAIL: %lu off time, %lu unexpected, %lu lost, %lu overdue, "
+                "%lu overruns\n", (unsigned long) late_or_early,
+                (unsigned long) unexpected, (unsigned long) lost,
+                (unsigned long) overdue, (unsigned long) stats.overruns);
+        return 1;
+    }
+    return 0;
+}
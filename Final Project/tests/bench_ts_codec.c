@@ -0,0 +1,191 @@
+/*
+ * Block codec on synthetic 1-minute moisture traces: a slow drying slope
+ * with pump cycles, then the same with ADC noise, then with noise and
+ * +-1 s sampling jitter. Each trace is encoded into blocks of 4096 bytes
+ * and of 32 bytes (one AT24C32 page), decoded back and compared record by
+ * record; a block that grows past its size or a record that changes fails
+ * the run. Reports bytes per record, encode and decode time, and how many
+ * days of history fit in a 16 KB flash sector and in the 4 KB AT24C32.
+ *
+ * Usage: bench_ts_codec [records]
+ */
+#include "bench.h"
+#include "ts_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_RECORDS     20160UL     /* Two weeks of 1-minute samples */
+#define RECORDS_PER_DAY     1440.0
+#define FLASH_SECTOR_BYTES  16384.0
+#define EEPROM_BYTES        4096.0
+#define SLOT_BYTES          8.0         /* Flash log slot, log_record.h */
+
+typedef struct {
+    const char *name;
+    uint8_t noise;                      /* ADC noise, +-LSB */
+    uint8_t jitter;                     /* Sampling jitter, +-1 s if set */
+} trace_kind_t;
+
+static const trace_kind_t kinds[] = {
+    { "clean", 0, 0 },
+    { "noise +-2", 2, 0 },
+    { "noise +-2, jitter", 2, 1 }
+};
+static const uint16_t block_sizes[] = { 4096, 32 };
+
+static ts_record_t *trace;
+static uint8_t *blocks;
+static uint16_t *lengths;
+static uint32_t record_count;
+static uint32_t rng;
+
+static uint32_t nextRandom(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/**
+ * @brief Dries by 0.15 LSB a minute, waters down 1100 LSB in 44 minutes.
+ */
+static void makeTrace(const trace_kind_t *kind) {
+    uint32_t time = 763821296U;
+    uint32_t moisture = 3000 * 100;     /* Hundredths of an LSB */
+    uint8_t pump = 0;
+
+    rng = 0x2545F491U;
+    for (uint32_t i = 0; i < record_count; i++) {
+        time += 60;
+        if (kind->jitter && nextRandom() % 3 == 0) {
+            time += nextRandom() % 3 - 1;
+        }
+        moisture = pump ? moisture - 2500 : moisture + 15;
+        if (moisture > 3300 * 100) {
+            pump = 1;
+        } else if (moisture < 2200 * 100) {
+            pump = 0;
+        }
+        int32_t raw = (int32_t) (moisture / 100);
+        if (kind->noise) {
+            raw += (int32_t) (nextRandom() % (2U * kind->noise + 1)) - kind->noise;
+        }
+        trace[i].time = time;
+        trace[i].moisture_raw = (uint16_t) raw;
+        trace[i].pump = pump;
+    }
+}
+
+/**
+ * @brief Encodes the trace into blocks of 'size' bytes.
+ * @return Bytes used by all blocks; their count is left in *block_count
+ */
+static uint32_t encodeAll(uint16_t size, uint32_t *block_count) {
+    uint32_t total = 0;
+    uint32_t n = 0;
+    uint32_t i = 0;
+
+    while (i < record_count) {
+        ts_encoder_t enc;
+        TsCodec_encoderInit(&enc, &blocks[(size_t) n * size], size);
+        while (i < record_count && TsCodec_append(&enc, &trace[i])) {
+            i++;
+        }
+        lengths[n] = TsCodec_finish(&enc);
+        total += lengths[n];
+        n++;
+    }
+    *block_count = n;
+    return total;
+}
+
+/**
+ * @brief Decodes every block and compares it with the trace.
+ * @return Records that differ or are missing
+ */
+static uint32_t decodeAll(uint16_t size, uint32_t block_count) {
+    uint32_t i = 0;
+    uint32_t errors = 0;
+
+    for (uint32_t b = 0; b < block_count; b++) {
+        ts_decoder_t dec;
+        ts_record_t r;
+        if (lengths[b] > size) {
+            errors++;
+        }
+        TsCodec_decoderInit(&dec, &blocks[(size_t) b * size], lengths[b]);
+        while (TsCodec_next(&dec, &r)) {
+            if (i >= record_count || r.time != trace[i].time
+                    || r.moisture_raw != trace[i].moisture_raw
+                    || r.pump != trace[i].pump) {
+                errors++;
+            }
+            i++;
+        }
+    }
+    return errors + (i != record_count);
+}
+
+/**
+ * @brief Most blocks of 'size' bytes the trace can need.
+ */
+static uint32_t maxBlocks(uint16_t size) {
+    uint32_t per_block = 1 + (size - TS_BLOCK_HEADER) / TS_RECORD_MAX;
+    return record_count / per_block + 1;
+}
+
+int main(int argc, char **argv) {
+    record_count = argc > 1 ? strtoul(argv[1], 0, 10) : DEFAULT_RECORDS;
+    size_t max_bytes = 0;
+    uint32_t max_blocks = 0;
+    for (size_t s = 0; s < sizeof(block_sizes) / sizeof(block_sizes[0]); s++) {
+        uint32_t n = maxBlocks(block_sizes[s]);
+        if ((size_t) n * block_sizes[s] > max_bytes) {
+            max_bytes = (size_t) n * block_sizes[s];
+        }
+        if (n > max_blocks) {
+            max_blocks = n;
+        }
+    }
+    trace = calloc(record_count, sizeof(*trace));
+    blocks = malloc(max_bytes);
+    lengths = calloc(max_blocks, sizeof(*lengths));
+    if (!trace || !blocks || !lengths || record_count == 0) {
+        return 1;
+    }
+
+    uint32_t failures = 0;
+    printf("%lu records, 1 per minute; a flash log slot is %.0f bytes\n",
+            (unsigned long) record_count, SLOT_BYTES);
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        makeTrace(&kinds[k]);
+        for (size_t s = 0; s < sizeof(block_sizes) / sizeof(block_sizes[0]);
+                s++) {
+            uint16_t size = block_sizes[s];
+            uint32_t block_count;
+
+            uint64_t start = Bench_nowNs();
+            uint32_t total = encodeAll(size, &block_count);
+            uint64_t enc_ns = Bench_nowNs() - start;
+            start = Bench_nowNs();
+            uint32_t errors = decodeAll(size, block_count);
+            uint64_t dec_ns = Bench_nowNs() - start;
+
+            double per_record = (double) total / record_count;
+            printf("  %-18s block %4u: %.2f B/record (%.1fx), "
+                    "%.1f/%.1f ns enc/dec, %.1f days per 16 KB sector, "
+                    "%.1f days in the AT24C32\n", kinds[k].name, size,
+                    per_record, SLOT_BYTES / per_record,
+                    (double) enc_ns / record_count,
+                    (double) dec_ns / record_count,
+                    FLASH_SECTOR_BYTES / per_record / RECORDS_PER_DAY,
+                    EEPROM_BYTES / per_record / RECORDS_PER_DAY);
+            if (errors) {
+                printf("FAIL: %lu records lost or changed\n",
+                        (unsigned long) errors);
+                failures++;
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
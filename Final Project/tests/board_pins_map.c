@@ -0,0 +1,67 @@
+/*
+ * Prints the board pin map and checks the pin table: Board_pinsInit must
+ * find no pin used twice, the map must list every entry once with a
+ * distinct pin, and the relay must be driven low before its pin turns
+ * into an output. Runs against the host GPIO ports in host/stm32f4xx.h.
+ *
+ * Usage: board_pins
+ */
+#include "board_pins.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GPIO_TypeDef host_gpio_ports[8];
+RCC_TypeDef host_rcc;
+
+static int failures = 0;
+static uint8_t lines = 0;
+static char last_pin[6];
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * @brief Prints a map line; the same "PB10" twice in a row is a conflict.
+ */
+static void printLine(const char *line) {
+    char pin[6];
+
+    puts(line);
+    expect(strlen(line) == BOARD_PIN_LINE_WIDTH, "map line width");
+    memcpy(pin, line, 5);
+    pin[5] = '\0';
+    if (lines > 0 && strcmp(pin, last_pin) == 0) {
+        printf("FAIL: %s assigned twice\n", pin);
+        failures++;
+    }
+    memcpy(last_pin, pin, sizeof(pin));
+    lines++;
+}
+
+int main(void) {
+    Board_printPinMap(printLine);
+    expect(lines == board_pin_count, "map does not list every entry");
+
+    int8_t conflict = Board_pinsInit();
+    if (conflict >= 0) {
+        printf("FAIL: %s reuses a pin\n", board_pins[conflict].name);
+        failures++;
+    }
+    expect((RELAY_PORT->BSRR & (1UL << (RELAY_PIN + 16))) != 0,
+            "relay not driven low");
+    expect(((RELAY_PORT->MODER >> (RELAY_PIN * 2)) & 0x3)
+            == GPIO_DRIVER_MODE_OUTPUT, "relay pin is not an output");
+    expect((RCC->AHB1ENR & 0x3) == 0x3, "GPIOA/GPIOB clocks not enabled");
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("%u pins, no conflicts\n", board_pin_count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*
+ * Differential fuzz test and benchmark of cmd_parser against the sscanf
+ * parse_token it replaced. Lines come from a corpus file, then from random
+ * mutations of it. Both parsers must agree on every line:
+ *   - the same "hh:mm:ss AM|PM" time and pump digit, or both no time;
+ *   - a bare "0"/"1" as a pump command;
+ *   - a line the old parser rejected or ignored is CMD_ERROR or CMD_NONE
+ *     as before, or, new, CMD_KEYED.
+ *
+ * Usage: fuzz_cmd_parser corpus.txt [mutations]
+ */
+#include "cmd_parser.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_LEN    128
+#define CORPUS_MAX      1024
+
+/**
+ * @brief Result of the old parser.
+ */
+typedef struct {
+    int is_time;
+    int hour, minute, second;
+    int pump;           /* -1 if absent */
+    int is_pump;        /* Bare "0"/"1" */
+} legacy_t;
+
+/**
+ * @brief parse_token from the original labview_comm.c, without the side
+ * effects: sscanf retried at every offset of the line.
+ */
+static legacy_t legacyParse(const char *data_str) {
+    legacy_t r = { 0, 0, 0, 0, -1, 0 };
+    int h = 0, m = 0, s = 0;
+    char am_pm_str[3] = { 0 };
+    int items_matched = 0;
+    int chars_consumed = 0;
+    const char *ptr_search = data_str;
+
+    while (*ptr_search != '\0') {
+        items_matched = sscanf(ptr_search, "%d:%d:%d %2s%n", &h, &m, &s,
+                am_pm_str, &chars_consumed);
+        if (items_matched == 4) {
+            if ((strcmp(am_pm_str, "AM") == 0 || strcmp(am_pm_str, "PM") == 0)
+                    && (h >= 1 && h <= 12) && (m >= 0 && m <= 59)
+                    && (s >= 0 && s <= 59)) {
+                break;
+            } else {
+                items_matched = 0;
+            }
+        }
+        ptr_search++;
+    }
+
+    if (items_matched == 4) {
+        r.is_time = 1;
+        r.hour = h;
+        if (strcmp(am_pm_str, "PM") == 0 && h != 12) {
+            r.hour += 12;
+        } else if (strcmp(am_pm_str, "AM") == 0 && h == 12) {
+            r.hour = 0;
+        }
+        r.minute = m;
+        r.second = s;
+        char pump_cmd_char = ptr_search[chars_consumed];
+        if (pump_cmd_char == '1' || pump_cmd_char == '0') {
+            r.pump = pump_cmd_char - '0';
+        }
+    } else if (strlen(data_str) == 1 && (data_str[0] == '0'
+            || data_str[0] == '1')) {
+        r.is_pump = 1;
+        r.pump = data_str[0] - '0';
+    }
+    return r;
+}
+
+static cmd_type_t parseLine(cmd_parser_t *p, const char *line, cmd_t *cmd) {
+    while (*line) {
+        CmdParser_putChar(p, *line++, cmd);
+    }
+    return CmdParser_putChar(p, '\n', cmd);
+}
+
+/**
+ * @brief Compares both parsers on one line.
+ * @return 1 if they agree
+ */
+static int check(const char *line) {
+    static cmd_parser_t parser;
+    static int initialised;
+    cmd_t cmd;
+
+    if (!initialised) {
+        CmdParser_reset(&parser);
+        initialised = 1;
+    }
+    cmd_type_t type = parseLine(&parser, line, &cmd);
+    legacy_t old = legacyParse(line);
+    int ok;
+
+    if (old.is_time) {
+        ok = type == CMD_SET_TIME && cmd.hour == old.hour
+                && cmd.minute == old.minute && cmd.second == old.second
+                && cmd.pump == old.pump;
+    } else if (old.is_pump) {
+        ok = type == CMD_PUMP && cmd.pump == old.pump;
+    } else if (strlen(line) <= 1) {
+        /* A lone character was ignored; a keyword letter is new */
+        ok = type == CMD_NONE || type == CMD_KEYED;
+    } else {
+        ok = type == CMD_ERROR || type == CMD_KEYED;
+    }
+    if (!ok) {
+        printf("mismatch on \"%s\": type %d %02u:%02u:%02u pump %d, "
+                "sscanf %s %02d:%02d:%02d pump %d\n", line, type, cmd.hour,
+                cmd.minute, cmd.second, cmd.pump,
+                old.is_time ? "time" : "no time", old.hour, old.minute,
+                old.second, old.pump);
+    }
+    return ok;
+}
+
+/**
+ * @brief Derives a random line from a corpus line: characters replaced,
+ * inserted, deleted or repeated from an alphabet rich in time syntax.
+ */
+static void mutate(char *out, const char *in) {
+    static const char alphabet[] = "0123456789::  AMPMAP+-\t\v,01X_";
+    size_t len = strlen(in);
+    int edits = 1 + rand() % 4;
+
+    memcpy(out, in, len + 1);
+    for (int e = 0; e < edits; e++) {
+        size_t pos = len ? (size_t) rand() % (len + 1) : 0;
+        char c = alphabet[rand() % (sizeof(alphabet) - 1)];
+        switch (rand() % 3) {
+        case 0:
+            if (pos < len) {
+                out[pos] = c;
+            }
+            break;
+        case 1:
+            if (len + 1 < LINE_MAX_LEN) {
+                memmove(&out[pos + 1], &out[pos], len - pos + 1);
+                out[pos] = c;
+                len++;
+            }
+            break;
+        default:
+            if (pos < len) {
+                memmove(&out[pos], &out[pos + 1], len - pos);
+                len--;
+            }
+            break;
+        }
+    }
+}
+
+static char corpus[CORPUS_MAX][LINE_MAX_LEN];
+static size_t corpus_size;
+
+static void loadCorpus(const char *path) {
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    while (corpus_size < CORPUS_MAX
+            && fgets(corpus[corpus_size], LINE_MAX_LEN, f)) {
+        corpus[corpus_size][strcspn(corpus[corpus_size], "\r\n")] = '\0';
+        corpus_size++;
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s corpus.txt [mutations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    loadCorpus(argv[1]);
+    uint32_t mutations = (argc > 2) ? (uint32_t) strtoul(argv[2], 0, 0)
+            : 2000000;
+    uint32_t failures = 0;
+
+    for (size_t i = 0; i < corpus_size; i++) {
+        failures += !check(corpus[i]);
+    }
+    srand(1);
+    for (uint32_t n = 0; n < mutations && failures < 20; n++) {
+        char line[LINE_MAX_LEN];
+        mutate(line, corpus[rand() % corpus_size]);
+        failures += !check(line);
+    }
+    printf("%zu corpus lines, %u mutations, %u mismatches\n", corpus_size,
+            mutations, failures);
+
+    /* Throughput over the corpus */
+    cmd_parser_t parser;
+    cmd_t cmd;
+    size_t bytes = 0;
+    uint32_t rounds = 200;
+    volatile int sink = 0;
+    CmdParser_reset(&parser);
+
+    uint64_t start = Bench_nowNs();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpus_size; i++) {
+            sink += parseLine(&parser, corpus[i], &cmd);
+            bytes += strlen(corpus[i]) + 1;
+        }
+    }
+    double parser_ns = (double) (Bench_nowNs() - start);
+    start = Bench_nowNs();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpus_size; i++) {
+            sink += legacyParse(corpus[i]).hour;
+        }
+    }
+    double legacy_ns = (double) (Bench_nowNs() - start);
+    printf("cmd_parser %7.1f MB/s, sscanf scan %6.1f MB/s, x%.1f\n",
+            bytes * 1e3 / parser_ns, bytes * 1e3 / legacy_ns,
+            legacy_ns / parser_ns);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
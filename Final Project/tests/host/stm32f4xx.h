@@ -0,0 +1,43 @@
+/*
+ * Host stand-in for the CMSIS device header, enough for GPIO/gpio.c and
+ * the board pin table. The ports and RCC are plain memory, laid out
+ * 0x400 bytes apart like the AHB1 GPIO blocks, so register writes can be
+ * inspected after the fact.
+ */
+#ifndef HOST_STM32F4XX_H_
+#define HOST_STM32F4XX_H_
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t MODER;
+    volatile uint32_t OTYPER;
+    volatile uint32_t OSPEEDR;
+    volatile uint32_t PUPDR;
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+    volatile uint32_t LCKR;
+    volatile uint32_t AFR[2];
+    uint32_t RESERVED[246];     /* Pads each port to 0x400 bytes */
+} GPIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t AHB1ENR;
+} RCC_TypeDef;
+
+extern GPIO_TypeDef host_gpio_ports[8];
+extern RCC_TypeDef host_rcc;
+
+#define GPIOA_BASE                  ((uint32_t) (uintptr_t) &host_gpio_ports[0])
+#define GPIOA                       (&host_gpio_ports[0])
+#define GPIOB                       (&host_gpio_ports[1])
+#define GPIOC                       (&host_gpio_ports[2])
+#define GPIOD                       (&host_gpio_ports[3])
+#define GPIOE                       (&host_gpio_ports[4])
+#define GPIOH                       (&host_gpio_ports[7])
+#define RCC                         (&host_rcc)
+
+#define RCC_AHB1ENR_GPIOAEN_Pos     0U
+
+#endif /* HOST_STM32F4XX_H_ */
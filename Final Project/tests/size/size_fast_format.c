@@ -0,0 +1,20 @@
+/* Code size: the same lines as size_sprintf.c built with fast_format */
+#include "fast_format.h"
+
+volatile int hours = 12, minutes = 34, seconds = 56, percent = 42, pump = 1;
+char line[3][32];
+
+int main(void) {
+    char *p = FMT_str(line[0], "AUTO ");
+    p = FMT_time(p, hours, minutes, seconds);
+    *p = '\0';
+    p = FMT_str(line[1], "Moist:");
+    p = FMT_percent(p, percent);
+    p = FMT_str(p, " P:");
+    p = FMT_onOff(p, pump);
+    *p = '\0';
+    p = FMT_uint(line[2], percent * 100 + pump, 1);
+    *p++ = '\n';
+    *p = '\0';
+    return 0;
+}
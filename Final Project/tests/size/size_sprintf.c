@@ -0,0 +1,12 @@
+/* Code size reference: the updateLCD lines built with newlib sprintf */
+#include <stdio.h>
+
+volatile int hours = 12, minutes = 34, seconds = 56, percent = 42, pump = 1;
+char line[3][32];
+
+int main(void) {
+    sprintf(line[0], "AUTO %02d:%02d:%02d", hours, minutes, seconds);
+    sprintf(line[1], "Moist:%3d%% P:%s", percent, pump ? "ON" : "OFF");
+    sprintf(line[2], "%d\n", percent * 100 + pump);
+    return 0;
+}
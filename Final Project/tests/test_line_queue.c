@@ -0,0 +1,166 @@
+/*
+ * Two-thread stress test of the SPSC line queue: a producer thread plays the
+ * USART2 ISR and feeds characters, a consumer thread plays the main loop.
+ * Checks that lines arrive whole and in order, that overlong lines never
+ * arrive, and that every line sent is either received or counted as a full
+ * or long drop (an overlong line met by a full queue is a full drop).
+ * First, LineQueue_dropLine must discard a line cut by lost bytes.
+ *
+ * Usage: test_line_queue [lines]
+ */
+#include "line_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every LONG_EVERY-th line exceeds LINE_QUEUE_LINE_MAX */
+#define LONG_EVERY  97
+
+static line_queue_t queue;
+static uint32_t total_lines;
+static volatile int producer_done;
+
+/* Consumer results */
+static uint32_t received;
+static uint32_t gaps;
+static uint32_t long_sent;
+static int corrupt;
+
+/**
+ * @brief Builds line 'seq': its number, then a payload derived from it.
+ */
+static size_t makeLine(char *line, uint32_t seq) {
+    size_t len = (size_t) sprintf(line, "%u:", seq);
+    size_t payload = (seq % LONG_EVERY == 0) ? LINE_QUEUE_LINE_MAX + 10
+            : seq % 60;
+
+    for (size_t i = 0; i < payload; i++) {
+        line[len++] = (char) ('a' + (seq + i) % 26);
+    }
+    line[len] = '\0';
+    return len;
+}
+
+static void *producer(void *arg) {
+    char line[LINE_QUEUE_LINE_MAX + 32];
+
+    (void) arg;
+    for (uint32_t seq = 1; seq <= total_lines; seq++) {
+        size_t len = makeLine(line, seq);
+        for (size_t i = 0; i < len; i++) {
+            LineQueue_putChar(&queue, line[i]);
+        }
+        LineQueue_putChar(&queue, (seq & 1) ? '\n' : '\r');
+        if ((seq & 0x07) == 0) {
+            /* Let the queue drain now and then, as between bursts */
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&producer_done, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void *consumer(void *arg) {
+    char expected[LINE_QUEUE_LINE_MAX + 32];
+    uint32_t last = 0;
+
+    (void) arg;
+    for (;;) {
+        int done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+        const char *line = LineQueue_peek(&queue);
+        if (!line) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        uint32_t seq = (uint32_t) strtoul(line, 0, 10);
+        makeLine(expected, seq);
+        if (seq <= last || seq % LONG_EVERY == 0
+                || strcmp(line, expected) != 0) {
+            if (!corrupt) {
+                printf("bad line after %u: \"%s\"\n", last, line);
+            }
+            corrupt++;
+        }
+        for (uint32_t s = last + 1; s < seq; s++) {
+            gaps++;
+        }
+        last = seq;
+        received++;
+        LineQueue_release(&queue);
+    }
+    gaps += total_lines - last;
+    return 0;
+}
+
+static void putText(const char *text) {
+    while (*text) {
+        LineQueue_putChar(&queue, *text++);
+    }
+}
+
+/**
+ * @brief Bytes up to the next line end after LineQueue_dropLine never
+ * arrive, even if the cut fell between two lines; the lines after do.
+ */
+static int checkDropLine(void) {
+    static const char *const expected[] = { "MODE 2", "HEALTH" };
+    int ok = 1;
+
+    LineQueue_init(&queue);
+    putText("SET 1");
+    LineQueue_dropLine(&queue);
+    putText("0,5\nMODE 2\n");
+    LineQueue_dropLine(&queue);
+    putText("LTH\nHEALTH\n");
+
+    for (size_t i = 0; i < 2 && ok; i++) {
+        const char *line = LineQueue_peek(&queue);
+        ok = line && strcmp(line, expected[i]) == 0;
+        if (ok) {
+            LineQueue_release(&queue);
+        }
+    }
+    if (!ok || LineQueue_peek(&queue) != NULL) {
+        printf("FAILED: LineQueue_dropLine kept a cut line\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    pthread_t threads[2];
+    line_queue_stats_t stats;
+
+    total_lines = (argc > 1) ? (uint32_t) strtoul(argv[1], 0, 0) : 2000000;
+    long_sent = total_lines / LONG_EVERY;
+
+    if (!checkDropLine()) {
+        return EXIT_FAILURE;
+    }
+    LineQueue_init(&queue);
+    pthread_create(&threads[0], 0, consumer, 0);
+    pthread_create(&threads[1], 0, producer, 0);
+    pthread_join(threads[1], 0);
+    pthread_join(threads[0], 0);
+    LineQueue_getStats(&queue, &stats);
+
+    printf("sent %u, received %u, full drops %u, long drops %u, "
+            "high watermark %u\n", total_lines, received, stats.full_drops,
+            stats.long_drops, stats.high_watermark);
+
+    int ok = !corrupt
+            && stats.lines == received
+            && stats.long_drops <= long_sent
+            && received + stats.full_drops + stats.long_drops == total_lines
+            && gaps == stats.full_drops + stats.long_drops
+            && stats.high_watermark <= LINE_QUEUE_SLOTS;
+    if (!ok) {
+        printf("FAILED (%d corrupt lines, %u gaps)\n", corrupt, gaps);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
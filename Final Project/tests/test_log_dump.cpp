@@ -0,0 +1,194 @@
+/*
+ * Builds a "LOG" export the way the firmware sends it: two sectors of
+ * slots from LogRecord_header/encode, one slot torn by a reset, sent as
+ * PROTO_MSG_LOG_DUMP frames of FLASH_LOG_FRAME_SLOTS slots mixed with
+ * telemetry lines, then an empty end frame. Then a "HIST" export: a
+ * minute trace long enough to wrap the Log/history.c ring, sent as
+ * PROTO_MSG_HISTORY frames. Decodes both again as tools/log_dump does and
+ * checks every sample; the history must be the newest records, unbroken.
+ *
+ * Usage: test_log_dump [capture.bin]
+ * The optional capture file receives the byte stream, for tools/log_dump.
+ */
+#include "uart_demux.hpp"
+#include "log_record.h"
+#include "history.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define SAMPLES         40
+#define TORN_SAMPLE     17      /* Its slot loses the commit byte */
+#define FRAME_SLOTS     (PROTO_MAX_PAYLOAD / LOG_SLOT_SIZE)
+#define HISTORY_RECORDS 4000    /* More than the ring holds */
+
+static std::vector<uint8_t> wire;
+static uint8_t history_seq = 0;
+
+static log_entry_t makeEntry(uint32_t i) {
+    log_entry_t e;
+
+    /* 300 s apart, with one gap long enough to need a new BASE */
+    e.time = 770000000U + i * 300U + (i >= 30 ? 100000U : 0U);
+    e.moisture_raw = static_cast<uint16_t>(1500 + (i * 37) % 900);
+    e.pump = (i / 5) & 1;
+    e.mode = (i / 13) & 1;
+    return e;
+}
+
+static ts_record_t makeMinute(uint32_t i) {
+    ts_record_t r;
+
+    r.time = 770000000U + i * 60U;
+    r.moisture_raw = static_cast<uint16_t>(2500 + (i * 7919U) % 5 + i / 40);
+    r.pump = (i / 90) & 1;
+    return r;
+}
+
+static uint8_t emitHistory(const uint8_t *block, uint16_t length) {
+    labview::WireFrame frame;
+    labview::encode(PROTO_MSG_HISTORY, history_seq++, block,
+            static_cast<uint8_t>(length), frame);
+    wire.insert(wire.end(), frame.bytes, frame.bytes + frame.size);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    std::vector<uint8_t> slots(LOG_SLOT_SIZE);
+    log_codec_t codec;
+
+    /* Sector 7 holds the first half, sector 8 the rest */
+    LogRecord_reset(&codec);
+    LogRecord_header(7, &slots[0]);
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        if (i == SAMPLES / 2) {
+            LogRecord_reset(&codec);
+            size_t at = slots.size();
+            slots.resize(at + LOG_SLOT_SIZE);
+            LogRecord_header(8, &slots[at]);
+        }
+        log_entry_t e = makeEntry(i);
+        uint8_t pair[2 * LOG_SLOT_SIZE];
+        uint8_t n = LogRecord_encode(&codec, &e, pair);
+        slots.insert(slots.end(), pair, pair + n * LOG_SLOT_SIZE);
+        if (i == TORN_SAMPLE) {
+            /* Reset while programming: the boot after starts with a BASE */
+            slots[slots.size() - LOG_SLOT_SIZE] = LOG_ERASED;
+            LogRecord_reset(&codec);
+        } else {
+            LogRecord_commit(&codec, &e);
+        }
+    }
+
+    uint8_t seq = 0;
+    for (size_t at = 0; at < slots.size(); at += FRAME_SLOTS * LOG_SLOT_SIZE) {
+        size_t length = slots.size() - at;
+        if (length > FRAME_SLOTS * LOG_SLOT_SIZE) {
+            length = FRAME_SLOTS * LOG_SLOT_SIZE;
+        }
+        labview::WireFrame frame;
+        labview::encode(PROTO_MSG_LOG_DUMP, seq++, &slots[at],
+                static_cast<uint8_t>(length), frame);
+        wire.insert(wire.end(), frame.bytes, frame.bytes + frame.size);
+
+        static const char line[] = "DATA,1800,45,0\r\n";
+        wire.insert(wire.end(), line, line + sizeof(line) - 1);
+    }
+    labview::WireFrame end;
+    labview::encode(PROTO_MSG_LOG_DUMP, seq, 0, 0, end);
+    wire.insert(wire.end(), end.bytes, end.bytes + end.size);
+
+    History_Init();
+    for (uint32_t i = 0; i < HISTORY_RECORDS; i++) {
+        ts_record_t r = makeMinute(i);
+        History_append(&r);
+    }
+    History_exportStart();
+    while (History_exportStep(emitHistory)) {
+    }
+    emitHistory(0, 0);
+
+    if (argc > 1) {
+        FILE *out = fopen(argv[1], "wb");
+        if (!out) {
+            perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+        fwrite(wire.data(), 1, wire.size(), out);
+        fclose(out);
+    }
+
+    /* Decode it back */
+    labview::Demux demux;
+    uint32_t next = 0;
+    uint32_t ends = 0;
+    int errors = 0;
+    uint32_t history_first = 0;
+    uint32_t history_next = 0;
+    LogRecord_reset(&codec);
+    auto on_frame = [&](proto_channel_t, const proto_frame_t &f) {
+        if (f.msg_id == PROTO_MSG_HISTORY) {
+            ts_decoder_t dec;
+            ts_record_t got;
+            TsCodec_decoderInit(&dec, f.payload, f.len);
+            while (TsCodec_next(&dec, &got)) {
+                if (history_next == 0) {
+                    history_first = (got.time - 770000000U) / 60U;
+                    history_next = history_first;
+                }
+                ts_record_t want = makeMinute(history_next++);
+                if (got.time != want.time || got.pump != want.pump
+                        || got.moisture_raw != want.moisture_raw) {
+                    errors++;
+                }
+            }
+            return;
+        }
+        if (f.msg_id != PROTO_MSG_LOG_DUMP) {
+            return;
+        }
+        if (f.len == 0) {
+            ends++;
+            return;
+        }
+        for (uint8_t i = 0; i < f.len; i += LOG_SLOT_SIZE) {
+            log_entry_t got;
+            if (LogRecord_decode(&codec, &f.payload[i], 0, &got)
+                    != LOG_SLOT_ENTRY) {
+                continue;
+            }
+            if (next == TORN_SAMPLE) {
+                next++;
+            }
+            log_entry_t want = makeEntry(next++);
+            if (memcmp(&got, &want, sizeof(got)) != 0) {
+                printf("FAIL: sample %u is %u,%u,%u,%u\n", next - 1,
+                        got.time, got.moisture_raw, got.pump, got.mode);
+                errors++;
+            }
+        }
+    };
+    demux.feed(wire.data(), wire.size(), on_frame, [](const char*) {});
+    demux.finish(on_frame, [](const char*) {});
+
+    history_stats_t stats;
+    History_getStats(&stats);
+    printf("%zu slots in %u frames, %u samples decoded\n",
+            slots.size() / LOG_SLOT_SIZE, seq, next - 1);
+    printf("history: %u of %u minutes kept in %u frames, %u blocks reused\n",
+            history_next - history_first, HISTORY_RECORDS, history_seq - 1,
+            stats.overwritten);
+    if (history_next != HISTORY_RECORDS || history_first == 0
+            || stats.overwritten == 0) {
+        printf("FAIL: history kept minutes %u to %u\n", history_first,
+                history_next);
+        return EXIT_FAILURE;
+    }
+    if (errors || next != SAMPLES || ends != 1) {
+        printf("FAIL: %d wrong samples, %u decoded, %u end frames\n", errors,
+                next - 1, ends);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/*
+ * Host build of the profiler (PROFILE_HOST). A scripted clock first checks
+ * min, mean, max, the histogram and the report text exactly, also when the
+ * report is paced by a refusing emit and when a histogram wraps; then the
+ * monotonic clock (1 "cycle" = 1 ns) profiles a few fast_format lines and
+ * prints the same report the "PROF" command sends.
+ *
+ * Usage: test_profiler [samples]
+ */
+#include "bench.h"
+#include "fast_format.h"
+#include "profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Scripted clock: every read costs HOST_STEP, measured by Profile_Init */
+#define HOST_STEP   3
+
+enum {
+    STAGE_LCD, STAGE_UART, STAGE_EMPTY, STAGE_COUNT
+};
+
+static const char *const stage_names[STAGE_COUNT] = {
+    [STAGE_LCD] = "LCD", [STAGE_UART] = "UART", [STAGE_EMPTY] = "EMPTY"
+};
+
+static uint8_t real_clock = 0;
+static uint32_t host_clock = 0;
+
+static char report[16][PROFILE_LINE_WIDTH + 1];
+static uint8_t report_lines = 0;
+static int failures = 0;
+
+uint32_t Profile_hostCycles(void) {
+    if (real_clock) {
+        return (uint32_t) Bench_nowNs();
+    }
+    host_clock += HOST_STEP;
+    return host_clock;
+}
+
+static void collect(const char *line) {
+    if (report_lines < sizeof(report) / sizeof(report[0])) {
+        strcpy(report[report_lines++], line);
+    }
+}
+
+/**
+ * @brief Paced emit that refuses every other line, like a full TX ring.
+ */
+static uint8_t collectPaced(const char *line) {
+    static uint8_t refuse = 0;
+
+    refuse ^= 1;
+    if (refuse) {
+        return 0;
+    }
+    collect(line);
+    return 1;
+}
+
+static void printLine(const char *line) {
+    printf("%s\n", line);
+}
+
+static void expectLine(uint8_t index, const char *expected) {
+    if (index >= report_lines || strcmp(report[index], expected) != 0) {
+        printf("FAIL: line %u is \"%s\", expected \"%s\"\n", index,
+                index < report_lines ? report[index] : "", expected);
+        failures++;
+    }
+}
+
+/**
+ * @brief Records one stage run that takes 'cycles' on the scripted clock.
+ */
+static void runStage(uint8_t stage, uint32_t cycles) {
+    switch (stage) {
+    case STAGE_LCD: {
+        PROFILE_BEGIN(STAGE_LCD);
+        host_clock += cycles;
+        PROFILE_END(STAGE_LCD);
+        break;
+    }
+    default: {
+        PROFILE_BEGIN(STAGE_UART);
+        host_clock += cycles;
+        PROFILE_END(STAGE_UART);
+        break;
+    }
+    }
+}
+
+static void scriptedRun(void) {
+    Profile_Init(stage_names, STAGE_COUNT);
+
+    /* 80000-80999 cycles, all in bucket 2^16 */
+    for (uint32_t i = 0; i < 1000; i++) {
+        runStage(STAGE_LCD, 80000 + i);
+    }
+    /* One each in buckets 2^0 (0 and 1 cycles), 2^3, 2^10 and the last */
+    runStage(STAGE_UART, 0);
+    runStage(STAGE_UART, 1);
+    runStage(STAGE_UART, 8);
+    runStage(STAGE_UART, 1500);
+    runStage(STAGE_UART, 0x40000000);
+
+    const profile_stage_t *lcd = Profile_getStage(STAGE_LCD);
+    if (lcd->count != 1000 || lcd->min != 80000 || lcd->max != 80999
+            || lcd->total != 80000ULL * 1000 + 999 * 1000 / 2) {
+        printf("FAIL: LCD n=%u min=%u max=%u\n", lcd->count, lcd->min,
+                lcd->max);
+        failures++;
+    }
+    if (Profile_getStage(STAGE_COUNT) != 0) {
+        printf("FAIL: unknown stage id accepted\n");
+        failures++;
+    }
+
+    Profile_report(collect);
+    expectLine(0, "LCD     n=1000 min=80000 avg=80499 max=80999");
+    expectLine(1, "  2^16:1000");
+    expectLine(2, "UART    n=5 min=0 avg=214748666 max=1073741824");
+    expectLine(3, "  2^0:2 2^3:1 2^10:1 2^23:1");
+    /* EMPTY has no samples and is left out */
+    if (report_lines != 4) {
+        printf("FAIL: %u report lines, expected 4\n", report_lines);
+        failures++;
+    }
+
+    /* The paced report gives the same lines, however often it is refused */
+    report_lines = 0;
+    Profile_reportStart();
+    uint32_t steps = 0;
+    while (Profile_reportStep(collectPaced)) {
+        steps++;
+    }
+    expectLine(0, "LCD     n=1000 min=80000 avg=80499 max=80999");
+    expectLine(1, "  2^16:1000");
+    expectLine(2, "UART    n=5 min=0 avg=214748666 max=1073741824");
+    expectLine(3, "  2^0:2 2^3:1 2^10:1 2^23:1");
+    if (report_lines != 4 || steps != 4) {
+        printf("FAIL: paced report gave %u lines in %u steps\n",
+                report_lines, (unsigned) steps);
+        failures++;
+    }
+
+    Profile_reset();
+    report_lines = 0;
+    Profile_report(collect);
+    if (report_lines != 0) {
+        printf("FAIL: report not empty after Profile_reset\n");
+        failures++;
+    }
+}
+
+/**
+ * @brief A sample in every bucket wraps the histogram over several lines;
+ * the paced report must wrap it the same way.
+ */
+static void wrappedRun(void) {
+    char direct[16][PROFILE_LINE_WIDTH + 1];
+    uint8_t direct_lines;
+
+    Profile_Init(stage_names, STAGE_COUNT);
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+        runStage(STAGE_LCD, 1UL << b);
+    }
+    report_lines = 0;
+    Profile_report(collect);
+    direct_lines = report_lines;
+    memcpy(direct, report, sizeof(direct));
+
+    report_lines = 0;
+    Profile_reportStart();
+    while (Profile_reportStep(collectPaced)) {
+    }
+    if (direct_lines < 3 || report_lines != direct_lines) {
+        printf("FAIL: wrapped report gave %u lines, paced %u\n",
+                direct_lines, report_lines);
+        failures++;
+        return;
+    }
+    for (uint8_t i = 0; i < direct_lines; i++) {
+        expectLine(i, direct[i]);
+    }
+}
+
+/**
+ * @brief Profiles the LCD and telemetry lines on the monotonic clock.
+ */
+static void realRun(uint32_t samples) {
+    char line[32];
+    volatile char sink = 0;
+
+    real_clock = 1;
+    Profile_Init(stage_names, STAGE_COUNT);
+    for (uint32_t i = 0; i < samples; i++) {
+        PROFILE_BEGIN(STAGE_LCD);
+        char *p = FMT_str(line, "Moist:");
+        p = FMT_percent(p, i % 101);
+        p = FMT_str(p, " P:");
+        p = FMT_onOff(p, i & 1);
+        FMT_finishLine(line, p, 16);
+        PROFILE_END(STAGE_LCD);
+        sink ^= line[6];
+
+        PROFILE_BEGIN(STAGE_UART);
+        p = FMT_str(line, "DATA,");
+        p = FMT_uint(p, i & 0x0FFF, 1);
+        *p++ = ',';
+        p = FMT_uint(p, i % 101, 1);
+        *p = '\0';
+        PROFILE_END(STAGE_UART);
+        sink ^= line[5];
+    }
+    (void) sink;
+    printf("%u samples per stage, in ns:\n", samples);
+    Profile_report(printLine);
+}
+
+int main(int argc, char **argv) {
+    uint32_t samples = argc > 1 ? strtoul(argv[1], 0, 10) : 100000;
+
+    scriptedRun();
+    wrappedRun();
+    realRun(samples);
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
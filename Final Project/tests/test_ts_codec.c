@@ -0,0 +1,98 @@
+/*
+ * Edge cases of the block codec: a flat trace long enough for run codes to
+ * pass the 16-bit record count must stop at TS_BLOCK_RECORDS_MAX and
+ * decode to exactly that many records; the record refused there must fit
+ * a new block; and a time step change of TS_DOD_LIMIT is refused.
+ *
+ * Usage: test_ts_codec
+ */
+#include "ts_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FLAT_RECORDS    70000UL
+
+static uint8_t block[4096];
+static int failures = 0;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * @brief Counts the records of a finished block, checking each one.
+ */
+static uint32_t decodeFlat(uint16_t length, uint32_t first_time) {
+    ts_decoder_t dec;
+    ts_record_t r;
+    uint32_t n = 0;
+
+    TsCodec_decoderInit(&dec, block, length);
+    while (TsCodec_next(&dec, &r)) {
+        if (r.time != first_time + n * 60 || r.moisture_raw != 2048
+                || r.pump != 1) {
+            printf("FAIL: record %lu is %lu,%u,%u\n", (unsigned long) n,
+                    (unsigned long) r.time, r.moisture_raw, r.pump);
+            failures++;
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+static void checkCountLimit(void) {
+    ts_encoder_t enc;
+    ts_record_t r = { 1000, 2048, 1 };
+    uint32_t appended = 0;
+
+    TsCodec_encoderInit(&enc, block, sizeof(block));
+    for (uint32_t i = 0; i < FLAT_RECORDS; i++) {
+        r.time = 1000 + i * 60;
+        if (!TsCodec_append(&enc, &r)) {
+            break;
+        }
+        appended++;
+    }
+    uint16_t length = TsCodec_finish(&enc);
+
+    printf("%lu flat records: %lu in a %u-byte block\n",
+            (unsigned long) FLAT_RECORDS, (unsigned long) appended, length);
+    expect(appended == TS_BLOCK_RECORDS_MAX, "append not refused at the limit");
+    expect(block[0] == 0xFF && block[1] == 0xFF, "header count is not 65535");
+    expect(decodeFlat(length, 1000) == TS_BLOCK_RECORDS_MAX,
+            "block does not decode to 65535 records");
+
+    /* The refused record starts the next block */
+    TsCodec_encoderInit(&enc, block, sizeof(block));
+    expect(TsCodec_append(&enc, &r), "refused record does not fit a new block");
+    expect(decodeFlat(TsCodec_finish(&enc), r.time) == 1,
+            "new block does not hold the refused record");
+}
+
+static void checkDodLimit(void) {
+    ts_encoder_t enc;
+    ts_record_t r = { 1000, 100, 0 };
+
+    TsCodec_encoderInit(&enc, block, sizeof(block));
+    TsCodec_append(&enc, &r);
+    r.time += 60;
+    TsCodec_append(&enc, &r);
+    r.time += 60 + TS_DOD_LIMIT;
+    expect(!TsCodec_append(&enc, &r), "time step change at the limit accepted");
+    r.time -= 1;
+    expect(TsCodec_append(&enc, &r), "time step change below the limit refused");
+}
+
+int main(void) {
+    checkCountLimit();
+    checkDodLimit();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*
+ * End-to-end check of the channel multiplexer and the host demultiplexer:
+ * frames and text lines are queued on the four uart_mux channels as the
+ * firmware does, drained in random-sized runs as the TX DMA does, and the
+ * resulting byte stream is split again with labview::Demux. Every channel
+ * must come back complete and in order, and the mux counters must account
+ * for every block.
+ *
+ * Usage: test_uart_demux [blocks [capture.bin]]
+ * The optional capture file receives the byte stream, for tools/uart_demux.
+ */
+#include "uart_demux.hpp"
+#include "uart_mux.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static uint8_t rings[UART_MUX_CHANNELS][512];
+static uart_mux_t mux;
+
+/* Next payload counter expected per channel, and for text lines */
+static uint32_t sent[UART_MUX_CHANNELS];
+static uint32_t received[UART_MUX_CHANNELS];
+static uint32_t text_sent;
+static uint32_t text_received;
+static int errors;
+
+static const uint8_t channel_msg[UART_MUX_CHANNELS] = {
+    PROTO_MSG_ACK, PROTO_MSG_FIELDS, PROTO_MSG_LOG, PROTO_MSG_ADC_BLOCK
+};
+
+static bool queueFrame(uint8_t ch) {
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint8_t length = static_cast<uint8_t>(4 + rand() % (PROTO_MAX_PAYLOAD - 3));
+    uint32_t n = sent[ch];
+
+    memcpy(payload, &n, 4);
+    for (uint8_t i = 4; i < length; i++) {
+        payload[i] = static_cast<uint8_t>(n * 31 + i);
+    }
+    labview::WireFrame frame;
+    labview::encode(channel_msg[ch], static_cast<uint8_t>(n), payload, length,
+            frame);
+    if (!UartMux_write(&mux, ch, frame.bytes, frame.size)) {
+        return false;
+    }
+    sent[ch]++;
+    return true;
+}
+
+static bool queueText() {
+    char line[32];
+    int length = snprintf(line, sizeof(line), "%u\r\n", text_sent);
+
+    if (!UartMux_write(&mux, PROTO_CH_TELEMETRY,
+            reinterpret_cast<const uint8_t*>(line),
+            static_cast<uint16_t>(length))) {
+        return false;
+    }
+    text_sent++;
+    return true;
+}
+
+static void drain(std::vector<uint8_t> &wire, uint32_t max_runs) {
+    const uint8_t *data;
+    uint16_t length;
+
+    for (uint32_t r = 0; r < max_runs
+            && (length = UartMux_next(&mux, &data)) != 0; r++) {
+        wire.insert(wire.end(), data, data + length);
+        UartMux_complete(&mux);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t blocks = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], 0, 0))
+            : 200000;
+    uint32_t attempts[UART_MUX_CHANNELS] = {};
+    std::vector<uint8_t> wire;
+
+    for (uint8_t ch = 0; ch < UART_MUX_CHANNELS; ch++) {
+        UartMux_initChannel(&mux, ch, rings[ch], sizeof(rings[ch]));
+    }
+    UartMux_reset(&mux);
+
+    srand(3);
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint8_t ch = static_cast<uint8_t>(rand() % UART_MUX_CHANNELS);
+        attempts[ch]++;
+        if (ch == PROTO_CH_TELEMETRY && (rand() & 1)) {
+            queueText();
+        } else {
+            queueFrame(ch);
+        }
+        drain(wire, static_cast<uint32_t>(rand() % 3));
+    }
+    drain(wire, UINT32_MAX);
+
+    if (argc > 2) {
+        FILE *f = fopen(argv[2], "wb");
+        if (!f || fwrite(wire.data(), 1, wire.size(), f) != wire.size()) {
+            perror(argv[2]);
+            return EXIT_FAILURE;
+        }
+        fclose(f);
+    }
+
+    labview::Demux demux;
+    auto on_frame = [&](proto_channel_t ch, const proto_frame_t &f) {
+        uint32_t n;
+        memcpy(&n, f.payload, 4);
+        if (f.msg_id != channel_msg[ch] || n != received[ch]) {
+            if (errors++ < 5) {
+                printf("channel %d: frame %u, expected %u\n", ch, n,
+                        received[ch]);
+            }
+        }
+        received[ch] = n + 1;
+    };
+    auto on_text = [&](const char *line) {
+        uint32_t n = static_cast<uint32_t>(strtoul(line, 0, 10));
+        if (n != text_received && errors++ < 5) {
+            printf("text line %u, expected %u\n", n, text_received);
+        }
+        text_received = n + 1;
+    };
+    demux.feed(wire.data(), wire.size(), on_frame, on_text);
+    demux.finish(on_frame, on_text);
+
+    uint32_t text_blocks = text_sent;
+    for (uint8_t ch = 0; ch < UART_MUX_CHANNELS; ch++) {
+        uart_mux_stats_t stats;
+        UartMux_getStats(&mux, ch, &stats);
+        uint32_t queued = sent[ch] + (ch == PROTO_CH_TELEMETRY ? text_blocks : 0);
+        printf("channel %u: %u queued, %u dropped, %u preempted, %u received\n",
+                ch, queued, stats.dropped_blocks, stats.preemptions,
+                received[ch]);
+        if (received[ch] != sent[ch] || stats.blocks_sent != queued
+                || queued + stats.dropped_blocks != attempts[ch]
+                || stats.used != 0) {
+            printf("channel %u: counters do not add up\n", ch);
+            errors++;
+        }
+    }
+    if (text_received != text_sent || demux.badChunks() != 0) {
+        printf("%u of %u text lines, %u bad chunks\n", text_received,
+                text_sent, demux.badChunks());
+        errors++;
+    }
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
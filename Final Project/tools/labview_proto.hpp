@@ -0,0 +1,107 @@
+#ifndef LABVIEW_PROTO_HPP_
+#define LABVIEW_PROTO_HPP_
+
+/*
+ * Host-side C++ interface to the binary LabVIEW protocol. A thin wrapper
+ * over labview_proto.c, which is built unchanged on the host, so firmware
+ * and host tools share one codec. Nothing here allocates.
+ *
+ *     labview::FrameDecoder decoder;
+ *     decoder.feed(bytes, n, [](const proto_frame_t &frame) { ... });
+ */
+
+#include "labview_proto.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace labview {
+
+/**
+ * @brief One complete wire frame, delimiters included.
+ */
+struct WireFrame {
+    uint8_t bytes[PROTO_MAX_WIRE];
+    uint16_t size = 0;
+};
+
+/**
+ * @brief Encodes a frame.
+ * @return false if the payload exceeds PROTO_MAX_PAYLOAD
+ */
+inline bool encode(uint8_t msg_id, uint8_t seq, const uint8_t *payload,
+        uint8_t length, WireFrame &out) {
+    out.size = Proto_encodeFrame(msg_id, seq, payload, length, out.bytes);
+    return out.size != 0;
+}
+
+/**
+ * @brief Encodes a telemetry frame.
+ */
+inline bool encode(uint8_t seq, const proto_telemetry_t &telemetry,
+        WireFrame &out) {
+    uint8_t payload[PROTO_TELEMETRY_SIZE];
+    uint8_t n = Proto_packTelemetry(&telemetry, payload);
+    return encode(PROTO_MSG_TELEMETRY, seq, payload, n, out);
+}
+
+/**
+ * @brief Parses the payload of a PROTO_MSG_TELEMETRY frame.
+ */
+inline bool unpackTelemetry(const proto_frame_t &frame,
+        proto_telemetry_t &telemetry) {
+    return frame.msg_id == PROTO_MSG_TELEMETRY
+            && Proto_unpackTelemetry(frame.payload, frame.len, &telemetry);
+}
+
+/**
+ * @brief Returns the logical channel of a message.
+ */
+inline proto_channel_t channelOf(uint8_t msg_id) {
+    return static_cast<proto_channel_t>(Proto_channelOf(msg_id));
+}
+
+/**
+ * @brief Streaming frame decoder.
+ * Text lines sharing the link contain no 0x00, so they are taken for the
+ * start of a frame and counted as format errors at the next delimiter.
+ */
+class FrameDecoder {
+public:
+    FrameDecoder() : decoder_(), frame_() {
+        Proto_decoderReset(&decoder_);
+    }
+
+    /**
+     * @brief Feeds wire bytes, calling on_frame(const proto_frame_t &)
+     * for every valid frame.
+     * @return Number of valid frames
+     */
+    template<typename OnFrame>
+    size_t feed(const uint8_t *data, size_t length, OnFrame &&on_frame) {
+        size_t frames = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (Proto_decoderPut(&decoder_, data[i], &frame_)
+                    == PROTO_DECODE_FRAME) {
+                on_frame(static_cast<const proto_frame_t&>(frame_));
+                frames++;
+            }
+        }
+        return frames;
+    }
+
+    uint32_t crcErrors() const {
+        return decoder_.crc_errors;
+    }
+
+    uint32_t formatErrors() const {
+        return decoder_.format_errors;
+    }
+
+private:
+    proto_decoder_t decoder_;
+    proto_frame_t frame_;
+};
+
+} // namespace labview
+
+#endif /* LABVIEW_PROTO_HPP_ */
@@ -0,0 +1,158 @@
+/*
+ * log_dump: prints the moisture and pump history from a "LOG" or "HIST"
+ * export.
+ *
+ * A binary host receives the flash log as PROTO_MSG_LOG_DUMP frames of raw
+ * 8-byte slots (Log/log_record.h), and the minute history as
+ * PROTO_MSG_HISTORY frames of one ts_codec block each (Log/history.h);
+ * each export ends with an empty frame. Capture the link raw while
+ * sending "LOG" or "HIST", e.g. on Linux:
+ *     stty -F /dev/ttyACM0 115200 raw -echo
+ *     cat /dev/ttyACM0 > capture.bin
+ * then:
+ *     log_dump capture.bin
+ * prints one line per sample, "time,raw,pump,mode" as a text host gets
+ * them ("LOG,..." lines in the capture are passed through), with the
+ * date and time in a trailing comment. Sector headers are printed as
+ * comments; slots that fail their check are counted. Minute history
+ * records are printed as "time,raw,pump" after a "# minute history" line
+ * ("HIST,..." lines are passed through).
+ */
+#include "uart_demux.hpp"
+#include "log_record.h"
+#include "ts_codec.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+/* Log times count seconds from 2000-01-01 00:00:00 */
+static const time_t kEpoch2000 = 946684800;
+
+struct DumpState {
+    log_codec_t codec;
+    uint32_t records;
+    uint32_t invalid;
+    uint32_t exports;
+    uint32_t bad_frames;
+    uint32_t history_records;
+    uint32_t history_blocks;
+    bool history_open;
+};
+
+static const char *formatDate(uint32_t seconds, char *date, size_t size) {
+    time_t t = kEpoch2000 + static_cast<time_t>(seconds);
+
+    strftime(date, size, "%Y-%m-%d %H:%M:%S", gmtime(&t));
+    return date;
+}
+
+static void printEntry(const log_entry_t &entry) {
+    char date[32];
+
+    printf("%u,%u,%u,%u  # %s %s %s\n", entry.time, entry.moisture_raw,
+            entry.pump, entry.mode, formatDate(entry.time, date, sizeof(date)),
+            entry.pump ? "ON" : "OFF", entry.mode ? "MANUAL" : "AUTO");
+}
+
+static void dumpHistory(DumpState &s, const proto_frame_t &f) {
+    if (f.len == 0) {
+        s.exports++;
+        s.history_open = false;
+        return;
+    }
+    if (!s.history_open) {
+        printf("# minute history\n");
+        s.history_open = true;
+    }
+    ts_decoder_t dec;
+    ts_record_t r;
+    char date[32];
+
+    s.history_blocks++;
+    TsCodec_decoderInit(&dec, f.payload, f.len);
+    while (TsCodec_next(&dec, &r)) {
+        printf("%u,%u,%u  # %s %s\n", r.time, r.moisture_raw, r.pump,
+                formatDate(r.time, date, sizeof(date)), r.pump ? "ON" : "OFF");
+        s.history_records++;
+    }
+}
+
+static void dumpFrame(DumpState &s, const proto_frame_t &f) {
+    if (f.len == 0) {
+        /* End of an export; the next one starts over */
+        s.exports++;
+        LogRecord_reset(&s.codec);
+        return;
+    }
+    if (f.len % LOG_SLOT_SIZE != 0) {
+        s.bad_frames++;
+        return;
+    }
+    for (uint8_t i = 0; i < f.len; i += LOG_SLOT_SIZE) {
+        uint32_t seq;
+        log_entry_t entry;
+        switch (LogRecord_decode(&s.codec, &f.payload[i], &seq, &entry)) {
+        case LOG_SLOT_HEADER:
+            printf("# sector %u\n", seq);
+            break;
+        case LOG_SLOT_ENTRY:
+            printEntry(entry);
+            s.records++;
+            break;
+        case LOG_SLOT_INVALID:
+            s.invalid++;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.bin\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    DumpState state = {};
+    LogRecord_reset(&state.codec);
+    labview::Demux demux;
+    auto on_frame = [&](proto_channel_t, const proto_frame_t &f) {
+        if (f.msg_id == PROTO_MSG_LOG_DUMP) {
+            dumpFrame(state, f);
+        } else if (f.msg_id == PROTO_MSG_HISTORY) {
+            dumpHistory(state, f);
+        }
+    };
+    auto on_text = [&](const char *line) {
+        if (strcmp(line, "LOG,END") == 0 || strcmp(line, "HIST,END") == 0) {
+            state.exports++;
+        } else if (strncmp(line, "LOG,", 4) == 0) {
+            printf("%s\n", line + 4);
+            state.records++;
+        } else if (strncmp(line, "HIST,", 5) == 0) {
+            printf("%s\n", line + 5);
+            state.history_records++;
+        }
+    };
+
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        demux.feed(buffer, n, on_frame, on_text);
+    }
+    demux.finish(on_frame, on_text);
+    fclose(in);
+
+    fprintf(stderr, "%u records, %u invalid slots, %u bad frames, "
+            "%u history records in %u blocks, %u complete exports\n",
+            state.records, state.invalid, state.bad_frames,
+            state.history_records, state.history_blocks, state.exports);
+    return EXIT_SUCCESS;
+}
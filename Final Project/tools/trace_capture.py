@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Captures an event trace from the board as a Chrome trace JSON file.
+
+Text protocol, straight from the serial port (Linux/macOS, stdlib only):
+
+    trace_capture.py /dev/ttyACM0 -o trace.json [--baud 115200] [--record 2]
+
+sends "TRACE 1", waits --record seconds, sends "TRACE" and keeps the
+export, from the "[" line to the line ending in "]". Telemetry lines sent
+meanwhile are skipped.
+
+Binary protocol: the export arrives as PROTO_MSG_LOG frames. Capture the
+link raw while sending the same two commands, split it with uart_demux and
+extract the trace from its log channel:
+
+    uart_demux capture.bin
+    trace_capture.py --from-demux capture.bin.log.txt -o trace.json
+
+Load the result in chrome://tracing or https://ui.perfetto.dev.
+"""
+import argparse
+import os
+import sys
+import termios
+import time
+
+BAUD_CONSTANTS = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+    230400: termios.B230400,
+}
+for _rate in (460800, 921600, 2000000):
+    if hasattr(termios, "B%d" % _rate):
+        BAUD_CONSTANTS[_rate] = getattr(termios, "B%d" % _rate)
+
+
+def open_port(path, baud):
+    """Opens the port raw, 8N1, without echo."""
+    if baud not in BAUD_CONSTANTS:
+        sys.exit("unsupported baud rate %d" % baud)
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                    # iflag
+    attrs[1] = 0                                    # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                    # lflag
+    attrs[4] = attrs[5] = BAUD_CONSTANTS[baud]
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1                     # 100 ms read timeout
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def read_lines(fd, timeout):
+    """Yields received lines until 'timeout' seconds pass without data."""
+    pending = b""
+    last = time.monotonic()
+    while time.monotonic() - last < timeout:
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            continue
+        last = time.monotonic()
+        pending += chunk
+        while b"\n" in pending:
+            line, pending = pending.split(b"\n", 1)
+            yield line.decode("ascii", "replace").strip("\r")
+
+
+def extract(lines):
+    """Keeps the export: from the "[" line to the line ending in "]"."""
+    trace = []
+    for line in lines:
+        if not trace:
+            if line == "[":
+                trace.append(line)
+            continue
+        if line.startswith("{"):
+            trace.append(line)
+            if line.endswith("]"):
+                return trace
+    return None
+
+
+def demux_log_lines(path):
+    """Payloads of the LOG frames in a uart_demux log channel file."""
+    with open(path, encoding="ascii", errors="replace") as f:
+        for line in f:
+            marker = line.find(" LOG ")
+            if marker >= 0:
+                yield line[marker + 5:].rstrip("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("port", nargs="?", help="serial device")
+    parser.add_argument("-o", "--output", default="trace.json")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--record", type=float, default=2.0,
+                        help="seconds to record before exporting")
+    parser.add_argument("--from-demux", metavar="LOG_TXT",
+                        help="uart_demux log channel of a binary capture")
+    args = parser.parse_args()
+
+    if args.from_demux:
+        trace = extract(demux_log_lines(args.from_demux))
+    elif args.port:
+        fd = open_port(args.port, args.baud)
+        os.write(fd, b"TRACE 1\n")
+        time.sleep(args.record)
+        termios.tcflush(fd, termios.TCIFLUSH)
+        os.write(fd, b"TRACE\n")
+        trace = extract(read_lines(fd, timeout=2.0))
+        os.close(fd)
+    else:
+        parser.error("give a serial port or --from-demux")
+
+    if trace is None:
+        sys.exit("no complete trace export found")
+    with open(args.output, "w") as f:
+        f.write("\n".join(trace) + "\n")
+    print("%s: %d records" % (args.output, len(trace) - 1))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+/*
+ * uart_demux: splits a raw USART2 capture into one file per logical
+ * channel, for inspection.
+ *
+ * Capture the link raw, e.g. on Linux:
+ *     stty -F /dev/ttyACM0 115200 raw -echo
+ *     cat /dev/ttyACM0 > capture.bin
+ * then:
+ *     uart_demux capture.bin [prefix]
+ * writes prefix.control.txt, prefix.telemetry.txt, prefix.log.txt and
+ * prefix.bulk.txt (prefix defaults to the capture name) and prints the
+ * frame and byte counts per channel.
+ */
+#include "uart_demux.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static const char *const channel_names[] = {
+    "control", "telemetry", "log", "bulk"
+};
+
+struct ChannelOut {
+    FILE *file;
+    uint32_t frames;
+    uint32_t bytes;
+};
+
+static void writeFrame(ChannelOut &out, const proto_frame_t &f) {
+    proto_telemetry_t t;
+
+    out.frames++;
+    out.bytes += f.len;
+    fprintf(out.file, "seq=%3u id=0x%02x len=%2u ", f.seq, f.msg_id, f.len);
+    if (labview::unpackTelemetry(f, t)) {
+        fprintf(out.file, "TELEMETRY t=%u ms raw=%u %u%% mode=%u pump=%u "
+                "%02u:%02u:%02u\n", t.timestamp_ms, t.moisture_raw,
+                t.moisture_percent, t.mode, t.pump, t.hours, t.minutes,
+                t.seconds);
+        return;
+    }
+    if (f.msg_id == PROTO_MSG_LOG) {
+        fprintf(out.file, "LOG %.*s\n", f.len, reinterpret_cast<const char*>(f.payload));
+        return;
+    }
+    for (uint8_t i = 0; i < f.len; i++) {
+        fprintf(out.file, "%02x", f.payload[i]);
+    }
+    fputc('\n', out.file);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.bin [prefix]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    std::string prefix = (argc > 2) ? argv[2] : argv[1];
+
+    ChannelOut out[4] = {};
+    for (int c = 0; c < 4; c++) {
+        std::string path = prefix + "." + channel_names[c] + ".txt";
+        out[c].file = fopen(path.c_str(), "w");
+        if (!out[c].file) {
+            perror(path.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    labview::Demux demux;
+    uint32_t text_lines = 0;
+    auto on_frame = [&](proto_channel_t channel, const proto_frame_t &f) {
+        writeFrame(out[channel & 3], f);
+    };
+    auto on_text = [&](const char *line) {
+        text_lines++;
+        fprintf(out[PROTO_CH_TELEMETRY].file, "TEXT %s\n", line);
+    };
+
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        demux.feed(buffer, n, on_frame, on_text);
+    }
+    demux.finish(on_frame, on_text);
+    fclose(in);
+
+    for (int c = 0; c < 4; c++) {
+        printf("%-9s %8u frames %10u payload bytes\n", channel_names[c],
+                out[c].frames, out[c].bytes);
+        fclose(out[c].file);
+    }
+    printf("text      %8u lines\n", text_lines);
+    printf("bad       %8u chunks\n", demux.badChunks());
+    return EXIT_SUCCESS;
+}
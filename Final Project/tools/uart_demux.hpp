@@ -0,0 +1,136 @@
+#ifndef UART_DEMUX_HPP_
+#define UART_DEMUX_HPP_
+
+/*
+ * Splits a captured USART2 byte stream back into its logical channels.
+ *
+ * The firmware interleaves binary frames (0x00 | COBS | 0x00) with legacy
+ * text lines, which never contain 0x00. Every run of bytes between two
+ * 0x00 is therefore either one frame or a piece of text: it is decoded as
+ * a frame first, and taken as text lines if that fails. Text lines belong
+ * to PROTO_CH_TELEMETRY.
+ */
+
+#include "labview_proto.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace labview {
+
+class Demux {
+public:
+    /* Longest text line kept; longer lines are cut */
+    static const size_t kLineMax = 256;
+
+    Demux() : chunk_len_(0), line_len_(0), text_(false), bad_(0) {
+    }
+
+    /**
+     * @brief Feeds captured bytes.
+     * @param on_frame Called as on_frame(proto_channel_t, const proto_frame_t &)
+     * @param on_text Called as on_text(const char *line) per text line
+     */
+    template<typename OnFrame, typename OnText>
+    void feed(const uint8_t *data, size_t length, OnFrame &&on_frame,
+            OnText &&on_text) {
+        for (size_t i = 0; i < length; i++) {
+            uint8_t byte = data[i];
+            if (byte == 0x00) {
+                endChunk(on_frame, on_text);
+            } else if (text_) {
+                putText(byte, on_text);
+            } else if (chunk_len_ < sizeof(chunk_)) {
+                chunk_[chunk_len_++] = byte;
+            } else {
+                /* Too long for a frame: it is text */
+                text_ = true;
+                for (size_t j = 0; j < chunk_len_; j++) {
+                    putText(chunk_[j], on_text);
+                }
+                chunk_len_ = 0;
+                putText(byte, on_text);
+            }
+        }
+    }
+
+    /**
+     * @brief Handles bytes left at the end of the capture.
+     */
+    template<typename OnFrame, typename OnText>
+    void finish(OnFrame &&on_frame, OnText &&on_text) {
+        endChunk(on_frame, on_text);
+    }
+
+    /**
+     * @brief Runs between delimiters that were neither a frame nor text.
+     */
+    uint32_t badChunks() const {
+        return bad_;
+    }
+
+private:
+    template<typename OnFrame, typename OnText>
+    void endChunk(OnFrame &on_frame, OnText &on_text) {
+        if (text_) {
+            flushLine(on_text);
+            text_ = false;
+            return;
+        }
+        if (chunk_len_ == 0) {
+            return;
+        }
+        /* The decoder is idle after every delimiter */
+        static const uint8_t delimiter = 0x00;
+        decoder_.feed(chunk_, chunk_len_, [](const proto_frame_t&) {});
+        size_t frames = decoder_.feed(&delimiter, 1,
+                [&](const proto_frame_t &f) {
+            on_frame(channelOf(f.msg_id), f);
+        });
+        if (frames == 0) {
+            bool printable = true;
+            for (size_t j = 0; j < chunk_len_ && printable; j++) {
+                printable = chunk_[j] >= 0x20 || chunk_[j] == '\r'
+                        || chunk_[j] == '\n' || chunk_[j] == '\t';
+            }
+            if (printable) {
+                for (size_t j = 0; j < chunk_len_; j++) {
+                    putText(chunk_[j], on_text);
+                }
+                flushLine(on_text);
+            } else {
+                bad_++;
+            }
+        }
+        chunk_len_ = 0;
+    }
+
+    template<typename OnText>
+    void putText(uint8_t byte, OnText &on_text) {
+        if (byte == '\r' || byte == '\n') {
+            flushLine(on_text);
+        } else if (line_len_ < kLineMax) {
+            line_[line_len_++] = static_cast<char>(byte);
+        }
+    }
+
+    template<typename OnText>
+    void flushLine(OnText &on_text) {
+        if (line_len_ > 0) {
+            line_[line_len_] = '\0';
+            on_text(static_cast<const char*>(line_));
+            line_len_ = 0;
+        }
+    }
+
+    FrameDecoder decoder_;
+    uint8_t chunk_[PROTO_MAX_WIRE];
+    size_t chunk_len_;
+    char line_[kLineMax + 1];
+    size_t line_len_;
+    bool text_;
+    uint32_t bad_;
+};
+
+} // namespace labview
+
+#endif /* UART_DEMUX_HPP_ */